@@ -5,6 +5,8 @@
 // 1) FBX SDK 2020.2 ߸µİ汾
 // 2) ȷinclude fbxsdk.h
 // 3) ĵַȷȷ
+// NOTE: nidhog_import (see CMakeLists.txt) links the SDK libraries itself.
+#ifndef NIDHOG_IMPORT_FBX
 #if _DEBUG
 #pragma comment (lib, "D:\\FBX_SDK_2020_2\\lib\\vs2019\\x64\\debug\\libfbxsdk-md.lib")
 #pragma comment (lib, "D:\\FBX_SDK_2020_2\\lib\\vs2019\\x64\\debug\\libxml2-md.lib")
@@ -14,6 +16,7 @@
 #pragma comment (lib, "D:\\FBX_SDK_2020_2\\lib\\vs2019\\x64\\release\\libxml2-md.lib")
 #pragma comment (lib, "D:\\FBX_SDK_2020_2\\lib\\vs2019\\x64\\release\\zlib-md.lib")
 #endif
+#endif
 // LNK4099 PDB ͨ installing FBX SDK PDBs (separate download) 
 // ֱӽ
 
@@ -334,28 +337,16 @@ namespace nidhog::tools {
         return true;
     }
 
-    //FBX contextݣpackݲظeditor
-    EDITOR_INTERFACE void ImportFbx(const char* file, scene_data* data)
+    // NOTE: doesn't process or pack the scene (see SceneImporters.cpp), so it can also be used to measure reading on its own.
+    bool import_fbx(const char* file, scene& scene, scene_data& data)
     {
-        assert(file && data);
-        scene scene{};
-
+        assert(file);
         // NOTE: κ漰ʹ FBX SDK ݶӦǵ̵߳ģֲ֧߳У
-        {
-            std::lock_guard lock{ fbx_mutex };
-            fbx_context fbx_context{ file, &scene, data };
-            if (fbx_context.is_valid())
-            {
-                fbx_context.get_scene();
-            }
-            else
-            {
-                // TODO: send failure log message to editor
-                return;
-            }
-        }
+        std::lock_guard lock{ fbx_mutex };
+        fbx_context fbx_context{ file, &scene, &data };
+        if (!fbx_context.is_valid()) return false;
 
-        process_scene(scene, data->settings);
-        pack_data(scene, *data);
+        fbx_context.get_scene();
+        return true;
     }
 }
@@ -28,7 +28,7 @@ namespace nidhog::tools {
         {
             _fbx_scene->Destroy();
             _fbx_manager->Destroy();
-            ZeroMemory(this, sizeof(fbx_context));
+            memset(this, 0, sizeof(fbx_context));
         }
 
         void get_scene(FbxNode* root = nullptr);
@@ -52,4 +52,8 @@ namespace nidhog::tools {
         f32                         _scene_scale{ 1.0f };
     };
 
+    // Reads an FBX file into a scene. If the file has no normals or tangents, they're flagged to be calculated in
+    // data.settings. Returns false if the file can't be read.
+    bool import_fbx(const char* file, scene& scene, scene_data& data);
+
 }
\ No newline at end of file
@@ -1,5 +1,13 @@
 #include "Geometry.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexCompression.h"
+#include "MeshletBuilder.h"
+#include "MappedFile.h"
 #include "Utilities/IOStream.h"
+#include <chrono>
+#include <cstdarg>
+#include <filesystem>
 
 namespace nidhog::tools
 {
@@ -34,8 +42,43 @@ namespace nidhog::tools
             }
         }
 
+        // Groups the references (positions in the index buffer) to each vertex with a counting sort.
+        // The references of vertex i are refs[offsets[i] .. offsets[i + 1]), in index buffer order.
+        void build_vertex_refs(const utl::vector<u32>& indices, u32 num_vertices, utl::vector<u32>& offsets, utl::vector<u32>& refs)
+        {
+            const u32 num_indices{ (u32)indices.size() };
+            offsets.resize(num_vertices + 1);
+            memset(offsets.data(), 0, offsets.size() * sizeof(u32));
+            for (u32 i{ 0 }; i < num_indices; ++i) ++offsets[indices[i] + 1];
+            for (u32 i{ 0 }; i < num_vertices; ++i) offsets[i + 1] += offsets[i];
+
+            utl::vector<u32> cursors(num_vertices);
+            memcpy(cursors.data(), offsets.data(), num_vertices * sizeof(u32));
+            refs.resize(num_indices);
+            for (u32 i{ 0 }; i < num_indices; ++i) refs[cursors[indices[i]]++] = i;
+        }
+
+        // Turns per-vertex cluster counts into the id of each vertex's first new vertex. Returns the total.
+        u32 cluster_base_ids(utl::vector<u32>& cluster_counts)
+        {
+            u32 total{ 0 };
+            for (auto& count : cluster_counts)
+            {
+                const u32 c{ count };
+                count = total;
+                total += c;
+            }
+
+            return total;
+        }
+
         //ֻǼ򵥸ߺЩǶӦñΪsoftЩhard
         //Ҫʹcosжϣ
+        // NOTE: the references of each vertex are clustered greedily, in index buffer order: the first remaining
+        //       reference starts a cluster and pulls in all later references that match it. That's O(refs * clusters)
+        //       per vertex rather than O(refs^2), and remaining references are compacted instead of erased.
+        //       Vertices are independent of each other, so they're processed in parallel, and new vertices are
+        //       numbered by a prefix sum over the cluster counts, which keeps the output order deterministic.
         void process_normals(mesh& m, f32 smoothing_angle)
         {
             const f32 cos_alpha{ XMScalarCos(pi - smoothing_angle * pi / 180.f) };
@@ -45,114 +88,415 @@ namespace nidhog::tools
             const u32 num_vertices{ (u32)m.positions.size() };
             assert(num_indices && num_vertices);
 
-            m.indices.resize(num_indices);
+            utl::vector<u32> offsets;
+            utl::vector<u32> refs;
+            build_vertex_refs(m.raw_indices, num_vertices, offsets, refs);
 
-            //Ϊӿٶȣֻһ
-            utl::vector<utl::vector<u32>> idx_ref(num_vertices);
-            for (u32 i{ 0 }; i < num_indices; ++i)
-                idx_ref[m.raw_indices[i]].emplace_back(i);
+            utl::vector<u32> cluster_counts(num_vertices);
+            utl::vector<u32> clusters(num_indices);         // cluster of each reference, relative to its vertex
+            utl::vector<v3> cluster_normals(num_indices);   // normals of vertex i's clusters start at offsets[i]
 
-            for (u32 i{ 0 }; i < num_vertices; ++i)
-            {
-                auto& refs{ idx_ref[i] };
-                u32 num_refs{ (u32)refs.size() };
-                for (u32 j{ 0 }; j < num_refs; ++j)
+            parallel_for(num_vertices, [&](u32 begin, u32 end) {
+                utl::vector<u32> pending;
+                for (u32 i{ begin }; i < end; ++i)
                 {
-                    m.indices[refs[j]] = (u32)m.vertices.size();
-                    //ض¶
-                    vertex& v{ m.vertices.emplace_back() };
-                    v.position = m.positions[m.raw_indices[refs[j]]];
+                    u32 num_pending{ offsets[i + 1] - offsets[i] };
+                    pending.resize(num_pending);
+                    memcpy(pending.data(), &refs[offsets[i]], num_pending * sizeof(u32));
 
-                    //жǷεĶƽ
-                    XMVECTOR n1{ XMLoadFloat3(&m.normals[refs[j]]) };
-                    if (!is_hard_edge)
+                    u32 cluster{ 0 };
+                    while (num_pending)
                     {
-                        for (u32 k{ j + 1 }; k < num_refs; ++k)
+                        const u32 head{ pending[0] };
+                        clusters[head] = cluster;
+                        XMVECTOR n1{ XMLoadFloat3(&m.normals[head]) };
+                        u32 remaining{ 0 };
+                        for (u32 k{ 1 }; k < num_pending; ++k)
                         {
-                            // ֵʾ֮Ƕȵҡ
-                            f32 cos_theta{ 0.f };
-                            XMVECTOR n2{ XMLoadFloat3(&m.normals[refs[k]]) };
-                            if (!is_soft_edge)
+                            const u32 ref{ pending[k] };
+                            bool merge{ false };
+                            if (!is_hard_edge)
                             {
-                                // NOTE: пn1ĳ
-                                //       Ϊѭз仯
-                                //       Ǽٶn2Ϊλ
-                                //       cos(angle) = dot(n1, n2) / (||n1||*||n2||)
-                                XMStoreFloat(&cos_theta, XMVector3Dot(n1, n2) * XMVector3ReciprocalLength(n1));
-                            }
-
-                            //鷨֮нжǷӻֿ
+                                // This value is the cosine of the angle between the normals.
+                                f32 cos_theta{ 0.f };
+                                XMVECTOR n2{ XMLoadFloat3(&m.normals[ref]) };
+                                if (!is_soft_edge)
+                                {
+                                    // NOTE: we take the length of n1 into account, because it changes as normals are added.
+                                    //       n2 is assumed to be of unit length.
+                                    //       cos(angle) = dot(n1, n2) / (||n1||*||n2||)
+                                    XMStoreFloat(&cos_theta, XMVector3Dot(n1, n2) * XMVector3ReciprocalLength(n1));
+                                }
 
-                            //ƽ
-                            if (is_soft_edge || cos_theta >= cos_alpha)
-                            {
-                                n1 += n2;
-                                //ͬ
-                                m.indices[refs[k]] = m.indices[refs[j]];
-                                refs.erase(refs.begin() + k);
-                                //
-                                --num_refs;
-                                --k;
+                                merge = is_soft_edge || cos_theta >= cos_alpha;
+                                if (merge) n1 += n2;
                             }
+
+                            if (merge) clusters[ref] = cluster;
+                            else pending[remaining++] = ref;
                         }
+
+                        XMStoreFloat3(&cluster_normals[offsets[i] + cluster], XMVector3Normalize(n1));
+                        ++cluster;
+                        num_pending = remaining;
                     }
-                    XMStoreFloat3(&v.normal, XMVector3Normalize(n1));
+
+                    cluster_counts[i] = cluster;
                 }
-            }
+            });
+
+            const u32 new_vertex_count{ cluster_base_ids(cluster_counts) };
+            m.vertices.resize(new_vertex_count);
+            m.indices.resize(num_indices);
+
+            parallel_for(num_vertices, [&](u32 begin, u32 end) {
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    const u32 base{ cluster_counts[i] };
+                    const u32 count{ (i + 1 < num_vertices ? cluster_counts[i + 1] : new_vertex_count) - base };
+                    for (u32 c{ 0 }; c < count; ++c)
+                    {
+                        vertex& v{ m.vertices[base + c] };
+                        v.position = m.positions[i];
+                        v.normal = cluster_normals[offsets[i] + c];
+                    }
+
+                    for (u32 j{ offsets[i] }; j < offsets[i + 1]; ++j)
+                    {
+                        m.indices[refs[j]] = base + clusters[refs[j]];
+                    }
+                }
+            });
         }
 
+        // NOTE: same scheme as process_normals(), except that references are matched against the UV of the
+        //       reference that started the cluster.
         void process_uvs(mesh& m)
         {
-            //žɶ
             utl::vector<vertex> old_vertices;
             old_vertices.swap(m.vertices);
-            utl::vector<u32> old_indices(m.indices.size());
+            utl::vector<u32> old_indices;
             old_indices.swap(m.indices);
 
             const u32 num_vertices{ (u32)old_vertices.size() };
             const u32 num_indices{ (u32)old_indices.size() };
             assert(num_vertices && num_indices);
 
-            //Ϊӿٶȣֻһÿ㣩
-            utl::vector<utl::vector<u32>> idx_ref(num_vertices);
-            for (u32 i{ 0 }; i < num_indices; ++i)
-                idx_ref[old_indices[i]].emplace_back(i);
+            utl::vector<u32> offsets;
+            utl::vector<u32> refs;
+            build_vertex_refs(old_indices, num_vertices, offsets, refs);
 
-            for (u32 i{ 0 }; i < num_vertices; ++i)
-            {
-                auto& refs{ idx_ref[i] };
-                u32 num_refs{ (u32)refs.size() };
-                for (u32 j{ 0 }; j < num_refs; ++j)
+            utl::vector<u32> cluster_counts(num_vertices);
+            utl::vector<u32> clusters(num_indices);
+            utl::vector<u32> cluster_heads(num_indices);    // reference that started each cluster
+            const utl::vector<v2>& uvs{ m.uv_sets[0] };
+
+            parallel_for(num_vertices, [&](u32 begin, u32 end) {
+                utl::vector<u32> pending;
+                for (u32 i{ begin }; i < end; ++i)
                 {
-                    m.indices[refs[j]] = (u32)m.vertices.size();
-                    vertex& v{ old_vertices[old_indices[refs[j]]] };
-                    v.uv = m.uv_sets[0][refs[j]];
-                    m.vertices.emplace_back(v);
+                    u32 num_pending{ offsets[i + 1] - offsets[i] };
+                    pending.resize(num_pending);
+                    memcpy(pending.data(), &refs[offsets[i]], num_pending * sizeof(u32));
 
-                    //ֶ
-                    for (u32 k{ j + 1 }; k < num_refs; ++k)
+                    u32 cluster{ 0 };
+                    while (num_pending)
                     {
-                        v2& uv1{ m.uv_sets[0][refs[k]] };
-                        if (XMScalarNearEqual(v.uv.x, uv1.x, epsilon) &&
-                            XMScalarNearEqual(v.uv.y, uv1.y, epsilon))
+                        const u32 head{ pending[0] };
+                        const v2& uv0{ uvs[head] };
+                        clusters[head] = cluster;
+                        cluster_heads[offsets[i] + cluster] = head;
+                        u32 remaining{ 0 };
+                        for (u32 k{ 1 }; k < num_pending; ++k)
                         {
-                            m.indices[refs[k]] = m.indices[refs[j]];
-                            refs.erase(refs.begin() + k);
-                            --num_refs;
-                            --k;
+                            const u32 ref{ pending[k] };
+                            const v2& uv1{ uvs[ref] };
+                            if (XMScalarNearEqual(uv0.x, uv1.x, epsilon) &&
+                                XMScalarNearEqual(uv0.y, uv1.y, epsilon))
+                            {
+                                clusters[ref] = cluster;
+                            }
+                            else
+                            {
+                                pending[remaining++] = ref;
+                            }
                         }
+
+                        ++cluster;
+                        num_pending = remaining;
+                    }
+
+                    cluster_counts[i] = cluster;
+                }
+            });
+
+            const u32 new_vertex_count{ cluster_base_ids(cluster_counts) };
+            m.vertices.resize(new_vertex_count);
+            m.indices.resize(num_indices);
+
+            parallel_for(num_vertices, [&](u32 begin, u32 end) {
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    const u32 base{ cluster_counts[i] };
+                    const u32 count{ (i + 1 < num_vertices ? cluster_counts[i + 1] : new_vertex_count) - base };
+                    for (u32 c{ 0 }; c < count; ++c)
+                    {
+                        vertex& v{ m.vertices[base + c] };
+                        v = old_vertices[i];
+                        v.uv = uvs[cluster_heads[offsets[i] + c]];
+                    }
+
+                    for (u32 j{ offsets[i] }; j < offsets[i + 1]; ++j)
+                    {
+                        m.indices[refs[j]] = base + clusters[refs[j]];
+                    }
+                }
+            });
+        }
+
+        // Per-corner tangent contribution. sign is the handedness of the UV mapping (+1 or -1).
+        struct corner_tangent
+        {
+            v3  tangent;
+            f32 sign;
+        };
+
+        // Orthonormalizes t against n. Falls back to any vector perpendicular to n if t is degenerate.
+        XMVECTOR orthonormalize_tangent(XMVECTOR n, XMVECTOR t)
+        {
+            t = t - n * XMVector3Dot(n, t);
+            if (XMVectorGetX(XMVector3LengthSq(t)) > 1e-12f) return XMVector3Normalize(t);
+            const XMVECTOR axis{ fabsf(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1.f, 0.f, 0.f, 0.f) : XMVectorSet(0.f, 1.f, 0.f, 0.f) };
+            return XMVector3Normalize(XMVector3Cross(XMVector3Cross(n, axis), n));
+        }
+
+        // Sums the corner tangents of every vertex and stores the result in vertex::tangent, with the handedness in w.
+        // Vertices whose corners disagree on handedness (mirrored UVs) are split in two, so each half gets a
+        // consistent tangent frame. Runs in parallel over vertices; split vertices are appended in vertex order.
+        void accumulate_tangents(mesh& m, const utl::vector<corner_tangent>& corners)
+        {
+            const u32 num_vertices{ (u32)m.vertices.size() };
+            const u32 num_indices{ (u32)m.indices.size() };
+            assert(corners.size() == num_indices);
+
+            utl::vector<u32> offsets;
+            utl::vector<u32> refs;
+            build_vertex_refs(m.indices, num_vertices, offsets, refs);
+
+            utl::vector<v3> mirrored_tangents(num_vertices);
+            utl::vector<u32> split_counts(num_vertices);
+
+            parallel_for(num_vertices, [&](u32 begin, u32 end) {
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    XMVECTOR sums[2]{ XMVectorZero(), XMVectorZero() };
+                    u32 counts[2]{ 0, 0 };
+                    for (u32 j{ offsets[i] }; j < offsets[i + 1]; ++j)
+                    {
+                        const corner_tangent& c{ corners[refs[j]] };
+                        const u32 side{ c.sign < 0.f ? 1u : 0u };
+                        sums[side] += XMLoadFloat3(&c.tangent);
+                        ++counts[side];
+                    }
+
+                    // NOTE: the vertex keeps the handedness most of its corners agree on.
+                    const u32 major{ counts[1] > counts[0] ? 1u : 0u };
+                    vertex& v{ m.vertices[i] };
+                    const XMVECTOR n{ XMLoadFloat3(&v.normal) };
+                    XMStoreFloat4(&v.tangent, XMVectorSetW(orthonormalize_tangent(n, sums[major]), major ? -1.f : 1.f));
+
+                    split_counts[i] = counts[major ^ 1] ? 1 : 0;
+                    if (split_counts[i])
+                    {
+                        XMStoreFloat3(&mirrored_tangents[i], orthonormalize_tangent(n, sums[major ^ 1]));
+                    }
+                }
+            });
+
+            const u32 num_splits{ cluster_base_ids(split_counts) };
+            if (!num_splits) return;
+
+            m.vertices.resize(num_vertices + num_splits);
+            parallel_for(num_vertices, [&](u32 begin, u32 end) {
+                for (u32 i{ begin }; i < end; ++i)
+                {
+                    const bool is_split{ (i + 1 < num_vertices ? split_counts[i + 1] : num_splits) != split_counts[i] };
+                    if (!is_split) continue;
+
+                    const u32 new_index{ num_vertices + split_counts[i] };
+                    vertex& v{ m.vertices[new_index] };
+                    v = m.vertices[i];
+                    v.tangent = { mirrored_tangents[i].x, mirrored_tangents[i].y, mirrored_tangents[i].z, -m.vertices[i].tangent.w };
+
+                    for (u32 j{ offsets[i] }; j < offsets[i + 1]; ++j)
+                    {
+                        if (corners[refs[j]].sign != v.tangent.w) continue;
+                        m.indices[refs[j]] = new_index;
+                    }
+                }
+            });
+        }
+
+        // Generates tangents from UV derivatives, weighted by corner angle like MikkTSpace does.
+        // Every triangle is handled independently, in parallel, before they're accumulated per (welded) vertex.
+        void calculate_tangents(mesh& m)
+        {
+            const u32 num_indices{ (u32)m.indices.size() };
+            assert(num_indices && (num_indices % 3) == 0);
+            utl::vector<corner_tangent> corners(num_indices);
+
+            parallel_for(num_indices / 3, [&](u32 begin, u32 end) {
+                for (u32 t{ begin }; t < end; ++t)
+                {
+                    const vertex* v[3]{ &m.vertices[m.indices[t * 3]], &m.vertices[m.indices[t * 3 + 1]], &m.vertices[m.indices[t * 3 + 2]] };
+                    const XMVECTOR p[3]{ XMLoadFloat3(&v[0]->position), XMLoadFloat3(&v[1]->position), XMLoadFloat3(&v[2]->position) };
+                    const XMVECTOR e1{ p[1] - p[0] };
+                    const XMVECTOR e2{ p[2] - p[0] };
+                    const f32 du1{ v[1]->uv.x - v[0]->uv.x }, dv1{ v[1]->uv.y - v[0]->uv.y };
+                    const f32 du2{ v[2]->uv.x - v[0]->uv.x }, dv2{ v[2]->uv.y - v[0]->uv.y };
+                    const f32 det{ du1 * dv2 - du2 * dv1 };
+
+                    // NOTE: degenerate UVs don't contribute. Their vertices fall back to an arbitrary tangent
+                    //       if nothing else contributes either.
+                    XMVECTOR tangent{ XMVectorZero() };
+                    f32 sign{ 1.f };
+                    if (fabsf(det) > 1e-20f)
+                    {
+                        tangent = XMVector3Normalize((e1 * dv2 - e2 * dv1) * (1.f / det));
+                        sign = det < 0.f ? -1.f : 1.f;
+                    }
+
+                    for (u32 i{ 0 }; i < 3; ++i)
+                    {
+                        const XMVECTOR a{ XMVector3Normalize(p[(i + 1) % 3] - p[i]) };
+                        const XMVECTOR b{ XMVector3Normalize(p[(i + 2) % 3] - p[i]) };
+                        const f32 angle{ XMVectorGetX(XMVector3AngleBetweenNormals(a, b)) };
+                        corner_tangent& c{ corners[t * 3 + i] };
+                        XMStoreFloat3(&c.tangent, tangent * angle);
+                        c.sign = sign;
                     }
                 }
+            }, 256);
+
+            accumulate_tangents(m, corners);
+        }
+
+        // Uses the tangents that came with the imported mesh (one per index, like normals).
+        void process_tangents(mesh& m)
+        {
+            const u32 num_indices{ (u32)m.indices.size() };
+            assert(m.tangents.size() == num_indices);
+            utl::vector<corner_tangent> corners(num_indices);
+            for (u32 i{ 0 }; i < num_indices; ++i)
+            {
+                const v4& t{ m.tangents[i] };
+                corners[i] = { { t.x, t.y, t.z }, t.w < 0.f ? -1.f : 1.f };
+            }
+
+            accumulate_tangents(m, corners);
+        }
+
+        // Drops the triangles that a chunk only has for the neighborhood of its border vertices (see mesh::halo).
+        // The vertices that only they referenced are dropped by optimize_vertices().
+        void remove_halo_triangles(mesh& m)
+        {
+            const u32 num_triangles{ (u32)m.indices.size() / 3 };
+            assert(m.halo.size() == num_triangles);
+            u32 count{ 0 };
+            for (u32 t{ 0 }; t < num_triangles; ++t)
+            {
+                if (m.halo[t]) continue;
+                if (count != t) memcpy(&m.indices[count * 3], &m.indices[t * 3], 3 * sizeof(u32));
+                ++count;
+            }
+
+            assert(count);
+            m.indices.resize(count * 3);
+            m.halo.clear();
+        }
+
+        // Writes a line of import statistics to the debug output, but only if the import settings ask for it.
+        // All per-mesh statistics go through here, so importing doesn't log (or spend time on them) by default.
+        void report_stats(const geometry_import_settings& settings, const char* format, ...)
+        {
+            if (!settings.log_stats) return;
+            char message[512];
+            va_list args;
+            va_start(args, format);
+            vsprintf_s(message, format, args);
+            va_end(args);
+            OutputDebugStringA(message);
+        }
+
+        // Reorders triangles for the post-transform vertex cache and then vertices for fetch locality.
+        void optimize_vertices(mesh& m, const geometry_import_settings& settings)
+        {
+            const u32 num_vertices{ (u32)m.vertices.size() };
+            const vertex_cache_stats before{ settings.log_stats ? analyze_vertex_cache(m.indices, num_vertices) : vertex_cache_stats{} };
+
+            optimize_vertex_cache(m.indices, num_vertices);
+            optimize_vertex_fetch(m.vertices, m.indices);
+
+            if (!settings.log_stats) return;
+            const vertex_cache_stats after{ analyze_vertex_cache(m.indices, (u32)m.vertices.size()) };
+            report_stats(settings, "Vertex cache [%s]: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+                         m.name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+        }
+
+        // Removes the flags that don't change the layout of the element buffer.
+        elements::elements_type::type get_vertex_layout(elements::elements_type::type elements_type)
+        {
+            using namespace elements;
+            return (elements_type::type)(elements_type & ~(elements_type::quantized_position | elements_type::octahedral_tspace | elements_type::meshlets));
+        }
+
+        u64 get_position_size(elements::elements_type::type elements_type)
+        {
+            return (elements_type & elements::elements_type::quantized_position) ? sizeof(elements::packed_position) : sizeof(math::v3);
+        }
+
+        // Computes the AABB of the vertices and a bounding sphere around its center, like the meshlet bounds.
+        void compute_bounds(mesh& m)
+        {
+            const u32 num_vertices{ (u32)m.vertices.size() };
+            assert(num_vertices);
+            XMVECTOR min{ XMLoadFloat3(&m.vertices[0].position) };
+            XMVECTOR max{ min };
+            for (u32 i{ 1 }; i < num_vertices; ++i)
+            {
+                const XMVECTOR p{ XMLoadFloat3(&m.vertices[i].position) };
+                min = XMVectorMin(min, p);
+                max = XMVectorMax(max, p);
+            }
+
+            const XMVECTOR center{ (min + max) * 0.5f };
+            f32 radius_sq{ 0.f };
+            for (u32 i{ 0 }; i < num_vertices; ++i)
+            {
+                const XMVECTOR p{ XMLoadFloat3(&m.vertices[i].position) };
+                radius_sq = std::max(radius_sq, XMVectorGetX(XMVector3LengthSq(p - center)));
             }
+
+            XMStoreFloat3(&m.bounds_min, min);
+            XMStoreFloat3(&m.bounds_max, max);
+            XMStoreFloat3(&m.sphere_center, center);
+            m.sphere_radius = sqrtf(radius_sq);
+        }
+
+        // NOTE: the vertices themselves may have been released after packing (see release_unpacked_data()).
+        u32 get_packed_vertex_count(const mesh& m)
+        {
+            return (u32)(m.position_buffer.size() / get_position_size(m.elements_type));
         }
 
         u64 get_vertex_element_size(elements::elements_type::type elements_type)
         {
             using namespace elements;
-            switch (elements_type)
+            switch (get_vertex_layout(elements_type))
             {
             case elements_type::static_normal:                  return sizeof(static_normal);
             case elements_type::static_normal_texture:          return sizeof(static_normal_texture);
+            case elements_type::static_normal_texture_quaternion: return sizeof(static_normal_texture_quaternion);
             case elements_type::static_color:                   return sizeof(static_color);
             case elements_type::skeletal:                       return sizeof(skeletal);
             case elements_type::skeletal_color:                 return sizeof(skeletal_color);
@@ -166,181 +510,169 @@ namespace nidhog::tools
         }
 
 
-        //
-        void pack_vertices(mesh& m)
-        {
-            const u32 num_vertices{ (u32)m.vertices.size() };
-            assert(num_vertices);
-            
-            m.position_buffer.resize(sizeof(math::v3) * num_vertices);
-            math::v3* const position_buffer{ (math::v3* const)m.position_buffer.data() };
-
-            for (u32 i{ 0 }; i < num_vertices; ++i)
-            {
-                position_buffer[i] = m.vertices[i].position;
-            }
-
-            struct u16v2 { u16 x, y; };
-            struct u8v3 { u8 x, y, z; };
+        template<u32 layout> struct element_struct {};
+        template<> struct element_struct<elements::elements_type::static_color> { using type = elements::static_color; };
+        template<> struct element_struct<elements::elements_type::static_normal> { using type = elements::static_normal; };
+        template<> struct element_struct<elements::elements_type::static_normal_texture> { using type = elements::static_normal_texture; };
+        template<> struct element_struct<elements::elements_type::static_normal_texture_quaternion> { using type = elements::static_normal_texture_quaternion; };
+        template<> struct element_struct<elements::elements_type::skeletal> { using type = elements::skeletal; };
+        template<> struct element_struct<elements::elements_type::skeletal_color> { using type = elements::skeletal_color; };
+        template<> struct element_struct<elements::elements_type::skeletal_normal> { using type = elements::skeletal_normal; };
+        template<> struct element_struct<elements::elements_type::skeletal_normal_color> { using type = elements::skeletal_normal_color; };
+        template<> struct element_struct<elements::elements_type::skeletal_normal_texture> { using type = elements::skeletal_normal_texture; };
+        template<> struct element_struct<elements::elements_type::skeletal_normal_texture_color> { using type = elements::skeletal_normal_texture_color; };
 
-            utl::vector<u8> t_signs(num_vertices);
-            utl::vector<u16v2> normals(num_vertices);
-            utl::vector<u16v2> tangents(num_vertices);
-            utl::vector<u8v3> joint_weights(num_vertices);
+        // Converts vertices to the element struct of 'layout' in a single pass. Everything that depends on the
+        // layout is resolved at compile time, so the loop body is straight-line code without branches.
+        template<u32 layout, bool octahedral>
+        void pack_elements(const vertex* const vertices, u32 begin, u32 end, u8* const buffer)
+        {
+            using namespace elements;
+            using element = typename element_struct<layout>::type;
+            constexpr bool has_joints{ (layout & elements_type::skeletal) != 0 };
+            constexpr bool has_color{ !has_joints || (layout & elements_type::static_color) };
+            constexpr bool has_normal{ (layout & elements_type::static_normal) != 0 };
+            constexpr bool has_tangent{ (layout & elements_type::static_normal_texture) == elements_type::static_normal_texture };
+            constexpr bool quaternion{ (layout & elements_type::quaternion_tspace) != 0 };
+            static_assert(!quaternion || has_tangent);
 
-            if (m.elements_type & elements::elements_type::static_normal)
+            element* const element_buffer{ (element* const)buffer };
+            for (u32 i{ begin }; i < end; ++i)
             {
-                // normals only
-                for (u32 i{ 0 }; i < num_vertices; ++i)
-                {
-                    vertex& v{ m.vertices[i] };
-                    t_signs[i] = (u8)((v.normal.z > 0.f) << 1);
-                    normals[i] = { (u16)pack_float<16>(v.normal.x, -1.f, 1.f), (u16)pack_float<16>(v.normal.y, -1.f, 1.f) };
-                }
-
-                if (m.elements_type & elements::elements_type::static_normal_texture)
-                {
-                    // full T-space
-                    for (u32 i{ 0 }; i < num_vertices; ++i)
-                    {
-                        vertex& v{ m.vertices[i] };
-                        t_signs[i] |= (u8)((v.tangent.w > 0.f) && (v.tangent.z > 0.f));
-                        tangents[i] = { (u16)pack_float<16>(v.tangent.x, -1.f, 1.f), (u16)pack_float<16>(v.tangent.y, -1.f, 1.f) };
-                    }
-                }
-            }
+                const vertex& v{ vertices[i] };
+                element e{};
 
-            if (m.elements_type & elements::elements_type::skeletal)
-            {
-                for (u32 i{ 0 }; i < num_vertices; ++i)
+                if constexpr (has_joints)
                 {
-                    vertex& v{ m.vertices[i] };
                     // pack joint weights (from [0.0, 1.0] to [0..255])
-                    joint_weights[i] = {
-                        (u8)pack_unit_float<8>(v.joint_weights.x),
-                        (u8)pack_unit_float<8>(v.joint_weights.y),
-                        (u8)pack_unit_float<8>(v.joint_weights.z) };
-
                     // NOTE: w3 will be calculated in shader since joint weights sum to one(1).
+                    e.joint_weights[0] = (u8)pack_unit_float<8>(v.joint_weights.x);
+                    e.joint_weights[1] = (u8)pack_unit_float<8>(v.joint_weights.y);
+                    e.joint_weights[2] = (u8)pack_unit_float<8>(v.joint_weights.z);
+                    e.joint_indices[0] = (u16)v.joint_indices.x;
+                    e.joint_indices[1] = (u16)v.joint_indices.y;
+                    e.joint_indices[2] = (u16)v.joint_indices.z;
+                    e.joint_indices[3] = (u16)v.joint_indices.w;
                 }
-            }
 
-            m.element_buffer.resize(get_vertex_element_size(m.elements_type) * num_vertices);
-            using namespace elements;
-            //pack element bufferÿԭʼbufferתΪelements_type֮
-            switch (m.elements_type)
-            {
-            case elements_type::static_color:
-            {
-                static_color* const element_buffer{ (static_color* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
-                {
-                    vertex& v{ m.vertices[i] };
-                    element_buffer[i] = { {v.red, v.green, v.blue}, {} };
-                }
-            }
-            break;
-            case elements_type::static_normal:
-            {
-                static_normal* const element_buffer{ (static_normal* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
+                if constexpr (has_color)
                 {
-                    vertex& v{ m.vertices[i] };
-                    element_buffer[i] = { {v.red, v.green, v.blue}, t_signs[i], {normals[i].x, normals[i].y} };
+                    e.color[0] = v.red;
+                    e.color[1] = v.green;
+                    e.color[2] = v.blue;
                 }
-            }
-            break;
-            case elements_type::static_normal_texture:
-            {
-                static_normal_texture* const element_buffer{ (static_normal_texture* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
+
+                if constexpr (quaternion)
                 {
-                    vertex& v{ m.vertices[i] };
-                    element_buffer[i] = { {v.red, v.green, v.blue}, t_signs[i],
-                                         {normals[i].x, normals[i].y}, {tangents[i].x, tangents[i].y},
-                                         v.uv };
+                    e.t_sign = (u8)((v.tangent.w > 0.f) << 2);
+                    e.tbn = encode_tbn_quaternion(v.normal, { v.tangent.x, v.tangent.y, v.tangent.z });
                 }
-            }
-            break;
-            case elements_type::skeletal:
-            {
-                skeletal* const element_buffer{ (skeletal* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
+                else if constexpr (has_normal && octahedral)
                 {
-                    vertex& v{ m.vertices[i] };
-                    const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y , (u16)v.joint_indices.z , (u16)v.joint_indices.w };
-                    element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, {},
-                                         {indices[0], indices[1], indices[2], indices[3]} };
+                    encode_octahedral(v.normal, e.normal[0], e.normal[1]);
+                    if constexpr (has_tangent)
+                    {
+                        e.t_sign = (u8)((v.tangent.w > 0.f) << 2);
+                        encode_octahedral({ v.tangent.x, v.tangent.y, v.tangent.z }, e.tangent[0], e.tangent[1]);
+                    }
                 }
-            }
-            break;
-            case elements_type::skeletal_color:
-            {
-                skeletal_color* const element_buffer{ (skeletal_color* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
+                else if constexpr (has_normal)
                 {
-                    vertex& v{ m.vertices[i] };
-                    const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y , (u16)v.joint_indices.z , (u16)v.joint_indices.w };
-                    element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, {},
-                                         {indices[0], indices[1], indices[2], indices[3]},
-                                         {v.red, v.green, v.blue}, {} };
+                    e.t_sign = (u8)((v.normal.z > 0.f) << 1);
+                    e.normal[0] = (u16)pack_float<16>(v.normal.x, -1.f, 1.f);
+                    e.normal[1] = (u16)pack_float<16>(v.normal.y, -1.f, 1.f);
+                    if constexpr (has_tangent)
+                    {
+                        e.t_sign |= (u8)(v.tangent.z > 0.f) | (u8)((v.tangent.w > 0.f) << 2);
+                        e.tangent[0] = (u16)pack_float<16>(v.tangent.x, -1.f, 1.f);
+                        e.tangent[1] = (u16)pack_float<16>(v.tangent.y, -1.f, 1.f);
+                    }
                 }
-            }
-            break;
-            case elements_type::skeletal_normal:
-            {
-                skeletal_normal* const element_buffer{ (skeletal_normal* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
+
+                if constexpr (has_tangent)
                 {
-                    vertex& v{ m.vertices[i] };
-                    const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y , (u16)v.joint_indices.z , (u16)v.joint_indices.w };
-                    element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, t_signs[i],
-                                         {indices[0], indices[1], indices[2], indices[3]},
-                                         {normals[i].x, normals[i].y} };
+                    e.uv = v.uv;
                 }
+
+                element_buffer[i] = e;
             }
-            break;
-            case elements_type::skeletal_normal_color:
+        }
+
+        using element_packer = void(*)(const vertex* const, u32, u32, u8* const);
+
+        template<u32 layout>
+        element_packer get_element_packer(bool octahedral)
+        {
+            if (octahedral) return &pack_elements<layout, true>;
+            return &pack_elements<layout, false>;
+        }
+
+        element_packer get_element_packer(elements::elements_type::type elements_type)
+        {
+            using namespace elements;
+            const bool octahedral{ (elements_type & elements_type::octahedral_tspace) != 0 };
+            switch (get_vertex_layout(elements_type))
             {
-                skeletal_normal_color* const element_buffer{ (skeletal_normal_color* const)m.element_buffer.data() };
-                for (u32 i{ 0 }; i < num_vertices; ++i)
-                {
-                    vertex& v{ m.vertices[i] };
-                    const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y , (u16)v.joint_indices.z , (u16)v.joint_indices.w };
-                    element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, t_signs[i],
-                                         {indices[0], indices[1], indices[2], indices[3]},
-                                         {normals[i].x, normals[i].y}, {v.red, v.green, v.blue}, {} };
-                }
+            case elements_type::static_normal:                      return get_element_packer<elements_type::static_normal>(octahedral);
+            case elements_type::static_normal_texture:              return get_element_packer<elements_type::static_normal_texture>(octahedral);
+            case elements_type::static_normal_texture_quaternion:   return get_element_packer<elements_type::static_normal_texture_quaternion>(false);
+            case elements_type::static_color:                       return get_element_packer<elements_type::static_color>(false);
+            case elements_type::skeletal:                           return get_element_packer<elements_type::skeletal>(false);
+            case elements_type::skeletal_color:                     return get_element_packer<elements_type::skeletal_color>(false);
+            case elements_type::skeletal_normal:                    return get_element_packer<elements_type::skeletal_normal>(octahedral);
+            case elements_type::skeletal_normal_color:              return get_element_packer<elements_type::skeletal_normal_color>(octahedral);
+            case elements_type::skeletal_normal_texture:            return get_element_packer<elements_type::skeletal_normal_texture>(octahedral);
+            case elements_type::skeletal_normal_texture_color:      return get_element_packer<elements_type::skeletal_normal_texture_color>(octahedral);
             }
-            break;
-            case elements_type::skeletal_normal_texture:
+
+            return nullptr;
+        }
+
+        //
+        void pack_vertices(mesh& m)
+        {
+            const u32 num_vertices{ (u32)m.vertices.size() };
+            assert(num_vertices);
+            
+            compute_bounds(m);
+            math::v3 aabb_min{ m.fixed_bounds ? m.aabb_min : m.bounds_min };
+            math::v3 aabb_max{ m.fixed_bounds ? m.aabb_max : m.bounds_max };
+
+            if (m.elements_type & elements::elements_type::quantized_position)
             {
-                skeletal_normal_texture* const element_buffer{ (skeletal_normal_texture* const)m.element_buffer.data() };
+                // NOTE: a flat axis (e.g. a plane) would have an empty range, so we give it some room.
+                //       All of its positions quantize to 0, which decodes to aabb_min exactly.
+                if (!(aabb_min.x < aabb_max.x)) aabb_max.x = aabb_min.x + 1.f;
+                if (!(aabb_min.y < aabb_max.y)) aabb_max.y = aabb_min.y + 1.f;
+                if (!(aabb_min.z < aabb_max.z)) aabb_max.z = aabb_min.z + 1.f;
+
+                m.position_buffer.resize(sizeof(elements::packed_position) * num_vertices);
+                elements::packed_position* const position_buffer{ (elements::packed_position* const)m.position_buffer.data() };
+
                 for (u32 i{ 0 }; i < num_vertices; ++i)
                 {
-                    vertex& v{ m.vertices[i] };
-                    const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y , (u16)v.joint_indices.z , (u16)v.joint_indices.w };
-                    element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, t_signs[i],
-                                         {indices[0], indices[1], indices[2], indices[3]},
-                                         {normals[i].x, normals[i].y}, {tangents[i].x, tangents[i].y}, v.uv };
+                    const math::v3& p{ m.vertices[i].position };
+                    position_buffer[i] = { { (u16)pack_float<16>(p.x, aabb_min.x, aabb_max.x),
+                                             (u16)pack_float<16>(p.y, aabb_min.y, aabb_max.y),
+                                             (u16)pack_float<16>(p.z, aabb_min.z, aabb_max.z) } };
                 }
             }
-            break;
-            case elements_type::skeletal_normal_texture_color:
+            else
             {
-                skeletal_normal_texture_color* const element_buffer{ (skeletal_normal_texture_color* const)m.element_buffer.data() };
+                m.position_buffer.resize(sizeof(math::v3) * num_vertices);
+                math::v3* const position_buffer{ (math::v3* const)m.position_buffer.data() };
+
                 for (u32 i{ 0 }; i < num_vertices; ++i)
                 {
-                    vertex& v{ m.vertices[i] };
-                    const u16 indices[4]{ (u16)v.joint_indices.x, (u16)v.joint_indices.y , (u16)v.joint_indices.z , (u16)v.joint_indices.w };
-                    element_buffer[i] = { {joint_weights[i].x, joint_weights[i].y, joint_weights[i].z}, t_signs[i],
-                                         {indices[0], indices[1], indices[2], indices[3]},
-                                         {normals[i].x, normals[i].y}, {tangents[i].x, tangents[i].y}, v.uv,
-                                         {v.red, v.green, v.blue}, {} };
+                    position_buffer[i] = m.vertices[i].position;
                 }
             }
-            break;
-            }
+
+            m.aabb_min = aabb_min;
+            m.aabb_max = aabb_max;
+
+            m.element_buffer.resize(get_vertex_element_size(m.elements_type) * num_vertices);
+            pack_vertex_elements(m.elements_type, m.vertices.data(), num_vertices, m.element_buffer.data());
         }
 
         void determine_elements_type(mesh& m)
@@ -365,34 +697,183 @@ namespace nidhog::tools
             // TODO: we lack data for skeletal meshes. ֮
         }
 
-        //ҪÿuvǶζԵ
-        void process_vertices(mesh& m, const geometry_import_settings& settings)
+        // Adds the flags for the position and tangent space encodings that were chosen in the import settings.
+        void determine_vertex_encoding(mesh& m, const geometry_import_settings& settings)
         {
-            assert((m.raw_indices.size() % 3) == 0);
-            if (settings.calculate_normals || m.normals.empty())
+            using namespace elements;
+            u32 flags{ settings.quantize_positions ? elements_type::quantized_position : 0u };
+            if (settings.build_meshlets) flags |= elements_type::meshlets;
+
+            if ((m.elements_type & elements_type::static_normal) && !(m.elements_type & elements_type::skeletal))
             {
-                //ûз㷨
-                recalculate_normals(m);
+                const bool has_tangents{ (m.elements_type & elements_type::static_normal_texture) == elements_type::static_normal_texture };
+                switch (settings.tspace_encoding)
+                {
+                case tspace_encoding::octahedral: flags |= elements_type::octahedral_tspace; break;
+                case tspace_encoding::quaternion: flags |= has_tangents ? elements_type::quaternion_tspace : elements_type::octahedral_tspace; break;
+                }
             }
-            //֮
-            process_normals(m, settings.smoothing_angle);
 
-            if (!m.uv_sets.empty())
+            m.elements_type = (elements_type::type)(m.elements_type | flags);
+        }
+
+        // Partitions the (optimized) index buffer into meshlets and computes their culling bounds.
+        void build_mesh_meshlets(mesh& m, const geometry_import_settings& settings)
+        {
+            using clock = std::chrono::high_resolution_clock;
+            const clock::time_point start{ clock::now() };
+            build_meshlets(m.vertices, m.indices, m.meshlets, m.meshlet_vertices, m.meshlet_triangles);
+
+            const u32 meshlet_count{ (u32)m.meshlets.size() };
+            m.meshlet_bounds.resize(meshlet_count);
+            u32 cone_count{ 0 };
+            for (u32 i{ 0 }; i < meshlet_count; ++i)
             {
-                //uvΪգuv
-                process_uvs(m);
+                m.meshlet_bounds[i] = compute_meshlet_bounds(m.vertices, m.meshlets[i], m.meshlet_vertices, m.meshlet_triangles);
+                if (m.meshlet_bounds[i].cone_cutoff < 1.f) ++cone_count;
             }
 
-            //ɫķʽ
-            determine_elements_type(m);
-            pack_vertices(m);
+            const double ms{ (double)std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count() * 1e-3 };
+            report_stats(settings, "Meshlets [%s]: %u triangles -> %u meshlets, %.1f vertices and %.1f triangles on average, "
+                         "%u with a usable normal cone, %.2f ms\n",
+                         m.name.c_str(), (u32)m.indices.size() / 3, meshlet_count, (f32)m.meshlet_vertices.size() / meshlet_count,
+                         (f32)m.meshlet_triangles.size() / (3.f * meshlet_count), cone_count, ms);
         }
 
-        u64 get_mesh_size(const mesh& m)
+        u64 get_meshlet_section_size(const mesh& m)
         {
-            const u64 num_vertices{ m.vertices.size() };
+            if (!(m.elements_type & elements::elements_type::meshlets)) return 0;
+            constexpr u64 su32{ sizeof(u32) };
+            return
+                su32 * 3 + // meshlet count, meshlet vertex count and meshlet triangle index count
+                sizeof(content::meshlet) * m.meshlets.size() +
+                sizeof(content::meshlet_bounds) * m.meshlet_bounds.size() +
+                su32 * m.meshlet_vertices.size() +
+                math::align_size_up<su32>(m.meshlet_triangles.size()); // triangle indices padded to 4 bytes
+        }
+
+        // Logs how much precision the tangent space encoding loses and how big the vertex elements are,
+        // compared to the default encoding (x, y and the sign of z).
+        void report_tspace_encoding(const mesh& m, const geometry_import_settings& settings)
+        {
+            using namespace elements;
+            const bool has_tangents{ (m.elements_type & elements_type::static_normal_texture) == elements_type::static_normal_texture };
+            const bool quaternion{ (m.elements_type & elements_type::quaternion_tspace) != 0 };
+            const bool octahedral{ (m.elements_type & elements_type::octahedral_tspace) != 0 };
+
+            auto decode_xy_sign = [](const math::v3& v) {
+                const f32 x{ unpack_to_float<16>(pack_float<16>(v.x, -1.f, 1.f), -1.f, 1.f) };
+                const f32 y{ unpack_to_float<16>(pack_float<16>(v.y, -1.f, 1.f), -1.f, 1.f) };
+                return math::v3{ x, y, sqrtf(std::max(0.f, 1.f - x * x - y * y)) * (v.z > 0.f ? 1.f : -1.f) };
+            };
+
+            auto angle = [](const math::v3& a, const math::v3& b) {
+                return XMConvertToDegrees(XMVectorGetX(XMVector3AngleBetweenNormals(
+                    XMVector3Normalize(XMLoadFloat3(&a)), XMVector3Normalize(XMLoadFloat3(&b)))));
+            };
+
+            const u32 num_vertices{ (u32)m.vertices.size() };
+            f32 normal_max{ 0.f }, tangent_max{ 0.f };
+            double normal_sum{ 0.0 }, tangent_sum{ 0.0 };
+            for (u32 i{ 0 }; i < num_vertices; ++i)
+            {
+                const vertex& v{ m.vertices[i] };
+                const math::v3 tangent{ v.tangent.x, v.tangent.y, v.tangent.z };
+                math::v3 n, t;
+                if (quaternion)
+                {
+                    decode_tbn_quaternion(encode_tbn_quaternion(v.normal, tangent), n, t);
+                }
+                else if (octahedral)
+                {
+                    u16 x, y;
+                    encode_octahedral(v.normal, x, y);
+                    n = decode_octahedral(x, y);
+                    encode_octahedral(tangent, x, y);
+                    t = decode_octahedral(x, y);
+                }
+                else
+                {
+                    n = decode_xy_sign(v.normal);
+                    t = decode_xy_sign(tangent);
+                }
+
+                const f32 normal_error{ angle(v.normal, n) };
+                normal_max = std::max(normal_max, normal_error);
+                normal_sum += normal_error;
+                if (has_tangents)
+                {
+                    const f32 tangent_error{ angle(tangent, t) };
+                    tangent_max = std::max(tangent_max, tangent_error);
+                    tangent_sum += tangent_error;
+                }
+            }
+
+            const u32 size{ (u32)get_vertex_element_size(m.elements_type) };
+            const u32 default_size{ (u32)get_vertex_element_size((elements_type::type)(m.elements_type & ~elements_type::quaternion_tspace)) };
+            report_stats(settings, "TSpace encoding [%s]: %s, %u bytes per vertex (%u with x/y and sign), "
+                         "normal error avg %.4f max %.4f deg, tangent error avg %.4f max %.4f deg\n",
+                         m.name.c_str(), quaternion ? "quaternion" : octahedral ? "octahedral" : "x/y and sign", size, default_size,
+                         normal_sum / num_vertices, normal_max, tangent_sum / num_vertices, tangent_max);
+        }
+
+        //ҪÿuvǶζԵ
+        void process_vertices(mesh& m, const geometry_import_settings& settings)
+        {
+            assert((m.raw_indices.size() % 3) == 0);
+            if (settings.calculate_normals || m.normals.empty())
+            {
+                //ûз㷨
+                recalculate_normals(m);
+            }
+            //֮
+            process_normals(m, settings.smoothing_angle);
+
+            if (!m.uv_sets.empty())
+            {
+                //uvΪգuv
+                process_uvs(m);
+
+                // NOTE: tangents are only needed (and only defined) when the mesh has UVs.
+                if (!settings.calculate_tangents && m.tangents.size() == m.indices.size())
+                {
+                    process_tangents(m);
+                }
+                else
+                {
+                    calculate_tangents(m);
+                }
+            }
+
+            if (!m.halo.empty())
+            {
+                remove_halo_triangles(m);
+            }
+
+            optimize_vertices(m, settings);
+
+            //ɫķʽ
+            determine_elements_type(m);
+            determine_vertex_encoding(m, settings);
+            pack_vertices(m);
+            if (m.elements_type & elements::elements_type::meshlets)
+            {
+                build_mesh_meshlets(m, settings);
+            }
+
+            // NOTE: measuring the error decodes every normal and tangent, so only do it when it's logged.
+            if (settings.log_stats && (m.elements_type & elements::elements_type::static_normal))
+            {
+                report_tspace_encoding(m, settings);
+            }
+        }
+
+        u64 get_mesh_size(const mesh& m)
+        {
+            const u64 num_vertices{ get_packed_vertex_count(m) };
             const u64 position_buffer_size{ m.position_buffer.size() };
-            assert(position_buffer_size == sizeof(math::v3) * num_vertices);
+            assert(position_buffer_size == get_position_size(m.elements_type) * num_vertices);
+            const bool quantized{ (m.elements_type & elements::elements_type::quantized_position) != 0 };
             const u64 element_buffer_size{ m.element_buffer.size() };
             assert(element_buffer_size == get_vertex_element_size(m.elements_type) * num_vertices);
             const u64 index_size{ (num_vertices < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
@@ -407,9 +888,12 @@ namespace nidhog::tools
                 su32 + // size (16 bit or 32 bit)
                 su32 + // 
                 sizeof(f32) + // LODֵ
+                sizeof(f32) * 11 + // bounds: AABB, sphere and LOD error
+                (quantized ? sizeof(math::v3) * 2 : 0) + // AABB of quantized positions
                 position_buffer_size + // room for vertex positions
                 element_buffer_size + // room for vertex elements
-                index_buffer_size // room for indices
+                index_buffer_size + // room for indices
+                get_meshlet_section_size(m) // room for meshlets
             };
 
             return size;
@@ -458,7 +942,7 @@ namespace nidhog::tools
             // elements type enumeration
             blob.write((u32)m.elements_type);
             // number of vertices
-            const u32 num_vertices{ (u32)m.vertices.size() };
+            const u32 num_vertices{ get_packed_vertex_count(m) };
             blob.write(num_vertices);
             // index size (16 bit or 32 bit)
             const u32 index_size{ (num_vertices < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
@@ -468,8 +952,20 @@ namespace nidhog::tools
             blob.write(num_indices);
             // LOD threshold
             blob.write(m.lod_threshold);
+            // bounds for culling and LOD selection
+            blob.write(m.bounds_min.x); blob.write(m.bounds_min.y); blob.write(m.bounds_min.z);
+            blob.write(m.bounds_max.x); blob.write(m.bounds_max.y); blob.write(m.bounds_max.z);
+            blob.write(m.sphere_center.x); blob.write(m.sphere_center.y); blob.write(m.sphere_center.z);
+            blob.write(m.sphere_radius);
+            blob.write(m.lod_error);
+            // AABB that quantized positions are relative to
+            if (m.elements_type & elements::elements_type::quantized_position)
+            {
+                blob.write(m.aabb_min.x); blob.write(m.aabb_min.y); blob.write(m.aabb_min.z);
+                blob.write(m.aabb_max.x); blob.write(m.aabb_max.y); blob.write(m.aabb_max.z);
+            }
             // position buffer
-            assert(m.position_buffer.size() == sizeof(math::v3) * num_vertices);
+            assert(m.position_buffer.size() == get_position_size(m.elements_type) * num_vertices);
             blob.write(m.position_buffer.data(), m.position_buffer.size());
             // element buffer
             assert(m.element_buffer.size() == elements_size * num_vertices);
@@ -486,140 +982,901 @@ namespace nidhog::tools
                 data = (const u8*)indices.data();
             }
             blob.write(data, index_buffer_size);
+            // meshlets
+            if (m.elements_type & elements::elements_type::meshlets)
+            {
+                assert(m.meshlets.size() == m.meshlet_bounds.size());
+                const u32 triangle_index_count{ (u32)m.meshlet_triangles.size() };
+                blob.write((u32)m.meshlets.size());
+                blob.write((u32)m.meshlet_vertices.size());
+                blob.write(triangle_index_count);
+                blob.write((const u8*)m.meshlets.data(), sizeof(content::meshlet) * m.meshlets.size());
+                blob.write((const u8*)m.meshlet_bounds.data(), sizeof(content::meshlet_bounds) * m.meshlet_bounds.size());
+                blob.write((const u8*)m.meshlet_vertices.data(), sizeof(u32) * m.meshlet_vertices.size());
+                blob.write(m.meshlet_triangles.data(), triangle_index_count);
+                const u32 padding{ (u32)math::align_size_up<sizeof(u32)>(triangle_index_count) - triangle_index_count };
+                for (u32 i{ 0 }; i < padding; ++i) blob.write((u8)0);
+            }
         }
 
-        //materialmesh
-        bool split_meshes_by_material(u32 material_idx, const mesh& m, mesh& submesh)
+        // Per-thread scratch memory for splitting meshes, so it doesn't get reallocated for every mesh.
+        struct split_scratch
         {
-            submesh.name = m.name;
-            submesh.lod_threshold = m.lod_threshold;
-            submesh.lod_id = m.lod_id;
-            submesh.material_used.emplace_back(material_idx);
-            submesh.uv_sets.resize(m.uv_sets.size());
+            utl::vector<u32> material_slots;    // index in material_used of each material id
+            utl::vector<u32> offsets;           // first polygon of each material in 'polygons'
+            utl::vector<u32> cursors;
+            utl::vector<u32> polygons;          // polygon indices, bucketed by material
+            utl::vector<u32> vertex_slots;      // submesh that vertex_refs[v] belongs to
+            utl::vector<u32> vertex_refs;       // index of position v in that submesh
+        };
 
+        // Splits a mesh that uses more than one material into one submesh per material, in the order of material_used.
+        // NOTE: polygons are bucketed by material with a counting sort, so every submesh is built from its own
+        //       polygons only instead of scanning the whole mesh once per material. The position remap is
+        //       shared by all submeshes and tagged with the submesh it belongs to, so it's only reset once per mesh.
+        void split_meshes_by_material(const mesh& m, utl::vector<mesh>& submeshes, split_scratch& scratch)
+        {
+            const u32 num_materials{ (u32)m.material_used.size() };
             const u32 num_polys{ (u32)m.raw_indices.size() / 3 };
-            utl::vector<u32> vertex_ref(m.positions.size(), u32_invalid_id);
+            assert(num_materials > 1 && m.material_indices.size() == num_polys);
+
+            u32 max_material_id{ 0 };
+            for (u32 i{ 0 }; i < num_materials; ++i) max_material_id = std::max(max_material_id, m.material_used[i]);
+            scratch.material_slots.clear();
+            scratch.material_slots.resize((u64)max_material_id + 1, u32_invalid_id);
+            for (u32 i{ 0 }; i < num_materials; ++i) scratch.material_slots[m.material_used[i]] = i;
 
+            // Counting sort. Polygons keep their original order within each material.
+            scratch.offsets.clear();
+            scratch.offsets.resize((u64)num_materials + 1, 0);
             for (u32 i{ 0 }; i < num_polys; ++i)
             {
-                const u32 mtl_idx{ m.material_indices[i] };
-                if (mtl_idx != material_idx) continue;
+                assert(m.material_indices[i] <= max_material_id && scratch.material_slots[m.material_indices[i]] != u32_invalid_id);
+                ++scratch.offsets[scratch.material_slots[m.material_indices[i]] + 1];
+            }
+
+            for (u32 i{ 0 }; i < num_materials; ++i) scratch.offsets[i + 1] += scratch.offsets[i];
 
-                const u32 index{ i * 3 };
-                for (u32 j = index; j < index + 3; ++j)
+            scratch.polygons.resize(num_polys);
+            scratch.cursors.resize(num_materials);
+            memcpy(scratch.cursors.data(), scratch.offsets.data(), num_materials * sizeof(u32));
+            for (u32 i{ 0 }; i < num_polys; ++i)
+            {
+                scratch.polygons[scratch.cursors[scratch.material_slots[m.material_indices[i]]]++] = i;
+            }
+
+            const u32 num_positions{ (u32)m.positions.size() };
+            scratch.vertex_slots.clear();
+            scratch.vertex_slots.resize(num_positions, u32_invalid_id);
+            scratch.vertex_refs.resize(num_positions);
+
+            const bool has_normals{ !m.normals.empty() };
+            const bool has_tangents{ !m.tangents.empty() };
+            const bool has_halo{ !m.halo.empty() };
+            const u32 num_uv_sets{ (u32)m.uv_sets.size() };
+
+            for (u32 slot{ 0 }; slot < num_materials; ++slot)
+            {
+                const u32 first{ scratch.offsets[slot] };
+                const u32 count{ scratch.offsets[slot + 1] - first };
+                if (!count) continue;
+
+                mesh& submesh{ submeshes.emplace_back() };
+                submesh.name = m.name;
+                submesh.lod_threshold = m.lod_threshold;
+                submesh.lod_id = m.lod_id;
+                submesh.material_used.emplace_back(m.material_used[slot]);
+                submesh.uv_sets.resize(num_uv_sets);
+
+                const u32 num_indices{ count * 3 };
+                submesh.raw_indices.reserve(num_indices);
+                submesh.positions.reserve(std::min(num_indices, num_positions));
+                if (has_normals) submesh.normals.reserve(num_indices);
+                if (has_tangents) submesh.tangents.reserve(num_indices);
+                if (has_halo) submesh.halo.reserve(count);
+                for (u32 k{ 0 }; k < num_uv_sets; ++k)
                 {
-                    const u32 v_idx{ m.raw_indices[j] };
-                    if (vertex_ref[v_idx] != u32_invalid_id)
-                    {
-                        submesh.raw_indices.emplace_back(vertex_ref[v_idx]);
-                    }
-                    else
-                    {
-                        submesh.raw_indices.emplace_back((u32)submesh.positions.size());
-                        vertex_ref[v_idx] = submesh.raw_indices.back();
-                        submesh.positions.emplace_back(m.positions[v_idx]);
-                    }
+                    if (m.uv_sets[k].size()) submesh.uv_sets[k].reserve(num_indices);
+                }
 
-                    if (m.normals.size())
+                for (u32 p{ first }; p < first + count; ++p)
+                {
+                    const u32 index{ scratch.polygons[p] * 3 };
+                    if (has_halo) submesh.halo.emplace_back(m.halo[scratch.polygons[p]]);
+                    for (u32 j = index; j < index + 3; ++j)
                     {
-                        submesh.normals.emplace_back(m.normals[j]);
-                    }
+                        const u32 v_idx{ m.raw_indices[j] };
+                        if (scratch.vertex_slots[v_idx] != slot)
+                        {
+                            scratch.vertex_slots[v_idx] = slot;
+                            scratch.vertex_refs[v_idx] = (u32)submesh.positions.size();
+                            submesh.positions.emplace_back(m.positions[v_idx]);
+                        }
 
-                    if (m.tangents.size())
-                    {
-                        submesh.tangents.emplace_back(m.tangents[j]);
-                    }
+                        submesh.raw_indices.emplace_back(scratch.vertex_refs[v_idx]);
 
-                    for (u32 k{ 0 }; k < m.uv_sets.size(); ++k)
-                    {
-                        if (m.uv_sets[k].size())
+                        if (has_normals)
                         {
-                            submesh.uv_sets[k].emplace_back(m.uv_sets[k][j]);
+                            submesh.normals.emplace_back(m.normals[j]);
+                        }
+
+                        if (has_tangents)
+                        {
+                            submesh.tangents.emplace_back(m.tangents[j]);
+                        }
+
+                        for (u32 k{ 0 }; k < num_uv_sets; ++k)
+                        {
+                            if (m.uv_sets[k].size())
+                            {
+                                submesh.uv_sets[k].emplace_back(m.uv_sets[k][j]);
+                            }
                         }
                     }
                 }
+
+                assert(submesh.raw_indices.size() == num_indices);
             }
+        }
 
-            assert((submesh.raw_indices.size() % 3) == 0);
-            return !submesh.raw_indices.empty();
+        // Collects pointers to all meshes of the scene, in LOD group order.
+        utl::vector<mesh*> get_all_meshes(scene& scene)
+        {
+            utl::vector<mesh*> meshes;
+            for (auto& lod : scene.lod_groups)
+            {
+                for (auto& m : lod.meshes) meshes.emplace_back(&m);
+            }
+
+            return meshes;
         }
 
         void split_meshes_by_material(scene& scene)
         {
+            // NOTE: every mesh is split on its own into its own list of submeshes, in parallel. The lists are
+            //       joined in the original mesh order afterwards, so the result doesn't depend on scheduling.
+            utl::vector<mesh*> meshes{ get_all_meshes(scene) };
+            const u32 num_meshes{ (u32)meshes.size() };
+            utl::vector<utl::vector<mesh>> submeshes(num_meshes);
+            utl::vector<split_scratch> scratch(get_worker_count(num_meshes));
+
+            parallel_for_each(num_meshes, [&](u32 index, u32 worker_index) {
+                mesh& m{ *meshes[index] };
+                // If more than one material is used in this mesh
+                // then split it into submeshes.
+                if (m.material_used.size() > 1)
+                {
+                    split_meshes_by_material(m, submeshes[index], scratch[worker_index]);
+                }
+                else
+                {
+                    submeshes[index].emplace_back(std::move(m));
+                }
+            });
+
+            u32 index{ 0 };
             for (auto& lod : scene.lod_groups)
             {
                 utl::vector<mesh> new_meshes;
+                const u32 lod_mesh_count{ (u32)lod.meshes.size() };
+                for (u32 i{ 0 }; i < lod_mesh_count; ++i, ++index)
+                {
+                    for (auto& submesh : submeshes[index]) new_meshes.emplace_back(std::move(submesh));
+                }
 
-                for (auto& m : lod.meshes)
+                new_meshes.swap(lod.meshes);
+            }
+
+            assert(index == num_meshes);
+        }
+
+
+        // Converts the geometric error of a LOD to the distance from where it's no longer visible.
+        // NOTE: assumes a 1080p viewport, a 60 degree vertical field of view and 1 pixel of allowed error.
+        constexpr f32 lod_error_to_distance{ 1080.f / (2.f * 0.57735f) };
+        constexpr f32 lod_min_reduction{ 0.9f };
+
+        // Authored LODs don't come with a geometric error, so it's derived from their threshold, the other way
+        // around from how generate_lods() derives thresholds from errors.
+        void estimate_lod_errors(lod_group& lod)
+        {
+            for (auto& m : lod.meshes)
+            {
+                if (m.lod_id != 0 && m.lod_threshold > 0.f) m.lod_error = m.lod_threshold / lod_error_to_distance;
+            }
+        }
+
+        // Generates simplified LODs for LOD groups that only have LOD 0, e.g. FBX files without LOD groups.
+        // Each LOD targets half the triangles of the previous one, and its threshold is derived from the
+        // largest error any of its meshes got during simplification.
+        void generate_lods(lod_group& lod, const geometry_import_settings& settings)
+        {
+            if (!settings.auto_lod_count || lod.meshes.empty()) return;
+
+            f32 threshold{ 0.f };
+            u32 previous_index_count{ 0 };
+            for (const auto& m : lod.meshes)
+            {
+                // LODs were authored, so we leave them alone.
+                if (m.lod_id != 0) return;
+                // Chunks of a huge mesh don't keep their vertices (see process_huge_mesh()). A LOD has to have
+                // all meshes of the group, so the whole group keeps only LOD 0.
+                if (m.vertices.empty()) return;
+                threshold = std::max(threshold, m.lod_threshold);
+                previous_index_count += (u32)m.indices.size();
+            }
+
+            const u32 base_mesh_count{ (u32)lod.meshes.size() };
+            for (u32 level{ 1 }; level <= settings.auto_lod_count; ++level)
+            {
+                utl::vector<mesh> lod_meshes(base_mesh_count);
+                utl::vector<f32> errors(base_mesh_count);
+                const f32 ratio{ 1.f / (f32)(1 << level) };
+
+                parallel_for_each(base_mesh_count, [&](u32 i, u32) {
+                    const mesh& src{ lod.meshes[i] };
+                    mesh& dst{ lod_meshes[i] };
+                    dst.name = src.name + "_LOD" + std::to_string(level);
+                    dst.lod_id = level;
+                    dst.elements_type = src.elements_type;
+                    dst.material_used = src.material_used;
+                    dst.fixed_bounds = src.fixed_bounds;
+                    dst.aabb_min = src.aabb_min;
+                    dst.aabb_max = src.aabb_max;
+
+                    const u32 target{ std::max(3u, (u32)((f32)src.indices.size() * ratio) / 3 * 3) };
+                    errors[i] = simplify_mesh(src.vertices, src.indices, target, dst.indices);
+                    dst.lod_error = errors[i];
+                    assert(!dst.indices.empty());
+                    dst.vertices = src.vertices;
+                    optimize_vertices(dst, settings);
+                    pack_vertices(dst);
+                    if (dst.elements_type & elements::elements_type::meshlets)
+                    {
+                        build_mesh_meshlets(dst, settings);
+                    }
+                });
+
+                f32 max_error{ 0.f };
+                u32 index_count{ 0 };
+                for (u32 i{ 0 }; i < base_mesh_count; ++i)
+                {
+                    max_error = std::max(max_error, errors[i]);
+                    index_count += (u32)lod_meshes[i].indices.size();
+                }
+
+                // Stop when simplification doesn't get anywhere anymore (e.g. everything is locked by seams).
+                if ((f32)index_count > (f32)previous_index_count * lod_min_reduction) break;
+                previous_index_count = index_count;
+
+                // NOTE: thresholds have to be in ascending order.
+                threshold = std::max(threshold * 1.01f + epsilon, max_error * lod_error_to_distance);
+                for (auto& m : lod_meshes)
+                {
+                    m.lod_threshold = threshold;
+                    lod.meshes.emplace_back(std::move(m));
+                }
+            }
+        }
+
+
+        // Meshes with more triangles than this are processed out of core, in spatial chunks (see process_huge_mesh()).
+        constexpr u32 out_of_core_triangle_threshold{ 8u << 20 };
+        // Number of triangles we aim for per chunk. Chunks are made of whole grid cells, so they can be larger.
+        constexpr u32 out_of_core_chunk_triangles{ 4u << 20 };
+        // Triangles are binned by centroid into a grid with 2^out_of_core_grid_bits cells per axis.
+        constexpr u32 out_of_core_grid_bits{ 6 };
+        constexpr u32 out_of_core_grid_size{ 1u << out_of_core_grid_bits };
+
+        u32 morton_code(u32 x, u32 y, u32 z)
+        {
+            u32 code{ 0 };
+            for (u32 i{ 0 }; i < out_of_core_grid_bits; ++i)
+            {
+                code |= (((x >> i) & 1) << (3 * i)) | (((y >> i) & 1) << (3 * i + 1)) | (((z >> i) & 1) << (3 * i + 2));
+            }
+
+            return code;
+        }
+
+        // Which streams a huge mesh has, and therefore every one of its chunks.
+        struct chunk_layout
+        {
+            bool                normals;
+            bool                tangents;
+            bool                material_indices;
+            utl::vector<u8>     uv_sets;    // 1 for every uv set that isn't empty
+        };
+
+        // Pointers to the streams of a chunk in its scratch memory. Streams the mesh doesn't have are nullptr.
+        struct chunk_streams
+        {
+            v3*                 positions;
+            u32*                raw_indices;
+            v3*                 normals;            // per corner
+            v4*                 tangents;           // per corner
+            utl::vector<v2*>    uv_sets;            // per corner
+            u32*                material_indices;   // per triangle
+            u8*                 halo;               // per triangle
+        };
+
+        // A spatial chunk of a huge mesh. Its streams are kept in a scratch file until the chunk is processed,
+        // so the source mesh can be released before any chunk is.
+        struct mesh_chunk
+        {
+            std::unique_ptr<scratch_file>   file;
+            utl::vector<u8>                 memory;         // used instead if a scratch file couldn't be created
+            utl::vector<u32>                material_used;
+            u32                             num_positions{ 0 };
+            u32                             num_triangles{ 0 };
+
+            [[nodiscard]] u8* data() { return file->is_valid() ? file->data() : memory.data(); }
+        };
+
+        // Lays the streams of a chunk out one after the other, starting at 'data'. Returns the size of all streams,
+        // so it can be called with nullptr to get the size of the scratch memory first.
+        u64 get_chunk_streams(u8* const data, const chunk_layout& layout, u32 num_positions, u32 num_triangles, chunk_streams& streams)
+        {
+            const u64 num_corners{ (u64)num_triangles * 3 };
+            u64 offset{ 0 };
+            auto take = [data, &offset](u64 size) {
+                u8* const stream{ data ? data + offset : nullptr };
+                offset += size;
+                return stream;
+            };
+
+            streams.positions = (v3*)take(sizeof(v3) * num_positions);
+            streams.raw_indices = (u32*)take(sizeof(u32) * num_corners);
+            streams.normals = layout.normals ? (v3*)take(sizeof(v3) * num_corners) : nullptr;
+            streams.tangents = layout.tangents ? (v4*)take(sizeof(v4) * num_corners) : nullptr;
+            streams.uv_sets.resize(layout.uv_sets.size());
+            for (u32 k{ 0 }; k < layout.uv_sets.size(); ++k)
+            {
+                streams.uv_sets[k] = layout.uv_sets[k] ? (v2*)take(sizeof(v2) * num_corners) : nullptr;
+            }
+
+            streams.material_indices = layout.material_indices ? (u32*)take(sizeof(u32) * num_triangles) : nullptr;
+            streams.halo = take(num_triangles);
+            return offset;
+        }
+
+        // Partitions a huge mesh into spatial chunks and writes each chunk to a scratch file.
+        // NOTE: triangles are binned by centroid into a grid, and the cells are grouped into chunks in Morton order,
+        //       so every chunk is a compact region of the mesh. Besides its own triangles, every chunk gets a halo:
+        //       all triangles of other chunks that touch a position it shares with them. That gives border vertices
+        //       their full neighborhood, and since the triangles keep their original order, process_vertices()
+        //       clusters them into the same normals, UVs and tangents in every chunk they're in.
+        // Returns the number of halo triangles of all chunks.
+        u32 partition_huge_mesh(const mesh& m, const chunk_layout& layout, const v3& aabb_min, const v3& aabb_max, utl::vector<mesh_chunk>& chunks)
+        {
+            const u32 num_positions{ (u32)m.positions.size() };
+            const u32 num_triangles{ (u32)(m.raw_indices.size() / 3) };
+            assert(num_positions && num_triangles);
+
+            auto get_scale = [](f32 min, f32 max) { return max > min ? (f32)out_of_core_grid_size / (max - min) : 0.f; };
+            const v3 scale{ get_scale(aabb_min.x, aabb_max.x), get_scale(aabb_min.y, aabb_max.y), get_scale(aabb_min.z, aabb_max.z) };
+            auto get_cell = [](f32 c, f32 min, f32 scale) { return std::min((u32)std::max((c - min) * scale, 0.f), out_of_core_grid_size - 1); };
+
+            // Grid cell of every triangle, and then its chunk.
+            utl::vector<u32> triangle_chunks(num_triangles);
+            parallel_for(num_triangles, [&](u32 begin, u32 end) {
+                for (u32 t{ begin }; t < end; ++t)
+                {
+                    const u32* const index{ &m.raw_indices[(u64)t * 3] };
+                    const v3& p0{ m.positions[index[0]] };
+                    const v3& p1{ m.positions[index[1]] };
+                    const v3& p2{ m.positions[index[2]] };
+                    const f32 third{ 1.f / 3.f };
+                    triangle_chunks[t] = morton_code(get_cell((p0.x + p1.x + p2.x) * third, aabb_min.x, scale.x),
+                                                     get_cell((p0.y + p1.y + p2.y) * third, aabb_min.y, scale.y),
+                                                     get_cell((p0.z + p1.z + p2.z) * third, aabb_min.z, scale.z));
+                }
+            });
+
+            // Group the cells into chunks in Morton order. Afterwards cell_chunks holds the chunk of every cell.
+            utl::vector<u32> cell_chunks(out_of_core_grid_size * out_of_core_grid_size * out_of_core_grid_size, 0);
+            for (u32 t{ 0 }; t < num_triangles; ++t) ++cell_chunks[triangle_chunks[t]];
+
+            utl::vector<u32> chunk_offsets{};   // first own triangle of each chunk in 'own_triangles'
+            u32 chunk_size{ 0 };
+            u32 total{ 0 };
+            for (u32& cell : cell_chunks)
+            {
+                const u32 cell_triangles{ cell };
+                if (chunk_size && chunk_size + cell_triangles > out_of_core_chunk_triangles)
+                {
+                    chunk_offsets.emplace_back(total);
+                    total += chunk_size;
+                    chunk_size = 0;
+                }
+
+                cell = (u32)chunk_offsets.size();
+                chunk_size += cell_triangles;
+            }
+
+            chunk_offsets.emplace_back(total);
+            chunk_offsets.emplace_back(total + chunk_size);
+            const u32 num_chunks{ (u32)chunk_offsets.size() - 1 };
+
+            for (u32 t{ 0 }; t < num_triangles; ++t) triangle_chunks[t] = cell_chunks[triangle_chunks[t]];
+
+            // Find the positions that are shared by more than one chunk, and which chunks share them.
+            constexpr u32 shared_position{ u32_invalid_id - 1 };
+            utl::vector<u32> position_chunks(num_positions, u32_invalid_id);
+            for (u32 t{ 0 }; t < num_triangles; ++t)
+            {
+                for (u32 j{ 0 }; j < 3; ++j)
+                {
+                    u32& chunk{ position_chunks[m.raw_indices[(u64)t * 3 + j]] };
+                    if (chunk == u32_invalid_id) chunk = triangle_chunks[t];
+                    else if (chunk != triangle_chunks[t]) chunk = shared_position;
+                }
+            }
+
+            utl::vector<u64> shared_refs;   // (position << 32) | chunk, sorted
+            for (u32 t{ 0 }; t < num_triangles; ++t)
+            {
+                for (u32 j{ 0 }; j < 3; ++j)
+                {
+                    const u32 p{ m.raw_indices[(u64)t * 3 + j] };
+                    if (position_chunks[p] == shared_position) shared_refs.emplace_back(((u64)p << 32) | triangle_chunks[t]);
+                }
+            }
+
+            std::sort(shared_refs.begin(), shared_refs.end());
+            shared_refs.resize(std::unique(shared_refs.begin(), shared_refs.end()) - shared_refs.begin());
+
+            // Every triangle with a shared position is in the halo of all other chunks that share it.
+            utl::vector<u64> halo_refs;     // (chunk << 32) | triangle, sorted
+            for (u32 t{ 0 }; t < num_triangles; ++t)
+            {
+                for (u32 j{ 0 }; j < 3; ++j)
+                {
+                    const u64 p{ m.raw_indices[(u64)t * 3 + j] };
+                    if (position_chunks[p] != shared_position) continue;
+
+                    for (const u64* ref{ std::lower_bound(shared_refs.begin(), shared_refs.end(), p << 32) };
+                         ref != shared_refs.end() && (*ref >> 32) == p; ++ref)
+                    {
+                        const u32 chunk{ (u32)*ref };
+                        if (chunk != triangle_chunks[t]) halo_refs.emplace_back(((u64)chunk << 32) | t);
+                    }
+                }
+            }
+
+            std::sort(halo_refs.begin(), halo_refs.end());
+            halo_refs.resize(std::unique(halo_refs.begin(), halo_refs.end()) - halo_refs.begin());
+            shared_refs = utl::vector<u64>{};
+
+            // Own triangles of every chunk, in their original order (counting sort).
+            utl::vector<u32> own_triangles(num_triangles);
+            {
+                utl::vector<u32> cursors(num_chunks);
+                memcpy(cursors.data(), chunk_offsets.data(), num_chunks * sizeof(u32));
+                for (u32 t{ 0 }; t < num_triangles; ++t) own_triangles[cursors[triangle_chunks[t]]++] = t;
+            }
+
+            triangle_chunks = utl::vector<u32>{};
+
+            // NOTE: from here on position_chunks marks the positions that are already in the chunk that's being written.
+            memset(position_chunks.data(), 0xff, num_positions * sizeof(u32));
+            utl::vector<u32> position_remap(num_positions);
+            utl::vector<u32> chunk_positions;
+            utl::vector<u32> chunk_triangles;
+            utl::vector<u8> chunk_halo;
+            utl::vector<u32> chunk_materials;
+            chunks.resize(num_chunks);
+            u64 halo_ref{ 0 };
+
+            for (u32 c{ 0 }; c < num_chunks; ++c)
+            {
+                // Merge own and halo triangles in their original order.
+                chunk_triangles.clear();
+                chunk_halo.clear();
+                u32 own{ chunk_offsets[c] };
+                const u32 own_end{ chunk_offsets[c + 1] };
+                for (;;)
+                {
+                    const u32 own_triangle{ own < own_end ? own_triangles[own] : u32_invalid_id };
+                    const bool has_halo{ halo_ref < halo_refs.size() && (u32)(halo_refs[halo_ref] >> 32) == c };
+                    const u32 halo_triangle{ has_halo ? (u32)halo_refs[halo_ref] : u32_invalid_id };
+                    if (own_triangle == u32_invalid_id && halo_triangle == u32_invalid_id) break;
+
+                    const bool is_halo{ halo_triangle < own_triangle };
+                    chunk_triangles.emplace_back(is_halo ? halo_triangle : own_triangle);
+                    chunk_halo.emplace_back(is_halo ? 1 : 0);
+                    if (is_halo) ++halo_ref;
+                    else ++own;
+                }
+
+                chunk_positions.clear();
+                const u32 num_chunk_triangles{ (u32)chunk_triangles.size() };
+                for (u32 t{ 0 }; t < num_chunk_triangles; ++t)
+                {
+                    for (u32 j{ 0 }; j < 3; ++j)
+                    {
+                        const u32 p{ m.raw_indices[(u64)chunk_triangles[t] * 3 + j] };
+                        if (position_chunks[p] == c) continue;
+                        position_chunks[p] = c;
+                        position_remap[p] = (u32)chunk_positions.size();
+                        chunk_positions.emplace_back(p);
+                    }
+                }
+
+                mesh_chunk& chunk{ chunks[c] };
+                chunk.num_positions = (u32)chunk_positions.size();
+                chunk.num_triangles = num_chunk_triangles;
+                chunk_streams streams{};
+                const u64 size{ get_chunk_streams(nullptr, layout, chunk.num_positions, num_chunk_triangles, streams) };
+                chunk.file = std::make_unique<scratch_file>(size);
+                if (!chunk.file->is_valid()) chunk.memory.resize(size);
+                get_chunk_streams(chunk.data(), layout, chunk.num_positions, num_chunk_triangles, streams);
+
+                for (u32 i{ 0 }; i < chunk.num_positions; ++i) streams.positions[i] = m.positions[chunk_positions[i]];
+                for (u32 t{ 0 }; t < num_chunk_triangles; ++t)
                 {
-                    // If more than one material is used in this mesh
-                    // then split it into submeshes.
-                    const u32 num_materials{ (u32)m.material_used.size() };
-                    if (num_materials > 1)
+                    const u64 src{ (u64)chunk_triangles[t] * 3 };
+                    const u64 dst{ (u64)t * 3 };
+                    for (u32 j{ 0 }; j < 3; ++j)
                     {
-                        for (u32 i{ 0 }; i < num_materials; ++i)
+                        streams.raw_indices[dst + j] = position_remap[m.raw_indices[src + j]];
+                        if (streams.normals) streams.normals[dst + j] = m.normals[src + j];
+                        if (streams.tangents) streams.tangents[dst + j] = m.tangents[src + j];
+                        for (u32 k{ 0 }; k < streams.uv_sets.size(); ++k)
                         {
-                            mesh submesh{};
-                            if (split_meshes_by_material(m.material_used[i], m, submesh))
-                            {
-                                new_meshes.emplace_back(submesh);
-                            }
+                            if (streams.uv_sets[k]) streams.uv_sets[k][dst + j] = m.uv_sets[k][src + j];
                         }
                     }
-                    else
+
+                    if (streams.material_indices) streams.material_indices[t] = m.material_indices[chunk_triangles[t]];
+                    streams.halo[t] = chunk_halo[t];
+                }
+
+                // The chunk uses the materials of the mesh that its triangles use, in the same order.
+                if (streams.material_indices)
+                {
+                    chunk_materials.resize(num_chunk_triangles);
+                    memcpy(chunk_materials.data(), streams.material_indices, num_chunk_triangles * sizeof(u32));
+                    std::sort(chunk_materials.begin(), chunk_materials.end());
+                    u32* const last{ std::unique(chunk_materials.begin(), chunk_materials.end()) };
+                    for (u32 id : m.material_used)
                     {
-                        new_meshes.emplace_back(m);
+                        if (std::binary_search(chunk_materials.begin(), last, id)) chunk.material_used.emplace_back(id);
                     }
                 }
+                else
+                {
+                    chunk.material_used = m.material_used;
+                }
+            }
 
-                new_meshes.swap(lod.meshes);
+            assert(halo_ref == halo_refs.size());
+            return (u32)halo_refs.size();
+        }
+
+        // Copies a chunk from its scratch memory into a mesh, and releases the scratch memory.
+        void load_chunk(mesh_chunk& chunk, const chunk_layout& layout, mesh& m)
+        {
+            chunk_streams streams{};
+            get_chunk_streams(chunk.data(), layout, chunk.num_positions, chunk.num_triangles, streams);
+            const u64 num_corners{ (u64)chunk.num_triangles * 3 };
+
+            m.positions.resize(chunk.num_positions);
+            memcpy(m.positions.data(), streams.positions, chunk.num_positions * sizeof(v3));
+            m.raw_indices.resize(num_corners);
+            memcpy(m.raw_indices.data(), streams.raw_indices, num_corners * sizeof(u32));
+            if (streams.normals)
+            {
+                m.normals.resize(num_corners);
+                memcpy(m.normals.data(), streams.normals, num_corners * sizeof(v3));
             }
+
+            if (streams.tangents)
+            {
+                m.tangents.resize(num_corners);
+                memcpy(m.tangents.data(), streams.tangents, num_corners * sizeof(v4));
+            }
+
+            m.uv_sets.resize(streams.uv_sets.size());
+            for (u32 k{ 0 }; k < streams.uv_sets.size(); ++k)
+            {
+                if (!streams.uv_sets[k]) continue;
+                m.uv_sets[k].resize(num_corners);
+                memcpy(m.uv_sets[k].data(), streams.uv_sets[k], num_corners * sizeof(v2));
+            }
+
+            if (streams.material_indices)
+            {
+                m.material_indices.resize(chunk.num_triangles);
+                memcpy(m.material_indices.data(), streams.material_indices, chunk.num_triangles * sizeof(u32));
+            }
+
+            m.halo.resize(chunk.num_triangles);
+            memcpy(m.halo.data(), streams.halo, chunk.num_triangles);
+            m.material_used.swap(chunk.material_used);
+
+            chunk.file.reset();
+            chunk.memory = utl::vector<u8>{};
         }
 
+        // Releases everything a processed mesh doesn't need anymore to be packed, including its vertices.
+        // NOTE: LODs are simplified from the vertices, so LODs can't be generated for the mesh anymore.
+        void release_unpacked_data(mesh& m)
+        {
+            mesh released{};
+            m.positions.swap(released.positions);
+            m.normals.swap(released.normals);
+            m.tangents.swap(released.tangents);
+            m.colors.swap(released.colors);
+            m.uv_sets.swap(released.uv_sets);
+            m.material_indices.swap(released.material_indices);
+            m.raw_indices.swap(released.raw_indices);
+            m.vertices.swap(released.vertices);
+        }
+
+        // Processes a mesh that's too large to process at once (see out_of_core_triangle_threshold), chunk by chunk,
+        // and appends the processed submeshes of all chunks to 'submeshes'.
+        // NOTE: the source mesh is released once its chunks are written, and only one chunk is unpacked at a time.
+        //       What's left of each processed submesh is only its packed data. Keeping the vertices of every chunk
+        //       to simplify them would need several times the memory of the whole mesh, so no LODs are generated
+        //       for LOD groups with huge meshes (see generate_lods()). All chunks quantize positions
+        //       to the bounds of the whole mesh, so positions on chunk borders decode to the same value.
+        void process_huge_mesh(mesh& m, const geometry_import_settings& settings, utl::vector<mesh>& submeshes)
+        {
+            assert(!m.raw_indices.empty() && !m.positions.empty());
+            chunk_layout layout{ !m.normals.empty(), !m.tangents.empty(), m.material_used.size() > 1 && !m.material_indices.empty(), {} };
+            for (const auto& uvs : m.uv_sets) layout.uv_sets.emplace_back(uvs.empty() ? 0 : 1);
+
+            v3 aabb_min{ m.positions[0] };
+            v3 aabb_max{ m.positions[0] };
+            for (const v3& p : m.positions)
+            {
+                aabb_min = { std::min(aabb_min.x, p.x), std::min(aabb_min.y, p.y), std::min(aabb_min.z, p.z) };
+                aabb_max = { std::max(aabb_max.x, p.x), std::max(aabb_max.y, p.y), std::max(aabb_max.z, p.z) };
+            }
+
+            const u32 num_triangles{ (u32)(m.raw_indices.size() / 3) };
+            utl::vector<mesh_chunk> chunks;
+            const u32 num_halo_triangles{ partition_huge_mesh(m, layout, aabb_min, aabb_max, chunks) };
+
+            const std::string name{ m.name };
+            const u32 lod_id{ m.lod_id };
+            const f32 lod_threshold{ m.lod_threshold };
+            m = mesh{};
+
+            report_stats(settings, "Out of core [%s]: %u triangles in %u chunks, %u halo triangles (%.2f%%)\n", name.c_str(),
+                         num_triangles, (u32)chunks.size(), num_halo_triangles, 100.f * (f32)num_halo_triangles / (f32)num_triangles);
+            if (settings.auto_lod_count) report_stats(settings, "Out of core [%s]: LODs aren't generated for meshes processed out of core\n", name.c_str());
+
+            split_scratch scratch;
+            for (auto& chunk : chunks)
+            {
+                utl::vector<mesh> chunk_submeshes;
+                {
+                    mesh chunk_mesh{};
+                    chunk_mesh.name = name;
+                    chunk_mesh.lod_id = lod_id;
+                    chunk_mesh.lod_threshold = lod_threshold;
+                    load_chunk(chunk, layout, chunk_mesh);
+                    if (chunk_mesh.material_used.size() > 1) split_meshes_by_material(chunk_mesh, chunk_submeshes, scratch);
+                    else chunk_submeshes.emplace_back(std::move(chunk_mesh));
+                }
+
+                // NOTE: chunks are processed one after the other, so process_vertices() gets all threads.
+                for (auto& submesh : chunk_submeshes)
+                {
+                    // A submesh can be all halo if the chunk only touches the neighbor's material at the border.
+                    if (std::find(submesh.halo.begin(), submesh.halo.end(), (u8)0) == submesh.halo.end()) continue;
 
+                    submesh.fixed_bounds = true;
+                    submesh.aabb_min = aabb_min;
+                    submesh.aabb_max = aabb_max;
+                    process_vertices(submesh, settings);
+                    release_unpacked_data(submesh);
+                    submeshes.emplace_back(std::move(submesh));
+                }
+            }
+        }
+
+        // Replaces the huge meshes of the scene with their processed submeshes (see process_huge_mesh()).
+        void process_huge_meshes(scene& scene, const geometry_import_settings& settings)
+        {
+            auto is_huge = [](const mesh& m) { return m.raw_indices.size() / 3 > out_of_core_triangle_threshold; };
+            for (auto& lod : scene.lod_groups)
+            {
+                if (std::none_of(lod.meshes.begin(), lod.meshes.end(), is_huge)) continue;
+
+                utl::vector<mesh> new_meshes;
+                for (auto& m : lod.meshes)
+                {
+                    if (is_huge(m)) process_huge_mesh(m, settings, new_meshes);
+                    else new_meshes.emplace_back(std::move(m));
+                }
+
+                new_meshes.swap(lod.meshes);
+            }
+        }
 	}//namespace
+    void pack_vertex_elements(elements::elements_type::type elements_type, const vertex* const vertices, u32 vertex_count, u8* const buffer)
+    {
+        assert(vertices && vertex_count && buffer);
+        const element_packer packer{ get_element_packer(elements_type) };
+        assert(packer);
+        parallel_for(vertex_count, [packer, vertices, buffer](u32 begin, u32 end) {
+            packer(vertices, begin, end, buffer);
+        });
+    }
+
     void process_scene(scene& scene, const geometry_import_settings& settings)
     {
+        // NOTE: huge meshes are processed out of core first, before everything else is split and processed.
+        //       Their processed submeshes only have one material each and are skipped below.
+        process_huge_meshes(scene, settings);
         split_meshes_by_material(scene);
         //
+        // NOTE: meshes are independent of each other, so they're all processed in parallel. LOD generation
+        //       needs every mesh of its LOD group, so it runs afterwards, in parallel over LOD groups
+        //       (and over the meshes of a LOD group when there's only one).
+        utl::vector<mesh*> meshes{ get_all_meshes(scene) };
+        parallel_for_each((u32)meshes.size(), [&](u32 index, u32) {
+            mesh& m{ *meshes[index] };
+            if (m.position_buffer.empty()) process_vertices(m, settings);
+        });
+
+        parallel_for_each((u32)scene.lod_groups.size(), [&](u32 index, u32) {
+            estimate_lod_errors(scene.lod_groups[index]);
+            generate_lods(scene.lod_groups[index], settings);
+        });
+    }
+
+    void log_import_stats(const char* format, const char* file, const scene& scene, double milliseconds)
+    {
+        u64 mesh_count{ 0 };
+        u64 triangle_count{ 0 };
+        for (const lod_group& lod : scene.lod_groups)
+        {
+            mesh_count += lod.meshes.size();
+            for (const mesh& m : lod.meshes) triangle_count += m.raw_indices.size() / 3;
+        }
+
+        std::error_code error;
+        const u64 file_size{ std::filesystem::file_size(file, error) };
+        const double megabytes{ error ? 0.0 : (double)file_size / (1024.0 * 1024.0) };
+        char message[512];
+        sprintf_s(message, "%s import [%s]: %u LOD groups, %llu meshes, %llu triangles, %.1f MB in %.1f ms (%.0f MB/s)\n",
+                  format, scene.name.c_str(), (u32)scene.lod_groups.size(), (unsigned long long)mesh_count,
+                  (unsigned long long)triangle_count, megabytes, milliseconds, megabytes * 1000.0 / std::max(milliseconds, 1e-3));
+        OutputDebugStringA(message);
+    }
+
+
+    memory_scene_sink::memory_scene_sink(u64 initial_capacity)
+        : _capacity{ initial_capacity }
+    {
+        if (_capacity)
+        {
+            _buffer = (u8*)CoTaskMemAlloc(_capacity);
+            assert(_buffer);
+        }
+    }
+
+    memory_scene_sink::~memory_scene_sink()
+    {
+        if (_buffer) CoTaskMemFree(_buffer);
+    }
+
+    bool memory_scene_sink::write(const u8* const data, u64 size)
+    {
+        if (_size + size > _capacity)
+        {
+            const u64 new_capacity{ std::max(_size + size, _capacity + (_capacity >> 1)) };
+            u8* const new_buffer{ (u8*)CoTaskMemRealloc(_buffer, new_capacity) };
+            if (!new_buffer) return false;
+            _buffer = new_buffer;
+            _capacity = new_capacity;
+        }
+
+        memcpy(&_buffer[_size], data, size);
+        _size += size;
+        return true;
+    }
+
+    u8* memory_scene_sink::release()
+    {
+        u8* const buffer{ _buffer };
+        _buffer = nullptr;
+        _size = _capacity = 0;
+        return buffer;
+    }
+
+    bool handle_scene_sink::write(const u8* const data, u64 size)
+    {
+        // NOTE: WriteFile takes a 32-bit size, so large chunks are written in pieces.
+        constexpr u64 max_write_size{ 1ull << 30 };
+        while (size)
+        {
+            const DWORD write_size{ (DWORD)std::min(size, max_write_size) };
+            DWORD written{ 0 };
+            if (!WriteFile(_handle, data, write_size, &written, nullptr) || !written) return false;
+            data += written;
+            size -= written;
+        }
+
+        return true;
+    }
+
+    void pack_data(scene& scene, scene_data& data)
+    {
+        // NOTE: the size is known up front, so the buffer is only allocated once.
+        memory_scene_sink sink{ get_scene_size(scene) };
+        data.buffer_size = pack_data(scene, sink, true);
+        assert(data.buffer_size == sink.size());
+        data.buffer = sink.release();
+    }
+
+    u64 pack_data(scene& scene, scene_sink& sink, bool release_meshes)
+    {
+        constexpr u64 su32{ sizeof(u32) };
+        utl::vector<u8> chunk;
+        u64 total_size{ 0 };
+
+        // Packs 'size' bytes into the chunk buffer and hands them to the sink.
+        // NOTE: the chunk buffer is reused, so it only grows to the size of the largest mesh.
+        auto write_chunk = [&](u64 size, auto&& pack) {
+            if (chunk.size() < size) chunk.resize(size);
+            utl::blob_stream_writer blob{ chunk.data(), size };
+            pack(blob);
+            assert(blob.offset() == size);
+            total_size += size;
+            return sink.write(chunk.data(), size);
+        };
+
+        const bool success{ write_chunk(su32 + scene.name.size() + su32, [&scene](utl::blob_stream_writer& blob) {
+            // scene name
+            blob.write((u32)scene.name.size());
+            blob.write(scene.name.c_str(), scene.name.size());
+            // number of LODs
+            blob.write((u32)scene.lod_groups.size());
+        }) };
+        if (!success) return 0;
+
         for (auto& lod : scene.lod_groups)
+        {
+            const bool lod_success{ write_chunk(su32 + lod.name.size() + su32, [&lod](utl::blob_stream_writer& blob) {
+                // LOD name
+                blob.write((u32)lod.name.size());
+                blob.write(lod.name.c_str(), lod.name.size());
+                // number of meshes in this LOD
+                blob.write((u32)lod.meshes.size());
+            }) };
+            if (!lod_success) return 0;
+
             for (auto& m : lod.meshes)
             {
-                process_vertices(m, settings);
+                if (!write_chunk(get_mesh_size(m), [&m](utl::blob_stream_writer& blob) { pack_mesh_data(m, blob); })) return 0;
+                if (release_meshes) m = mesh{};
             }
-    }
+        }
 
+        return total_size;
+    }
 
-    void pack_data(const scene& scene, scene_data& data)
+    void unpack_positions(const mesh& m, utl::vector<math::v3>& positions)
     {
-        //ȡsceneС
-        const u64 scene_size{ get_scene_size(scene) };
-        //bufferУڴԴeditor
-        data.buffer_size = (u32)scene_size;
-        data.buffer = (u8*)CoTaskMemAlloc(scene_size);
-        assert(data.buffer);
-        
-        utl::blob_stream_writer blob{ data.buffer, data.buffer_size };
-        
-        // scene name
-        blob.write((u32)scene.name.size());
-        blob.write(scene.name.c_str(), scene.name.size());
-        // number of LODs
-        blob.write((u32)scene.lod_groups.size());
-        
-        for (auto& lod : scene.lod_groups)
+        const u32 num_vertices{ (u32)(m.position_buffer.size() / get_position_size(m.elements_type)) };
+        positions.resize(num_vertices);
+
+        if (m.elements_type & elements::elements_type::quantized_position)
         {
-            // LOD name
-            blob.write((u32)lod.name.size());
-            blob.write(lod.name.c_str(), lod.name.size());
-            // number of meshes in this LOD
-            blob.write((u32)lod.meshes.size());
-        
-            for (auto& m : lod.meshes)
+            const elements::packed_position* const position_buffer{ (const elements::packed_position*)m.position_buffer.data() };
+            for (u32 i{ 0 }; i < num_vertices; ++i)
             {
-                pack_mesh_data(m, blob);
+                positions[i] = elements::decode_position(position_buffer[i], m.aabb_min, m.aabb_max);
             }
         }
-        assert(scene_size == blob.offset());
+        else
+        {
+            memcpy(positions.data(), m.position_buffer.data(), sizeof(math::v3) * num_vertices);
+        }
     }
 }
\ No newline at end of file
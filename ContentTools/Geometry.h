@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ToolsCommon.h"
+#include "Content/Meshlet.h"
 //һع
 namespace nidhog::tools
 {
@@ -31,9 +32,50 @@ namespace nidhog::tools
 				skeletal_normal_color = skeletal_normal | static_color,
 				skeletal_normal_texture = skeletal | static_normal_texture,
 				skeletal_normal_texture_color = skeletal_normal_texture | static_color,
+
+				// NOTE: flag that can be combined with any of the above. It doesn't change the element buffer,
+				//       but the position buffer holds packed_position instead of math::v3 and the submesh
+				//       header contains the AABB that the positions are relative to.
+				quantized_position = 0x10,
+
+				// NOTE: alternative tangent space encodings for static_normal(_texture). octahedral_tspace uses the
+				//       same layout with octahedral encoded normal and tangent (see VertexCompression.h).
+				//       quaternion_tspace packs normal and tangent into a single u32 (static_normal_texture only).
+				octahedral_tspace = 0x20,
+				quaternion_tspace = 0x40,
+				static_normal_octahedral = static_normal | octahedral_tspace,
+				static_normal_texture_octahedral = static_normal_texture | octahedral_tspace,
+				static_normal_texture_quaternion = static_normal_texture | quaternion_tspace,
+
+				// NOTE: flag that can be combined with any of the above. It doesn't change the vertex data, but
+				//       the submesh has a meshlet section after the indices (see content::meshlet).
+				meshlets = 0x80,
+			};
+		};
+
+		struct tspace_encoding {
+			enum type : u32 {
+				xy_sign = 0,        // x and y, with the sign of z in t_sign
+				octahedral,
+				quaternion,         // falls back to octahedral if the mesh has no UVs (and therefore no tangents)
+
+				count
 			};
 		};
 
+		// Position quantized to 16-bit unorm per axis, relative to the submesh AABB.
+		struct packed_position
+		{
+			u16         position[3];
+		};
+
+		[[nodiscard]] inline math::v3 decode_position(const packed_position& p, const math::v3& aabb_min, const math::v3& aabb_max)
+		{
+			return { math::unpack_to_float<16>(p.position[0], aabb_min.x, aabb_max.x),
+					 math::unpack_to_float<16>(p.position[1], aabb_min.y, aabb_max.y),
+					 math::unpack_to_float<16>(p.position[2], aabb_min.z, aabb_max.z) };
+		}
+
 		struct static_color
 		{
 			u8          color[3];
@@ -43,18 +85,26 @@ namespace nidhog::tools
 		struct static_normal
 		{
 			u8          color[3];
-			u8          t_sign;     // bit 0: tangent handedness * (tangent.z sign), bit 1: normal.z sign (0 means -1, 1 means +1).
+			u8          t_sign;     // bit 0: tangent.z sign, bit 1: normal.z sign, bit 2: tangent handedness (0 means -1, 1 means +1).
 			u16         normal[2];
 		};
 
 		struct static_normal_texture
 		{
 			u8          color[3];
-			u8          t_sign;     // bit 0: tangent handedness * (tangent.z sign), bit 1: normal.z sign (0 means -1, 1 means +1).
+			u8          t_sign;     // bit 0: tangent.z sign, bit 1: normal.z sign, bit 2: tangent handedness (0 means -1, 1 means +1).
 			u16         normal[2];
 			u16         tangent[2];
 			math::v2    uv;
 		};
+
+		struct static_normal_texture_quaternion
+		{
+			u8          color[3];
+			u8          t_sign;     // bit 2: tangent handedness (0 means -1, 1 means +1).
+			u32         tbn;        // see encode_tbn_quaternion()
+			math::v2    uv;
+		};
 		//about skeleton animationjoint_weights/indices
 		struct skeletal
 		{
@@ -75,7 +125,7 @@ namespace nidhog::tools
 		struct skeletal_normal
 		{
 			u8          joint_weights[3];   // normalized joint weights for up to 4 joints.
-			u8          t_sign;             // bit 0: tangent handedness * (tangent.z sign), bit 1: normal.z sign (0 means -1, 1 means +1).
+			u8          t_sign;             // bit 0: tangent.z sign, bit 1: normal.z sign, bit 2: tangent handedness (0 means -1, 1 means +1).
 			u16         joint_indices[4];
 			u16         normal[2];
 		};
@@ -83,7 +133,7 @@ namespace nidhog::tools
 		struct skeletal_normal_color
 		{
 			u8          joint_weights[3];   // normalized joint weights for up to 4 joints.
-			u8          t_sign;             // bit 0: tangent handedness * (tangent.z sign), bit 1: normal.z sign (0 means -1, 1 means +1).
+			u8          t_sign;             // bit 0: tangent.z sign, bit 1: normal.z sign, bit 2: tangent handedness (0 means -1, 1 means +1).
 			u16         joint_indices[4];
 			u16         normal[2];
 			u8          color[3];
@@ -93,7 +143,7 @@ namespace nidhog::tools
 		struct skeletal_normal_texture
 		{
 			u8          joint_weights[3];   // normalized joint weights for up to 4 joints.
-			u8          t_sign;             // bit 0: tangent handedness * (tangent.z sign), bit 1: normal.z sign (0 means -1, 1 means +1).
+			u8          t_sign;             // bit 0: tangent.z sign, bit 1: normal.z sign, bit 2: tangent handedness (0 means -1, 1 means +1).
 			u16         joint_indices[4];
 			u16         normal[2];
 			u16         tangent[2];
@@ -103,7 +153,7 @@ namespace nidhog::tools
 		struct skeletal_normal_texture_color
 		{
 			u8          joint_weights[3];   // normalized joint weights for up to 4 joints.
-			u8          t_sign;             // bit 0: tangent handedness * (tangent.z sign), bit 1: normal.z sign (0 means -1, 1 means +1).
+			u8          t_sign;             // bit 0: tangent.z sign, bit 1: normal.z sign, bit 2: tangent handedness (0 means -1, 1 means +1).
 			u16         joint_indices[4];
 			u16         normal[2];
 			u16         tangent[2];
@@ -133,12 +183,30 @@ namespace nidhog::tools
         // м
         utl::vector<vertex>                 vertices;
         utl::vector<u32>                    indices;
+        // Chunks of meshes that are processed out of core: 1 for triangles that belong to a neighboring chunk.
+        // They're only there so vertices on the chunk border get the same normals and tangents in both chunks,
+        // and are dropped before the vertices are packed.
+        utl::vector<u8>                     halo;
+        // Quantize positions relative to aabb_min/aabb_max as given, instead of the bounds of the vertices,
+        // so the chunks of a mesh decode shared border positions to the exact same value.
+        bool                                fixed_bounds{ false };
 
         // 
         std::string                         name;
         elements::elements_type::type       elements_type;
         utl::vector<u8>                     position_buffer;
         utl::vector<u8>                     element_buffer;
+        math::v3                            aabb_min{};     // bounds of the packed positions. Quantized positions are relative to these.
+        math::v3                            aabb_max{};
+        math::v3                            bounds_min{};   // tight bounds of the packed vertices, for culling
+        math::v3                            bounds_max{};
+        math::v3                            sphere_center{};
+        f32                                 sphere_radius{ 0.f };
+        f32                                 lod_error{ 0.f };   // geometric error compared to LOD 0, in mesh units
+        utl::vector<content::meshlet>       meshlets;
+        utl::vector<content::meshlet_bounds> meshlet_bounds;
+        utl::vector<u32>                    meshlet_vertices;   // vertex indices of all meshlets
+        utl::vector<u8>                     meshlet_triangles;  // 3 meshlet-local vertex indices per triangle
 
         f32                                 lod_threshold{ -1.f };
         u32                                 lod_id{ u32_invalid_id };
@@ -171,17 +239,80 @@ namespace nidhog::tools
         u8  import_embeded_textures;
         //
         u8  import_animations;
+        // NOTE: number of LODs to generate by simplification for LOD groups that only have LOD 0.
+        u8  auto_lod_count;
+        // NOTE: store positions as 16-bit unorm relative to the submesh AABB instead of 3 floats.
+        u8  quantize_positions;
+        // NOTE: one of elements::tspace_encoding.
+        u8  tspace_encoding;
+        // NOTE: partition submeshes into meshlets with bounds for cluster culling.
+        u8  build_meshlets;
+        // NOTE: write per-mesh import statistics (vertex cache, etc.) to the debug output.
+        u8  log_stats;
     };
 
     //
     struct scene_data
     {
         u8* buffer;
-        u32                      buffer_size;
+        u64                      buffer_size;
         //嵼뷽ʽ
         geometry_import_settings settings;
     };
 
+    // Receives a packed scene in consecutive chunks (header, LOD group headers and meshes, in order).
+    class scene_sink
+    {
+    public:
+        virtual ~scene_sink() = default;
+        // Returns false if the data couldn't be written, which stops packing.
+        virtual bool write(const u8* const data, u64 size) = 0;
+    };
+
+    // Collects the chunks in a single buffer, allocated with CoTaskMemAlloc so it can be handed to the editor.
+    class memory_scene_sink : public scene_sink
+    {
+    public:
+        explicit memory_scene_sink(u64 initial_capacity);
+        ~memory_scene_sink() override;
+        DISABLE_COPY_AND_MOVE(memory_scene_sink);
+
+        bool write(const u8* const data, u64 size) override;
+        // Hands over the buffer, which then has to be freed with CoTaskMemFree.
+        [[nodiscard]] u8* release();
+        [[nodiscard]] constexpr u64 size() const { return _size; }
+    private:
+        u8*     _buffer{ nullptr };
+        u64     _size{ 0 };
+        u64     _capacity{ 0 };
+    };
+
+#ifdef _WIN64
+    // Writes the chunks to a file or pipe handle, which isn't closed by the sink.
+    class handle_scene_sink : public scene_sink
+    {
+    public:
+        explicit handle_scene_sink(HANDLE handle) : _handle{ handle } { assert(handle && handle != INVALID_HANDLE_VALUE); }
+        bool write(const u8* const data, u64 size) override;
+    private:
+        HANDLE  _handle;
+    };
+#endif
+
     void process_scene(scene& scene, const geometry_import_settings& settings);
-    void pack_data(const scene& scene, scene_data& data);
+    // Logs how long reading a scene from a file took, in the same format for all importers, so they can be compared.
+    void log_import_stats(const char* format, const char* file, const scene& scene, double milliseconds);
+    // Packs the scene into one buffer for the editor. Meshes are released as they're packed.
+    void pack_data(scene& scene, scene_data& data);
+    // Packs the scene in the same format as above, but passes it to 'sink' one chunk at a time, so it never
+    // has to be in memory as a whole. If release_meshes is true, every mesh is freed right after it's written,
+    // which keeps peak memory at about the size of the scene. Returns the number of bytes written, or 0 on failure.
+    u64 pack_data(scene& scene, scene_sink& sink, bool release_meshes);
+
+    // Packs vertices into the element buffer layout of elements_type (vertex_count * element size bytes).
+    // NOTE: used by the import pipeline, but doesn't need a mesh, so procedural geometry can be packed directly.
+    void pack_vertex_elements(elements::elements_type::type elements_type, const vertex* const vertices, u32 vertex_count, u8* const buffer);
+
+    // Decodes the position buffer of a packed mesh into floats, for either position format.
+    void unpack_positions(const mesh& m, utl::vector<math::v3>& positions);
 }
@@ -0,0 +1,730 @@
+#include "GltfImporter.h"
+#include "Geometry.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include <cfloat>
+#include <cmath>
+#include <filesystem>
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        constexpr u32 glb_magic{ 0x46546c67 };      // "glTF"
+        constexpr u32 glb_json_chunk{ 0x4e4f534a };  // "JSON"
+        constexpr u32 glb_bin_chunk{ 0x004e4942 };   // "BIN\0"
+        constexpr u32 triangles_mode{ 4 };
+        constexpr u32 max_node_depth{ 256 };
+
+        // NOTE: glTF LODs switch by screen coverage, our LOD thresholds are distances. We convert with the
+        //       bounding sphere of LOD 0 for this vertical field of view.
+        constexpr f32 lod_reference_fov{ 60.f * 3.14159265f / 180.f };
+        // Screen coverage at which LOD 1 is used if the file doesn't say (MSFT_screencoverage is optional).
+        constexpr f32 default_lod_coverage{ 0.5f };
+
+        enum component_type : u32
+        {
+            int8_type = 5120,
+            uint8_type = 5121,
+            int16_type = 5122,
+            uint16_type = 5123,
+            uint32_type = 5125,
+            float_type = 5126,
+        };
+
+        [[nodiscard]] u32 get_component_size(u32 type)
+        {
+            switch (type)
+            {
+            case int8_type:
+            case uint8_type: return 1;
+            case int16_type:
+            case uint16_type: return 2;
+            case uint32_type:
+            case float_type: return 4;
+            default: return 0;
+            }
+        }
+
+        [[nodiscard]] u32 get_component_count(const std::string& type)
+        {
+            if (type == "SCALAR") return 1;
+            if (type == "VEC2") return 2;
+            if (type == "VEC3") return 3;
+            if (type == "VEC4") return 4;
+            return 0;
+        }
+
+        template<typename T> [[nodiscard]] T load(const u8* p)
+        {
+            T v;
+            memcpy(&v, p, sizeof(T));
+            return v;
+        }
+
+        // Typed, strided view of an accessor's elements in a buffer. Nothing is copied; elements are converted
+        // when they're read.
+        struct accessor_view
+        {
+            const u8*   data{ nullptr };
+            u32         count{ 0 };
+            u32         stride{ 0 };
+            u32         component_type{ 0 };
+            u32         components{ 0 };
+            bool        normalized{ false };
+
+            [[nodiscard]] constexpr bool is_valid() const { return data != nullptr; }
+
+            [[nodiscard]] f32 get_float(u32 index, u32 component) const
+            {
+                assert(index < count && component < components);
+                const u8* const p{ data + (u64)index * stride + component * get_component_size(component_type) };
+                switch (component_type)
+                {
+                case float_type:  return load<f32>(p);
+                case int8_type:   return normalized ? std::max((f32)load<s8>(p) / 127.f, -1.f) : (f32)load<s8>(p);
+                case uint8_type:  return normalized ? (f32)load<u8>(p) / 255.f : (f32)load<u8>(p);
+                case int16_type:  return normalized ? std::max((f32)load<s16>(p) / 32767.f, -1.f) : (f32)load<s16>(p);
+                case uint16_type: return normalized ? (f32)load<u16>(p) / 65535.f : (f32)load<u16>(p);
+                case uint32_type: return (f32)load<u32>(p);
+                default: return 0.f;
+                }
+            }
+
+            // Reads a whole element as math::v2, v3 or v4. Float elements, which is most of them, are read directly.
+            template<typename T>
+            [[nodiscard]] T get_element(u32 index) const
+            {
+                static_assert(sizeof(T) % sizeof(f32) == 0);
+                constexpr u32 element_components{ sizeof(T) / sizeof(f32) };
+                assert(index < count && components == element_components);
+                T v;
+                if (component_type == float_type)
+                {
+                    memcpy(&v, data + (u64)index * stride, sizeof(T));
+                }
+                else
+                {
+                    f32 c[element_components];
+                    for (u32 i{ 0 }; i < element_components; ++i) c[i] = get_float(index, i);
+                    memcpy(&v, c, sizeof(T));
+                }
+
+                return v;
+            }
+
+            [[nodiscard]] u32 get_index(u32 index) const
+            {
+                assert(index < count);
+                const u8* const p{ data + (u64)index * stride };
+                switch (component_type)
+                {
+                case uint8_type:  return load<u8>(p);
+                case uint16_type: return load<u16>(p);
+                case uint32_type: return load<u32>(p);
+                default: return u32_invalid_id;
+                }
+            }
+        };
+
+        // Column-major 4x4 matrix, like in glTF.
+        struct transform
+        {
+            f32 m[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+            [[nodiscard]] transform operator*(const transform& other) const
+            {
+                transform result;
+                for (u32 c{ 0 }; c < 4; ++c)
+                {
+                    for (u32 r{ 0 }; r < 4; ++r)
+                    {
+                        f32 sum{ 0.f };
+                        for (u32 k{ 0 }; k < 4; ++k) sum += m[k * 4 + r] * other.m[c * 4 + k];
+                        result.m[c * 4 + r] = sum;
+                    }
+                }
+
+                return result;
+            }
+
+            [[nodiscard]] math::v3 transform_point(const math::v3& p) const
+            {
+                return { m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                         m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                         m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14] };
+            }
+
+            [[nodiscard]] math::v3 transform_direction(const math::v3& d) const
+            {
+                return { m[0] * d.x + m[4] * d.y + m[8] * d.z,
+                         m[1] * d.x + m[5] * d.y + m[9] * d.z,
+                         m[2] * d.x + m[6] * d.y + m[10] * d.z };
+            }
+
+            [[nodiscard]] f32 determinant3x3() const
+            {
+                return m[0] * (m[5] * m[10] - m[6] * m[9]) - m[4] * (m[1] * m[10] - m[2] * m[9]) + m[8] * (m[1] * m[6] - m[2] * m[5]);
+            }
+
+            // Returns the cofactor matrix of the upper 3x3, which is the inverse transpose scaled by the determinant.
+            // That's all we need for normals, since they're normalized anyway.
+            [[nodiscard]] transform normal_transform() const
+            {
+                const math::v3 c0{ m[0], m[1], m[2] };
+                const math::v3 c1{ m[4], m[5], m[6] };
+                const math::v3 c2{ m[8], m[9], m[10] };
+                auto cross = [](const math::v3& a, const math::v3& b) -> math::v3 {
+                    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+                };
+
+                const math::v3 r0{ cross(c1, c2) };
+                const math::v3 r1{ cross(c2, c0) };
+                const math::v3 r2{ cross(c0, c1) };
+                const f32 sign{ determinant3x3() < 0.f ? -1.f : 1.f };
+                transform result;
+                for (u32 i{ 0 }; i < 3; ++i)
+                {
+                    const math::v3& r{ i == 0 ? r0 : i == 1 ? r1 : r2 };
+                    result.m[i * 4 + 0] = r.x * sign;
+                    result.m[i * 4 + 1] = r.y * sign;
+                    result.m[i * 4 + 2] = r.z * sign;
+                }
+
+                return result;
+            }
+        };
+
+        [[nodiscard]] math::v3 normalize(const math::v3& v)
+        {
+            const f32 length{ sqrtf(v.x * v.x + v.y * v.y + v.z * v.z) };
+            return length > 0.f ? math::v3{ v.x / length, v.y / length, v.z / length } : v;
+        }
+
+        [[nodiscard]] transform get_local_transform(const json::value& node)
+        {
+            transform t;
+            const json::value matrix{ node["matrix"] };
+            if (matrix.size() == 16)
+            {
+                for (u32 i{ 0 }; i < 16; ++i) t.m[i] = matrix[i].as_f32();
+                return t;
+            }
+
+            const json::value translation{ node["translation"] };
+            const json::value rotation{ node["rotation"] };
+            const json::value scale{ node["scale"] };
+            const f32 x{ rotation[0].as_f32(0.f) }, y{ rotation[1].as_f32(0.f) }, z{ rotation[2].as_f32(0.f) }, w{ rotation[3].as_f32(1.f) };
+            const f32 sx{ scale[0].as_f32(1.f) }, sy{ scale[1].as_f32(1.f) }, sz{ scale[2].as_f32(1.f) };
+
+            // T * R * S
+            t.m[0] = (1.f - 2.f * (y * y + z * z)) * sx;
+            t.m[1] = (2.f * (x * y + z * w)) * sx;
+            t.m[2] = (2.f * (x * z - y * w)) * sx;
+            t.m[4] = (2.f * (x * y - z * w)) * sy;
+            t.m[5] = (1.f - 2.f * (x * x + z * z)) * sy;
+            t.m[6] = (2.f * (y * z + x * w)) * sy;
+            t.m[8] = (2.f * (x * z + y * w)) * sz;
+            t.m[9] = (2.f * (y * z - x * w)) * sz;
+            t.m[10] = (1.f - 2.f * (x * x + y * y)) * sz;
+            t.m[12] = translation[0].as_f32(0.f);
+            t.m[13] = translation[1].as_f32(0.f);
+            t.m[14] = translation[2].as_f32(0.f);
+            return t;
+        }
+
+        [[nodiscard]] bool decode_base64(const char* p, const char* const end, utl::vector<u8>& bytes)
+        {
+            auto decode = [](char c) -> u32 {
+                if (c >= 'A' && c <= 'Z') return (u32)(c - 'A');
+                if (c >= 'a' && c <= 'z') return (u32)(c - 'a' + 26);
+                if (c >= '0' && c <= '9') return (u32)(c - '0' + 52);
+                if (c == '+' || c == '-') return 62;
+                if (c == '/' || c == '_') return 63;
+                return u32_invalid_id;
+            };
+
+            bytes.clear();
+            bytes.reserve((u64)(end - p) / 4 * 3);
+            u32 bits{ 0 };
+            u32 bit_count{ 0 };
+            for (; p < end && *p != '='; ++p)
+            {
+                const u32 value{ decode(*p) };
+                if (value == u32_invalid_id) return false;
+                bits = (bits << 6) | value;
+                bit_count += 6;
+                if (bit_count >= 8)
+                {
+                    bit_count -= 8;
+                    bytes.emplace_back((u8)(bits >> bit_count));
+                }
+            }
+
+            return true;
+        }
+
+        [[nodiscard]] std::string decode_uri(const std::string& uri)
+        {
+            std::string s;
+            s.reserve(uri.size());
+            for (size_t i{ 0 }; i < uri.size(); ++i)
+            {
+                if (uri[i] == '%' && i + 2 < uri.size())
+                {
+                    s += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+                    i += 2;
+                }
+                else s += uri[i];
+            }
+
+            return s;
+        }
+
+        class gltf_context
+        {
+        public:
+            explicit gltf_context(const char* file);
+            DISABLE_COPY_AND_MOVE(gltf_context);
+
+            [[nodiscard]] constexpr bool is_valid() const { return _valid; }
+            void get_scene(scene& scene);
+        private:
+            struct buffer_data
+            {
+                const u8*   data;
+                u64         size;
+            };
+
+            [[nodiscard]] bool load_buffers(const std::filesystem::path& directory, const u8* glb_bin, u64 glb_bin_size);
+            [[nodiscard]] accessor_view get_accessor(u32 index) const;
+            void get_meshes(u32 node_index, const transform& parent, utl::vector<mesh>& meshes, u32 lod_id, f32 lod_threshold,
+                            u32 depth, bool is_lod_level);
+            void get_lod_group(u32 node_index, const transform& parent, u32 depth);
+            [[nodiscard]] bool get_mesh_data(const json::value& gltf_mesh, const transform& world, mesh& m) const;
+
+            mapped_file                                 _file;
+            json::document                              _json;
+            json::value                                 _root;
+            utl::vector<buffer_data>                    _buffers;
+            utl::vector<std::unique_ptr<mapped_file>>   _external_buffers;
+            utl::vector<utl::vector<u8>>                _embedded_buffers;
+            utl::vector<lod_group>                      _lod_groups;
+            bool                                        _valid{ false };
+        };
+
+        gltf_context::gltf_context(const char* file) : _file{ file }
+        {
+            if (!_file.is_valid()) return;
+
+            const u8* const data{ (const u8*)_file.data() };
+            const u64 size{ _file.size() };
+            const u8* json_text{ data };
+            u64 json_size{ size };
+            const u8* bin{ nullptr };
+            u64 bin_size{ 0 };
+
+            if (size >= 12 && load<u32>(data) == glb_magic)
+            {
+                // GLB: 12 byte header, then chunks of { length, type, data }. JSON comes first, BIN is optional.
+                if (load<u32>(data + 4) != 2) return;
+                const u64 length{ std::min<u64>(load<u32>(data + 8), size) };
+                for (u64 offset{ 12 }; offset + 8 <= length;)
+                {
+                    const u32 chunk_length{ load<u32>(data + offset) };
+                    const u32 chunk_type{ load<u32>(data + offset + 4) };
+                    if (offset + 8 + chunk_length > length) return;
+                    if (chunk_type == glb_json_chunk && json_text == data)
+                    {
+                        json_text = data + offset + 8;
+                        json_size = chunk_length;
+                    }
+                    else if (chunk_type == glb_bin_chunk && !bin)
+                    {
+                        bin = data + offset + 8;
+                        bin_size = chunk_length;
+                    }
+
+                    offset += 8 + math::align_size_up<4>((u64)chunk_length);
+                }
+
+                if (json_text == data) return;
+            }
+
+            if (!_json.parse((const char*)json_text, json_size)) return;
+            _root = _json.root();
+            if (_root["asset"]["version"].as_string().rfind("2", 0) != 0) return;
+
+            _valid = load_buffers(std::filesystem::path{ file }.parent_path(), bin, bin_size);
+        }
+
+        bool gltf_context::load_buffers(const std::filesystem::path& directory, const u8* glb_bin, u64 glb_bin_size)
+        {
+            const json::value buffers{ _root["buffers"] };
+            for (u32 i{ 0 }; i < buffers.size(); ++i)
+            {
+                const json::value buffer{ buffers[i] };
+                const u64 byte_length{ (u64)buffer["byteLength"].as_number(0.0) };
+                const json::value uri_value{ buffer["uri"] };
+                buffer_data data{ nullptr, 0 };
+
+                if (!uri_value.is_valid())
+                {
+                    // NOTE: only the first buffer of a GLB can refer to the BIN chunk.
+                    if (i || !glb_bin) return false;
+                    data = { glb_bin, glb_bin_size };
+                }
+                else
+                {
+                    const std::string uri{ uri_value.as_string() };
+                    if (uri.rfind("data:", 0) == 0)
+                    {
+                        const size_t comma{ uri.find(',') };
+                        if (comma == std::string::npos || uri.find(";base64") > comma) return false;
+                        utl::vector<u8>& bytes{ _embedded_buffers.emplace_back() };
+                        if (!decode_base64(uri.data() + comma + 1, uri.data() + uri.size(), bytes)) return false;
+                        data = { bytes.data(), bytes.size() };
+                    }
+                    else
+                    {
+                        const std::string path{ (directory / decode_uri(uri)).string() };
+                        std::unique_ptr<mapped_file>& file{ _external_buffers.emplace_back(std::make_unique<mapped_file>(path.c_str())) };
+                        if (!file->is_valid()) return false;
+                        data = { (const u8*)file->data(), file->size() };
+                    }
+                }
+
+                if (data.size < byte_length) return false;
+                _buffers.emplace_back(data);
+            }
+
+            return true;
+        }
+
+        accessor_view gltf_context::get_accessor(u32 index) const
+        {
+            const json::value accessor{ _root["accessors"][index] };
+            // NOTE: sparse accessors aren't supported, and accessors without a buffer view are all zeros,
+            //       which is never useful for the attributes we import.
+            if (!accessor.is_valid() || accessor["sparse"].is_valid()) return {};
+
+            const json::value view{ _root["bufferViews"][accessor["bufferView"].as_u32()] };
+            const u32 buffer_index{ view["buffer"].as_u32() };
+            if (!view.is_valid() || buffer_index >= _buffers.size()) return {};
+
+            accessor_view result{};
+            result.component_type = accessor["componentType"].as_u32(0);
+            result.components = get_component_count(accessor["type"].as_string());
+            result.normalized = accessor["normalized"].as_bool();
+            result.count = accessor["count"].as_u32(0);
+
+            const u32 element_size{ get_component_size(result.component_type) * result.components };
+            result.stride = view["byteStride"].as_u32(0);
+            if (!result.stride) result.stride = element_size;
+            if (!element_size || !result.count || result.stride < element_size) return {};
+
+            // Make sure all elements are within the buffer view and the view is within the buffer.
+            const buffer_data& buffer{ _buffers[buffer_index] };
+            const u64 view_offset{ (u64)view["byteOffset"].as_number(0.0) };
+            const u64 view_length{ (u64)view["byteLength"].as_number(0.0) };
+            const u64 offset{ (u64)accessor["byteOffset"].as_number(0.0) };
+            if (view_offset + view_length > buffer.size ||
+                offset + (u64)(result.count - 1) * result.stride + element_size > view_length)
+            {
+                return {};
+            }
+
+            result.data = buffer.data + view_offset + offset;
+            return result;
+        }
+
+        void gltf_context::get_scene(scene& scene)
+        {
+            assert(is_valid());
+            const json::value nodes{ _root["nodes"] };
+            const u32 node_count{ nodes.size() };
+
+            // Root nodes of the default scene, or all nodes that aren't children or lower LODs of other nodes.
+            utl::vector<u32> roots;
+            const json::value scene_nodes{ _root["scenes"][_root["scene"].as_u32(0)]["nodes"] };
+            if (scene_nodes.is_array())
+            {
+                for (u32 i{ 0 }; i < scene_nodes.size(); ++i) roots.emplace_back(scene_nodes[i].as_u32());
+            }
+            else
+            {
+                utl::vector<u8> is_child(node_count, 0);
+                for (u32 i{ 0 }; i < node_count; ++i)
+                {
+                    const json::value children{ nodes[i]["children"] };
+                    for (u32 j{ 0 }; j < children.size(); ++j) if (children[j].as_u32() < node_count) is_child[children[j].as_u32()] = 1;
+                    const json::value lods{ nodes[i]["extensions"]["MSFT_lod"]["ids"] };
+                    for (u32 j{ 0 }; j < lods.size(); ++j) if (lods[j].as_u32() < node_count) is_child[lods[j].as_u32()] = 1;
+                }
+
+                for (u32 i{ 0 }; i < node_count; ++i) if (!is_child[i]) roots.emplace_back(i);
+            }
+
+            for (u32 root : roots)
+            {
+                if (root >= node_count) continue;
+                lod_group lod{};
+                get_meshes(root, transform{}, lod.meshes, 0, -1.f, 0, false);
+                if (lod.meshes.size())
+                {
+                    lod.name = lod.meshes[0].name;
+                    scene.lod_groups.emplace_back(std::move(lod));
+                }
+            }
+
+            // NOTE: LOD groups are added after the other groups, because they're found while those are collected.
+            for (lod_group& lod : _lod_groups) scene.lod_groups.emplace_back(std::move(lod));
+            _lod_groups.clear();
+            scene.name = _root["asset"]["extras"]["title"].as_string();
+        }
+
+        void gltf_context::get_meshes(u32 node_index, const transform& parent, utl::vector<mesh>& meshes, u32 lod_id, f32 lod_threshold,
+                                      u32 depth, bool is_lod_level)
+        {
+            const json::value node{ _root["nodes"][node_index] };
+            if (!node.is_valid() || depth > max_node_depth) return;
+
+            // Like in FBX files, a LOD group and the meshes of all its levels become a separate LOD group.
+            if (!is_lod_level && node["extensions"]["MSFT_lod"].is_valid())
+            {
+                get_lod_group(node_index, parent, depth);
+                return;
+            }
+
+            const transform world{ parent * get_local_transform(node) };
+            const json::value gltf_mesh{ _root["meshes"][node["mesh"].as_u32()] };
+            if (gltf_mesh.is_valid())
+            {
+                mesh m{};
+                m.lod_id = lod_id;
+                m.lod_threshold = lod_threshold;
+                m.name = node["name"].as_string(gltf_mesh["name"].as_string().c_str());
+                if (get_mesh_data(gltf_mesh, world, m))
+                {
+                    meshes.emplace_back(std::move(m));
+                }
+            }
+
+            const json::value children{ node["children"] };
+            for (u32 i{ 0 }; i < children.size(); ++i)
+            {
+                get_meshes(children[i].as_u32(), world, meshes, lod_id, lod_threshold, depth + 1, false);
+            }
+        }
+
+        void gltf_context::get_lod_group(u32 node_index, const transform& parent, u32 depth)
+        {
+            const json::value node{ _root["nodes"][node_index] };
+            const json::value ids{ node["extensions"]["MSFT_lod"]["ids"] };
+            const json::value coverages{ node["extras"]["MSFT_screencoverage"] };
+
+            lod_group lod{};
+            lod.name = node["name"].as_string();
+            f32 radius{ 0.f };
+            f32 previous_threshold{ -1.f };
+            for (u32 level{ 0 }; level <= ids.size(); ++level)
+            {
+                f32 lod_threshold{ -1.f };
+                if (level > 0)
+                {
+                    // NOTE: screen coverage is the fraction of the screen height the object covers, for which the
+                    //       previous level is still used. The distance at which the bounding sphere covers that
+                    //       much is our threshold.
+                    const f32 distance_per_coverage{ (radius > 0.f ? radius : 1.f) / tanf(lod_reference_fov * 0.5f) };
+                    const f32 coverage{ coverages[level - 1].as_f32(0.f) };
+                    if (coverage > 0.f) lod_threshold = distance_per_coverage / coverage;
+
+                    // NOTE: the engine only loads geometry with increasing thresholds. Levels without a coverage,
+                    //       or with one that isn't smaller than the previous level's, switch at twice the previous
+                    //       distance, where the object covers half as much of the screen.
+                    if (lod_threshold <= previous_threshold)
+                    {
+                        lod_threshold = previous_threshold > 0.f ? previous_threshold * 2.f : distance_per_coverage / default_lod_coverage;
+                    }
+
+                    previous_threshold = lod_threshold;
+                }
+
+                const u32 level_node{ level ? ids[level - 1].as_u32() : node_index };
+                get_meshes(level_node, parent, lod.meshes, level, lod_threshold, depth + 1, true);
+
+                if (!level)
+                {
+                    math::v3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+                    math::v3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+                    for (const mesh& m : lod.meshes)
+                    {
+                        for (const math::v3& p : m.positions)
+                        {
+                            min = { std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z) };
+                            max = { std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z) };
+                        }
+                    }
+
+                    if (!lod.meshes.empty())
+                    {
+                        const math::v3 size{ max.x - min.x, max.y - min.y, max.z - min.z };
+                        radius = 0.5f * sqrtf(size.x * size.x + size.y * size.y + size.z * size.z);
+                    }
+                }
+            }
+
+            if (lod.meshes.size())
+            {
+                if (lod.name.empty()) lod.name = lod.meshes[0].name;
+                _lod_groups.emplace_back(std::move(lod));
+            }
+        }
+
+        // Merges all triangle list primitives of a glTF mesh into one mesh, with the primitive's material as
+        // the material of its triangles. Normals, tangents and UVs are only imported if all primitives have them.
+        bool gltf_context::get_mesh_data(const json::value& gltf_mesh, const transform& world, mesh& m) const
+        {
+            struct primitive_views
+            {
+                accessor_view   positions;
+                accessor_view   indices;
+                accessor_view   normals;
+                accessor_view   tangents;
+                accessor_view   uvs[2];
+                u32             material;
+                u32             first_corner;
+                u32             first_position;
+            };
+
+            const json::value primitives{ gltf_mesh["primitives"] };
+            const u32 default_material{ _root["materials"].size() };
+            utl::vector<primitive_views> views;
+            bool has_normals{ true };
+            bool has_tangents{ true };
+            bool has_uvs[2]{ true, true };
+            u64 corner_count{ 0 };
+            u64 position_count{ 0 };
+
+            for (u32 i{ 0 }; i < primitives.size(); ++i)
+            {
+                const json::value primitive{ primitives[i] };
+                if (primitive["mode"].as_u32(triangles_mode) != triangles_mode) continue;
+
+                const json::value attributes{ primitive["attributes"] };
+                primitive_views v{};
+                v.positions = get_accessor(attributes["POSITION"].as_u32());
+                if (!v.positions.is_valid() || v.positions.components != 3) continue;
+
+                const json::value indices{ primitive["indices"] };
+                if (indices.is_valid())
+                {
+                    v.indices = get_accessor(indices.as_u32());
+                    if (!v.indices.is_valid() || v.indices.components != 1 || v.indices.get_index(0) == u32_invalid_id) continue;
+                }
+
+                v.normals = get_accessor(attributes["NORMAL"].as_u32());
+                v.tangents = get_accessor(attributes["TANGENT"].as_u32());
+                v.uvs[0] = get_accessor(attributes["TEXCOORD_0"].as_u32());
+                v.uvs[1] = get_accessor(attributes["TEXCOORD_1"].as_u32());
+                has_normals &= v.normals.is_valid() && v.normals.components == 3 && v.normals.count == v.positions.count;
+                has_tangents &= v.tangents.is_valid() && v.tangents.components == 4 && v.tangents.count == v.positions.count;
+                for (u32 k{ 0 }; k < 2; ++k) has_uvs[k] &= v.uvs[k].is_valid() && v.uvs[k].components == 2 && v.uvs[k].count == v.positions.count;
+
+                const u32 index_count{ v.indices.is_valid() ? v.indices.count : v.positions.count };
+                v.material = primitive["material"].as_u32(default_material);
+                v.first_corner = (u32)corner_count;
+                v.first_position = (u32)position_count;
+                corner_count += index_count - index_count % 3;
+                position_count += v.positions.count;
+                if (corner_count >= u32_invalid_id || position_count >= u32_invalid_id) return false;
+                views.emplace_back(v);
+            }
+
+            if (!corner_count) return false;
+            has_uvs[1] &= has_uvs[0];
+
+            m.positions.resize(position_count);
+            m.raw_indices.resize(corner_count);
+            if (has_normals) m.normals.resize(corner_count);
+            if (has_tangents) m.tangents.resize(corner_count);
+            m.uv_sets.resize(has_uvs[1] ? 2 : has_uvs[0] ? 1 : 0);
+            for (auto& uv_set : m.uv_sets) uv_set.resize(corner_count);
+            m.material_indices.resize(corner_count / 3);
+
+            const transform normal_transform{ world.normal_transform() };
+            // NOTE: mirroring transforms flip the winding order, so we flip it back.
+            const bool flip_winding{ world.determinant3x3() < 0.f };
+            bool valid_indices{ true };
+
+            for (const primitive_views& v : views)
+            {
+                parallel_for(v.positions.count, [&](u32 begin, u32 end) {
+                    for (u32 i{ begin }; i < end; ++i)
+                    {
+                        m.positions[v.first_position + i] = world.transform_point(v.positions.get_element<math::v3>(i));
+                    }
+                });
+
+                const u32 triangle_count{ (v.indices.is_valid() ? v.indices.count : v.positions.count) / 3 };
+                std::atomic<bool> primitive_valid{ true };
+                parallel_for(triangle_count, [&](u32 begin, u32 end) {
+                    for (u32 t{ begin }; t < end; ++t)
+                    {
+                        const u32 corner{ v.first_corner + t * 3 };
+                        m.material_indices[corner / 3] = v.material;
+                        for (u32 k{ 0 }; k < 3; ++k)
+                        {
+                            const u32 source{ t * 3 + (flip_winding && k ? 3 - k : k) };
+                            const u32 index{ v.indices.is_valid() ? v.indices.get_index(source) : source };
+                            if (index >= v.positions.count)
+                            {
+                                primitive_valid = false;
+                                return;
+                            }
+
+                            m.raw_indices[corner + k] = v.first_position + index;
+                            if (has_normals)
+                            {
+                                m.normals[corner + k] = normalize(normal_transform.transform_direction(v.normals.get_element<math::v3>(index)));
+                            }
+
+                            if (has_tangents)
+                            {
+                                const math::v4 t{ v.tangents.get_element<math::v4>(index) };
+                                const math::v3 tangent{ normalize(world.transform_direction({ t.x, t.y, t.z })) };
+                                m.tangents[corner + k] = { tangent.x, tangent.y, tangent.z, flip_winding ? -t.w : t.w };
+                            }
+
+                            for (u32 uv_set{ 0 }; uv_set < m.uv_sets.size(); ++uv_set)
+                            {
+                                // NOTE: glTF UVs have their origin in the top-left corner, ours (like FBX) in the bottom-left.
+                                const math::v2 uv{ v.uvs[uv_set].get_element<math::v2>(index) };
+                                m.uv_sets[uv_set][corner + k] = { uv.x, 1.f - uv.y };
+                            }
+                        }
+                    }
+                });
+
+                valid_indices &= primitive_valid;
+                if (std::find(m.material_used.begin(), m.material_used.end(), v.material) == m.material_used.end())
+                {
+                    m.material_used.emplace_back(v.material);
+                }
+            }
+
+            return valid_indices;
+        }
+    } // anonymous namespace
+
+    bool import_gltf(const char* file, scene& scene)
+    {
+        assert(file);
+        gltf_context gltf{ file };
+        if (!gltf.is_valid()) return false;
+
+        gltf.get_scene(scene);
+        if (scene.name.empty()) scene.name = std::filesystem::path{ file }.stem().string();
+        return !scene.lod_groups.empty();
+    }
+}
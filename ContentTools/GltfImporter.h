@@ -0,0 +1,15 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    struct scene;
+
+    // Reads a glTF 2.0 file (.gltf with embedded or external buffers, or binary .glb) into a scene.
+    // Like the FBX importer, every root node becomes a LOD group with all meshes below it as LOD 0, and
+    // nodes with the MSFT_lod extension become LOD groups with one level per LOD node.
+    // Buffers are memory-mapped and read through typed, strided accessor views, so vertex data is only
+    // copied once, into the mesh. Only triangle list primitives are imported.
+    // Returns false if the file can't be read or has no meshes.
+    bool import_gltf(const char* file, scene& scene);
+}
@@ -0,0 +1,112 @@
+#include "Geometry.h"
+#include "ObjImporter.h"
+#include "PlyImporter.h"
+#include "GltfImporter.h"
+#ifdef NIDHOG_IMPORT_FBX
+#include "FbxImporter.h"
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+// Command line tool that reads geometry files with the importers (without processing or packing the scenes,
+// which need the rest of ContentTools), and prints what it found and how long reading took. With --runs, every
+// file is read that many times and the fastest and average times are printed, so equivalent assets in different
+// formats (e.g. the same model as .fbx and .glb) can be compared.
+// It's built by CMakeLists.txt. FBX files can only be read if it was configured with FBX_SDK_DIR.
+//
+// Usage: nidhog_import [--runs count] file...
+using namespace nidhog;
+using namespace nidhog::tools;
+
+namespace
+{
+    bool import_file(const char* file, scene& scene)
+    {
+        std::string extension{ std::filesystem::path{ file }.extension().string() };
+        for (char& c : extension) c = (char)tolower(c);
+        if (extension == ".obj") return import_obj(file, scene);
+        if (extension == ".ply") return import_ply(file, scene);
+        if (extension == ".gltf" || extension == ".glb") return import_gltf(file, scene);
+#ifdef NIDHOG_IMPORT_FBX
+        if (extension == ".fbx")
+        {
+            // NOTE: same defaults as the editor's import settings.
+            scene_data data{};
+            data.settings.calculate_tangents = 1;
+            return import_fbx(file, scene, data);
+        }
+#endif
+
+        fprintf(stderr, "%s: unknown file type\n", file);
+        return false;
+    }
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    int first_file{ 1 };
+    u32 runs{ 1 };
+    if (argc > 2 && !strcmp(argv[1], "--runs"))
+    {
+        runs = (u32)std::max(1, atoi(argv[2]));
+        first_file = 3;
+    }
+
+    if (first_file >= argc)
+    {
+        fprintf(stderr, "usage: %s [--runs count] file...\n", argv[0]);
+        return 1;
+    }
+
+    int result{ 0 };
+    for (int i{ first_file }; i < argc; ++i)
+    {
+        const char* const file{ argv[i] };
+        scene scene{};
+        double min_ms{ 0.0 };
+        double total_ms{ 0.0 };
+        bool succeeded{ true };
+        for (u32 run{ 0 }; run < runs && succeeded; ++run)
+        {
+            scene = {};
+            using clock = std::chrono::steady_clock;
+            const clock::time_point start{ clock::now() };
+            succeeded = import_file(file, scene);
+            const double ms{ std::chrono::duration<double, std::milli>(clock::now() - start).count() };
+            min_ms = run ? std::min(min_ms, ms) : ms;
+            total_ms += ms;
+        }
+
+        if (!succeeded)
+        {
+            fprintf(stderr, "%s: import failed\n", file);
+            result = 1;
+            continue;
+        }
+
+        u64 mesh_count{ 0 }, vertex_count{ 0 }, triangle_count{ 0 };
+        for (const lod_group& lod : scene.lod_groups)
+        {
+            mesh_count += lod.meshes.size();
+            for (const mesh& m : lod.meshes)
+            {
+                vertex_count += m.positions.size();
+                triangle_count += m.raw_indices.size() / 3;
+            }
+        }
+
+        std::error_code error;
+        const u64 file_size{ std::filesystem::file_size(file, error) };
+        const double megabytes{ error ? 0.0 : (double)file_size / (1024.0 * 1024.0) };
+        printf("%s: %u LOD groups, %llu meshes, %llu vertices, %llu triangles, %.1f MB in %.1f ms (%.0f MB/s)",
+               file, (u32)scene.lod_groups.size(), (unsigned long long)mesh_count, (unsigned long long)vertex_count,
+               (unsigned long long)triangle_count, megabytes, min_ms, megabytes * 1000.0 / std::max(min_ms, 1e-3));
+        if (runs > 1) printf(", fastest of %u runs, %.1f ms on average", runs, total_ms / runs);
+        printf("\n");
+    }
+
+    return result;
+}
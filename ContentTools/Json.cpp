@@ -0,0 +1,294 @@
+#include "Json.h"
+#include "TextParser.h"
+
+namespace nidhog::tools::json
+{
+    namespace
+    {
+        constexpr u32 max_depth{ 128 };
+
+        [[nodiscard]] constexpr bool is_whitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+        void skip_whitespace(const char*& p, const char* const end)
+        {
+            while (p < end && is_whitespace(*p)) ++p;
+        }
+
+        [[nodiscard]] bool parse_literal(const char*& p, const char* const end, const char* literal)
+        {
+            const size_t length{ strlen(literal) };
+            if ((size_t)(end - p) < length || memcmp(p, literal, length)) return false;
+            p += length;
+            return true;
+        }
+
+        [[nodiscard]] u32 parse_hex4(const char* p)
+        {
+            u32 code{ 0 };
+            for (u32 i{ 0 }; i < 4; ++i)
+            {
+                const char c{ p[i] };
+                code <<= 4;
+                if (c >= '0' && c <= '9') code |= (u32)(c - '0');
+                else if (c >= 'a' && c <= 'f') code |= (u32)(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F') code |= (u32)(c - 'A' + 10);
+                else return u32_invalid_id;
+            }
+
+            return code;
+        }
+
+        void append_utf8(std::string& s, u32 code)
+        {
+            if (code < 0x80) s += (char)code;
+            else if (code < 0x800)
+            {
+                s += (char)(0xc0 | (code >> 6));
+                s += (char)(0x80 | (code & 0x3f));
+            }
+            else if (code < 0x10000)
+            {
+                s += (char)(0xe0 | (code >> 12));
+                s += (char)(0x80 | ((code >> 6) & 0x3f));
+                s += (char)(0x80 | (code & 0x3f));
+            }
+            else
+            {
+                s += (char)(0xf0 | (code >> 18));
+                s += (char)(0x80 | ((code >> 12) & 0x3f));
+                s += (char)(0x80 | ((code >> 6) & 0x3f));
+                s += (char)(0x80 | (code & 0x3f));
+            }
+        }
+    } // anonymous namespace
+
+    value_type value::type() const
+    {
+        assert(is_valid());
+        return _document->_nodes[_index].type;
+    }
+
+    u32 value::size() const
+    {
+        if (!is_valid()) return 0;
+        const document::node& n{ _document->_nodes[_index] };
+        return (n.type == value_type::array || n.type == value_type::object) ? n.count : 0;
+    }
+
+    value value::operator[](u32 index) const
+    {
+        if (index >= size()) return {};
+        return { _document, _document->_children[_document->_nodes[_index].first + index] };
+    }
+
+    value value::operator[](const char* key) const
+    {
+        if (!is_object()) return {};
+        const document::node& n{ _document->_nodes[_index] };
+        const size_t length{ strlen(key) };
+        for (u32 i{ 0 }; i < n.count; ++i)
+        {
+            const u32 child{ _document->_children[n.first + i] };
+            const document::text_range& range{ _document->_nodes[child].key };
+            // NOTE: keys are compared without unescaping them, which is fine for the plain ASCII keys we look for.
+            if (range.length == length && !memcmp(_document->_text + range.offset, key, length)) return { _document, child };
+        }
+
+        return {};
+    }
+
+    std::string value::key(u32 index) const
+    {
+        if (!is_object() || index >= size()) return {};
+        const u32 child{ _document->_children[_document->_nodes[_index].first + index] };
+        return _document->get_string(_document->_nodes[child].key);
+    }
+
+    double value::as_number(double default_value /*= 0.0*/) const
+    {
+        return is_number() ? _document->_nodes[_index].number : default_value;
+    }
+
+    u32 value::as_u32(u32 default_value /*= u32_invalid_id*/) const
+    {
+        if (!is_number()) return default_value;
+        const double number{ _document->_nodes[_index].number };
+        return (number >= 0.0 && number <= (double)u32_invalid_id) ? (u32)number : default_value;
+    }
+
+    bool value::as_bool(bool default_value /*= false*/) const
+    {
+        return (is_valid() && type() == value_type::boolean) ? _document->_nodes[_index].boolean : default_value;
+    }
+
+    std::string value::as_string(const char* default_value /*= ""*/) const
+    {
+        return (is_valid() && type() == value_type::string) ? _document->get_string(_document->_nodes[_index].string) : default_value;
+    }
+
+    bool document::parse(const char* text, u64 size)
+    {
+        assert(text);
+        if (size >= u32_invalid_id) return false;
+
+        _nodes.clear();
+        _children.clear();
+        _stack.clear();
+        _text = text;
+        _end = text + size;
+
+        const char* p{ text };
+        if (!parse_value(p, 0)) return false;
+        skip_whitespace(p, _end);
+        return p == _end || *p == '\0';
+    }
+
+    bool document::parse_value(const char*& p, u32 depth)
+    {
+        skip_whitespace(p, _end);
+        if (p == _end || depth > max_depth) return false;
+
+        const u32 index{ (u32)_nodes.size() };
+        _nodes.emplace_back(node{ value_type::null, false, 0.0, {}, {}, 0, 0 });
+
+        const char c{ *p };
+        if (c == '{' || c == '[')
+        {
+            const bool is_object{ c == '{' };
+            const char close{ is_object ? '}' : ']' };
+            const u32 stack_base{ (u32)_stack.size() };
+            _nodes[index].type = is_object ? value_type::object : value_type::array;
+            ++p;
+            skip_whitespace(p, _end);
+            if (p < _end && *p == close)
+            {
+                ++p;
+                _nodes[index].first = (u32)_children.size();
+                return true;
+            }
+
+            for (;;)
+            {
+                text_range key{};
+                if (is_object)
+                {
+                    skip_whitespace(p, _end);
+                    if (!parse_string(p, key)) return false;
+                    skip_whitespace(p, _end);
+                    if (p == _end || *p != ':') return false;
+                    ++p;
+                }
+
+                const u32 child{ (u32)_nodes.size() };
+                if (!parse_value(p, depth + 1)) return false;
+                _nodes[child].key = key;
+                _stack.emplace_back(child);
+
+                skip_whitespace(p, _end);
+                if (p == _end) return false;
+                if (*p == ',')
+                {
+                    ++p;
+                    continue;
+                }
+
+                if (*p != close) return false;
+                ++p;
+                break;
+            }
+
+            // The children of nested containers are done, so ours are on top of the stack.
+            const u32 count{ (u32)_stack.size() - stack_base };
+            _nodes[index].first = (u32)_children.size();
+            _nodes[index].count = count;
+            for (u32 i{ 0 }; i < count; ++i) _children.emplace_back(_stack[stack_base + i]);
+            _stack.resize(stack_base);
+            return true;
+        }
+
+        if (c == '"')
+        {
+            _nodes[index].type = value_type::string;
+            return parse_string(p, _nodes[index].string);
+        }
+
+        if (c == 't' || c == 'f')
+        {
+            _nodes[index].type = value_type::boolean;
+            _nodes[index].boolean = c == 't';
+            return parse_literal(p, _end, c == 't' ? "true" : "false");
+        }
+
+        if (c == 'n') return parse_literal(p, _end, "null");
+
+        _nodes[index].type = value_type::number;
+        return text::parse_double(p, _end, _nodes[index].number);
+    }
+
+    bool document::parse_string(const char*& p, text_range& range)
+    {
+        if (p == _end || *p != '"') return false;
+        const char* const first{ ++p };
+        while (p < _end && *p != '"')
+        {
+            if (*p == '\\') ++p;
+            ++p;
+        }
+
+        if (p >= _end) return false;
+        range = { (u32)(first - _text), (u32)(p - first) };
+        ++p;
+        return true;
+    }
+
+    std::string document::get_string(const text_range& range) const
+    {
+        const char* p{ _text + range.offset };
+        const char* const end{ p + range.length };
+        if (!memchr(p, '\\', range.length)) return { p, end };
+
+        std::string s;
+        s.reserve(range.length);
+        while (p < end)
+        {
+            if (*p != '\\')
+            {
+                s += *p++;
+                continue;
+            }
+
+            if (++p == end) break;
+            const char c{ *p++ };
+            switch (c)
+            {
+            case 'b': s += '\b'; break;
+            case 'f': s += '\f'; break;
+            case 'n': s += '\n'; break;
+            case 'r': s += '\r'; break;
+            case 't': s += '\t'; break;
+            case 'u':
+            {
+                if (end - p < 4) return s;
+                u32 code{ parse_hex4(p) };
+                p += 4;
+                // Combine UTF-16 surrogate pairs.
+                if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                {
+                    const u32 low{ parse_hex4(p + 2) };
+                    if (low >= 0xdc00 && low < 0xe000)
+                    {
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    }
+                }
+
+                if (code != u32_invalid_id) append_utf8(s, code);
+                break;
+            }
+            default: s += c; break; // '"', '\\' and '/'
+            }
+        }
+
+        return s;
+    }
+}
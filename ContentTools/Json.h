@@ -0,0 +1,89 @@
+#pragma once
+#include "ToolsCommon.h"
+
+// Minimal read-only JSON DOM, enough for glTF. Strings aren't copied: values refer to the source text, which
+// must outlive the document.
+namespace nidhog::tools::json
+{
+    enum class value_type : u8
+    {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object,
+    };
+
+    class document;
+
+    // Lightweight handle to a value in a document. Looking up a missing member or an index that's out of
+    // range returns an invalid value, whose accessors return the given defaults, so lookups can be chained.
+    class value
+    {
+    public:
+        constexpr value() = default;
+        constexpr value(const document* doc, u32 index) : _document{ doc }, _index{ index } {}
+
+        [[nodiscard]] constexpr bool is_valid() const { return _document != nullptr; }
+        [[nodiscard]] value_type type() const;
+        [[nodiscard]] bool is_number() const { return is_valid() && type() == value_type::number; }
+        [[nodiscard]] bool is_array() const { return is_valid() && type() == value_type::array; }
+        [[nodiscard]] bool is_object() const { return is_valid() && type() == value_type::object; }
+
+        // Number of elements of an array or members of an object.
+        [[nodiscard]] u32 size() const;
+        [[nodiscard]] value operator[](u32 index) const;
+        // NOTE: makes value[0] unambiguous, it would also match the key overload.
+        [[nodiscard]] value operator[](s32 index) const { return operator[]((u32)index); }
+        [[nodiscard]] value operator[](const char* key) const;
+        // Key of the index-th member of an object.
+        [[nodiscard]] std::string key(u32 index) const;
+
+        [[nodiscard]] double as_number(double default_value = 0.0) const;
+        [[nodiscard]] u32 as_u32(u32 default_value = u32_invalid_id) const;
+        [[nodiscard]] f32 as_f32(f32 default_value = 0.f) const { return (f32)as_number(default_value); }
+        [[nodiscard]] bool as_bool(bool default_value = false) const;
+        [[nodiscard]] std::string as_string(const char* default_value = "") const;
+    private:
+        const document* _document{ nullptr };
+        u32             _index{ 0 };
+    };
+
+    class document
+    {
+    public:
+        // Returns false if the text isn't valid JSON.
+        bool parse(const char* text, u64 size);
+        [[nodiscard]] value root() const { return _nodes.empty() ? value{} : value{ this, 0 }; }
+    private:
+        friend class value;
+
+        struct text_range
+        {
+            u32 offset;
+            u32 length;
+        };
+
+        struct node
+        {
+            value_type  type;
+            bool        boolean;
+            double      number;
+            text_range  string;     // string values
+            text_range  key;        // object members
+            u32         first;      // arrays and objects: first child in _children
+            u32         count;      // arrays and objects: number of children
+        };
+
+        [[nodiscard]] bool parse_value(const char*& p, u32 depth);
+        [[nodiscard]] bool parse_string(const char*& p, text_range& range);
+        [[nodiscard]] std::string get_string(const text_range& range) const;
+
+        utl::vector<node>   _nodes;
+        utl::vector<u32>    _children;  // children of every array and object, stored contiguously
+        utl::vector<u32>    _stack;     // children of the containers that are being parsed
+        const char*         _text{ nullptr };
+        const char*         _end{ nullptr };
+    };
+}
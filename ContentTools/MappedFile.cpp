@@ -0,0 +1,111 @@
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nidhog::tools
+{
+#ifdef _WIN32
+    mapped_file::mapped_file(const char* file)
+    {
+        assert(file);
+        _file = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) return;
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(_file, &size) || !size.QuadPart) return;
+
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!_mapping) return;
+
+        _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (_data) _size = (u64)size.QuadPart;
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (_data) UnmapViewOfFile(_data);
+        if (_mapping) CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+    }
+
+    scratch_file::scratch_file(u64 size)
+    {
+        assert(size);
+        char path[MAX_PATH]{};
+        char name[MAX_PATH]{};
+        if (!GetTempPathA(MAX_PATH, path) || !GetTempFileNameA(path, "ndg", 0, name)) return;
+
+        _file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) return;
+
+        // NOTE: creating the mapping grows the file to its full size.
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+        if (!_mapping) return;
+
+        _data = (u8*)MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, 0);
+        if (_data) _size = size;
+    }
+
+    scratch_file::~scratch_file()
+    {
+        if (_data) UnmapViewOfFile(_data);
+        if (_mapping) CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+    }
+#else
+    mapped_file::mapped_file(const char* file)
+    {
+        assert(file);
+        _file = open(file, O_RDONLY);
+        if (_file < 0) return;
+
+        struct stat info {};
+        if (fstat(_file, &info) || !info.st_size) return;
+
+        void* const data{ mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, _file, 0) };
+        if (data == MAP_FAILED) return;
+
+        // NOTE: we read the file front to back, so read-ahead can be as aggressive as the OS likes.
+        madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+        _data = (const char*)data;
+        _size = (u64)info.st_size;
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (_data) munmap((void*)_data, _size);
+        if (_file >= 0) close(_file);
+    }
+
+    scratch_file::scratch_file(u64 size)
+    {
+        assert(size);
+        char name[]{ "/tmp/ndgXXXXXX" };
+        _file = mkstemp(name);
+        if (_file < 0) return;
+
+        // NOTE: the file lives on until it's closed, without a name anyone else could open.
+        unlink(name);
+        if (ftruncate(_file, (off_t)size)) return;
+
+        void* const data{ mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0) };
+        if (data == MAP_FAILED) return;
+
+        _data = (u8*)data;
+        _size = size;
+    }
+
+    scratch_file::~scratch_file()
+    {
+        if (_data) munmap(_data, _size);
+        if (_file >= 0) close(_file);
+    }
+#endif
+}
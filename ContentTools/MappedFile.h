@@ -0,0 +1,52 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    // Maps a whole file into memory for reading. The OS pages the file in as it's read, so even files
+    // that are larger than physical memory can be parsed without copying them into our own buffers.
+    class mapped_file
+    {
+    public:
+        explicit mapped_file(const char* file);
+        ~mapped_file();
+        DISABLE_COPY_AND_MOVE(mapped_file);
+
+        [[nodiscard]] constexpr bool is_valid() const { return _data != nullptr; }
+        [[nodiscard]] constexpr const char* data() const { return _data; }
+        [[nodiscard]] constexpr u64 size() const { return _size; }
+    private:
+        const char*     _data{ nullptr };
+        u64             _size{ 0 };
+#ifdef _WIN32
+        HANDLE          _file{ INVALID_HANDLE_VALUE };
+        HANDLE          _mapping{ nullptr };
+#else
+        int             _file{ -1 };
+#endif
+    };
+
+    // Temporary file that's mapped for reading and writing, for intermediate data that's too large to keep
+    // in memory. Under memory pressure the OS writes its pages back to the file instead of failing allocations.
+    // The file is deleted when it's closed.
+    class scratch_file
+    {
+    public:
+        explicit scratch_file(u64 size);
+        ~scratch_file();
+        DISABLE_COPY_AND_MOVE(scratch_file);
+
+        [[nodiscard]] constexpr bool is_valid() const { return _data != nullptr; }
+        [[nodiscard]] constexpr u8* data() const { return _data; }
+        [[nodiscard]] constexpr u64 size() const { return _size; }
+    private:
+        u8*             _data{ nullptr };
+        u64             _size{ 0 };
+#ifdef _WIN32
+        HANDLE          _file{ INVALID_HANDLE_VALUE };
+        HANDLE          _mapping{ nullptr };
+#else
+        int             _file{ -1 };
+#endif
+    };
+}
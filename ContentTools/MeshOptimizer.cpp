@@ -0,0 +1,220 @@
+#include "MeshOptimizer.h"
+#include "Geometry.h"
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        // Scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+        constexpr u32 max_cache_size{ 32 };
+        constexpr u32 max_valence{ 32 };
+        constexpr f32 cache_decay_power{ 1.5f };
+        constexpr f32 last_triangle_score{ 0.75f };
+        constexpr f32 valence_boost_scale{ 2.f };
+        constexpr f32 valence_boost_power{ 0.5f };
+
+        struct score_tables
+        {
+            f32 cache[max_cache_size];
+            f32 valence[max_valence + 1];
+
+            score_tables()
+            {
+                for (u32 i{ 0 }; i < max_cache_size; ++i)
+                {
+                    // NOTE: the 3 vertices of the last triangle get a fixed score, so it's not
+                    //       beneficial to use them right away again.
+                    cache[i] = i < 3 ? last_triangle_score
+                        : powf(1.f - (f32)(i - 3) / (f32)(max_cache_size - 3), cache_decay_power);
+                }
+
+                valence[0] = 0.f;
+                for (u32 i{ 1 }; i <= max_valence; ++i)
+                {
+                    valence[i] = valence_boost_scale * powf((f32)i, -valence_boost_power);
+                }
+            }
+        };
+
+        const score_tables scores{};
+
+        f32 vertex_score(u32 cache_position, u32 live_triangles)
+        {
+            // Vertices that aren't used by any remaining triangle don't matter anymore.
+            if (!live_triangles) return -1.f;
+            const f32 cache_score{ cache_position < max_cache_size ? scores.cache[cache_position] : 0.f };
+            return cache_score + scores.valence[std::min(live_triangles, max_valence)];
+        }
+    } // anonymous namespace
+
+    vertex_cache_stats analyze_vertex_cache(const utl::vector<u32>& indices, u32 vertex_count, u32 cache_size)
+    {
+        const u32 index_count{ (u32)indices.size() };
+        assert(index_count && (index_count % 3) == 0 && vertex_count && cache_size);
+
+        // NOTE: FIFO cache, like most hardware. A vertex's timestamp tells when it entered the cache.
+        utl::vector<u32> timestamps(vertex_count, 0);
+        u32 time{ cache_size + 1 };
+        u32 misses{ 0 };
+
+        for (u32 i{ 0 }; i < index_count; ++i)
+        {
+            const u32 index{ indices[i] };
+            assert(index < vertex_count);
+            if (time - timestamps[index] > cache_size)
+            {
+                timestamps[index] = time++;
+                ++misses;
+            }
+        }
+
+        return { (f32)misses / (f32)(index_count / 3), (f32)misses / (f32)vertex_count };
+    }
+
+    void optimize_vertex_cache(utl::vector<u32>& indices, u32 vertex_count)
+    {
+        const u32 index_count{ (u32)indices.size() };
+        const u32 triangle_count{ index_count / 3 };
+        assert(index_count && (index_count % 3) == 0 && vertex_count);
+
+        // Build vertex -> triangle adjacency. The first live_triangles[v] entries in a vertex's range
+        // are the triangles that still have to be emitted.
+        utl::vector<u32> live_triangles(vertex_count, 0);
+        for (u32 i{ 0 }; i < index_count; ++i) ++live_triangles[indices[i]];
+
+        utl::vector<u32> adjacency_offsets(vertex_count + 1);
+        adjacency_offsets[0] = 0;
+        for (u32 i{ 0 }; i < vertex_count; ++i) adjacency_offsets[i + 1] = adjacency_offsets[i] + live_triangles[i];
+
+        utl::vector<u32> adjacency(index_count);
+        {
+            utl::vector<u32> fill(vertex_count, 0);
+            for (u32 i{ 0 }; i < index_count; ++i)
+            {
+                const u32 v{ indices[i] };
+                adjacency[adjacency_offsets[v] + fill[v]++] = i / 3;
+            }
+        }
+
+        utl::vector<u32> cache_positions(vertex_count, u32_invalid_id);
+        utl::vector<f32> vertex_scores(vertex_count);
+        for (u32 i{ 0 }; i < vertex_count; ++i) vertex_scores[i] = vertex_score(u32_invalid_id, live_triangles[i]);
+
+        utl::vector<f32> triangle_scores(triangle_count);
+        utl::vector<u8> emitted(triangle_count, 0);
+        u32 best_triangle{ 0 };
+        for (u32 i{ 0 }; i < triangle_count; ++i)
+        {
+            triangle_scores[i] = vertex_scores[indices[i * 3]] + vertex_scores[indices[i * 3 + 1]] + vertex_scores[indices[i * 3 + 2]];
+            if (triangle_scores[i] > triangle_scores[best_triangle]) best_triangle = i;
+        }
+
+        utl::vector<u32> result(index_count);
+        u32 cache[max_cache_size + 3];
+        u32 cache_count{ 0 };
+        u32 next_candidate{ 0 }; // used when no triangle in the cache is left
+
+        for (u32 out{ 0 }; out < triangle_count; ++out)
+        {
+            if (best_triangle == u32_invalid_id)
+            {
+                // NOTE: the cache ran dry (e.g. we finished a disconnected part of the mesh), so we just
+                //       continue with the next triangle in the original order.
+                while (emitted[next_candidate]) ++next_candidate;
+                best_triangle = next_candidate;
+            }
+
+            const u32* const tri{ &indices[best_triangle * 3] };
+            memcpy(&result[out * 3], tri, sizeof(u32) * 3);
+            emitted[best_triangle] = 1;
+
+            // Remove the triangle from its vertices' live adjacency.
+            for (u32 i{ 0 }; i < 3; ++i)
+            {
+                const u32 v{ tri[i] };
+                u32* const adj{ &adjacency[adjacency_offsets[v]] };
+                const u32 count{ live_triangles[v] };
+                for (u32 j{ 0 }; j < count; ++j)
+                {
+                    if (adj[j] == best_triangle)
+                    {
+                        adj[j] = adj[count - 1];
+                        adj[count - 1] = best_triangle;
+                        break;
+                    }
+                }
+                --live_triangles[v];
+            }
+
+            // The new cache has the emitted triangle's vertices at the front, followed by the old cache entries.
+            u32 new_cache[max_cache_size + 3];
+            u32 new_count{ 0 };
+            for (u32 i{ 0 }; i < 3; ++i) new_cache[new_count++] = tri[i];
+            for (u32 i{ 0 }; i < cache_count; ++i)
+            {
+                const u32 v{ cache[i] };
+                if (v != tri[0] && v != tri[1] && v != tri[2]) new_cache[new_count++] = v;
+            }
+
+            // Update vertex scores. Vertices that fell out of the cache get their position reset.
+            for (u32 i{ 0 }; i < new_count; ++i)
+            {
+                const u32 v{ new_cache[i] };
+                cache_positions[v] = i < max_cache_size ? i : u32_invalid_id;
+                vertex_scores[v] = vertex_score(cache_positions[v], live_triangles[v]);
+            }
+
+            // Update the scores of all triangles that touch a vertex in the cache and pick the best one.
+            best_triangle = u32_invalid_id;
+            f32 best_score{ -1.f };
+            for (u32 i{ 0 }; i < new_count; ++i)
+            {
+                const u32 v{ new_cache[i] };
+                const u32* const adj{ &adjacency[adjacency_offsets[v]] };
+                for (u32 j{ 0 }; j < live_triangles[v]; ++j)
+                {
+                    const u32 t{ adj[j] };
+                    const f32 score{ vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]] };
+                    triangle_scores[t] = score;
+                    if (score > best_score)
+                    {
+                        best_score = score;
+                        best_triangle = t;
+                    }
+                }
+            }
+
+            cache_count = std::min(new_count, max_cache_size);
+            memcpy(cache, new_cache, sizeof(u32) * cache_count);
+        }
+
+        indices.swap(result);
+    }
+
+    void optimize_vertex_fetch(utl::vector<vertex>& vertices, utl::vector<u32>& indices)
+    {
+        const u32 vertex_count{ (u32)vertices.size() };
+        const u32 index_count{ (u32)indices.size() };
+        assert(vertex_count && index_count);
+
+        utl::vector<u32> remap(vertex_count, u32_invalid_id);
+        utl::vector<vertex> new_vertices;
+        new_vertices.reserve(vertex_count);
+
+        for (u32 i{ 0 }; i < index_count; ++i)
+        {
+            u32& index{ indices[i] };
+            assert(index < vertex_count);
+            if (remap[index] == u32_invalid_id)
+            {
+                remap[index] = (u32)new_vertices.size();
+                new_vertices.emplace_back(vertices[index]);
+            }
+
+            index = remap[index];
+        }
+
+        // NOTE: vertices that aren't referenced by any triangle are dropped.
+        vertices.swap(new_vertices);
+    }
+}
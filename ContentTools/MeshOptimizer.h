@@ -0,0 +1,23 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    struct vertex;
+
+    struct vertex_cache_stats
+    {
+        f32 acmr;   // average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3.0 is worst)
+        f32 atvr;   // average transform to vertex ratio: transformed vertices per unique vertex (1.0 is ideal)
+    };
+
+    // Simulates a FIFO post-transform vertex cache of the given size.
+    vertex_cache_stats analyze_vertex_cache(const utl::vector<u32>& indices, u32 vertex_count, u32 cache_size = 16);
+
+    // Reorders triangles to improve post-transform vertex cache hit rate (Forsyth's linear-speed algorithm).
+    void optimize_vertex_cache(utl::vector<u32>& indices, u32 vertex_count);
+
+    // Reorders vertices in the order they're first referenced by the index buffer, so vertex fetches
+    // walk memory mostly linearly. Indices are remapped accordingly. Should run after optimize_vertex_cache().
+    void optimize_vertex_fetch(utl::vector<vertex>& vertices, utl::vector<u32>& indices);
+}
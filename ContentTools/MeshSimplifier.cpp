@@ -0,0 +1,273 @@
+#include "MeshSimplifier.h"
+#include "Geometry.h"
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        using namespace DirectX;
+
+        // Symmetric 4x4 matrix that sums the squared distances to a set of planes.
+        struct quadric
+        {
+            double a2{}, ab{}, ac{}, ad{};
+            double b2{}, bc{}, bd{};
+            double c2{}, cd{};
+            double d2{};
+
+            void add_plane(double a, double b, double c, double d)
+            {
+                a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+                b2 += b * b; bc += b * c; bd += b * d;
+                c2 += c * c; cd += c * d;
+                d2 += d * d;
+            }
+
+            void add(const quadric& q)
+            {
+                a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+                b2 += q.b2; bc += q.bc; bd += q.bd;
+                c2 += q.c2; cd += q.cd;
+                d2 += q.d2;
+            }
+
+            [[nodiscard]] double error(const math::v3& p) const
+            {
+                const double x{ p.x }, y{ p.y }, z{ p.z };
+                const double e{ a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+                                b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+                                c2 * z * z + 2 * cd * z +
+                                d2 };
+                return e > 0.0 ? e : 0.0;
+            }
+        };
+
+        struct collapse
+        {
+            double  cost;
+            u32     from;           // welded position that's removed
+            u32     to;             // welded position it collapses into
+            u32     to_vertex;      // vertex index to use for "to" in the triangles around "from"
+        };
+
+        // Gives every vertex the id of its position, so that split vertices (seams) share one id.
+        u32 weld_positions(const utl::vector<vertex>& vertices, utl::vector<u32>& position_ids, utl::vector<u32>& first_vertex)
+        {
+            const u32 num_vertices{ (u32)vertices.size() };
+            utl::vector<u32> order(num_vertices);
+            for (u32 i{ 0 }; i < num_vertices; ++i) order[i] = i;
+
+            auto less = [&](u32 a, u32 b) {
+                const math::v3& pa{ vertices[a].position };
+                const math::v3& pb{ vertices[b].position };
+                if (pa.x != pb.x) return pa.x < pb.x;
+                if (pa.y != pb.y) return pa.y < pb.y;
+                if (pa.z != pb.z) return pa.z < pb.z;
+                return a < b;
+            };
+            std::sort(order.begin(), order.end(), less);
+
+            position_ids.resize(num_vertices);
+            first_vertex.clear();
+            for (u32 i{ 0 }; i < num_vertices; ++i)
+            {
+                const u32 v{ order[i] };
+                if (i == 0 || memcmp(&vertices[v].position, &vertices[order[i - 1]].position, sizeof(math::v3)))
+                {
+                    first_vertex.emplace_back(v);
+                }
+
+                position_ids[v] = (u32)first_vertex.size() - 1;
+            }
+
+            return (u32)first_vertex.size();
+        }
+
+        XMVECTOR triangle_normal(const math::v3& p0, const math::v3& p1, const math::v3& p2)
+        {
+            const XMVECTOR v0{ XMLoadFloat3(&p0) };
+            return XMVector3Cross(XMLoadFloat3(&p1) - v0, XMLoadFloat3(&p2) - v0);
+        }
+    } // anonymous namespace
+
+    f32 simplify_mesh(const utl::vector<vertex>& vertices, const utl::vector<u32>& indices,
+                      u32 target_index_count, utl::vector<u32>& out_indices, f32 max_error)
+    {
+        const u32 num_indices{ (u32)indices.size() };
+        const u32 num_triangles{ num_indices / 3 };
+        assert(num_indices && (num_indices % 3) == 0 && vertices.size());
+
+        utl::vector<u32> position_ids;
+        utl::vector<u32> first_vertex;
+        const u32 num_positions{ weld_positions(vertices, position_ids, first_vertex) };
+        auto position = [&](u32 p) -> const math::v3& { return vertices[first_vertex[p]].position; };
+
+        // Lock seam vertices (more than one vertex per position) and border/non-manifold vertices
+        // (edges that aren't shared by exactly two triangles).
+        utl::vector<u8> locked(num_positions, 0);
+        {
+            utl::vector<u32> vertices_per_position(num_positions, 0);
+            for (u32 i{ 0 }; i < (u32)vertices.size(); ++i) ++vertices_per_position[position_ids[i]];
+            for (u32 i{ 0 }; i < num_positions; ++i) locked[i] = vertices_per_position[i] > 1;
+
+            std::unordered_map<u64, u32> edge_counts;
+            edge_counts.reserve(num_indices);
+            for (u32 i{ 0 }; i < num_indices; ++i)
+            {
+                const u32 a{ position_ids[indices[i]] };
+                const u32 b{ position_ids[indices[i - i % 3 + (i + 1) % 3]] };
+                ++edge_counts[((u64)std::min(a, b) << 32) | std::max(a, b)];
+            }
+
+            for (const auto& [edge, count] : edge_counts)
+            {
+                if (count != 2)
+                {
+                    locked[(u32)(edge >> 32)] = 1;
+                    locked[(u32)edge] = 1;
+                }
+            }
+        }
+
+        utl::vector<quadric> quadrics(num_positions);
+        for (u32 t{ 0 }; t < num_triangles; ++t)
+        {
+            const math::v3& p0{ vertices[indices[t * 3]].position };
+            XMVECTOR n{ triangle_normal(p0, vertices[indices[t * 3 + 1]].position, vertices[indices[t * 3 + 2]].position) };
+            if (XMVectorGetX(XMVector3LengthSq(n)) <= 0.f) continue;
+            n = XMVector3Normalize(n);
+            math::v3 normal;
+            XMStoreFloat3(&normal, n);
+            const double d{ -((double)normal.x * p0.x + (double)normal.y * p0.y + (double)normal.z * p0.z) };
+            for (u32 i{ 0 }; i < 3; ++i)
+            {
+                quadrics[position_ids[indices[t * 3 + i]]].add_plane(normal.x, normal.y, normal.z, d);
+            }
+        }
+
+        utl::vector<u32> working{ indices };
+        utl::vector<u8> removed(num_triangles, 0);
+        u32 live_triangles{ num_triangles };
+        const double max_cost{ max_error < FLT_MAX ? (double)max_error * max_error : DBL_MAX };
+        double worst_cost{ 0.0 };
+
+        utl::vector<u32> adjacency_offsets(num_positions + 1);
+        utl::vector<u32> adjacency;
+        utl::vector<collapse> collapses;
+        utl::vector<u8> touched(num_positions);
+
+        // NOTE: each pass picks the cheapest collapse for every vertex, and then applies them in order of cost,
+        //       skipping vertices whose neighborhood was already changed in this pass.
+        while (live_triangles * 3 > target_index_count)
+        {
+            // Position -> live triangle adjacency.
+            memset(adjacency_offsets.data(), 0, adjacency_offsets.size() * sizeof(u32));
+            for (u32 t{ 0 }; t < num_triangles; ++t)
+            {
+                if (removed[t]) continue;
+                for (u32 i{ 0 }; i < 3; ++i) ++adjacency_offsets[position_ids[working[t * 3 + i]] + 1];
+            }
+            for (u32 i{ 0 }; i < num_positions; ++i) adjacency_offsets[i + 1] += adjacency_offsets[i];
+            adjacency.resize(adjacency_offsets[num_positions]);
+            {
+                utl::vector<u32> fill(num_positions, 0);
+                for (u32 t{ 0 }; t < num_triangles; ++t)
+                {
+                    if (removed[t]) continue;
+                    for (u32 i{ 0 }; i < 3; ++i)
+                    {
+                        const u32 p{ position_ids[working[t * 3 + i]] };
+                        adjacency[adjacency_offsets[p] + fill[p]++] = t;
+                    }
+                }
+            }
+
+            collapses.clear();
+            for (u32 p{ 0 }; p < num_positions; ++p)
+            {
+                if (locked[p]) continue;
+                collapse best{ DBL_MAX, p, u32_invalid_id, u32_invalid_id };
+                for (u32 j{ adjacency_offsets[p] }; j < adjacency_offsets[p + 1]; ++j)
+                {
+                    const u32* const tri{ &working[adjacency[j] * 3] };
+                    for (u32 i{ 0 }; i < 3; ++i)
+                    {
+                        const u32 q{ position_ids[tri[i]] };
+                        if (q == p) continue;
+                        quadric sum{ quadrics[p] };
+                        sum.add(quadrics[q]);
+                        const double cost{ sum.error(position(q)) };
+                        if (cost < best.cost) best = { cost, p, q, tri[i] };
+                    }
+                }
+
+                if (best.to != u32_invalid_id && best.cost <= max_cost) collapses.emplace_back(best);
+            }
+
+            if (collapses.empty()) break;
+            std::sort(collapses.begin(), collapses.end(), [](const collapse& a, const collapse& b) {
+                return a.cost < b.cost || (a.cost == b.cost && a.from < b.from);
+            });
+
+            memset(touched.data(), 0, touched.size());
+            u32 applied{ 0 };
+            for (const auto& c : collapses)
+            {
+                if (live_triangles * 3 <= target_index_count) break;
+                if (touched[c.from] || touched[c.to]) continue;
+
+                // Reject collapses that would flip or degenerate any of the remaining triangles.
+                const math::v3& target{ position(c.to) };
+                bool valid{ true };
+                for (u32 j{ adjacency_offsets[c.from] }; j < adjacency_offsets[c.from + 1] && valid; ++j)
+                {
+                    const u32* const tri{ &working[adjacency[j] * 3] };
+                    const u32 ids[3]{ position_ids[tri[0]], position_ids[tri[1]], position_ids[tri[2]] };
+                    if (ids[0] == c.to || ids[1] == c.to || ids[2] == c.to) continue;
+
+                    math::v3 p[3]{ position(ids[0]), position(ids[1]), position(ids[2]) };
+                    const XMVECTOR old_normal{ triangle_normal(p[0], p[1], p[2]) };
+                    for (u32 i{ 0 }; i < 3; ++i) if (ids[i] == c.from) p[i] = target;
+                    const XMVECTOR new_normal{ triangle_normal(p[0], p[1], p[2]) };
+                    valid = XMVectorGetX(XMVector3Dot(old_normal, new_normal)) > 0.f;
+                }
+
+                if (!valid) continue;
+
+                for (u32 j{ adjacency_offsets[c.from] }; j < adjacency_offsets[c.from + 1]; ++j)
+                {
+                    const u32 t{ adjacency[j] };
+                    u32* const tri{ &working[t * 3] };
+                    for (u32 i{ 0 }; i < 3; ++i) touched[position_ids[tri[i]]] = 1;
+
+                    const u32 ids[3]{ position_ids[tri[0]], position_ids[tri[1]], position_ids[tri[2]] };
+                    if (ids[0] == c.to || ids[1] == c.to || ids[2] == c.to)
+                    {
+                        removed[t] = 1;
+                        --live_triangles;
+                    }
+                    else
+                    {
+                        for (u32 i{ 0 }; i < 3; ++i) if (ids[i] == c.from) tri[i] = c.to_vertex;
+                    }
+                }
+
+                quadrics[c.to].add(quadrics[c.from]);
+                worst_cost = std::max(worst_cost, c.cost);
+                ++applied;
+            }
+
+            if (!applied) break;
+        }
+
+        out_indices.clear();
+        out_indices.reserve(live_triangles * 3);
+        for (u32 t{ 0 }; t < num_triangles; ++t)
+        {
+            if (removed[t]) continue;
+            for (u32 i{ 0 }; i < 3; ++i) out_indices.emplace_back(working[t * 3 + i]);
+        }
+
+        return (f32)sqrt(worst_cost);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    struct vertex;
+
+    // Simplifies a triangle list with quadric error metrics (Garland-Heckbert) using half-edge collapses,
+    // until it has at most target_index_count indices or no collapse below max_error is left.
+    //
+    // Vertices that share their position with another vertex (UV/normal seams produced by process_normals
+    // and process_uvs) and vertices on open borders are locked, so seams and borders are kept exactly.
+    // The output indices reference the input vertices. Returns the geometric error (in mesh units) of the
+    // most expensive collapse.
+    f32 simplify_mesh(const utl::vector<vertex>& vertices, const utl::vector<u32>& indices,
+                      u32 target_index_count, utl::vector<u32>& out_indices, f32 max_error = FLT_MAX);
+}
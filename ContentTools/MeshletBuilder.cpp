@@ -0,0 +1,251 @@
+#include "MeshletBuilder.h"
+#include "Geometry.h"
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        using namespace DirectX;
+
+        constexpr u8 invalid_local_index{ 0xff };
+        static_assert(content::meshlet_max_vertices < invalid_local_index);
+
+        // Normal cones wider than this can't be used for culling anyway.
+        constexpr f32 min_cone_dot{ 0.1f };
+    } // anonymous namespace
+
+    void build_meshlets(const utl::vector<vertex>& vertices, const utl::vector<u32>& indices,
+                        utl::vector<content::meshlet>& meshlets, utl::vector<u32>& meshlet_vertices,
+                        utl::vector<u8>& meshlet_triangles)
+    {
+        const u32 index_count{ (u32)indices.size() };
+        const u32 triangle_count{ index_count / 3 };
+        const u32 vertex_count{ (u32)vertices.size() };
+        assert(index_count && (index_count % 3) == 0 && vertex_count);
+
+        meshlets.clear();
+        meshlet_vertices.clear();
+        meshlet_triangles.clear();
+        meshlet_vertices.reserve(index_count / 2);
+        meshlet_triangles.reserve(index_count);
+
+        // Vertex -> triangle adjacency. The first live_triangles[v] entries in a vertex's range are the
+        // triangles that aren't in a meshlet yet.
+        utl::vector<u32> live_triangles(vertex_count, 0);
+        for (u32 i{ 0 }; i < index_count; ++i) ++live_triangles[indices[i]];
+
+        utl::vector<u32> adjacency_offsets(vertex_count + 1);
+        adjacency_offsets[0] = 0;
+        for (u32 i{ 0 }; i < vertex_count; ++i) adjacency_offsets[i + 1] = adjacency_offsets[i] + live_triangles[i];
+
+        utl::vector<u32> adjacency(index_count);
+        {
+            utl::vector<u32> fill(vertex_count, 0);
+            for (u32 i{ 0 }; i < index_count; ++i)
+            {
+                const u32 v{ indices[i] };
+                adjacency[adjacency_offsets[v] + fill[v]++] = i / 3;
+            }
+        }
+
+        utl::vector<math::v3> centroids(triangle_count);
+        for (u32 t{ 0 }; t < triangle_count; ++t)
+        {
+            const math::v3& p0{ vertices[indices[t * 3]].position };
+            const math::v3& p1{ vertices[indices[t * 3 + 1]].position };
+            const math::v3& p2{ vertices[indices[t * 3 + 2]].position };
+            centroids[t] = { (p0.x + p1.x + p2.x) / 3.f, (p0.y + p1.y + p2.y) / 3.f, (p0.z + p1.z + p2.z) / 3.f };
+        }
+
+        utl::vector<u8> local_indices(vertex_count, invalid_local_index);
+        utl::vector<u8> emitted(triangle_count, 0);
+
+        content::meshlet current{ 0, 0, 0, 0 };
+        math::v3 centroid_sum{};
+        u32 last_triangle{ u32_invalid_id };
+        u32 next_seed{ 0 };
+
+        auto new_vertex_count = [&](u32 t) {
+            const u32* const tri{ &indices[t * 3] };
+            return (u32)(local_indices[tri[0]] == invalid_local_index) +
+                   (u32)(local_indices[tri[1]] == invalid_local_index) +
+                   (u32)(local_indices[tri[2]] == invalid_local_index);
+        };
+
+        // Looks for the best triangle that's adjacent to any of the given vertices. Ties are broken by
+        // triangle index, so the result doesn't depend on the order of the adjacency lists.
+        u32 best{ u32_invalid_id };
+        u32 best_extra{ 0 };
+        f32 best_distance{ 0.f };
+        auto find_candidate = [&](const u32* const candidate_vertices, u32 count, const math::v3& center) {
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                const u32 v{ candidate_vertices[i] };
+                const u32* const adj{ &adjacency[adjacency_offsets[v]] };
+                for (u32 j{ 0 }; j < live_triangles[v]; ++j)
+                {
+                    const u32 t{ adj[j] };
+                    const u32 extra{ new_vertex_count(t) };
+                    const math::v3& c{ centroids[t] };
+                    const f32 distance{ (c.x - center.x) * (c.x - center.x) + (c.y - center.y) * (c.y - center.y) + (c.z - center.z) * (c.z - center.z) };
+                    if (best == u32_invalid_id || extra < best_extra ||
+                        (extra == best_extra && (distance < best_distance || (distance == best_distance && t < best))))
+                    {
+                        best = t;
+                        best_extra = extra;
+                        best_distance = distance;
+                    }
+                }
+            }
+        };
+
+        auto flush = [&]() {
+            if (!current.triangle_count) return;
+            for (u32 i{ 0 }; i < current.vertex_count; ++i)
+            {
+                local_indices[meshlet_vertices[current.vertex_offset + i]] = invalid_local_index;
+            }
+
+            meshlets.emplace_back(current);
+            current = { (u32)meshlet_vertices.size(), (u32)meshlet_triangles.size() / 3, 0, 0 };
+            centroid_sum = {};
+            last_triangle = u32_invalid_id;
+        };
+
+        for (u32 added{ 0 }; added < triangle_count; ++added)
+        {
+            best = u32_invalid_id;
+            if (last_triangle != u32_invalid_id)
+            {
+                const f32 inv_count{ 1.f / (f32)current.triangle_count };
+                const math::v3 center{ centroid_sum.x * inv_count, centroid_sum.y * inv_count, centroid_sum.z * inv_count };
+
+                // NOTE: looking around the last triangle first is enough most of the time and much cheaper
+                //       than going through all vertices of the meshlet.
+                find_candidate(&indices[last_triangle * 3], 3, center);
+                if (best == u32_invalid_id)
+                {
+                    find_candidate(&meshlet_vertices[current.vertex_offset], current.vertex_count, center);
+                }
+            }
+
+            if (best == u32_invalid_id)
+            {
+                // NOTE: nothing connected is left, so we continue with the next triangle in index order,
+                //       which is spatially coherent after vertex cache optimization.
+                while (emitted[next_seed]) ++next_seed;
+                best = next_seed;
+            }
+
+            if (current.vertex_count + new_vertex_count(best) > content::meshlet_max_vertices ||
+                current.triangle_count + 1 > content::meshlet_max_triangles)
+            {
+                flush();
+            }
+
+            const u32* const tri{ &indices[best * 3] };
+            for (u32 i{ 0 }; i < 3; ++i)
+            {
+                const u32 v{ tri[i] };
+                if (local_indices[v] == invalid_local_index)
+                {
+                    local_indices[v] = (u8)current.vertex_count++;
+                    meshlet_vertices.emplace_back(v);
+                }
+
+                meshlet_triangles.emplace_back(local_indices[v]);
+
+                // Remove the triangle from the vertex's live adjacency.
+                u32* const adj{ &adjacency[adjacency_offsets[v]] };
+                const u32 count{ live_triangles[v] };
+                for (u32 j{ 0 }; j < count; ++j)
+                {
+                    if (adj[j] == best)
+                    {
+                        adj[j] = adj[count - 1];
+                        adj[count - 1] = best;
+                        --live_triangles[v];
+                        break;
+                    }
+                }
+            }
+
+            ++current.triangle_count;
+            emitted[best] = 1;
+            last_triangle = best;
+            const math::v3& c{ centroids[best] };
+            centroid_sum = { centroid_sum.x + c.x, centroid_sum.y + c.y, centroid_sum.z + c.z };
+        }
+
+        flush();
+    }
+
+    content::meshlet_bounds compute_meshlet_bounds(const utl::vector<vertex>& vertices, const content::meshlet& meshlet,
+                                                   const utl::vector<u32>& meshlet_vertices,
+                                                   const utl::vector<u8>& meshlet_triangles)
+    {
+        assert(meshlet.vertex_count && meshlet.triangle_count);
+        const u32* const local_vertices{ &meshlet_vertices[meshlet.vertex_offset] };
+        content::meshlet_bounds bounds{};
+
+        // Bounding sphere around the center of the AABB.
+        XMVECTOR min{ XMLoadFloat3(&vertices[local_vertices[0]].position) };
+        XMVECTOR max{ min };
+        for (u32 i{ 1 }; i < meshlet.vertex_count; ++i)
+        {
+            const XMVECTOR p{ XMLoadFloat3(&vertices[local_vertices[i]].position) };
+            min = XMVectorMin(min, p);
+            max = XMVectorMax(max, p);
+        }
+
+        const XMVECTOR center{ (min + max) * 0.5f };
+        f32 radius_sq{ 0.f };
+        for (u32 i{ 0 }; i < meshlet.vertex_count; ++i)
+        {
+            const XMVECTOR p{ XMLoadFloat3(&vertices[local_vertices[i]].position) };
+            radius_sq = std::max(radius_sq, XMVectorGetX(XMVector3LengthSq(p - center)));
+        }
+
+        XMStoreFloat3(&bounds.center, center);
+        bounds.radius = sqrtf(radius_sq);
+
+        // Normal cone around the average triangle normal.
+        XMVECTOR normals[content::meshlet_max_triangles];
+        u32 normal_count{ 0 };
+        XMVECTOR axis{ XMVectorZero() };
+        const u8* const triangles{ &meshlet_triangles[meshlet.triangle_offset * 3] };
+        for (u32 i{ 0 }; i < meshlet.triangle_count; ++i)
+        {
+            const XMVECTOR p0{ XMLoadFloat3(&vertices[local_vertices[triangles[i * 3]]].position) };
+            const XMVECTOR p1{ XMLoadFloat3(&vertices[local_vertices[triangles[i * 3 + 1]]].position) };
+            const XMVECTOR p2{ XMLoadFloat3(&vertices[local_vertices[triangles[i * 3 + 2]]].position) };
+            const XMVECTOR n{ XMVector3Cross(p1 - p0, p2 - p0) };
+            if (XMVectorGetX(XMVector3LengthSq(n)) <= 0.f) continue; // degenerate triangles can't be seen anyway.
+
+            normals[normal_count] = XMVector3Normalize(n);
+            axis += normals[normal_count++];
+        }
+
+        bounds.cone_axis = { 0.f, 0.f, 1.f };
+        bounds.cone_cutoff = 1.f;
+        if (!normal_count || XMVectorGetX(XMVector3LengthSq(axis)) <= 0.f) return bounds;
+
+        axis = XMVector3Normalize(axis);
+        f32 min_dot{ 1.f };
+        for (u32 i{ 0 }; i < normal_count; ++i)
+        {
+            min_dot = std::min(min_dot, XMVectorGetX(XMVector3Dot(axis, normals[i])));
+        }
+
+        XMStoreFloat3(&bounds.cone_axis, axis);
+        if (min_dot > min_cone_dot)
+        {
+            // NOTE: min_dot is the cosine of the normal cone's half angle. The triangles all face away from
+            //       the camera if it's within the cone that's 90 degrees wider, mirrored, whose cosine is
+            //       -cos(angle + 90) = sin(angle).
+            bounds.cone_cutoff = sqrtf(1.f - min_dot * min_dot);
+        }
+
+        return bounds;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "ToolsCommon.h"
+#include "Content/Meshlet.h"
+
+namespace nidhog::tools
+{
+    struct vertex;
+
+    // Partitions a triangle list into meshlets of at most content::meshlet_max_vertices vertices and
+    // content::meshlet_max_triangles triangles. Meshlets are grown greedily from the triangles adjacent to the
+    // ones that were added last, preferring triangles that add fewer new vertices and are closer to the meshlet.
+    // meshlet_vertices holds the (global) vertex indices of every meshlet, meshlet_triangles 3 local (u8) indices
+    // per triangle. The output only depends on the input, so it's the same for every run.
+    void build_meshlets(const utl::vector<vertex>& vertices, const utl::vector<u32>& indices,
+                        utl::vector<content::meshlet>& meshlets, utl::vector<u32>& meshlet_vertices,
+                        utl::vector<u8>& meshlet_triangles);
+
+    // Computes a bounding sphere and a normal cone for culling a meshlet.
+    [[nodiscard]] content::meshlet_bounds compute_meshlet_bounds(const utl::vector<vertex>& vertices, const content::meshlet& meshlet,
+                                                                 const utl::vector<u32>& meshlet_vertices,
+                                                                 const utl::vector<u8>& meshlet_triangles);
+}
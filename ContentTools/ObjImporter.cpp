@@ -0,0 +1,339 @@
+#include "ObjImporter.h"
+#include "Geometry.h"
+#include "MappedFile.h"
+#include "TextParser.h"
+#include <filesystem>
+#include <unordered_map>
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        // NOTE: face vertices refer to positions, uvs and normals by their index in the whole file. Chunks don't
+        //       know how many of those the chunks before them have, so relative (negative) indices are stored
+        //       relative to the chunk and fixed up when the chunks are merged.
+        constexpr s32 missing_index{ INT32_MIN };
+
+        enum corner_component : u32
+        {
+            position_component = 0,
+            uv_component,
+            normal_component,
+
+            component_count
+        };
+
+        struct material_event
+        {
+            u32         triangle;   // first triangle (in the chunk) that uses the material
+            std::string name;
+        };
+
+        struct obj_chunk
+        {
+            utl::vector<math::v3>       positions;
+            utl::vector<math::v3>       normals;
+            utl::vector<math::v2>       uvs;
+            utl::vector<s32>            corners;    // component_count indices per triangle corner
+            utl::vector<u32>            relative;   // corners entries that are relative to the chunk
+            utl::vector<material_event> materials;
+            bool                        all_uvs{ true };
+            bool                        all_normals{ true };
+            bool                        error{ false };
+        };
+
+        [[nodiscard]] bool starts_with(const char* p, const char* const end, const char* word)
+        {
+            for (; *word; ++p, ++word)
+            {
+                if (p == end || *p != *word) return false;
+            }
+
+            return p == end || text::is_blank(*p) || *p == '\n';
+        }
+
+        // Reads one 'v', 'v/vt', 'v//vn' or 'v/vt/vn' face vertex.
+        [[nodiscard]] bool parse_face_vertex(const char*& p, const char* const end, const obj_chunk& chunk, s32 (&corner)[component_count],
+                                             bool (&relative)[component_count])
+        {
+            const u32 counts[component_count]{ (u32)chunk.positions.size(), (u32)chunk.uvs.size(), (u32)chunk.normals.size() };
+            for (u32 i{ 0 }; i < component_count; ++i)
+            {
+                corner[i] = missing_index;
+                relative[i] = false;
+                if (i)
+                {
+                    if (p == end || *p != '/') break;
+                    ++p;
+                    if (p < end && *p == '/') continue;
+                }
+
+                s64 index{ 0 };
+                if (!text::parse_int(p, end, index) || !index) return i != 0;
+                if (index > 0)
+                {
+                    corner[i] = (s32)std::min(index - 1, (s64)INT32_MAX);
+                }
+                else
+                {
+                    corner[i] = (s32)std::max((s64)counts[i] + index, (s64)INT32_MIN + 1);
+                    relative[i] = true;
+                }
+            }
+
+            return true;
+        }
+
+        void parse_chunk(const text::chunk& range, obj_chunk& chunk)
+        {
+            const char* p{ range.begin };
+            const char* const end{ range.end };
+            utl::vector<s32> polygon;
+            utl::vector<u8> polygon_relative;
+
+            while (p < end)
+            {
+                text::skip_blanks(p, end);
+                if (p == end) break;
+
+                if (*p == 'v' && p + 1 < end)
+                {
+                    const char type{ p[1] };
+                    p += 2;
+                    if (text::is_blank(type))
+                    {
+                        math::v3 v{};
+                        if (!(text::parse_float(p, end, v.x) && text::parse_float(p, end, v.y) && text::parse_float(p, end, v.z))) chunk.error = true;
+                        chunk.positions.emplace_back(v);
+                    }
+                    else if (type == 'n')
+                    {
+                        math::v3 n{};
+                        if (!(text::parse_float(p, end, n.x) && text::parse_float(p, end, n.y) && text::parse_float(p, end, n.z))) chunk.error = true;
+                        chunk.normals.emplace_back(n);
+                    }
+                    else if (type == 't')
+                    {
+                        math::v2 uv{};
+                        if (!text::parse_float(p, end, uv.x)) chunk.error = true;
+                        // NOTE: v is optional.
+                        if (!text::parse_float(p, end, uv.y)) uv.y = 0.f;
+                        chunk.uvs.emplace_back(uv);
+                    }
+                }
+                else if (*p == 'f' && starts_with(p, end, "f"))
+                {
+                    ++p;
+                    polygon.clear();
+                    polygon_relative.clear();
+                    s32 corner[component_count];
+                    bool relative[component_count];
+                    for (;;)
+                    {
+                        text::skip_blanks(p, end);
+                        if (p == end || *p == '\n' || *p == '#') break;
+                        if (!parse_face_vertex(p, end, chunk, corner, relative))
+                        {
+                            chunk.error = true;
+                            break;
+                        }
+
+                        for (u32 i{ 0 }; i < component_count; ++i)
+                        {
+                            polygon.emplace_back(corner[i]);
+                            polygon_relative.emplace_back((u8)relative[i]);
+                        }
+                    }
+
+                    // Triangulate the polygon as a fan around its first vertex.
+                    const u32 polygon_size{ (u32)polygon.size() / component_count };
+                    if (polygon_size < 3) chunk.error = true;
+                    for (u32 i{ 2 }; i < polygon_size; ++i)
+                    {
+                        const u32 fan[3]{ 0, i - 1, i };
+                        for (u32 j : fan)
+                        {
+                            for (u32 k{ 0 }; k < component_count; ++k)
+                            {
+                                const u32 src{ j * component_count + k };
+                                if (polygon_relative[src]) chunk.relative.emplace_back((u32)chunk.corners.size());
+                                chunk.corners.emplace_back(polygon[src]);
+                            }
+
+                            chunk.all_uvs &= polygon[j * component_count + uv_component] != missing_index;
+                            chunk.all_normals &= polygon[j * component_count + normal_component] != missing_index;
+                        }
+                    }
+                }
+                else if (*p == 'u' && starts_with(p, end, "usemtl"))
+                {
+                    p += 6;
+                    const u32 triangle{ (u32)chunk.corners.size() / (3 * component_count) };
+                    chunk.materials.emplace_back(material_event{ triangle, text::parse_word(p, end) });
+                }
+
+                // NOTE: comments, groups, objects, smoothing groups, material libraries and everything we don't
+                //       support yet are skipped.
+                text::skip_line(p, end);
+            }
+        }
+
+        [[nodiscard]] u64 get_chunk_size(u64 file_size)
+        {
+            // NOTE: a few chunks per thread keep the threads busy when some chunks are faster to parse than others
+            //       (e.g. only positions vs. only faces). Very small chunks aren't worth the overhead.
+            constexpr u64 min_chunk_size{ 1024 * 1024 };
+            const u64 thread_count{ std::max(1u, std::thread::hardware_concurrency()) };
+            return std::max(min_chunk_size, file_size / (thread_count * 4));
+        }
+    } // anonymous namespace
+
+    bool import_obj(const char* file, scene& scene)
+    {
+        assert(file);
+        const mapped_file obj{ file };
+        if (!obj.is_valid()) return false;
+
+        const utl::vector<text::chunk> ranges{ text::split_lines(obj.data(), obj.data() + obj.size(), get_chunk_size(obj.size())) };
+        const u32 chunk_count{ (u32)ranges.size() };
+        utl::vector<obj_chunk> chunks(chunk_count);
+        parallel_for_each(chunk_count, [&](u32 i, u32) { parse_chunk(ranges[i], chunks[i]); });
+
+        // Offsets of every chunk's data in the merged arrays.
+        utl::vector<u64> bases((chunk_count + 1) * (component_count + 1), 0);
+        auto base = [&bases](u32 chunk, u32 component) -> u64& { return bases[chunk * (component_count + 1) + component]; };
+        bool all_uvs{ true };
+        bool all_normals{ true };
+        for (u32 i{ 0 }; i < chunk_count; ++i)
+        {
+            const obj_chunk& c{ chunks[i] };
+            if (c.error) return false;
+            base(i + 1, position_component) = base(i, position_component) + c.positions.size();
+            base(i + 1, uv_component) = base(i, uv_component) + c.uvs.size();
+            base(i + 1, normal_component) = base(i, normal_component) + c.normals.size();
+            base(i + 1, component_count) = base(i, component_count) + c.corners.size() / component_count;
+            all_uvs &= c.all_uvs;
+            all_normals &= c.all_normals;
+        }
+
+        const u64 totals[component_count]{ base(chunk_count, position_component), base(chunk_count, uv_component), base(chunk_count, normal_component) };
+        const u64 corner_count{ base(chunk_count, component_count) };
+        if (!corner_count || corner_count >= u32_invalid_id || totals[position_component] >= u32_invalid_id) return false;
+
+        all_uvs &= totals[uv_component] != 0;
+        all_normals &= totals[normal_component] != 0;
+
+        mesh m{};
+        m.name = std::filesystem::path{ file }.stem().string();
+        m.lod_id = 0;
+        m.lod_threshold = -1.f;
+        m.positions.resize(totals[position_component]);
+        m.raw_indices.resize(corner_count);
+        if (all_normals) m.normals.resize(corner_count);
+        if (all_uvs)
+        {
+            m.uv_sets.resize(1);
+            m.uv_sets[0].resize(corner_count);
+        }
+
+        // Resolve the indices to the merged arrays and copy everything in place.
+        utl::vector<u8> errors(chunk_count, 0);
+        parallel_for_each(chunk_count, [&](u32 i, u32) {
+            obj_chunk& c{ chunks[i] };
+            for (u32 k : c.relative) c.corners[k] += (s32)base(i, k % component_count);
+
+            if (!c.positions.empty()) memcpy(&m.positions[base(i, position_component)], c.positions.data(), c.positions.size() * sizeof(math::v3));
+
+            const u32 count{ (u32)(c.corners.size() / component_count) };
+            const u64 first{ base(i, component_count) };
+            for (u32 j{ 0 }; j < count; ++j)
+            {
+                const s32* const corner{ &c.corners[j * component_count] };
+                if ((u32)corner[position_component] >= totals[position_component]) { errors[i] = 1; return; }
+                m.raw_indices[first + j] = (u32)corner[position_component];
+
+                if (all_normals && (u32)corner[normal_component] >= totals[normal_component]) { errors[i] = 1; return; }
+                if (all_uvs && (u32)corner[uv_component] >= totals[uv_component]) { errors[i] = 1; return; }
+            }
+        });
+
+        if (std::find(errors.begin(), errors.end(), (u8)1) != errors.end()) return false;
+
+        // Normals and UVs are referenced across chunks, so they're gathered after every chunk is resolved.
+        if (all_normals || all_uvs)
+        {
+            utl::vector<math::v3> normals;
+            utl::vector<math::v2> uvs;
+            if (all_normals) normals.resize(totals[normal_component]);
+            if (all_uvs) uvs.resize(totals[uv_component]);
+            parallel_for_each(chunk_count, [&](u32 i, u32) {
+                const obj_chunk& c{ chunks[i] };
+                if (all_normals && !c.normals.empty()) memcpy(&normals[base(i, normal_component)], c.normals.data(), c.normals.size() * sizeof(math::v3));
+                if (all_uvs && !c.uvs.empty()) memcpy(&uvs[base(i, uv_component)], c.uvs.data(), c.uvs.size() * sizeof(math::v2));
+            });
+
+            parallel_for_each(chunk_count, [&](u32 i, u32) {
+                const obj_chunk& c{ chunks[i] };
+                const u32 count{ (u32)(c.corners.size() / component_count) };
+                const u64 first{ base(i, component_count) };
+                for (u32 j{ 0 }; j < count; ++j)
+                {
+                    const s32* const corner{ &c.corners[j * component_count] };
+                    if (all_normals) m.normals[first + j] = normals[corner[normal_component]];
+                    if (all_uvs) m.uv_sets[0][first + j] = uvs[corner[uv_component]];
+                }
+            });
+        }
+
+        // Assign material ids in the order in which the materials are first used. Triangles before the first
+        // 'usemtl' get a default material, which is the same as 'usemtl' without a name.
+        bool has_materials{ false };
+        for (const obj_chunk& c : chunks) has_materials |= !c.materials.empty();
+        if (has_materials)
+        {
+            const u32 triangle_count{ (u32)(corner_count / 3) };
+            std::unordered_map<std::string, u32> material_ids;
+            auto get_material_id = [&material_ids](const std::string& name) {
+                return material_ids.emplace(name, (u32)material_ids.size()).first->second;
+            };
+
+            const std::string default_material{};
+            const std::string* current{ &default_material };
+            u32 run_start{ 0 };
+            m.material_indices.resize(triangle_count);
+
+            // NOTE: ids are assigned when a run of triangles ends, so materials without triangles don't get one.
+            auto use_material = [&](u32 triangle, const std::string* name) {
+                if (triangle > run_start)
+                {
+                    const u32 id{ get_material_id(*current) };
+                    std::fill(m.material_indices.begin() + run_start, m.material_indices.begin() + triangle, id);
+                    if (std::find(m.material_used.begin(), m.material_used.end(), id) == m.material_used.end())
+                    {
+                        m.material_used.emplace_back(id);
+                    }
+                }
+
+                run_start = triangle;
+                current = name;
+            };
+
+            for (u32 i{ 0 }; i < chunk_count; ++i)
+            {
+                for (const material_event& e : chunks[i].materials)
+                {
+                    use_material((u32)(base(i, component_count) / 3) + e.triangle, &e.name);
+                }
+            }
+
+            use_material(triangle_count, nullptr);
+        }
+
+        lod_group lod{};
+        lod.name = m.name;
+        lod.meshes.emplace_back(std::move(m));
+        scene.name = lod.name;
+        scene.lod_groups.emplace_back(std::move(lod));
+        return true;
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    struct scene;
+
+    // Reads a Wavefront OBJ file into a scene with a single LOD group that holds a single mesh.
+    // The file is memory-mapped and split into line-aligned chunks that are parsed in parallel.
+    // Polygons are triangulated as fans. Normals and UVs are only imported if every face vertex has them.
+    // Materials are identified by the order in which their 'usemtl' statements first appear.
+    // Returns false if the file can't be read, has no faces or references vertices that don't exist.
+    bool import_obj(const char* file, scene& scene);
+}
@@ -0,0 +1,599 @@
+#include "PlyImporter.h"
+#include "Geometry.h"
+#include "MappedFile.h"
+#include "TextParser.h"
+#include <filesystem>
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        enum class ply_format : u32
+        {
+            ascii,
+            binary_little_endian,
+            binary_big_endian,
+        };
+
+        enum class scalar_type : u32
+        {
+            int8, uint8, int16, uint16, int32, uint32, float32, float64,
+
+            invalid
+        };
+
+        // Where a vertex property goes in the mesh.
+        enum vertex_slot : u32
+        {
+            slot_x, slot_y, slot_z,
+            slot_nx, slot_ny, slot_nz,
+            slot_u, slot_v,
+
+            slot_count,
+            slot_none = slot_count
+        };
+
+        struct ply_property
+        {
+            std::string     name;
+            scalar_type     type{ scalar_type::invalid };
+            scalar_type     count_type{ scalar_type::invalid };    // only for lists
+            bool            is_list{ false };
+        };
+
+        struct ply_element
+        {
+            std::string                 name;
+            u64                         count{ 0 };
+            utl::vector<ply_property>   properties;
+        };
+
+        struct ply_header
+        {
+            ply_format                  format{ ply_format::ascii };
+            utl::vector<ply_element>    elements;
+            const char*                 body{ nullptr };
+        };
+
+        struct ply_data
+        {
+            u64                         vertex_count{ 0 };
+            utl::vector<math::v3>       positions;
+            utl::vector<math::v3>       normals;
+            utl::vector<math::v2>       uvs;
+            utl::vector<u32>            slots;          // vertex_slot of each vertex property
+            u32                         index_property{ u32_invalid_id };
+            utl::vector<utl::vector<u32>> triangles;    // per chunk of faces
+        };
+
+        constexpr u32 scalar_sizes[]{ 1, 1, 2, 2, 4, 4, 4, 8 };
+        static_assert(_countof(scalar_sizes) == (u32)scalar_type::invalid);
+
+        [[nodiscard]] scalar_type get_scalar_type(const std::string& name)
+        {
+            if (name == "char" || name == "int8") return scalar_type::int8;
+            if (name == "uchar" || name == "uint8") return scalar_type::uint8;
+            if (name == "short" || name == "int16") return scalar_type::int16;
+            if (name == "ushort" || name == "uint16") return scalar_type::uint16;
+            if (name == "int" || name == "int32") return scalar_type::int32;
+            if (name == "uint" || name == "uint32") return scalar_type::uint32;
+            if (name == "float" || name == "float32") return scalar_type::float32;
+            if (name == "double" || name == "float64") return scalar_type::float64;
+            return scalar_type::invalid;
+        }
+
+        [[nodiscard]] u32 get_vertex_slot(const std::string& name)
+        {
+            constexpr const char* names[][4]{
+                { "x" }, { "y" }, { "z" },
+                { "nx" }, { "ny" }, { "nz" },
+                { "u", "s", "texture_u", "texture_s" }, { "v", "t", "texture_v", "texture_t" },
+            };
+            static_assert(_countof(names) == slot_count);
+
+            for (u32 i{ 0 }; i < slot_count; ++i)
+            {
+                for (const char* n : names[i])
+                {
+                    if (n && name == n) return i;
+                }
+            }
+
+            return slot_none;
+        }
+
+        [[nodiscard]] bool is_integer(scalar_type type)
+        {
+            return type != scalar_type::float32 && type != scalar_type::float64;
+        }
+
+        [[nodiscard]] bool parse_header(const char* const begin, const char* const end, ply_header& header)
+        {
+            const char* p{ begin };
+            if (text::parse_word(p, end) != "ply") return false;
+            text::skip_line(p, end);
+
+            while (p < end)
+            {
+                const std::string keyword{ text::parse_word(p, end) };
+                if (keyword == "format")
+                {
+                    const std::string format{ text::parse_word(p, end) };
+                    if (format == "ascii") header.format = ply_format::ascii;
+                    else if (format == "binary_little_endian") header.format = ply_format::binary_little_endian;
+                    else if (format == "binary_big_endian") header.format = ply_format::binary_big_endian;
+                    else return false;
+                }
+                else if (keyword == "element")
+                {
+                    ply_element element{};
+                    element.name = text::parse_word(p, end);
+                    s64 count{ 0 };
+                    if (!text::parse_int(p, end, count) || count < 0) return false;
+                    element.count = (u64)count;
+                    header.elements.emplace_back(std::move(element));
+                }
+                else if (keyword == "property")
+                {
+                    if (header.elements.empty()) return false;
+                    ply_property property{};
+                    std::string type{ text::parse_word(p, end) };
+                    if (type == "list")
+                    {
+                        property.is_list = true;
+                        property.count_type = get_scalar_type(text::parse_word(p, end));
+                        if (property.count_type == scalar_type::invalid || !is_integer(property.count_type)) return false;
+                        type = text::parse_word(p, end);
+                    }
+
+                    property.type = get_scalar_type(type);
+                    property.name = text::parse_word(p, end);
+                    if (property.type == scalar_type::invalid) return false;
+                    header.elements.back().properties.emplace_back(std::move(property));
+                }
+                else if (keyword == "end_header")
+                {
+                    text::skip_line(p, end);
+                    header.body = p;
+                    return true;
+                }
+
+                // NOTE: comment and obj_info lines are skipped.
+                text::skip_line(p, end);
+            }
+
+            return false;
+        }
+
+        class ascii_reader
+        {
+        public:
+            ascii_reader(const char* p, const char* end) : _p{ p }, _end{ end } {}
+
+            [[nodiscard]] bool scalar(scalar_type type, double& value)
+            {
+                if (is_integer(type))
+                {
+                    s64 v{ 0 };
+                    if (!text::parse_int(_p, _end, v)) return false;
+                    value = (double)v;
+                }
+                else
+                {
+                    f32 v{ 0.f };
+                    if (!text::parse_float(_p, _end, v)) return false;
+                    value = v;
+                }
+
+                return true;
+            }
+
+            constexpr const char* position() const { return _p; }
+        private:
+            const char*         _p;
+            const char* const   _end;
+        };
+
+        class binary_reader
+        {
+        public:
+            binary_reader(const u8* p, const u8* end, bool swap_bytes) : _p{ p }, _end{ end }, _swap_bytes{ swap_bytes } {}
+
+            [[nodiscard]] bool scalar(scalar_type type, double& value)
+            {
+                const u32 size{ scalar_sizes[(u32)type] };
+                if ((u64)(_end - _p) < size) return false;
+
+                switch (type)
+                {
+                case scalar_type::int8:     value = (double)load<s8>(); break;
+                case scalar_type::uint8:    value = (double)load<u8>(); break;
+                case scalar_type::int16:    value = (double)load<s16>(); break;
+                case scalar_type::uint16:   value = (double)load<u16>(); break;
+                case scalar_type::int32:    value = (double)load<s32>(); break;
+                case scalar_type::uint32:   value = (double)load<u32>(); break;
+                case scalar_type::float32:  value = (double)load<f32>(); break;
+                case scalar_type::float64:  value = load<double>(); break;
+                default: return false;
+                }
+
+                return true;
+            }
+
+            constexpr const u8* position() const { return _p; }
+        private:
+            // Reads a T and moves past it. The caller checks that there are sizeof(T) bytes left.
+            template<typename T> [[nodiscard]] T load()
+            {
+                u8 bytes[sizeof(T)];
+                memcpy(bytes, _p, sizeof(T));
+                if (_swap_bytes) std::reverse(bytes, bytes + sizeof(T));
+                _p += sizeof(T);
+
+                T v;
+                memcpy(&v, bytes, sizeof(T));
+                return v;
+            }
+
+            const u8*           _p;
+            const u8* const     _end;
+            const bool          _swap_bytes;
+        };
+
+        // Reads one item of an element and calls func(property_index, value) for every scalar and list entry.
+        template<typename R, typename F>
+        [[nodiscard]] bool read_item(R& reader, const ply_element& element, F&& func)
+        {
+            const u32 property_count{ (u32)element.properties.size() };
+            for (u32 i{ 0 }; i < property_count; ++i)
+            {
+                const ply_property& property{ element.properties[i] };
+                double value{ 0.0 };
+                if (!property.is_list)
+                {
+                    if (!reader.scalar(property.type, value)) return false;
+                    func(i, value);
+                    continue;
+                }
+
+                double count{ 0.0 };
+                if (!reader.scalar(property.count_type, count) || count < 0.0) return false;
+                for (u32 j{ 0 }; j < (u32)count; ++j)
+                {
+                    if (!reader.scalar(property.type, value)) return false;
+                    func(i, value);
+                }
+            }
+
+            return true;
+        }
+
+        template<typename R>
+        [[nodiscard]] bool read_vertex(R& reader, const ply_element& element, ply_data& data, u64 index)
+        {
+            f32 values[slot_count + 1]{};
+            if (!read_item(reader, element, [&](u32 property, double value) { values[data.slots[property]] = (f32)value; }))
+            {
+                return false;
+            }
+
+            data.positions[index] = { values[slot_x], values[slot_y], values[slot_z] };
+            if (!data.normals.empty()) data.normals[index] = { values[slot_nx], values[slot_ny], values[slot_nz] };
+            if (!data.uvs.empty()) data.uvs[index] = { values[slot_u], values[slot_v] };
+            return true;
+        }
+
+        template<typename R>
+        [[nodiscard]] bool read_face(R& reader, const ply_element& element, const ply_data& data, utl::vector<u32>& polygon,
+                                     utl::vector<u32>& triangles)
+        {
+            polygon.clear();
+            bool valid{ true };
+            if (!read_item(reader, element, [&](u32 property, double value) {
+                if (property != data.index_property) return;
+                valid &= value >= 0.0 && value < (double)data.vertex_count;
+                polygon.emplace_back((u32)value);
+            }))
+            {
+                return false;
+            }
+
+            // Triangulate the polygon as a fan around its first vertex.
+            const u32 polygon_size{ (u32)polygon.size() };
+            for (u32 i{ 2 }; i < polygon_size; ++i)
+            {
+                triangles.emplace_back(polygon[0]);
+                triangles.emplace_back(polygon[i - 1]);
+                triangles.emplace_back(polygon[i]);
+            }
+
+            return valid && polygon_size >= 3;
+        }
+
+        // Number of ranges to split 'count' bytes or items into for parallel parsing.
+        [[nodiscard]] u32 get_range_count(u64 count, u64 min_range)
+        {
+            // NOTE: a few ranges per thread keep the threads busy when some ranges take longer than others.
+            const u64 thread_count{ std::max(1u, std::thread::hardware_concurrency()) };
+            return (u32)std::clamp<u64>(count / min_range, 1, thread_count * 4);
+        }
+
+        [[nodiscard]] bool read_ascii_body(const ply_header& header, const char* const end, ply_data& data)
+        {
+            constexpr u64 min_chunk_size{ 1024 * 1024 };
+            const u64 body_size{ (u64)(end - header.body) };
+            const u64 chunk_size{ std::max<u64>(1, body_size / get_range_count(body_size, min_chunk_size)) };
+            const utl::vector<text::chunk> chunks{ text::split_lines(header.body, end, chunk_size) };
+            const u32 chunk_count{ (u32)chunks.size() };
+
+            // Every line holds one item, so the line number tells which element and item it belongs to.
+            utl::vector<u64> first_lines(chunk_count + 1, 0);
+            parallel_for_each(chunk_count, [&](u32 i, u32) { first_lines[i + 1] = text::count_lines(chunks[i].begin, chunks[i].end); });
+            for (u32 i{ 0 }; i < chunk_count; ++i) first_lines[i + 1] += first_lines[i];
+
+            utl::vector<u64> element_lines(header.elements.size() + 1, 0);
+            for (u32 i{ 0 }; i < header.elements.size(); ++i) element_lines[i + 1] = element_lines[i] + header.elements[i].count;
+            if (first_lines[chunk_count] < element_lines.back()) return false;
+
+            data.triangles.resize(chunk_count);
+            utl::vector<u8> errors(chunk_count, 0);
+            parallel_for_each(chunk_count, [&](u32 i, u32) {
+                const char* p{ chunks[i].begin };
+                const char* const chunk_end{ chunks[i].end };
+                u32 element{ 0 };
+                utl::vector<u32> polygon;
+                for (u64 line{ first_lines[i] }; p < chunk_end && line < element_lines.back(); ++line)
+                {
+                    while (line >= element_lines[element + 1]) ++element;
+                    const ply_element& e{ header.elements[element] };
+                    ascii_reader reader{ p, chunk_end };
+                    bool ok{ true };
+                    if (e.name == "vertex") ok = read_vertex(reader, e, data, line - element_lines[element]);
+                    else if (e.name == "face") ok = read_face(reader, e, data, polygon, data.triangles[i]);
+                    if (!ok)
+                    {
+                        errors[i] = 1;
+                        return;
+                    }
+
+                    text::skip_line(p, chunk_end);
+                }
+            });
+
+            return std::find(errors.begin(), errors.end(), (u8)1) == errors.end();
+        }
+
+        // Returns the size of an item if the element has no lists, 0 otherwise.
+        [[nodiscard]] u32 get_fixed_item_size(const ply_element& element)
+        {
+            u32 size{ 0 };
+            for (const ply_property& property : element.properties)
+            {
+                if (property.is_list) return 0;
+                size += scalar_sizes[(u32)property.type];
+            }
+
+            return size;
+        }
+
+        // Returns the size of a face if it's a triangle and the index list is the only list, 0 if that's not possible.
+        [[nodiscard]] u32 get_triangle_size(const ply_element& element, u32 index_property, u32& count_offset)
+        {
+            u32 size{ 0 };
+            for (u32 i{ 0 }; i < element.properties.size(); ++i)
+            {
+                const ply_property& property{ element.properties[i] };
+                if (i == index_property)
+                {
+                    count_offset = size;
+                    size += scalar_sizes[(u32)property.count_type] + 3 * scalar_sizes[(u32)property.type];
+                }
+                else if (property.is_list) return 0;
+                else size += scalar_sizes[(u32)property.type];
+            }
+
+            return size;
+        }
+
+        // Checks that all faces are triangles, assuming they are.
+        // NOTE: if they aren't, the counts we check after the first polygon that isn't a triangle are garbage.
+        //       The count of that polygon is at the right place though, so we still find out.
+        [[nodiscard]] bool are_all_triangles(const u8* const p, const u8* const end, bool swap_bytes, u64 count, u32 triangle_size,
+                                             u32 count_offset, scalar_type count_type)
+        {
+            if ((u64)(end - p) / triangle_size < count || count >= u32_invalid_id) return false;
+
+            std::atomic<bool> all_triangles{ true };
+            parallel_for((u32)count, [&](u32 begin, u32 range_end) {
+                for (u32 i{ begin }; i < range_end && all_triangles; ++i)
+                {
+                    binary_reader reader{ p + (u64)i * triangle_size + count_offset, end, swap_bytes };
+                    double polygon_size{ 0.0 };
+                    if (!reader.scalar(count_type, polygon_size) || polygon_size != 3.0) all_triangles = false;
+                }
+            }, 64 * 1024);
+
+            return all_triangles;
+        }
+
+        [[nodiscard]] bool read_binary_body(const ply_header& header, const u8* const end, ply_data& data)
+        {
+            // NOTE: we only run on little endian machines.
+            const bool swap_bytes{ header.format == ply_format::binary_big_endian };
+            const u8* p{ (const u8*)header.body };
+
+            for (const ply_element& e : header.elements)
+            {
+                const bool is_vertex{ e.name == "vertex" };
+                const bool is_face{ e.name == "face" };
+                u32 item_size{ get_fixed_item_size(e) };
+
+                // Most meshes only have triangles. We speculate that's the case here, so the faces can be read
+                // in parallel like elements of fixed size.
+                if (is_face && !item_size)
+                {
+                    u32 count_offset{ 0 };
+                    const u32 triangle_size{ get_triangle_size(e, data.index_property, count_offset) };
+                    if (triangle_size && are_all_triangles(p, end, swap_bytes, e.count, triangle_size, count_offset,
+                                                           e.properties[data.index_property].count_type))
+                    {
+                        item_size = triangle_size;
+                    }
+                }
+
+                if (item_size && (u64)(end - p) / item_size < e.count) return false;
+
+                if (item_size && (is_vertex || is_face))
+                {
+                    const u32 range_count{ get_range_count(e.count, 16 * 1024) };
+                    if (is_face) data.triangles.resize(range_count);
+
+                    utl::vector<u8> errors(range_count, 0);
+                    parallel_for_each(range_count, [&](u32 i, u32) {
+                        const u64 first{ e.count * i / range_count };
+                        const u64 last{ e.count * (i + 1) / range_count };
+                        binary_reader reader{ p + first * item_size, p + last * item_size, swap_bytes };
+                        utl::vector<u32> polygon;
+                        if (is_face) data.triangles[i].reserve((last - first) * 3);
+                        for (u64 j{ first }; j < last; ++j)
+                        {
+                            const bool ok{ is_vertex ? read_vertex(reader, e, data, j) : read_face(reader, e, data, polygon, data.triangles[i]) };
+                            if (!ok)
+                            {
+                                errors[i] = 1;
+                                return;
+                            }
+                        }
+                    });
+
+                    if (std::find(errors.begin(), errors.end(), (u8)1) != errors.end()) return false;
+                    p += e.count * item_size;
+                }
+                else if (item_size)
+                {
+                    p += e.count * item_size;
+                }
+                else
+                {
+                    // Items of different sizes (e.g. polygons that aren't triangles) have to be read one after
+                    // the other.
+                    binary_reader reader{ p, end, swap_bytes };
+                    utl::vector<u32> polygon;
+                    if (is_face) data.triangles.resize(1);
+                    for (u64 j{ 0 }; j < e.count; ++j)
+                    {
+                        const bool ok{ is_vertex ? read_vertex(reader, e, data, j) :
+                                       is_face ? read_face(reader, e, data, polygon, data.triangles[0]) :
+                                       read_item(reader, e, [](u32, double) {}) };
+                        if (!ok) return false;
+                    }
+
+                    p = reader.position();
+                }
+            }
+
+            return true;
+        }
+    } // anonymous namespace
+
+    bool import_ply(const char* file, scene& scene)
+    {
+        assert(file);
+        const mapped_file ply{ file };
+        if (!ply.is_valid()) return false;
+
+        const char* const end{ ply.data() + ply.size() };
+        ply_header header{};
+        if (!parse_header(ply.data(), end, header)) return false;
+
+        // Find the properties we import.
+        ply_data data{};
+        const ply_element* vertex_element{ nullptr };
+        const ply_element* face_element{ nullptr };
+        for (const ply_element& e : header.elements)
+        {
+            if (e.name == "vertex" && !vertex_element) vertex_element = &e;
+            else if (e.name == "face" && !face_element) face_element = &e;
+            else if (e.name == "vertex" || e.name == "face") return false;
+        }
+
+        if (!vertex_element || !face_element || !vertex_element->count || !face_element->count) return false;
+        if (vertex_element->count >= u32_invalid_id) return false;
+
+        bool has_slot[slot_count + 1]{};
+        for (const ply_property& property : vertex_element->properties)
+        {
+            const u32 slot{ property.is_list ? (u32)slot_none : get_vertex_slot(property.name) };
+            data.slots.emplace_back(slot);
+            has_slot[slot] = true;
+        }
+
+        for (u32 i{ 0 }; i < face_element->properties.size(); ++i)
+        {
+            const ply_property& property{ face_element->properties[i] };
+            if (property.is_list && (property.name == "vertex_indices" || property.name == "vertex_index"))
+            {
+                data.index_property = i;
+                break;
+            }
+        }
+
+        if (!(has_slot[slot_x] && has_slot[slot_y] && has_slot[slot_z]) || data.index_property == u32_invalid_id) return false;
+
+        data.vertex_count = vertex_element->count;
+        data.positions.resize(data.vertex_count);
+        if (has_slot[slot_nx] && has_slot[slot_ny] && has_slot[slot_nz]) data.normals.resize(data.vertex_count);
+        if (has_slot[slot_u] && has_slot[slot_v]) data.uvs.resize(data.vertex_count);
+
+        const bool result{ header.format == ply_format::ascii ?
+                           read_ascii_body(header, end, data) :
+                           read_binary_body(header, (const u8*)end, data) };
+        if (!result) return false;
+
+        // Merge the triangles of all chunks and expand the vertex attributes to the triangle corners.
+        const u32 chunk_count{ (u32)data.triangles.size() };
+        utl::vector<u64> offsets(chunk_count + 1, 0);
+        for (u32 i{ 0 }; i < chunk_count; ++i) offsets[i + 1] = offsets[i] + data.triangles[i].size();
+        const u64 corner_count{ offsets[chunk_count] };
+        if (!corner_count || corner_count >= u32_invalid_id) return false;
+
+        mesh m{};
+        m.name = std::filesystem::path{ file }.stem().string();
+        m.lod_id = 0;
+        m.lod_threshold = -1.f;
+        m.positions.swap(data.positions);
+        m.raw_indices.resize(corner_count);
+        parallel_for_each(chunk_count, [&](u32 i, u32) {
+            if (!data.triangles[i].empty())
+            {
+                memcpy(&m.raw_indices[offsets[i]], data.triangles[i].data(), data.triangles[i].size() * sizeof(u32));
+            }
+        });
+
+        if (!data.normals.empty()) m.normals.resize(corner_count);
+        if (!data.uvs.empty())
+        {
+            m.uv_sets.resize(1);
+            m.uv_sets[0].resize(corner_count);
+        }
+
+        if (!data.normals.empty() || !data.uvs.empty())
+        {
+            parallel_for((u32)corner_count, [&](u32 begin, u32 range_end) {
+                for (u32 i{ begin }; i < range_end; ++i)
+                {
+                    const u32 v{ m.raw_indices[i] };
+                    if (!data.normals.empty()) m.normals[i] = data.normals[v];
+                    if (!data.uvs.empty()) m.uv_sets[0][i] = data.uvs[v];
+                }
+            });
+        }
+
+        lod_group lod{};
+        lod.name = m.name;
+        lod.meshes.emplace_back(std::move(m));
+        scene.name = lod.name;
+        scene.lod_groups.emplace_back(std::move(lod));
+        return true;
+    }
+}
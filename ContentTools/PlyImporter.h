@@ -0,0 +1,15 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    struct scene;
+
+    // Reads a PLY file (ASCII, binary little or big endian) into a scene with a single LOD group that holds a
+    // single mesh. Positions, normals and UVs are read from the 'vertex' element and polygons from the
+    // 'vertex_indices' (or 'vertex_index') list of the 'face' element, triangulated as fans.
+    // The file is memory-mapped. ASCII files are split into line-aligned chunks and binary elements into ranges
+    // of items that are parsed in parallel.
+    // Returns false if the file can't be read, has no faces or references vertices that don't exist.
+    bool import_ply(const char* file, scene& scene);
+}
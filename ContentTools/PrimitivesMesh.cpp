@@ -293,6 +293,8 @@ namespace nidhog::tools
         creators[info->type](scene, *info);
 
         data->settings.calculate_normals = 1;
+        // NOTE: primitives are cheap enough, so we don't generate LODs for them.
+        data->settings.auto_lod_count = 0;
         process_scene(scene, data->settings);
         pack_data(scene, *data);
     }
@@ -0,0 +1,105 @@
+#include "Geometry.h"
+#include "FbxImporter.h"
+#include "ObjImporter.h"
+#include "PlyImporter.h"
+#include "GltfImporter.h"
+#include <chrono>
+
+// Editor entry points for the geometry importers. The importers only read files into a scene. The OBJ, PLY and
+// glTF importers also build on other platforms (see CMakeLists.txt). Processing and packing the scene for the
+// editor happens here.
+namespace nidhog::tools
+{
+    namespace
+    {
+        // Reads a scene with 'import' and logs how long that took (see log_import_stats()).
+        template<typename F>
+        bool read_scene(const char* format, const char* file, scene& scene, F&& import)
+        {
+            using clock = std::chrono::steady_clock;
+            const clock::time_point start{ clock::now() };
+            if (!import(file, scene)) return false;
+
+            log_import_stats(format, file, scene, std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            return true;
+        }
+
+        template<typename F>
+        void import_scene(const char* format, const char* file, scene_data* data, F&& import)
+        {
+            assert(file && data);
+            data->buffer = nullptr;
+            data->buffer_size = 0;
+            scene scene{};
+            if (!read_scene(format, file, scene, import)) return;
+
+            process_scene(scene, data->settings);
+            pack_data(scene, *data);
+        }
+
+        // Same as import_scene(), but streams the packed scene to 'output' instead of returning it in data->buffer,
+        // which stays null. data->buffer_size is set to the number of bytes written (0 on failure).
+        // NOTE: the packed scene can be larger than any single buffer (e.g. scans that are processed out of core),
+        //       so the editor imports through this.
+        template<typename F>
+        void import_scene_to_file(const char* format, const char* file, const char* output, scene_data* data, F&& import)
+        {
+            assert(file && output && data);
+            data->buffer = nullptr;
+            data->buffer_size = 0;
+            scene scene{};
+            if (!read_scene(format, file, scene, import)) return;
+
+            process_scene(scene, data->settings);
+
+            const HANDLE handle{ CreateFileA(output, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr) };
+            if (handle == INVALID_HANDLE_VALUE) return;
+
+            handle_scene_sink sink{ handle };
+            data->buffer_size = pack_data(scene, sink, true);
+            CloseHandle(handle);
+        }
+    } // anonymous namespace
+
+    EDITOR_INTERFACE void ImportFbx(const char* file, scene_data* data)
+    {
+        // TODO: send failure log message to editor
+        import_scene("FBX", file, data, [data](const char* file, scene& scene) { return import_fbx(file, scene, *data); });
+    }
+
+    // The ...ToFile entry points stream the packed scene to 'output' (see import_scene_to_file()).
+    EDITOR_INTERFACE void ImportFbxToFile(const char* file, const char* output, scene_data* data)
+    {
+        import_scene_to_file("FBX", file, output, data, [data](const char* file, scene& scene) { return import_fbx(file, scene, *data); });
+    }
+
+    EDITOR_INTERFACE void ImportObj(const char* file, scene_data* data)
+    {
+        import_scene("OBJ", file, data, import_obj);
+    }
+
+    EDITOR_INTERFACE void ImportPly(const char* file, scene_data* data)
+    {
+        import_scene("PLY", file, data, import_ply);
+    }
+
+    EDITOR_INTERFACE void ImportGltf(const char* file, scene_data* data)
+    {
+        import_scene("glTF", file, data, import_gltf);
+    }
+
+    EDITOR_INTERFACE void ImportObjToFile(const char* file, const char* output, scene_data* data)
+    {
+        import_scene_to_file("OBJ", file, output, data, import_obj);
+    }
+
+    EDITOR_INTERFACE void ImportPlyToFile(const char* file, const char* output, scene_data* data)
+    {
+        import_scene_to_file("PLY", file, output, data, import_ply);
+    }
+
+    EDITOR_INTERFACE void ImportGltfToFile(const char* file, const char* output, scene_data* data)
+    {
+        import_scene_to_file("glTF", file, output, data, import_gltf);
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include "ToolsCommon.h"
+#include <cmath>
+
+// Small, allocation-free parsers for text based geometry formats (OBJ, ASCII PLY).
+// NOTE: all of them take the current position by reference and advance it, and never read at or past 'end'.
+namespace nidhog::tools::text
+{
+    struct chunk
+    {
+        const char* begin;
+        const char* end;
+    };
+
+    [[nodiscard]] constexpr bool is_digit(char c) { return (u32)(c - '0') < 10; }
+    [[nodiscard]] constexpr bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline void skip_blanks(const char*& p, const char* const end)
+    {
+        while (p < end && is_blank(*p)) ++p;
+    }
+
+    // Moves p to the first character of the next line (or to end).
+    inline void skip_line(const char*& p, const char* const end)
+    {
+        const char* const eol{ (const char*)memchr(p, '\n', (size_t)(end - p)) };
+        p = eol ? eol + 1 : end;
+    }
+
+    [[nodiscard]] inline u64 count_lines(const char* p, const char* const end)
+    {
+        u64 count{ 0 };
+        while (p < end)
+        {
+            skip_line(p, end);
+            ++count;
+        }
+
+        return count;
+    }
+
+    // Splits [begin, end) into chunks of about 'chunk_size' bytes that start at the beginning of a line.
+    [[nodiscard]] inline utl::vector<chunk> split_lines(const char* const begin, const char* const end, u64 chunk_size)
+    {
+        assert(chunk_size);
+        utl::vector<chunk> chunks;
+        const char* p{ begin };
+        while (p < end)
+        {
+            const char* chunk_end{ (u64)(end - p) > chunk_size ? p + chunk_size : end };
+            if (chunk_end < end) skip_line(chunk_end, end);
+            chunks.emplace_back(chunk{ p, chunk_end });
+            p = chunk_end;
+        }
+
+        return chunks;
+    }
+
+    // Reads a word (e.g. a name) up to the next blank or the end of the line.
+    [[nodiscard]] inline std::string parse_word(const char*& p, const char* const end)
+    {
+        skip_blanks(p, end);
+        const char* const first{ p };
+        while (p < end && !is_blank(*p) && *p != '\n') ++p;
+        return { first, p };
+    }
+
+    [[nodiscard]] inline bool parse_int(const char*& p, const char* const end, s64& value)
+    {
+        skip_blanks(p, end);
+        const bool negative{ p < end && *p == '-' };
+        if (p < end && (*p == '-' || *p == '+')) ++p;
+        if (p == end || !is_digit(*p)) return false;
+
+        u64 v{ 0 };
+        while (p < end && is_digit(*p)) v = v * 10 + (u64)(*p++ - '0');
+        value = negative ? -(s64)v : (s64)v;
+        return true;
+    }
+
+    // Parses a decimal floating point number. Up to 19 significant digits are gathered in an integer and scaled
+    // by a power of ten from a table, which is exact for the usual exponents. That's not correctly rounded in
+    // every case like strtod, but a lot faster and well within float precision.
+    [[nodiscard]] inline bool parse_double(const char*& p, const char* const end, double& value)
+    {
+        constexpr double powers_of_ten[]{
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        constexpr s32 max_exact_power{ _countof(powers_of_ten) - 1 };
+
+        skip_blanks(p, end);
+        const bool negative{ p < end && *p == '-' };
+        if (p < end && (*p == '-' || *p == '+')) ++p;
+
+        u64 mantissa{ 0 };
+        s32 significant_digits{ 0 };
+        s32 exponent{ 0 };
+        bool has_digits{ false };
+
+        while (p < end && is_digit(*p))
+        {
+            has_digits = true;
+            if (significant_digits < 19)
+            {
+                mantissa = mantissa * 10 + (u64)(*p - '0');
+                if (mantissa) ++significant_digits;
+            }
+            else ++exponent;
+            ++p;
+        }
+
+        if (p < end && *p == '.')
+        {
+            ++p;
+            while (p < end && is_digit(*p))
+            {
+                has_digits = true;
+                if (significant_digits < 19)
+                {
+                    mantissa = mantissa * 10 + (u64)(*p - '0');
+                    if (mantissa) ++significant_digits;
+                    --exponent;
+                }
+                ++p;
+            }
+        }
+
+        if (!has_digits) return false;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* q{ p + 1 };
+            const bool negative_exponent{ q < end && *q == '-' };
+            if (q < end && (*q == '-' || *q == '+')) ++q;
+            if (q < end && is_digit(*q))
+            {
+                s32 e{ 0 };
+                while (q < end && is_digit(*q))
+                {
+                    if (e < 10000) e = e * 10 + (s32)(*q - '0');
+                    ++q;
+                }
+
+                exponent += negative_exponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double v{ (double)mantissa };
+        if (exponent < 0)
+        {
+            v = (-exponent <= max_exact_power) ? v / powers_of_ten[-exponent] : v * std::pow(10.0, (double)exponent);
+        }
+        else if (exponent > 0)
+        {
+            v = (exponent <= max_exact_power) ? v * powers_of_ten[exponent] : v * std::pow(10.0, (double)exponent);
+        }
+
+        value = negative ? -v : v;
+        return true;
+    }
+
+    [[nodiscard]] inline bool parse_float(const char*& p, const char* const end, f32& value)
+    {
+        double v{ 0.0 };
+        if (!parse_double(p, end, v)) return false;
+        value = (f32)v;
+        return true;
+    }
+}
@@ -4,16 +4,34 @@
 #define NOMINMAX
 #endif
 
+// NOTE: the OBJ, PLY and glTF importers only use what's in here and in the Engine's common headers, so they
+//       also build on other platforms (see CMakeLists.txt). Keep Win32 headers behind _WIN64.
+#ifdef _WIN64
 #include <wrl.h>
+#else
+#include <filesystem>
+#endif
+#include <thread>
+#include <atomic>
+#include <vector>
 
 #ifndef EDITOR_INTERFACE
+#ifdef _WIN64
 #define EDITOR_INTERFACE extern "C" __declspec(dllexport)
+#else
+#define EDITOR_INTERFACE extern "C" __attribute__((visibility("default")))
+#endif
 #endif // !EDITOR_INTERFACE
 
 inline bool file_exists(const char* file)
 {
+#ifdef _WIN64
     const DWORD attr{ GetFileAttributesA(file) };
     return attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    std::error_code error;
+    return std::filesystem::is_regular_file(file, error);
+#endif
 }
 
 inline std::wstring to_wstring(const char* cstr)
@@ -38,4 +56,80 @@ inline nidhog::utl::vector<std::string> split(std::string s, char delimiter)
 
     strings.emplace_back(s.substr(start));
     return strings;
-}
\ No newline at end of file
+}
+
+// NOTE: true on threads that run parallel_for_each items. Parallel loops nested in those items run on the
+//       calling thread, because the outer loop already keeps all cores busy.
+inline thread_local bool is_parallel_worker{ false };
+
+// Number of threads parallel_for_each uses for 'count' items. Per-thread scratch memory should be
+// allocated for this many workers.
+[[nodiscard]] inline u32 get_worker_count(u32 count)
+{
+    if (is_parallel_worker) return 1;
+    return std::min(std::max(1u, std::thread::hardware_concurrency()), count);
+}
+
+// Calls func(index, worker_index) for every index in [0, count). Items are handed out one at a time, so
+// items of very different cost (e.g. meshes) are balanced over the threads. worker_index is less than
+// get_worker_count(count) and can be used to pick per-thread scratch memory.
+// NOTE: the order in which items are processed is undefined. Results should be written to slot 'index'
+//       of a presized output to keep the output deterministic.
+template<typename F>
+inline void parallel_for_each(u32 count, F&& func)
+{
+    const u32 worker_count{ get_worker_count(count) };
+    if (worker_count <= 1)
+    {
+        for (u32 i{ 0 }; i < count; ++i) func(i, 0u);
+        return;
+    }
+
+    std::atomic<u32> next_index{ 0 };
+    auto worker = [&func, &next_index, count](u32 worker_index) {
+        is_parallel_worker = true;
+        for (u32 i{ next_index++ }; i < count; i = next_index++) func(i, worker_index);
+        is_parallel_worker = false;
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count - 1);
+    for (u32 i{ 1 }; i < worker_count; ++i) threads.emplace_back(worker, i);
+
+    worker(0);
+    for (auto& thread : threads) thread.join();
+}
+
+// Splits [0, count) into contiguous ranges and calls func(begin, end) for each of them on its own thread.
+// NOTE: ranges are never smaller than min_range, so small workloads just run on the calling thread.
+template<typename F>
+inline void parallel_for(u32 count, F&& func, u32 min_range = 1024)
+{
+    if (!count) return;
+    if (is_parallel_worker)
+    {
+        func(0u, count);
+        return;
+    }
+
+    const u32 max_threads{ std::max(1u, std::thread::hardware_concurrency()) };
+    const u32 num_ranges{ std::min(max_threads, (count + min_range - 1) / min_range) };
+    if (num_ranges <= 1)
+    {
+        func(0u, count);
+        return;
+    }
+
+    const u32 range_size{ (count + num_ranges - 1) / num_ranges };
+    std::vector<std::thread> threads;
+    threads.reserve(num_ranges - 1);
+    for (u32 i{ 1 }; i < num_ranges; ++i)
+    {
+        const u32 begin{ i * range_size };
+        const u32 end{ std::min(count, begin + range_size) };
+        if (begin < end) threads.emplace_back([&func, begin, end]() { func(begin, end); });
+    }
+
+    func(0u, std::min(count, range_size));
+    for (auto& thread : threads) thread.join();
+}
@@ -0,0 +1,159 @@
+#include "VertexCompression.h"
+
+namespace nidhog::tools
+{
+    namespace
+    {
+        constexpr f32 inv_sqrt2{ 0.70710678f };
+        constexpr u32 quaternion_bits{ 10 };
+        constexpr u32 quaternion_mask{ (1 << quaternion_bits) - 1 };
+
+        f32 sign_not_zero(f32 f)
+        {
+            return f >= 0.f ? 1.f : -1.f;
+        }
+
+        math::v3 normalize(const math::v3& v)
+        {
+            const f32 length{ sqrtf(v.x * v.x + v.y * v.y + v.z * v.z) };
+            return length > 0.f ? math::v3{ v.x / length, v.y / length, v.z / length } : math::v3{ 0.f, 0.f, 1.f };
+        }
+
+        math::v3 cross(const math::v3& a, const math::v3& b)
+        {
+            return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+        }
+
+        f32 dot(const math::v3& a, const math::v3& b)
+        {
+            return a.x * b.x + a.y * b.y + a.z * b.z;
+        }
+    } // anonymous namespace
+
+    void encode_octahedral(const math::v3& v, u16& x, u16& y)
+    {
+        const f32 l1_norm{ fabsf(v.x) + fabsf(v.y) + fabsf(v.z) };
+        if (!(l1_norm > 0.f))
+        {
+            // NOTE: not a valid direction. (0, 0) decodes to (0, 0, 1).
+            x = y = (u16)math::pack_float<16>(0.f, -1.f, 1.f);
+            return;
+        }
+
+        f32 px{ v.x / l1_norm };
+        f32 py{ v.y / l1_norm };
+
+        if (v.z < 0.f)
+        {
+            // Fold the lower hemisphere over the diagonals.
+            const f32 fx{ (1.f - fabsf(py)) * sign_not_zero(px) };
+            const f32 fy{ (1.f - fabsf(px)) * sign_not_zero(py) };
+            px = fx;
+            py = fy;
+        }
+
+        x = (u16)math::pack_float<16>(math::clamp(px, -1.f, 1.f), -1.f, 1.f);
+        y = (u16)math::pack_float<16>(math::clamp(py, -1.f, 1.f), -1.f, 1.f);
+    }
+
+    math::v3 decode_octahedral(u16 x, u16 y)
+    {
+        math::v3 v{ math::unpack_to_float<16>(x, -1.f, 1.f), math::unpack_to_float<16>(y, -1.f, 1.f), 0.f };
+        v.z = 1.f - fabsf(v.x) - fabsf(v.y);
+        const f32 t{ math::clamp(-v.z, 0.f, 1.f) };
+        v.x += v.x >= 0.f ? -t : t;
+        v.y += v.y >= 0.f ? -t : t;
+        return normalize(v);
+    }
+
+    u32 encode_tbn_quaternion(const math::v3& normal, const math::v3& tangent)
+    {
+        // Build an orthonormal, right-handed frame. The columns of the rotation matrix are t, b and n.
+        const math::v3 n{ normalize(normal) };
+        const f32 t_dot_n{ dot(tangent, n) };
+        math::v3 t{ normalize({ tangent.x - n.x * t_dot_n, tangent.y - n.y * t_dot_n, tangent.z - n.z * t_dot_n }) };
+        if (fabsf(dot(t, n)) > 0.99f)
+        {
+            // NOTE: degenerate tangent (parallel to the normal). Any tangent will do.
+            t = normalize(cross(fabsf(n.x) < 0.9f ? math::v3{ 1.f, 0.f, 0.f } : math::v3{ 0.f, 1.f, 0.f }, n));
+        }
+        const math::v3 b{ cross(n, t) };
+
+        // Rotation matrix to quaternion (x, y, z, w).
+        f32 q[4];
+        const f32 trace{ t.x + b.y + n.z };
+        if (trace > 0.f)
+        {
+            const f32 s{ sqrtf(trace + 1.f) * 2.f };
+            q[3] = 0.25f * s;
+            q[0] = (b.z - n.y) / s;
+            q[1] = (n.x - t.z) / s;
+            q[2] = (t.y - b.x) / s;
+        }
+        else if (t.x > b.y && t.x > n.z)
+        {
+            const f32 s{ sqrtf(1.f + t.x - b.y - n.z) * 2.f };
+            q[3] = (b.z - n.y) / s;
+            q[0] = 0.25f * s;
+            q[1] = (b.x + t.y) / s;
+            q[2] = (n.x + t.z) / s;
+        }
+        else if (b.y > n.z)
+        {
+            const f32 s{ sqrtf(1.f + b.y - t.x - n.z) * 2.f };
+            q[3] = (n.x - t.z) / s;
+            q[0] = (b.x + t.y) / s;
+            q[1] = 0.25f * s;
+            q[2] = (n.y + b.z) / s;
+        }
+        else
+        {
+            const f32 s{ sqrtf(1.f + n.z - t.x - b.y) * 2.f };
+            q[3] = (t.y - b.x) / s;
+            q[0] = (n.x + t.z) / s;
+            q[1] = (n.y + b.z) / s;
+            q[2] = 0.25f * s;
+        }
+
+        u32 largest{ 0 };
+        for (u32 i{ 1 }; i < 4; ++i)
+        {
+            if (fabsf(q[i]) > fabsf(q[largest])) largest = i;
+        }
+
+        // NOTE: q and -q are the same rotation, so we flip the quaternion to make the largest component
+        //       positive. Then it can be reconstructed from the other three, which are all in [-1/sqrt(2), 1/sqrt(2)].
+        const f32 flip{ q[largest] < 0.f ? -1.f : 1.f };
+        u32 packed{ largest << (quaternion_bits * 3) };
+        u32 shift{ quaternion_bits * 2 };
+        for (u32 i{ 0 }; i < 4; ++i)
+        {
+            if (i == largest) continue;
+            const f32 c{ math::clamp(q[i] * flip, -inv_sqrt2, inv_sqrt2) };
+            packed |= math::pack_float<quaternion_bits>(c, -inv_sqrt2, inv_sqrt2) << shift;
+            shift -= quaternion_bits;
+        }
+
+        return packed;
+    }
+
+    void decode_tbn_quaternion(u32 packed, math::v3& normal, math::v3& tangent)
+    {
+        const u32 largest{ packed >> (quaternion_bits * 3) };
+        f32 q[4];
+        f32 sum{ 0.f };
+        u32 shift{ quaternion_bits * 2 };
+        for (u32 i{ 0 }; i < 4; ++i)
+        {
+            if (i == largest) continue;
+            q[i] = math::unpack_to_float<quaternion_bits>((packed >> shift) & quaternion_mask, -inv_sqrt2, inv_sqrt2);
+            sum += q[i] * q[i];
+            shift -= quaternion_bits;
+        }
+        q[largest] = sqrtf(std::max(0.f, 1.f - sum));
+
+        const f32 x{ q[0] }, y{ q[1] }, z{ q[2] }, w{ q[3] };
+        tangent = normalize({ 1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y) });
+        normal = normalize({ 2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y) });
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "ToolsCommon.h"
+
+namespace nidhog::tools
+{
+    // Octahedral encoding ("A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.):
+    // projects a unit vector onto an octahedron and folds the lower half over the upper one, so that it maps
+    // to the [-1, 1] square. Unlike storing x and y and the sign of z, the error is about the same everywhere.
+    void encode_octahedral(const math::v3& v, u16& x, u16& y);
+    [[nodiscard]] math::v3 decode_octahedral(u16 x, u16 y);
+
+    // Packs the rotation that takes the x, y and z axes to tangent, cross(normal, tangent) and normal into 32 bits.
+    // We use the "smallest three" method: 2 bits for the index of the largest component and 10 bits for each
+    // of the other three. Handedness of the bitangent isn't part of the rotation and has to be stored separately.
+    [[nodiscard]] u32 encode_tbn_quaternion(const math::v3& normal, const math::v3& tangent);
+    void decode_tbn_quaternion(u32 packed, math::v3& normal, math::v3& tangent);
+}
@@ -11,9 +11,22 @@
 #include <unordered_map>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
 
 #if defined(_WIN64)
 #include<DirectXMath.h>
+#else
+// NOTE: the MSVC functions and intrinsics the common headers use, for the code that also builds on other
+//       platforms (like the content importers). Needs SSE4.2, same as on Windows.
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+#ifndef _countof
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+inline void* _aligned_malloc(size_t size, size_t alignment) { return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1)); }
+inline void _aligned_free(void* p) { std::free(p); }
 #endif
 
 
@@ -2,10 +2,29 @@
 #include "Graphics/Renderer.h"
 #include "Utilities/IOStream.h"
 
+#ifdef _WIN64
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
 namespace nidhog::content
 {
     namespace 
     {
+        // NOTE: content that can't be loaded is reported here, also in release builds, because the caller only
+        //       gets an invalid id back.
+        void log_error(const char* const message)
+        {
+#ifdef _WIN64
+            OutputDebugStringA(message);
+#endif
+        }
+
         //ǰblobbut only used for output format
         class geometry_hierarchy_stream
         {
@@ -36,18 +55,6 @@ namespace nidhog::content
                 id_count = _lod_offsets[lod].count;
             }
 
-            u32 lod_from_threshold(f32 threshold)
-            {
-                assert(threshold > 0);
-                if (_lod_count == 1) return 0;
-                for (u32 i{ _lod_count - 1 }; i > 0; --i)
-                {
-                    if (_thresholds[i] <= threshold) return i;
-                }
-
-                assert(false); // shouldn't ever get here.
-                return 0;
-            }
 
             [[nodiscard]] constexpr u32 lod_count() const { return _lod_count; }
             [[nodiscard]] constexpr f32* thresholds() const { return _thresholds; }
@@ -62,24 +69,373 @@ namespace nidhog::content
             u32                 _lod_count;
         };
 
-        // NOTE: This is needed to maintain compatibility with STL vector.
-        struct noexcept_map 
+
+        // Table of blocks of block_size entries each, indexed by id. Blocks are allocated when the first entry
+        // in them is set and never move once they're published, so readers don't take any lock. Writers have to
+        // be serialized by the owner of the table.
+        // NOTE: there's only room for capacity entries. Writers check fits() before they set an entry, so
+        //       content that doesn't fit is rejected in release builds too.
+        template<typename block, u32 block_size, u32 max_blocks>
+        class block_table
+        {
+        public:
+            constexpr static u32 capacity{ block_size * max_blocks };
+
+            block_table() = default;
+            DISABLE_COPY_AND_MOVE(block_table);
+            ~block_table()
+            {
+                for (auto& b : _blocks)
+                {
+                    delete b.load(std::memory_order_relaxed);
+                }
+            }
+
+            [[nodiscard]] constexpr static bool fits(u32 index) { return index < capacity; }
+
+            // Returns the block that holds entry 'index', and allocates it if there's none yet.
+            block& get_or_create(u32 index)
+            {
+                assert(fits(index));
+                std::atomic<block*>& slot{ _blocks[index / block_size] };
+                block* b{ slot.load(std::memory_order_relaxed) };
+                if (!b)
+                {
+                    b = new block{};
+                    slot.store(b, std::memory_order_release);
+                }
+
+                return *b;
+            }
+
+            [[nodiscard]] const block& get(u32 index) const
+            {
+                assert(fits(index));
+                const block* const b{ _blocks[index / block_size].load(std::memory_order_acquire) };
+                assert(b);
+                return *b;
+            }
+
+        private:
+            std::atomic<block*>     _blocks[max_blocks]{};
+        };
+
+        // Flat SoA table of LOD thresholds and LOD offsets indexed by geometry content id.
+        // get_lod_offsets() runs every frame for every render item, so instead of chasing the
+        // hierarchy pointers we keep a copy of the thresholds in fixed-size, 16-byte aligned rows.
+        // Selecting a LOD is then a SIMD compare-and-count: LOD = number of thresholds[1..n) <= threshold.
+        //
+        // NOTE: storage is a block_table. Writers (create/destroy geometry) are serialized by geometry_mutex.
+        class geometry_lod_table
+        {
+        public:
+            constexpr static u32 max_lods{ 8 };             // two SSE registers worth of thresholds per geometry
+            constexpr static u32 block_size{ 4096 };        // number of geometries per block
+            constexpr static u32 max_blocks{ 1024 };        // up to 4M geometries
+            constexpr static u32 capacity{ block_size * max_blocks };
+
+            [[nodiscard]] constexpr static bool fits(id::id_type id) { return table::fits(id); }
+
+            // NOTE: call while holding geometry_mutex.
+            void set(id::id_type id, const f32* const thresholds, const lod_offset* const offsets, u32 lod_count)
+            {
+                assert(lod_count && lod_count <= max_lods);
+                block& b{ _blocks.get_or_create(id) };
+                const u32 row{ (id % block_size) * max_lods };
+                // thresholds[0] is never compared against (LOD 0 is the fallback), so we mark it and
+                // all unused slots with FLT_MAX which never passes the "threshold <= x" test.
+                b.thresholds[row] = FLT_MAX;
+                for (u32 i{ 1 }; i < max_lods; ++i)
+                {
+                    b.thresholds[row + i] = i < lod_count ? thresholds[i] : FLT_MAX;
+                }
+                // NOTE: unused slots point to the last LOD, so a threshold that passes every test (e.g. FLT_MAX or
+                //       +inf) still selects a valid LOD.
+                for (u32 i{ 0 }; i < max_lods; ++i)
+                {
+                    b.offsets[row + i] = offsets[std::min(i, lod_count - 1)];
+                }
+            }
+
+            // NOTE: call while holding geometry_mutex.
+            void set_single_mesh(id::id_type id)
+            {
+                constexpr lod_offset offset{ 0, 1 };
+                set(id, nullptr, &offset, 1);
+            }
+
+            void get_lod_offsets(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, lod_offset* const offsets) const
+            {
+                for (u32 i{ 0 }; i < id_count; ++i)
+                {
+                    const id::id_type id{ geometry_ids[i] };
+                    const block& b{ _blocks.get(id) };
+                    const u32 row{ (id % block_size) * max_lods };
+                    const f32* const t{ &b.thresholds[row] };
+                    assert(thresholds[i] > 0);
+
+                    const __m128 x{ _mm_set1_ps(thresholds[i]) };
+                    const u32 mask{ (u32)_mm_movemask_ps(_mm_cmple_ps(_mm_load_ps(t), x)) |
+                                    ((u32)_mm_movemask_ps(_mm_cmple_ps(_mm_load_ps(t + 4), x)) << 4) };
+                    // NOTE: thresholds[0] is FLT_MAX, so all 8 tests only pass for x >= FLT_MAX. Clamp to stay in the row.
+                    const u32 lod{ std::min((u32)_mm_popcnt_u32(mask), max_lods - 1) };
+                    offsets[i] = b.offsets[row + lod];
+                    assert(offsets[i].count);
+                }
+            }
+
+        private:
+            struct block
+            {
+                alignas(16) f32     thresholds[block_size * max_lods];
+                lod_offset          offsets[block_size * max_lods];
+            };
+
+            using table = block_table<block, block_size, max_blocks>;
+            table                   _blocks;
+        };
+
+        // Flat SoA table of mesh_bounds. Culling reads the same component of many items in a row, so every
+        // component has its own 16-byte aligned array that can be loaded several entries at a time.
+        // NOTE: storage is a block_table, like geometry_lod_table. Writers are serialized by geometry_mutex.
+        class bounds_table
         {
-            std::unordered_map<u32, std::unique_ptr<u8[]>> map;
-            noexcept_map() = default;
-            noexcept_map(const noexcept_map&) = default;
-            noexcept_map(noexcept_map&&) noexcept = default;
-            noexcept_map& operator=(const noexcept_map&) = default;
-            noexcept_map& operator=(noexcept_map&&) noexcept = default;
+        public:
+            constexpr static u32 block_size{ 4096 };        // number of entries per block
+            constexpr static u32 max_blocks{ 8192 };        // up to 32M entries
+
+            [[nodiscard]] constexpr static bool fits(u32 index) { return table::fits(index); }
+
+            // NOTE: call while holding geometry_mutex.
+            void set(u32 index, const mesh_bounds& bounds)
+            {
+                block& b{ _blocks.get_or_create(index) };
+                const u32 i{ index % block_size };
+                b.aabb_center_x[i] = bounds.aabb_center.x;
+                b.aabb_center_y[i] = bounds.aabb_center.y;
+                b.aabb_center_z[i] = bounds.aabb_center.z;
+                b.aabb_extents_x[i] = bounds.aabb_extents.x;
+                b.aabb_extents_y[i] = bounds.aabb_extents.y;
+                b.aabb_extents_z[i] = bounds.aabb_extents.z;
+                b.sphere_center_x[i] = bounds.sphere_center.x;
+                b.sphere_center_y[i] = bounds.sphere_center.y;
+                b.sphere_center_z[i] = bounds.sphere_center.z;
+                b.sphere_radius[i] = bounds.sphere_radius;
+                b.lod_error[i] = bounds.lod_error;
+            }
+
+            void get(u32 index, mesh_bounds& bounds) const
+            {
+                const block& b{ _blocks.get(index) };
+                const u32 i{ index % block_size };
+                bounds.aabb_center = { b.aabb_center_x[i], b.aabb_center_y[i], b.aabb_center_z[i] };
+                bounds.aabb_extents = { b.aabb_extents_x[i], b.aabb_extents_y[i], b.aabb_extents_z[i] };
+                bounds.sphere_center = { b.sphere_center_x[i], b.sphere_center_y[i], b.sphere_center_z[i] };
+                bounds.sphere_radius = b.sphere_radius[i];
+                bounds.lod_error = b.lod_error[i];
+            }
+
+        private:
+            struct block
+            {
+                alignas(16) f32     aabb_center_x[block_size];
+                alignas(16) f32     aabb_center_y[block_size];
+                alignas(16) f32     aabb_center_z[block_size];
+                alignas(16) f32     aabb_extents_x[block_size];
+                alignas(16) f32     aabb_extents_y[block_size];
+                alignas(16) f32     aabb_extents_z[block_size];
+                alignas(16) f32     sphere_center_x[block_size];
+                alignas(16) f32     sphere_center_y[block_size];
+                alignas(16) f32     sphere_center_z[block_size];
+                alignas(16) f32     sphere_radius[block_size];
+                alignas(16) f32     lod_error[block_size];
+            };
+
+            using table = block_table<block, block_size, max_blocks>;
+            table                   _blocks;
         };
 
+        // Reads the bounds that every submesh starts with (see create_geometry_resource()).
+        mesh_bounds read_submesh_bounds(utl::blob_stream_reader& blob)
+        {
+            math::v3 aabb_min{}, aabb_max{};
+            mesh_bounds bounds{};
+            blob.read((u8*)&aabb_min, sizeof(math::v3));
+            blob.read((u8*)&aabb_max, sizeof(math::v3));
+            blob.read((u8*)&bounds.sphere_center, sizeof(math::v3));
+            bounds.sphere_radius = blob.read<f32>();
+            bounds.lod_error = blob.read<f32>();
+            bounds.aabb_center = { (aabb_min.x + aabb_max.x) * 0.5f, (aabb_min.y + aabb_max.y) * 0.5f, (aabb_min.z + aabb_max.z) * 0.5f };
+            bounds.aabb_extents = { (aabb_max.x - aabb_min.x) * 0.5f, (aabb_max.y - aabb_min.y) * 0.5f, (aabb_max.z - aabb_min.z) * 0.5f };
+            return bounds;
+        }
+
+        // Grows 'bounds' so it also contains 'other', for the bounds of a whole LOD. The error of a LOD is the
+        // largest error of its submeshes.
+        void merge_bounds(mesh_bounds& bounds, const mesh_bounds& other)
+        {
+            using namespace DirectX;
+            const XMVECTOR center{ XMLoadFloat3(&bounds.aabb_center) };
+            const XMVECTOR extents{ XMLoadFloat3(&bounds.aabb_extents) };
+            const XMVECTOR other_center{ XMLoadFloat3(&other.aabb_center) };
+            const XMVECTOR other_extents{ XMLoadFloat3(&other.aabb_extents) };
+            const XMVECTOR min{ XMVectorMin(center - extents, other_center - other_extents) };
+            const XMVECTOR max{ XMVectorMax(center + extents, other_center + other_extents) };
+            XMStoreFloat3(&bounds.aabb_center, (min + max) * 0.5f);
+            XMStoreFloat3(&bounds.aabb_extents, (max - min) * 0.5f);
+
+            // Smallest sphere that contains both spheres.
+            const XMVECTOR c0{ XMLoadFloat3(&bounds.sphere_center) };
+            const XMVECTOR c1{ XMLoadFloat3(&other.sphere_center) };
+            const f32 r0{ bounds.sphere_radius };
+            const f32 r1{ other.sphere_radius };
+            const f32 distance{ XMVectorGetX(XMVector3Length(c1 - c0)) };
+            if (distance + r0 <= r1)
+            {
+                bounds.sphere_center = other.sphere_center;
+                bounds.sphere_radius = r1;
+            }
+            else if (distance + r1 > r0)
+            {
+                const f32 radius{ (distance + r0 + r1) * 0.5f };
+                XMStoreFloat3(&bounds.sphere_center, c0 + (c1 - c0) * ((radius - r0) / distance));
+                bounds.sphere_radius = radius;
+            }
+
+            bounds.lod_error = std::max(bounds.lod_error, other.lod_error);
+        }
+
         // geometry_hierarchies еgpu_id, Ǹpointer
         constexpr uintptr_t                         single_mesh_marker{ (uintptr_t)0x01 };
-        utl::free_list<u8*>                         geometry_hierarchies;
+        // NOTE: writers are serialized by geometry_mutex. Readers don't lock: hierarchy buffers are retired
+        //       through geometry_epoch, so they stay valid while a reader is still inside an epoch_guard.
+        // NOTE: hierarchy buffers are small and live as long as their geometry, so they come from a slab
+        //       allocator. That keeps hierarchies of similar size next to each other in memory.
+        utl::slab_allocator                         hierarchy_allocator;
+        utl::paged_free_list<u8*>                   geometry_hierarchies;
         std::mutex                                  geometry_mutex;
+        utl::epoch_manager                          geometry_epoch;
+        geometry_lod_table                          geometry_lods;
+        bounds_table                                submesh_bounds;     // indexed by submesh gpu id
+        bounds_table                                lod_bounds;         // indexed by lod_bounds_index()
+
+        constexpr u32 lod_bounds_index(id::id_type geometry_id, u32 lod)
+        {
+            assert(lod < geometry_lod_table::max_lods);
+            return geometry_id * geometry_lod_table::max_lods + lod;
+        }
+
+        // NOTE: every geometry that fits in geometry_lods also has room for the bounds of all of its LODs.
+        static_assert(bounds_table::fits(lod_bounds_index(geometry_lod_table::capacity - 1, geometry_lod_table::max_lods - 1)));
+
+        // Returns false if a geometry doesn't fit in the tables above, which only happens with millions of
+        // geometries or submeshes. The caller then has to undo what it created.
+        // NOTE: call while holding geometry_mutex.
+        bool fits_in_tables(id::id_type id, const id::id_type* const gpu_ids, u32 gpu_id_count)
+        {
+            if (!geometry_lod_table::fits(id)) return false;
+            for (u32 i{ 0 }; i < gpu_id_count; ++i)
+            {
+                if (!bounds_table::fits(gpu_ids[i])) return false;
+            }
+
+            return true;
+        }
 
-        utl::free_list<noexcept_map>                shader_groups;
+        // Shader groups are immutable once they're added, so each group is baked into one contiguous blob:
+        //
+        // struct {
+        //     u32  shader_count,
+        //     u32  keys[shader_count],        // sorted in ascending order
+        //     u32  offsets[shader_count],     // offset of each compiled_shader from the start of the blob
+        //     u8   shaders[]                  // compiled_shaders, each one aligned to 8 bytes
+        // } shader_group
+        //
+        // Pointers to the blobs are published in a fixed-size table. Adding and removing groups is
+        // serialized by shader_mutex, while get_shader() doesn't block: one acquire-load and a binary search.
+        // Removed blobs are retired through shader_epoch, like geometry hierarchies.
+        constexpr u32                               max_shader_groups{ 4096 };
+        std::atomic<const u8*>                      shader_groups[max_shader_groups]{};
+        utl::vector<id::id_type>                    free_shader_group_ids;
+        u32                                         shader_group_slots_used{ 0 };
         std::mutex                                  shader_mutex;
+        utl::epoch_manager                          shader_epoch;
+
+        class shader_group_stream
+        {
+        public:
+            DISABLE_COPY_AND_MOVE(shader_group_stream);
+            explicit shader_group_stream(const u8* const buffer)
+                : _buffer{ buffer }
+            {
+                assert(buffer);
+                _shader_count = *(const u32*)buffer;
+                _keys = (const u32*)(&buffer[sizeof(u32)]);
+                _offsets = &_keys[_shader_count];
+            }
+
+            [[nodiscard]] compiled_shader_ptr find(u32 shader_key) const
+            {
+                // lower bound over the sorted keys
+                u32 first{ 0 };
+                u32 count{ _shader_count };
+                while (count)
+                {
+                    const u32 step{ count >> 1 };
+                    if (_keys[first + step] < shader_key)
+                    {
+                        first += step + 1;
+                        count -= step + 1;
+                    }
+                    else
+                    {
+                        count = step;
+                    }
+                }
+
+                return (first < _shader_count && _keys[first] == shader_key) ?
+                    (compiled_shader_ptr)(&_buffer[_offsets[first]]) : nullptr;
+            }
+
+            [[nodiscard]] constexpr static u32 header_size(u32 shader_count)
+            {
+                return (u32)math::align_size_up<sizeof(u64)>(sizeof(u32) + 2 * sizeof(u32) * (u64)shader_count);
+            }
+
+        private:
+            const u8* const     _buffer;
+            const u32*          _keys;
+            const u32*          _offsets;
+            u32                 _shader_count;
+        };
+
+        constexpr u32 geometry_header_size{ sizeof(u32) * 2 };   // format tag and version
+
+        // Returns false for geometry data that's in another format than create_geometry_resource() expects, e.g.
+        // because it was packed by an older editor, and for geometries with more LODs than the LOD table supports.
+        // That data isn't even hashed for the content cache, so it has to be checked before anything else.
+        bool is_supported_geometry(const void* const data)
+        {
+            assert(data);
+            utl::blob_stream_reader blob{ (const u8*)data };
+            const u32 tag{ blob.read<u32>() };
+            const u32 version{ blob.read<u32>() };
+            if (tag != geometry_format::tag || version != geometry_format::version)
+            {
+                log_error("Error: can't create geometry, its data is in an old or unknown format. Import it again.\n");
+                return false;
+            }
+
+            // NOTE: the LOD table has room for max_lods LODs per geometry. Geometries with more LODs are rejected
+            //       rather than cut off, because the thresholds of the missing LODs would be lost.
+            if (blob.read<u32>() > geometry_lod_table::max_lods)
+            {
+                log_error("Error: can't create geometry, it has more LODs than the LOD table supports.\n");
+                return false;
+            }
+
+            return true;
+        }
 
         // NOTE: expects the same data as create_geometry_resource()
         u32 get_geometry_hierarchy_buffer_size(const void* const data)
@@ -87,6 +443,7 @@ namespace nidhog::content
             assert(data);
             //blobȡ
             utl::blob_stream_reader blob{ (const u8*)data };
+            blob.skip(geometry_header_size);
             const u32 lod_count{ blob.read<u32>() };
             assert(lod_count);
             // add size of  lod_count, thresholds and lod offsets to the size of hierarchy.
@@ -111,14 +468,17 @@ namespace nidhog::content
         {
             assert(data);
             const u32 size{ get_geometry_hierarchy_buffer_size(data) };
-            u8* const hierarchy_buffer{ (u8* const)malloc(size) };
+            u8* const hierarchy_buffer{ (u8* const)hierarchy_allocator.allocate(size) };
 
             utl::blob_stream_reader blob{ (const u8*)data };
+            blob.skip(geometry_header_size);
             const u32 lod_count{ blob.read<u32>() };
-            assert(lod_count);
+            assert(lod_count && lod_count <= geometry_lod_table::max_lods);
             geometry_hierarchy_stream stream{ hierarchy_buffer, lod_count };
             u32 submesh_index{ 0 };
             id::id_type* const gpu_ids{ stream.gpu_ids() };
+            utl::vector<mesh_bounds> bounds;
+            mesh_bounds lod_bounds_of[geometry_lod_table::max_lods]{};
 
             for (u32 lod_idx{ 0 }; lod_idx < lod_count; ++lod_idx)
             {
@@ -129,6 +489,10 @@ namespace nidhog::content
                 blob.skip(sizeof(u32)); // skip over size_of_submeshes
                 for (u32 id_idx{ 0 }; id_idx < id_count; ++id_idx)
                 {
+                    const mesh_bounds& submesh{ bounds.emplace_back(read_submesh_bounds(blob)) };
+                    if (id_idx) merge_bounds(lod_bounds_of[lod_idx], submesh);
+                    else lod_bounds_of[lod_idx] = submesh;
+
                     const u8* at{ blob.position() };
                     gpu_ids[submesh_index++] = graphics::add_submesh(at);
                     blob.skip((u32)(at - blob.position()));
@@ -149,8 +513,24 @@ namespace nidhog::content
             //ڷ64λƽ̨
             static_assert(alignof(void*) > 2, "We need the least significant bit for the single mesh marker.");
             //̱߳⾺
-            std::lock_guard lock{ geometry_mutex };
-            return geometry_hierarchies.add(hierarchy_buffer);
+            {
+                std::lock_guard lock{ geometry_mutex };
+                const id::id_type id{ geometry_hierarchies.add(hierarchy_buffer) };
+                if (fits_in_tables(id, gpu_ids, submesh_index))
+                {
+                    geometry_lods.set(id, stream.thresholds(), stream.lod_offsets(), lod_count);
+                    for (u32 i{ 0 }; i < submesh_index; ++i) submesh_bounds.set(gpu_ids[i], bounds[i]);
+                    for (u32 i{ 0 }; i < lod_count; ++i) lod_bounds.set(lod_bounds_index(id, i), lod_bounds_of[i]);
+                    return id;
+                }
+
+                geometry_hierarchies.remove(id);
+            }
+
+            log_error("Error: can't create geometry, the geometry tables are full.\n");
+            for (u32 i{ 0 }; i < submesh_index; ++i) graphics::remove_submesh(gpu_ids[i]);
+            hierarchy_allocator.deallocate(hierarchy_buffer);
+            return id::invalid_id;
         }
 
         // Creates a single submesh gpu_id
@@ -160,8 +540,9 @@ namespace nidhog::content
         {
             assert(data);
             utl::blob_stream_reader blob{ (const u8*)data };
-            // skip lod_count, lod_threshold, submesh_count and size_of_submeshes
-            blob.skip(sizeof(u32) + sizeof(f32) + sizeof(u32) + sizeof(u32));
+            // skip the header, lod_count, lod_threshold, submesh_count and size_of_submeshes
+            blob.skip(geometry_header_size + sizeof(u32) + sizeof(f32) + sizeof(u32) + sizeof(u32));
+            const mesh_bounds bounds{ read_submesh_bounds(blob) };
             const u8* at{ blob.position() };
             const id::id_type gpu_id{ graphics::add_submesh(at) };
 
@@ -170,8 +551,23 @@ namespace nidhog::content
             constexpr u8 shift_bits{ (sizeof(uintptr_t) - sizeof(id::id_type)) << 3 };
             u8* const fake_pointer{ (u8* const)((((uintptr_t)gpu_id) << shift_bits) | single_mesh_marker) };
             //̱߳⾺
-            std::lock_guard lock{ geometry_mutex };
-            return geometry_hierarchies.add(fake_pointer);
+            {
+                std::lock_guard lock{ geometry_mutex };
+                const id::id_type id{ geometry_hierarchies.add(fake_pointer) };
+                if (fits_in_tables(id, &gpu_id, 1))
+                {
+                    geometry_lods.set_single_mesh(id);
+                    submesh_bounds.set(gpu_id, bounds);
+                    lod_bounds.set(lod_bounds_index(id, 0), bounds);
+                    return id;
+                }
+
+                geometry_hierarchies.remove(id);
+            }
+
+            log_error("Error: can't create geometry, the geometry tables are full.\n");
+            graphics::remove_submesh(gpu_id);
+            return id::invalid_id;
         }
 
         // Determine if this geometry has a single lod with a single submesh
@@ -181,6 +577,7 @@ namespace nidhog::content
             //check if 1 more LOD
             assert(data);
             utl::blob_stream_reader blob{ (const u8*)data };
+            blob.skip(geometry_header_size);
             const u32 lod_count{ blob.read<u32>() };
             assert(lod_count);
             if (lod_count > 1) return false;
@@ -202,17 +599,24 @@ namespace nidhog::content
 
         // NOTE: dataһ
         // struct{
+        //     u32 format_tag,                                           // geometry_format::tag
+        //     u32 format_version,                                       // geometry_format::version
         //     u32 lod_count,
         //     struct {
         //         f32 lod_threshold,
         //         u32 submesh_count,
         //         u32 size_of_submeshes,
         //         struct {
+        //             f32 bounds_min[3], f32 bounds_max[3],             // tight AABB of the vertices
+        //             f32 sphere_center[3], f32 sphere_radius,
+        //             f32 lod_error,                                    // geometric error compared to LOD 0
         //             u32 element_size, u32 vertex_count,
         //             u32 index_count, u32 elements_type, u32 primitive_topology
-        //             u8 positions[sizeof(f32) * 3 * vertex_count],     // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
+        //             f32 aabb_min[3], f32 aabb_max[3],                 // only for quantized positions.
+        //             u8 positions[position_size * vertex_count],       // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
         //             u8 elements[sizeof(element_size) * vertex_count], // sizeof(elements) must be a multiple of 4 bytes. Pad if needed.
-        //             u8 indices[index_size * index_count]
+        //             u8 indices[index_size * index_count],
+        //             u8 meshlets[]                                     // optional, see d3d12::content::submesh::add()
         //         } submeshes[submesh_count]
         //     } mesh_lods[lod_count]
         // } geometry;
@@ -242,7 +646,7 @@ namespace nidhog::content
         //
         id::id_type create_geometry_resource(const void* const data)
         {
-            assert(data);
+            assert(data && is_supported_geometry(data));
             return is_single_mesh(data) ? create_single_submesh(data) : create_mesh_hierarchy(data);
         }
         //Destroy all sub meshs and free allocated memory block
@@ -266,11 +670,13 @@ namespace nidhog::content
                         graphics::remove_submesh(stream.gpu_ids()[id_index++]);
                     }
                 }
-
-                free(pointer);
             }
 
             geometry_hierarchies.remove(id);
+            if (!((uintptr_t)pointer & single_mesh_marker))
+            {
+                geometry_epoch.retire(pointer, [](void* p) { hierarchy_allocator.deallocate(p); });
+            }
         }
 
         // NOTE: expects data to contain
@@ -291,6 +697,336 @@ namespace nidhog::content
             graphics::remove_material(id);
         }
 
+        // NOTE: expect shaders to be an array of pointers to compiled_shaders
+        id::id_type create_shader_group(const u8* const* shaders, u32 num_shaders, const u32* const keys)
+        {
+            assert(shaders && num_shaders && keys);
+
+            // Sort the shaders by key, so lookups can use a binary search.
+            utl::vector<u32> order(num_shaders);
+            for (u32 i{ 0 }; i < num_shaders; ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [keys](u32 a, u32 b) { return keys[a] < keys[b]; });
+
+            u64 size{ shader_group_stream::header_size(num_shaders) };
+            for (u32 i{ 0 }; i < num_shaders; ++i)
+            {
+                assert(shaders[i]);
+                assert(!i || keys[order[i - 1]] != keys[order[i]]); // keys must be unique within a group.
+                size += math::align_size_up<sizeof(u64)>(((const compiled_shader_ptr)shaders[i])->buffer_size());
+            }
+
+            assert(size < u32_invalid_id);
+            u8* const buffer{ new u8[size] };
+            u32* const group_keys{ (u32*)(&buffer[sizeof(u32)]) };
+            u32* const group_offsets{ &group_keys[num_shaders] };
+            *(u32*)buffer = num_shaders;
+
+            u32 offset{ shader_group_stream::header_size(num_shaders) };
+            for (u32 i{ 0 }; i < num_shaders; ++i)
+            {
+                const u8* const shader{ shaders[order[i]] };
+                const u64 shader_size{ ((const compiled_shader_ptr)shader)->buffer_size() };
+                group_keys[i] = keys[order[i]];
+                group_offsets[i] = offset;
+                memcpy(&buffer[offset], shader, shader_size);
+                offset += (u32)math::align_size_up<sizeof(u64)>(shader_size);
+            }
+
+            assert(offset == size);
+
+            std::lock_guard lock{ shader_mutex };
+            id::id_type id{ id::invalid_id };
+            if (free_shader_group_ids.empty())
+            {
+                if (shader_group_slots_used == max_shader_groups)
+                {
+                    log_error("Error: can't add shader group, all shader group slots are used.\n");
+                    delete[] buffer;
+                    return id::invalid_id;
+                }
+
+                id = shader_group_slots_used++;
+            }
+            else
+            {
+                id = free_shader_group_ids.back();
+                utl::erase_unordered(free_shader_group_ids, free_shader_group_ids.size() - 1);
+            }
+
+            shader_groups[id].store(buffer, std::memory_order_release);
+            return id;
+        }
+
+        // NOTE: removing a shader group that's still used by a material (or during a PSO build) is an error,
+        //       because get_shader() hands out pointers into the group's buffer. The buffer itself is retired,
+        //       so a get_shader() call that's still searching it doesn't read freed memory.
+        void destroy_shader_group(id::id_type id)
+        {
+            std::lock_guard lock{ shader_mutex };
+            assert(id::is_valid(id) && id < shader_group_slots_used);
+            const u8* const buffer{ shader_groups[id].exchange(nullptr, std::memory_order_acq_rel) };
+            assert(buffer);
+            shader_epoch.retire((void*)buffer, [](void* p) { delete[] (u8*)p; });
+            free_shader_group_ids.emplace_back(id);
+        }
+
+        // 128-bit hash of some content.
+        struct content_hash
+        {
+            u64 low;
+            u64 high;
+        };
+
+        // Identifies a resource by its content rather than by the address of its data.
+        // NOTE: we don't keep a copy of the content (for geometry that would double the memory of every mesh),
+        //       so two resources are the same if their sizes and 128-bit hashes are the same.
+        struct content_key
+        {
+            u64             size;
+            content_hash    hash;
+        };
+
+        constexpr u64 rotate_left(u64 x, u32 bits) { return (x << bits) | (x >> (64 - bits)); }
+
+        constexpr u64 hash_finalize(u64 k)
+        {
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdull;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ull;
+            k ^= k >> 33;
+            return k;
+        }
+
+        // MurmurHash3_x64_128. It isn't cryptographic, but with 128 bits accidental collisions between different
+        // content are far less likely than, say, a bit flip in memory.
+        content_hash hash_bytes(const u8* const data, u64 size, u64 seed = 0)
+        {
+            assert(data || !size);
+            constexpr u64 c1{ 0x87c37b91114253d5ull };
+            constexpr u64 c2{ 0x4cf5ad432745937full };
+            const auto mix_k1 = [](u64 k) { k *= c1; k = rotate_left(k, 31); return k * c2; };
+            const auto mix_k2 = [](u64 k) { k *= c2; k = rotate_left(k, 33); return k * c1; };
+            u64 h1{ seed };
+            u64 h2{ seed };
+
+            const u8* at{ data };
+            const u8* const end{ data + math::align_size_down<2 * sizeof(u64)>(size) };
+            while (at < end)
+            {
+                u64 k1, k2;
+                memcpy(&k1, at, sizeof(u64));
+                memcpy(&k2, at + sizeof(u64), sizeof(u64));
+                h1 ^= mix_k1(k1);
+                h1 = rotate_left(h1, 27) + h2;
+                h1 = h1 * 5 + 0x52dce729;
+                h2 ^= mix_k2(k2);
+                h2 = rotate_left(h2, 31) + h1;
+                h2 = h2 * 5 + 0x38495ab5;
+                at += 2 * sizeof(u64);
+            }
+
+            // NOTE: the tail is read as little-endian, which is what the byte-wise reference implementation does.
+            const u64 tail_size{ size & (2 * sizeof(u64) - 1) };
+            if (tail_size > sizeof(u64))
+            {
+                u64 k2{ 0 };
+                memcpy(&k2, at + sizeof(u64), tail_size - sizeof(u64));
+                h2 ^= mix_k2(k2);
+            }
+
+            if (tail_size)
+            {
+                u64 k1{ 0 };
+                memcpy(&k1, at, std::min(tail_size, (u64)sizeof(u64)));
+                h1 ^= mix_k1(k1);
+            }
+
+            h1 ^= size;
+            h2 ^= size;
+            h1 += h2;
+            h2 += h1;
+            h1 = hash_finalize(h1);
+            h2 = hash_finalize(h2);
+            h1 += h2;
+            h2 += h1;
+            return { h1, h2 };
+        }
+
+        // Maps content to one engine resource and keeps track of how many times it was created.
+        // NOTE: the same content always results in the same id, as long as there's at least one reference to it.
+        //       Entries are found by the low half of the content hash and told apart by the size and the high half.
+        class resource_cache
+        {
+        public:
+            // Returns the id of an existing resource and adds a reference to it, or invalid_id if there's none.
+            id::id_type acquire(content_key key)
+            {
+                std::lock_guard lock{ _mutex };
+                entry* const e{ find(key) };
+                if (!e) return id::invalid_id;
+                ++e->ref_count;
+                return e->id;
+            }
+
+            // Adds a newly created resource. If another thread added the same content in the meantime,
+            // then the existing id is returned and the caller should destroy its own resource.
+            id::id_type add(content_key key, id::id_type id)
+            {
+                assert(id::is_valid(id));
+                std::lock_guard lock{ _mutex };
+                if (entry* const e{ find(key) })
+                {
+                    ++e->ref_count;
+                    return e->id;
+                }
+
+                _entries.emplace(key.hash.low, entry{ id, 1, key.size, key.hash.high });
+                assert(_keys.find(id) == _keys.end());
+                _keys[id] = key.hash.low;
+                return id;
+            }
+
+            // Removes a reference. Returns true if this was the last one and the resource should be destroyed.
+            bool release(id::id_type id)
+            {
+                std::lock_guard lock{ _mutex };
+                auto key = _keys.find(id);
+                assert(key != _keys.end());
+                if (key == _keys.end()) return false;
+
+                auto [first, last] = _entries.equal_range(key->second);
+                auto pair = std::find_if(first, last, [id](const auto& p) { return p.second.id == id; });
+                assert(pair != last && pair->second.ref_count);
+                if (--pair->second.ref_count) return false;
+
+                _entries.erase(pair);
+                _keys.erase(key);
+                return true;
+            }
+
+        private:
+            struct entry
+            {
+                id::id_type             id;
+                u32                     ref_count;
+                u64                     size;
+                u64                     hash_high;
+            };
+
+            // NOTE: call while holding _mutex.
+            entry* find(content_key key)
+            {
+                auto [first, last] = _entries.equal_range(key.hash.low);
+                for (auto pair = first; pair != last; ++pair)
+                {
+                    entry& e{ pair->second };
+                    if (e.size == key.size && e.hash_high == key.hash.high) return &e;
+                }
+
+                return nullptr;
+            }
+
+            std::unordered_multimap<u64, entry>     _entries;   // by the low half of the content hash
+            std::unordered_map<id::id_type, u64>    _keys;      // low half of the content hash of every resource
+            std::mutex                              _mutex;
+        };
+
+        resource_cache                              geometry_cache;
+        resource_cache                              material_cache;
+        resource_cache                              shader_group_cache;
+
+        // Creating a resource happens outside of the cache lock (the same way we create PSOs),
+        // because uploading geometry can take a while.
+        template<typename create_function, typename destroy_function>
+        id::id_type get_or_create(resource_cache& cache, content_key key, create_function&& create, destroy_function&& destroy)
+        {
+            id::id_type id{ cache.acquire(key) };
+            if (id::is_valid(id)) return id;
+
+            const id::id_type new_id{ create() };
+            // NOTE: the content was rejected, e.g. because it's in a format we don't support.
+            if (!id::is_valid(new_id)) return id::invalid_id;
+
+            id = cache.add(key, new_id);
+            if (id != new_id)
+            {
+                // Someone beat us to it. Keep theirs.
+                destroy(new_id);
+            }
+
+            return id;
+        }
+
+        // NOTE: expects the same data as create_geometry_resource()
+        u64 get_geometry_data_size(const void* const data)
+        {
+            assert(data);
+            utl::blob_stream_reader blob{ (const u8*)data };
+            blob.skip(geometry_header_size);
+            const u32 lod_count{ blob.read<u32>() };
+            assert(lod_count);
+            for (u32 lod_idx{ 0 }; lod_idx < lod_count; ++lod_idx)
+            {
+                // skip threshold and submesh_count
+                blob.skip(sizeof(f32) + sizeof(u32));
+                blob.skip(blob.read<u32>());
+            }
+
+            return blob.offset();
+        }
+
+        content_key geometry_content_key(const void* const data)
+        {
+            const u64 size{ get_geometry_data_size(data) };
+            return { size, hash_bytes((const u8*)data, size) };
+        }
+
+        // Appends the bytes of 'value' to the content of a key.
+        void append_content(utl::vector<u8>& content, const void* const value, u64 size)
+        {
+            if (!size) return;
+            const u64 offset{ content.size() };
+            content.resize(offset + size);
+            memcpy(&content[offset], value, size);
+        }
+
+        // NOTE: materials are compared by value. Shader ids are already deduplicated by the shader group
+        //       cache, so two identical materials that use identical shaders have identical keys.
+        //       'content' is scratch memory for the bytes that are hashed.
+        content_key material_content_key(const void* const data, utl::vector<u8>& content)
+        {
+            const graphics::material_init_info& info{ *(const graphics::material_init_info* const)data };
+            content.clear();
+            append_content(content, &info.type, sizeof(info.type));
+            append_content(content, &info.texture_count, sizeof(info.texture_count));
+            append_content(content, &info.shader_ids[0], sizeof(info.shader_ids));
+            append_content(content, info.texture_ids, sizeof(id::id_type) * info.texture_count);
+            return { content.size(), hash_bytes(content.data(), content.size()) };
+        }
+
+        // NOTE: each compiled shader already carries a 128-bit hash of its byte code, so we compare the hashes
+        //       rather than the byte code. The shaders are sorted by key, because the order in which they're passed
+        //       doesn't matter for the group (see create_shader_group()).
+        //       'content' is scratch memory for the bytes that are hashed.
+        content_key shader_group_content_key(const u8* const* shaders, u32 num_shaders, const u32* const keys, utl::vector<u8>& content)
+        {
+            utl::vector<u32> order(num_shaders);
+            for (u32 i{ 0 }; i < num_shaders; ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [keys](u32 a, u32 b) { return keys[a] < keys[b]; });
+
+            content.clear();
+            for (u32 i{ 0 }; i < num_shaders; ++i)
+            {
+                const compiled_shader_ptr shader{ (const compiled_shader_ptr)shaders[order[i]] };
+                const u64 byte_code_size{ shader->byte_code_size() };
+                append_content(content, &keys[order[i]], sizeof(u32));
+                append_content(content, &byte_code_size, sizeof(byte_code_size));
+                append_content(content, shader->hash(), compiled_shader::hash_length);
+            }
+
+            return { content.size(), hash_bytes(content.data(), content.size()) };
+        }
 
     } // anonymous namespace
 
@@ -304,13 +1040,22 @@ namespace nidhog::content
         {
         case asset_type::animation:                                     break;
         case asset_type::audio:	                                        break;
-        case asset_type::material: id = create_material_resource(data); break;
-        case asset_type::mesh:	id = create_geometry_resource(data);    break;
+        case asset_type::material:
+        {
+            utl::vector<u8> content;
+            id = get_or_create(material_cache, material_content_key(data, content),
+                               [data]() { return create_material_resource(data); }, destroy_material_resource);
+        }
+            break;
+        case asset_type::mesh:
+            if (!is_supported_geometry(data)) break;
+            id = get_or_create(geometry_cache, geometry_content_key(data),
+                               [data]() { return create_geometry_resource(data); }, destroy_geometry_resource);
+            break;
         case asset_type::skeleton:                                      break;
         case asset_type::texture:                                       break;
         }
 
-        assert(id::is_valid(id));
         return id;
     }
 
@@ -321,8 +1066,8 @@ namespace nidhog::content
         {
         case asset_type::animation: break;
         case asset_type::audio:	break;
-        case asset_type::material: destroy_material_resource(id);  break;
-        case asset_type::mesh:	destroy_geometry_resource(id); break;
+        case asset_type::material: if (material_cache.release(id)) destroy_material_resource(id);  break;
+        case asset_type::mesh:	if (geometry_cache.release(id)) destroy_geometry_resource(id); break;
         case asset_type::skeleton: break;
         case asset_type::texture: break;
         default:
@@ -331,52 +1076,38 @@ namespace nidhog::content
         }
     }
     // NOTE: expect shaders to be an array of pointers to compiled_shaders
-    // NOTE: the editor is responsible for making sure that there are no duplicate shaders. If there are, we'll happily add them!
+    // NOTE: identical shader groups are only added once. Every call to add_shader_group() should be matched by
+    //       a call to remove_shader_group(), and the group is removed when the last reference is removed.
+    //       Returns id::invalid_id if all max_shader_groups slots are used.
     id::id_type add_shader_group(const u8* const* shaders, u32 num_shaders, const u32* const keys)
     {
         assert(shaders && num_shaders && keys);
-        noexcept_map group;
-        for (u32 i{ 0 }; i < num_shaders; ++i)
-        {
-            assert(shaders[i]);
-            const compiled_shader_ptr shader_ptr{ (const compiled_shader_ptr)shaders[i] };
-            const u64 size{ shader_ptr->buffer_size() };
-            std::unique_ptr<u8[]> shader{ std::make_unique<u8[]>(size) };
-            memcpy(shader.get(), shaders[i], size);
-            group.map[keys[i]] = std::move(shader);
-        }
-        std::lock_guard lock{ shader_mutex };
-        return shader_groups.add(std::move(group));
+        utl::vector<u8> content;
+        return get_or_create(shader_group_cache, shader_group_content_key(shaders, num_shaders, keys, content),
+                             [=]() { return create_shader_group(shaders, num_shaders, keys); }, destroy_shader_group);
     }
 
     void remove_shader_group(id::id_type id)
     {
-        std::lock_guard lock{ shader_mutex };
         assert(id::is_valid(id));
-        shader_groups[id].map.clear();
-        shader_groups.remove(id);
+        if (shader_group_cache.release(id)) destroy_shader_group(id);
     }
 
     compiled_shader_ptr get_shader(id::id_type id , u32 shader_key)
     {
-        std::lock_guard lock{ shader_mutex };
-        assert(id::is_valid(id));
-        for (const auto& [key, value] : shader_groups[id].map)
-        {
-            if (key == shader_key)
-            {
-                return (const compiled_shader_ptr)value.get();
-            }
-        }
-
-        assert(false); // should never occure.
-        return nullptr;
+        assert(id::is_valid(id) && id < max_shader_groups);
+        utl::epoch_guard guard{ shader_epoch };
+        const u8* const buffer{ shader_groups[id].load(std::memory_order_acquire) };
+        assert(buffer);
+        const compiled_shader_ptr shader{ shader_group_stream{ buffer }.find(shader_key) };
+        assert(shader); // should never occure.
+        return shader;
     }
 
 
     void get_submesh_gpu_ids(id::id_type geometry_content_id, u32 id_count, id::id_type* const gpu_ids)
     {
-        std::lock_guard lock{ geometry_mutex };
+        utl::epoch_guard guard{ geometry_epoch };
         //same as old implement,check id or pointer 
         u8* const pointer{ geometry_hierarchies[geometry_content_id] };
         if ((uintptr_t)pointer & single_mesh_marker)
@@ -404,22 +1135,30 @@ namespace nidhog::content
         assert(geometry_ids && thresholds && id_count);
         assert(offsets.empty());
 
-        std::lock_guard lock{ geometry_mutex };
+        // NOTE: no lock here. The LOD table is only written when geometries are created, and
+        //       it's the caller's responsibility not to render geometries while they're being removed.
+        offsets.resize(id_count);
+        geometry_lods.get_lod_offsets(geometry_ids, thresholds, id_count, offsets.data());
+    }
 
+    void get_submesh_bounds(const id::id_type* const gpu_ids, u32 id_count, mesh_bounds* const bounds)
+    {
+        assert(gpu_ids && id_count && bounds);
+        // NOTE: no lock, for the same reason as in get_lod_offsets().
         for (u32 i{ 0 }; i < id_count; ++i)
         {
-            //fake or  real pointer 
-            u8* const pointer{ geometry_hierarchies[geometry_ids[i]] };
-            if ((uintptr_t)pointer & single_mesh_marker)
-            {
-                offsets.emplace_back(lod_offset{ 0, 1 });
-            }
-            else
-            {
-                geometry_hierarchy_stream stream{ pointer };
-                const u32 lod{ stream.lod_from_threshold(thresholds[i]) };
-                offsets.emplace_back(stream.lod_offsets()[lod]);
-            }
+            submesh_bounds.get(gpu_ids[i], bounds[i]);
         }
     }
+
+    void get_lod_bounds(id::id_type geometry_content_id, u32 lod, mesh_bounds& bounds)
+    {
+        assert(id::is_valid(geometry_content_id));
+        lod_bounds.get(lod_bounds_index(geometry_content_id, lod), bounds);
+    }
+
+    utl::slab_allocator_stats get_geometry_allocator_stats()
+    {
+        return hierarchy_allocator.stats();
+    }
 }
\ No newline at end of file
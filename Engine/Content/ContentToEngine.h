@@ -52,7 +52,27 @@ namespace nidhog::content
 		u16 count;
 	};
 
+	// Bounding volumes of a submesh or of a whole LOD, in model space, and the LOD's geometric error
+	// compared to LOD 0 (in model units, 0 for LOD 0).
+	struct mesh_bounds
+	{
+		math::v3	aabb_center;
+		math::v3	aabb_extents;	// half size
+		math::v3	sphere_center;
+		f32			sphere_radius;
+		f32			lod_error;
+	};
+
+	// Geometry data for create_resource() starts with these two values, so data that was packed in another
+	// format is rejected instead of misread. Bump the version whenever the layout changes.
+	struct geometry_format
+	{
+		static constexpr u32 tag{ 0x4d47484e };		// "NHGM"
+		static constexpr u32 version{ 2 };			// 2: per-submesh bounds and LOD error
+	};
+
 
+	// NOTE: returns id::invalid_id if the data can't be used (e.g. a geometry in an old format or with too many LODs).
 	id::id_type create_resource(const void* const data, asset_type::type type);
 	void destroy_resource(id::id_type id, asset_type::type type);
 
@@ -65,4 +85,9 @@ namespace nidhog::content
 	void get_submesh_gpu_ids(id::id_type geometry_content_id, u32 id_count, id::id_type* const gpu_ids);
 	//per frameper objectܹʡcpu cycle
 	void get_lod_offsets(const id::id_type* const geometry_ids, const f32* const thresholds, u32 id_count, utl::vector<lod_offset>& offsets);
+	// NOTE: bounds are stored when a geometry is created, so they can be read without touching any GPU resources.
+	void get_submesh_bounds(const id::id_type* const gpu_ids, u32 id_count, mesh_bounds* const bounds);
+	void get_lod_bounds(id::id_type geometry_content_id, u32 lod, mesh_bounds& bounds);
+	// Memory used by geometry hierarchies.
+	utl::slab_allocator_stats get_geometry_allocator_stats();
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "Meshlet.h"
+
+namespace nidhog::content
+{
+    bool is_meshlet_visible(const meshlet_bounds& bounds, const meshlet_culling_info& info)
+    {
+        const math::v3& c{ bounds.center };
+        for (u32 i{ 0 }; i < _countof(info.frustum_planes); ++i)
+        {
+            const math::v4& plane{ info.frustum_planes[i] };
+            if (plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w < -bounds.radius) return false;
+        }
+
+        // NOTE: all triangles of the meshlet face away from the camera if the camera is inside the
+        //       "negative" cone: dot(center - camera, axis) >= cutoff * |center - camera| + radius.
+        const math::v3 view{ c.x - info.camera_position.x, c.y - info.camera_position.y, c.z - info.camera_position.z };
+        const f32 distance{ sqrtf(view.x * view.x + view.y * view.y + view.z * view.z) };
+        const f32 d{ view.x * bounds.cone_axis.x + view.y * bounds.cone_axis.y + view.z * bounds.cone_axis.z };
+        return d < bounds.cone_cutoff * distance + bounds.radius;
+    }
+
+    u32 cull_meshlets(const meshlet_bounds* const bounds, u32 count, const meshlet_culling_info& info, u32* const visible_indices)
+    {
+        assert(bounds && visible_indices);
+        u32 visible_count{ 0 };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            if (is_meshlet_visible(bounds[i], info)) visible_indices[visible_count++] = i;
+        }
+
+        return visible_count;
+    }
+}
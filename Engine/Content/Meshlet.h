@@ -0,0 +1,44 @@
+#pragma once
+#include "CommonHeaders.h"
+
+namespace nidhog::content
+{
+    // Limits used by the content tools when partitioning a mesh into meshlets. 64 vertices and 124 triangles
+    // fit the usual mesh shader output limits and keep the local triangle indices in a single byte.
+    constexpr u32 meshlet_max_vertices{ 64 };
+    constexpr u32 meshlet_max_triangles{ 124 };
+
+    struct meshlet
+    {
+        u32 vertex_offset;      // first entry in meshlet_vertices
+        u32 triangle_offset;    // first triangle in meshlet_triangles (3 local u8 indices per triangle)
+        u32 vertex_count;
+        u32 triangle_count;
+    };
+
+    // Bounds of a meshlet in mesh space.
+    struct meshlet_bounds
+    {
+        math::v3    center;
+        f32         radius;
+        math::v3    cone_axis;      // average direction of the triangle normals
+        f32         cone_cutoff;    // sine of the normal cone's half angle. 1 means the meshlet can't be backface culled.
+    };
+
+    struct meshlet_culling_info
+    {
+        // NOTE: planes and camera position have to be in the same space as the bounds (i.e. mesh space).
+        //       Plane normals (xyz) point into the frustum and w is the distance, so a point p is inside
+        //       if dot(plane.xyz, p) + plane.w >= 0 for all planes.
+        math::v4    frustum_planes[6];
+        math::v3    camera_position;
+    };
+
+    // Returns true if the meshlet may be visible: it's (partially) inside the frustum and not all of its
+    // triangles face away from the camera.
+    [[nodiscard]] bool is_meshlet_visible(const meshlet_bounds& bounds, const meshlet_culling_info& info);
+
+    // Writes the indices of the meshlets that may be visible to visible_indices (which must have room for
+    // 'count' indices) and returns how many there are.
+    u32 cull_meshlets(const meshlet_bounds* const bounds, u32 count, const meshlet_culling_info& info, u32* const visible_indices);
+}
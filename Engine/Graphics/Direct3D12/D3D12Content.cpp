@@ -2,6 +2,7 @@
 #include "D3D12Core.h"
 #include "Utilities/IOStream.h"
 #include "Content/ContentToEngine.h"
+#include "Content/Meshlet.h"
 #include "D3D12GPass.h"
 
 namespace nidhog::graphics::d3d12::content {
@@ -23,8 +24,20 @@ namespace nidhog::graphics::d3d12::content {
             D3D12_INDEX_BUFFER_VIEW                         index_buffer_view{};
             D3D_PRIMITIVE_TOPOLOGY                          primitive_topology;
             u32                                             elements_type{};
+            math::v3                                        position_scale{ 1.f, 1.f, 1.f };  // decodes quantized positions:
+            math::v3                                        position_offset{};                // offset + position * scale
+            const nidhog::content::meshlet_bounds*          meshlet_bounds{ nullptr };        // allocated from content_allocator
+            u32                                             meshlet_count{ 0 };
         };
 
+        // NOTE: elements_type flag for positions that are stored as 3 x 16-bit unorm relative to the submesh AABB.
+        //       Must be the same as tools::elements::elements_type::quantized_position.
+        constexpr u32 quantized_position_flag{ 0x10 };
+
+        // NOTE: elements_type flag for submeshes that have a meshlet section after the indices.
+        //       Must be the same as tools::elements::elements_type::meshlets.
+        constexpr u32 meshlets_flag{ 0x80 };
+
         struct d3d12_render_item
         {
             id::id_type entity_id;
@@ -34,23 +47,32 @@ namespace nidhog::graphics::d3d12::content {
             id::id_type depth_pso_id;			//Depath prepass Pipeline object	
         };
 
-        utl::free_list<ID3D12Resource*>                     submesh_buffers{};
-        utl::free_list<submesh_view>                        submesh_views{};
+        // NOTE: the registries below are read every frame by the render thread. Their items never move
+        //       (paged_free_list), so only writers take the mutexes. Memory owned by an item (material and
+        //       render item id buffers) is retired through content_epoch instead of being deleted right away,
+        //       because a reader might still be looking at it.
+        //       Those buffers are small and long-lived, so they're allocated from content_allocator, which
+        //       keeps buffers of similar size together instead of scattering them across the heap.
+        utl::slab_allocator                                 content_allocator;
+        utl::epoch_manager                                  content_epoch;
+
+        utl::paged_free_list<ID3D12Resource*>               submesh_buffers{};
+        utl::paged_free_list<submesh_view>                  submesh_views{};
         std::mutex                                          submesh_mutex{};
 
         utl::free_list<d3d12_texture>                       textures;
         std::mutex                                          texture_mutex{};
 
-        utl::vector<ID3D12RootSignature*>                   root_signatures;
+        utl::paged_free_list<ID3D12RootSignature*>          root_signatures;
         std::unordered_map<u64, id::id_type>                mtl_rs_map; // maps a material's type and shader flags to an index in the array of root signatures.
-        utl::free_list<std::unique_ptr<u8[]>>               materials;
+        utl::paged_free_list<u8*>                           materials;
         std::mutex                                          material_mutex{};
 
-        utl::free_list<d3d12_render_item>                   render_items;
-        utl::free_list<std::unique_ptr<id::id_type[]>>      render_item_ids;
+        utl::paged_free_list<d3d12_render_item>             render_items;
+        utl::paged_free_list<id::id_type*>                  render_item_ids;
         std::mutex                                          render_item_mutex{};
 
-        utl::vector<ID3D12PipelineState*>                   pipeline_states;
+        utl::paged_free_list<ID3D12PipelineState*>          pipeline_states;
         std::unordered_map<u64, id::id_type>                pso_map;
         std::mutex                                          pso_mutex{};
 
@@ -73,7 +95,7 @@ namespace nidhog::graphics::d3d12::content {
                 initialize();
             }
 
-            explicit d3d12_material_stream(std::unique_ptr<u8[]>& material_buffer, material_init_info info)
+            explicit d3d12_material_stream(u8*& material_buffer, material_init_info info)
             {
                 assert(!material_buffer);
 
@@ -99,8 +121,8 @@ namespace nidhog::graphics::d3d12::content {
                     (sizeof(id::id_type) + sizeof(u32)) * info.texture_count // texture ids and descriptor indices (maybe 0 if no textures used).
                 };
 
-                material_buffer = std::make_unique<u8[]>(buffer_size);
-                _buffer = material_buffer.get();
+                material_buffer = (u8*)content_allocator.allocate(buffer_size);
+                _buffer = material_buffer;
                 u8* const buffer{ _buffer };
 
                 *(material_type::type*)buffer = info.type;
@@ -259,7 +281,9 @@ namespace nidhog::graphics::d3d12::content {
                 }
 
                 parameters[params::global_shader_data].as_cbv(D3D12_SHADER_VISIBILITY_ALL, 0);
-                parameters[params::per_object_data].as_cbv(data_visibility, 1);
+                // NOTE: per-object data is a persistent table indexed by render item id. Instanced draws look up
+                //       the ids of their instances with SV_InstanceID in instance_indices.
+                parameters[params::per_object_data].as_srv(data_visibility, 7);
                 parameters[params::position_buffer].as_srv(buffer_visibility, 0);
                 parameters[params::element_buffer].as_srv(buffer_visibility, 1);
                 parameters[params::srv_indices].as_srv(D3D12_SHADER_VISIBILITY_PIXEL, 2); // TODO: needs to be visible to any stages that need to sample textures.
@@ -267,6 +291,7 @@ namespace nidhog::graphics::d3d12::content {
                 parameters[params::cullable_lights].as_srv(D3D12_SHADER_VISIBILITY_PIXEL, 4);
                 parameters[params::light_grid].as_srv(D3D12_SHADER_VISIBILITY_PIXEL, 5);
                 parameters[params::light_index_list].as_srv(D3D12_SHADER_VISIBILITY_PIXEL, 6);
+                parameters[params::instance_indices].as_srv(data_visibility, 8);
 
 
                 root_signature = d3dx::d3d12_root_signature_desc{ &parameters[0], _countof(parameters), get_root_signature_flags(flags) }.create();
@@ -275,8 +300,7 @@ namespace nidhog::graphics::d3d12::content {
             }
 
             assert(root_signature);
-            const id::id_type id{ (id::id_type)root_signatures.size() };
-            root_signatures.emplace_back(root_signature);
+            const id::id_type id{ root_signatures.add(root_signature) };
             mtl_rs_map[key] = id;
             NAME_D3D12_OBJECT_INDEXED(root_signature, key, L"GPass Root Signature - key");
 
@@ -308,9 +332,8 @@ namespace nidhog::graphics::d3d12::content {
             { 
                 // Lock scope to add the new PSO's pointer and id (I know  *v* , scoping is not necessary, but it's more obvious this way.)
                 std::lock_guard lock{ pso_mutex };
-                const id::id_type id{ (u32)pipeline_states.size() };
-                pipeline_states.emplace_back(pso);
-                NAME_D3D12_OBJECT_INDEXED(pipeline_states.back(), key,
+                const id::id_type id{ pipeline_states.add(pso) };
+                NAME_D3D12_OBJECT_INDEXED(pso, key,
                     is_depth ? L"Depth-only Pipeline State Object - key" : L"GPass Pipeline State Object - key");
 
                 pso_map[key] = id;
@@ -336,9 +359,8 @@ namespace nidhog::graphics::d3d12::content {
 
             d3dx::d3d12_pipeline_state_subobject_stream& stream{ *(d3dx::d3d12_pipeline_state_subobject_stream* const)stream_ptr };
             {
-                // Lock materials
-                std::lock_guard lock{ material_mutex };
-                const d3d12_material_stream material{ materials[material_id].get() };
+                utl::epoch_guard guard{ content_epoch };
+                const d3d12_material_stream material{ materials[material_id] };
 
                 D3D12_RT_FORMAT_ARRAY rt_array{};
                 rt_array.NumRenderTargets = 1;
@@ -403,21 +425,28 @@ namespace nidhog::graphics::d3d12::content {
         //       The rest of data should be released by the user,
         //       by calling "remove" functions, prior to shutting down the renderer.
         //       That way we make sure the book-keeping of content is CORRECT
-        for (auto& item : root_signatures)
+        // NOTE: root signatures and PSOs are never removed before shutdown, so every slot is still in use.
+        for (u32 i{ 0 }; i < root_signatures.capacity(); ++i)
         {
-            core::release(item);
+            core::release(root_signatures[i]);
+            root_signatures.remove(i);
         }
 
         mtl_rs_map.clear();
-        root_signatures.clear();
 
-        for (auto& item : pipeline_states)
+        for (u32 i{ 0 }; i < pipeline_states.capacity(); ++i)
         {
-            core::release(item);
+            core::release(pipeline_states[i]);
+            pipeline_states.remove(i);
         }
 
         pso_map.clear();
-        pipeline_states.clear();
+        content_epoch.collect();
+    }
+
+    utl::slab_allocator_stats get_allocator_stats()
+    {
+        return content_allocator.stats();
     }
 
     namespace submesh 
@@ -427,9 +456,18 @@ namespace nidhog::graphics::d3d12::content {
         // 
         //     u32 element_size, u32 vertex_count,
         //     u32 index_count, u32 elements_type, u32 primitive_topology
-        //     u8 positions[sizeof(f32) * 3 * vertex_count],     // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
+        //     f32 aabb_min[3], f32 aabb_max[3],                 // only if elements_type has quantized_position_flag.
+        //     u8 positions[position_size * vertex_count],       // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
+        //                                                       // position_size is sizeof(u16) * 3 for quantized positions, otherwise sizeof(f32) * 3.
         //     u8 elements[sizeof(element_size) * vertex_count], // sizeof(elements) must be a multiple of 4 bytes. Pad if needed.
         //     u8 indices[index_size * index_count],
+        //     struct {                                          // only if elements_type has meshlets_flag.
+        //         u32 meshlet_count, u32 meshlet_vertex_count, u32 meshlet_triangle_index_count,
+        //         meshlet meshlets[meshlet_count],
+        //         meshlet_bounds bounds[meshlet_count],
+        //         u32 meshlet_vertices[meshlet_vertex_count],
+        //         u8 meshlet_triangles[meshlet_triangle_index_count] // padded to a multiple of 4 bytes.
+        //     } meshlets
         // submeshes[submesh_count]
         //
         // Remarks:
@@ -447,8 +485,23 @@ namespace nidhog::graphics::d3d12::content {
             const u32 primitive_topology{ blob.read<u32>() };
             const u32 index_size{ (vertex_count < (1 << 16)) ? sizeof(u16) : sizeof(u32) };
 
+            submesh_view view{};
+            u32 position_size{ sizeof(math::v3) };
+            if (elements_type & quantized_position_flag)
+            {
+                math::v3 aabb_min{}, aabb_max{};
+                blob.read((u8*)&aabb_min, sizeof(math::v3));
+                blob.read((u8*)&aabb_max, sizeof(math::v3));
+                constexpr f32 inv_intervals{ 1.f / (f32)((1 << 16) - 1) };
+                view.position_scale = { (aabb_max.x - aabb_min.x) * inv_intervals,
+                                        (aabb_max.y - aabb_min.y) * inv_intervals,
+                                        (aabb_max.z - aabb_min.z) * inv_intervals };
+                view.position_offset = aabb_min;
+                position_size = sizeof(u16) * 3;
+            }
+
             // NOTE: element size may be 0, for position-only vertex formats.
-            const u32 position_buffer_size{ sizeof(math::v3) * vertex_count };
+            const u32 position_buffer_size{ position_size * vertex_count };
             const u32 element_buffer_size{ element_size * vertex_count };
             const u32 index_buffer_size{ index_size * index_count };
 
@@ -460,12 +513,33 @@ namespace nidhog::graphics::d3d12::content {
             ID3D12Resource* resource{ d3dx::create_buffer(blob.position(), total_buffer_size) };
 
             blob.skip(total_buffer_size);
+
+            // NOTE: we only keep the meshlet bounds for CPU culling for now. Meshlets themselves will be
+            //       needed once we render with mesh shaders.
+            if (elements_type & meshlets_flag)
+            {
+                const u32 meshlet_count{ blob.read<u32>() };
+                const u32 meshlet_vertex_count{ blob.read<u32>() };
+                const u32 meshlet_triangle_index_count{ blob.read<u32>() };
+                blob.skip(sizeof(nidhog::content::meshlet) * meshlet_count);
+                if (meshlet_count)
+                {
+                    const u32 bounds_size{ sizeof(nidhog::content::meshlet_bounds) * meshlet_count };
+                    void* const bounds{ content_allocator.allocate(bounds_size) };
+                    blob.read((u8*)bounds, bounds_size);
+                    view.meshlet_bounds = (const nidhog::content::meshlet_bounds*)bounds;
+                    view.meshlet_count = meshlet_count;
+                }
+
+                blob.skip(sizeof(u32) * meshlet_vertex_count);
+                blob.skip(math::align_size_up<sizeof(u32)>(meshlet_triangle_index_count));
+            }
+
             data = blob.position();
 
-            submesh_view view{};
             view.position_buffer_view.BufferLocation = resource->GetGPUVirtualAddress();
             view.position_buffer_view.SizeInBytes = position_buffer_size;
-            view.position_buffer_view.StrideInBytes = sizeof(math::v3);
+            view.position_buffer_view.StrideInBytes = position_size;
 
             if (element_size)
             {
@@ -481,7 +555,8 @@ namespace nidhog::graphics::d3d12::content {
 
 
             view.primitive_topology = get_d3d_primitive_topology((primitive_topology::type)primitive_topology);
-            view.elements_type = elements_type;
+            // NOTE: meshlets_flag doesn't change the vertex layout, so it's not part of the PSO key.
+            view.elements_type = elements_type & ~meshlets_flag;
 
             std::lock_guard lock{ submesh_mutex };
             submesh_buffers.add(resource);
@@ -491,6 +566,12 @@ namespace nidhog::graphics::d3d12::content {
         void remove(id::id_type id)
         {
             std::lock_guard lock{ submesh_mutex };
+            const nidhog::content::meshlet_bounds* const bounds{ submesh_views[id].meshlet_bounds };
+            if (bounds)
+            {
+                content_epoch.retire((void*)bounds, [](void* p) { content_allocator.deallocate(p); });
+            }
+
             submesh_views.remove(id);
 
             core::deferred_release(submesh_buffers[id]);
@@ -501,9 +582,9 @@ namespace nidhog::graphics::d3d12::content {
         {
             assert(gpu_ids && id_count);
             assert(cache.position_buffers && cache.element_buffers && cache.index_buffer_views &&
-                cache.primitive_topologies && cache.elements_types);
+                cache.primitive_topologies && cache.elements_types &&
+                cache.position_scales && cache.position_offsets);
 
-            std::lock_guard lock{ submesh_mutex };
             for (u32 i{ 0 }; i < id_count; ++i)
             {
                 // Copy and fill struct
@@ -513,9 +594,20 @@ namespace nidhog::graphics::d3d12::content {
                 cache.index_buffer_views[i] = view.index_buffer_view;
                 cache.primitive_topologies[i] = view.primitive_topology;
                 cache.elements_types[i] = view.elements_type;
+                cache.position_scales[i] = view.position_scale;
+                cache.position_offsets[i] = view.position_offset;
             }
         }
 
+        // NOTE: no lock, like get_views(). Views never move and the bounds are retired through content_epoch.
+        u32 get_meshlet_bounds(id::id_type id, const nidhog::content::meshlet_bounds** bounds)
+        {
+            assert(bounds);
+            const submesh_view& view{ submesh_views[id] };
+            *bounds = view.meshlet_bounds;
+            return view.meshlet_count;
+        }
+
     } // namespace submesh
 
     namespace texture 
@@ -547,28 +639,30 @@ namespace nidhog::graphics::d3d12::content {
         // } d3d12_material
         id::id_type add(material_init_info info)
         {
-            std::unique_ptr<u8[]> buffer;
+            u8* buffer{ nullptr };
             std::lock_guard lock{ material_mutex };
             d3d12_material_stream stream{ buffer, info };
             assert(buffer);
-            return materials.add(std::move(buffer));
+            return materials.add(buffer);
         }
 
         void remove(id::id_type id)
         {
             std::lock_guard lock{ material_mutex };
+            u8* const buffer{ materials[id] };
             materials.remove(id);
+            content_epoch.retire(buffer, [](void* p) { content_allocator.deallocate(p); });
         }
 
         void get_materials(const id::id_type* const material_ids, u32 material_count, const materials_cache& cache)
         {
             assert(material_ids && material_count);
             assert(cache.root_signatures && cache.material_types);
-            std::lock_guard lock{ material_mutex };
+            utl::epoch_guard guard{ content_epoch };
 
             for (u32 i{ 0 }; i < material_count; ++i)
             {
-                const d3d12_material_stream stream{ materials[material_ids[i]].get() };
+                const d3d12_material_stream stream{ materials[material_ids[i]] };
                 cache.root_signatures[i] = root_signatures[stream.root_signature_id()];
                 cache.material_types[i] = stream.material_type();
             }
@@ -606,7 +700,7 @@ namespace nidhog::graphics::d3d12::content {
 
             // NOTE: start:         geomtery id
             //       end:           invalid id
-            std::unique_ptr<id::id_type[]> items{ std::make_unique<id::id_type[]>(sizeof(id::id_type)* (1 + (u64)material_count + 1)) };
+            id::id_type* const items{ (id::id_type*)content_allocator.allocate(sizeof(id::id_type) * (1 + (u64)material_count + 1)) };
 
             items[0] = geometry_content_id;
             id::id_type* const item_ids{ &items[1] };
@@ -631,13 +725,14 @@ namespace nidhog::graphics::d3d12::content {
             // mark the end of ids list.
             item_ids[material_count] = id::invalid_id;
 
-            return render_item_ids.add(std::move(items));
+            return render_item_ids.add(items);
         }
 
         void remove(id::id_type id)
         {
             std::lock_guard lock{ render_item_mutex };
-            const id::id_type* const item_ids{ &render_item_ids[id][1] };
+            id::id_type* const buffer{ render_item_ids[id] };
+            const id::id_type* const item_ids{ &buffer[1] };
 
             // NOTE: the last element in the list of ids is always an invalid id.
             for (u32 i{ 0 }; item_ids[i] != id::invalid_id; ++i)
@@ -646,6 +741,7 @@ namespace nidhog::graphics::d3d12::content {
             }
 
             render_item_ids.remove(id);
+            content_epoch.retire(buffer, [](void* p) { content_allocator.deallocate(p); });
         }
 
         void get_d3d12_render_item_ids(const frame_info& info, utl::vector<id::id_type>& d3d12_render_item_ids)
@@ -658,12 +754,12 @@ namespace nidhog::graphics::d3d12::content {
             frame_cache.geometry_ids.clear();
             const u32 count{ info.render_item_count };
 
-            std::lock_guard lock{ render_item_mutex };
+            utl::epoch_guard guard{ content_epoch };
 
             //Next,write cache
             for (u32 i{ 0 }; i < count; ++i)
             {
-                const id::id_type* const buffer{ render_item_ids[info.render_item_ids[i]].get() };
+                const id::id_type* const buffer{ render_item_ids[info.render_item_ids[i]] };
                 frame_cache.geometry_ids.emplace_back(buffer[0]);
             }
 
@@ -698,9 +794,6 @@ namespace nidhog::graphics::d3d12::content {
             assert(cache.entity_ids && cache.submesh_gpu_ids && cache.material_ids &&
                 cache.gpass_psos && cache.depth_psos);
 
-            std::lock_guard lock1{ render_item_mutex };
-            std::lock_guard lock2{ pso_mutex };
-
             for (u32 i{ 0 }; i < id_count; ++i)
             {
                 const d3d12_render_item& item{ render_items[d3d12_render_item_ids[i]] };
@@ -712,5 +805,32 @@ namespace nidhog::graphics::d3d12::content {
             }
         }
 
+        bool get_draw_keys(const id::id_type* const d3d12_render_item_ids, u32 id_count, u64* const keys)
+        {
+            assert(d3d12_render_item_ids && id_count && keys);
+            utl::epoch_guard guard{ content_epoch };
+
+            // NOTE: ids are truncated to the size of their field, and we remember if that happened.
+            bool all_fit{ true };
+            const auto field = [&all_fit](u32 value, u32 bits, u32 shift) {
+                const u32 mask{ (1u << bits) - 1 };
+                all_fit &= value <= mask;
+                return (u64)(value & mask) << shift;
+            };
+
+            for (u32 i{ 0 }; i < id_count; ++i)
+            {
+                const d3d12_render_item& item{ render_items[d3d12_render_item_ids[i]] };
+                const d3d12_material_stream stream{ materials[item.material_id] };
+                keys[i] = field(stream.material_type(), 4, 60) |
+                          field(id::index(stream.root_signature_id()), 8, 52) |
+                          field(id::index(item.pso_id), 12, 40) |
+                          field(id::index(item.material_id), 12, 28) |
+                          field(id::index(item.submesh_gpu_id), 12, 16);
+            }
+
+            return all_fit;
+        }
+
     } // namespace render_item
 }
\ No newline at end of file
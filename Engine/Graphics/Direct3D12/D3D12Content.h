@@ -2,10 +2,14 @@
 
 #include "D3D12CommonHeaders.h"
 
+namespace nidhog::content { struct meshlet_bounds; }
+
 namespace nidhog::graphics::d3d12::content 
 {
 	bool initialize();
 	void shutdown();
+	// Memory used by materials, render items and meshlet bounds.
+	utl::slab_allocator_stats get_allocator_stats();
 	namespace submesh 
 	{
 		// Easy for us to sequencial access data 
@@ -16,12 +20,18 @@ namespace nidhog::graphics::d3d12::content
 			D3D12_INDEX_BUFFER_VIEW* const      index_buffer_views;
 			D3D_PRIMITIVE_TOPOLOGY* const       primitive_topologies;
 			u32* const                          elements_types;
+			math::v3* const                     position_scales;    // offset + position * scale decodes quantized positions.
+			math::v3* const                     position_offsets;
 		};
 
 		id::id_type add(const u8*& data);
 		void remove(id::id_type id);
 
 		void get_views(const id::id_type* const gpu_ids, u32 id_count, const views_cache& cache);
+
+		// Returns the number of meshlets of the submesh and sets 'bounds' to their bounds (in mesh space),
+		// or nullptr if the submesh wasn't imported with meshlets. The bounds stay valid until the submesh is removed.
+		u32 get_meshlet_bounds(id::id_type id, const nidhog::content::meshlet_bounds** bounds);
 	} // namespace submesh
 
 
@@ -65,5 +75,12 @@ namespace nidhog::graphics::d3d12::content
 		void remove(id::id_type id);
 		void get_d3d12_render_item_ids(const frame_info& info, utl::vector<id::id_type>& d3d12_render_item_ids);
 		void get_items(const id::id_type* const d3d12_render_item_ids, u32 id_count, const items_cache& cache);
+
+		// Writes a sort key for every render item, so that items which need the same states end up next to each other:
+		//   bits 60-63: material type, 52-59: root signature, 40-51: gpass pipeline state, 28-39: material,
+		//   16-27: submesh, 0-15: zero, left for the caller (e.g. for the depth of the item).
+		// NOTE: ids that don't fit in their field are truncated, so items with different states may get the same key.
+		//       Returns false if that happened for any item. The keys then can't tell all states apart.
+		[[nodiscard]] bool get_draw_keys(const id::id_type* const d3d12_render_item_ids, u32 id_count, u64* const keys);
 	} // namespace render_item
 }
\ No newline at end of file
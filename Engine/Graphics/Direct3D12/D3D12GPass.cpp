@@ -8,6 +8,13 @@
 #include "Components/Entity.h"
 #include "Components/Transform.h"
 #include "D3D12LightCulling.h"
+#include "Content/ContentToEngine.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/OcclusionCulling.h"
+#include "Graphics/Instancing.h"
+#include "Graphics/GpuScene.h"
+#include "Utilities/RadixSort.h"
+#include "Utilities/WorkerPool.h"
 
 namespace nidhog::graphics::d3d12::gpass
 {
@@ -15,11 +22,15 @@ namespace nidhog::graphics::d3d12::gpass
 	{
 
         constexpr math::u32v2           initial_dimensions{ 100, 100 };
+        constexpr math::u32v2           occlusion_buffer_size{ 256, 128 };
+        constexpr u32                   sort_range_size{ 4096 };
 
         d3d12_render_texture            gpass_main_buffer{};
         d3d12_depth_buffer              gpass_depth_buffer{};
         math::u32v2                     dimensions{ initial_dimensions };
         D3D12_RESOURCE_BARRIER_FLAGS    flags{};
+        draw_statistics                 depth_prepass_stats{};
+        draw_statistics                 gpass_stats{};
 
         
 
@@ -41,7 +52,7 @@ namespace nidhog::graphics::d3d12::gpass
         {
             utl::vector<id::id_type>    d3d12_render_item_ids;
 
-            // NOTE: when adding new arrays, make sure to update resize() and struct_size.
+            // NOTE: when adding new arrays, make sure to update resize(), reorder() and struct_size.
             //       just some offset
             id::id_type*                    entity_ids{ nullptr };
             id::id_type*                    submesh_gpu_ids{ nullptr };         //find submesh
@@ -55,7 +66,8 @@ namespace nidhog::graphics::d3d12::gpass
             D3D12_INDEX_BUFFER_VIEW*        index_buffer_views{ nullptr };
             D3D_PRIMITIVE_TOPOLOGY*         primitive_topologies{ nullptr };
             u32*                            elements_types{ nullptr };
-            D3D12_GPU_VIRTUAL_ADDRESS*      per_object_data{ nullptr };
+            math::v3*                       position_scales{ nullptr };
+            math::v3*                       position_offsets{ nullptr };
 
             // Fill gpass cache with data
             CONSTEXPR content::render_item::items_cache items_cache() const
@@ -78,7 +90,9 @@ namespace nidhog::graphics::d3d12::gpass
                     element_buffers,
                     index_buffer_views,
                     primitive_topologies,
-                    elements_types
+                    elements_types,
+                    position_scales,
+                    position_offsets
                 };
             }
 
@@ -125,11 +139,45 @@ namespace nidhog::graphics::d3d12::gpass
                     index_buffer_views = (D3D12_INDEX_BUFFER_VIEW*)(&element_buffers[items_count]);
                     primitive_topologies = (D3D_PRIMITIVE_TOPOLOGY*)(&index_buffer_views[items_count]);
                     elements_types = (u32*)(&primitive_topologies[items_count]);
-                    per_object_data = (D3D12_GPU_VIRTUAL_ADDRESS*)(&elements_types[items_count]);
+                    position_scales = (math::v3*)(&elements_types[items_count]);
+                    position_offsets = (math::v3*)(&position_scales[items_count]);
                 }
             }
 
+            // Puts the items in a new order. order[i] is the current index of the item that moves to index i.
+            void reorder(const u32* const order, utl::vector<u8>& scratch)
+            {
+                const u32 items_count{ size() };
+                reorder(d3d12_render_item_ids.data(), order, items_count, scratch);
+                reorder(entity_ids, order, items_count, scratch);
+                reorder(submesh_gpu_ids, order, items_count, scratch);
+                reorder(material_ids, order, items_count, scratch);
+                reorder(gpass_pipeline_states, order, items_count, scratch);
+                reorder(depth_pipeline_states, order, items_count, scratch);
+                reorder(root_signatures, order, items_count, scratch);
+                reorder(material_types, order, items_count, scratch);
+                reorder(position_buffers, order, items_count, scratch);
+                reorder(element_buffers, order, items_count, scratch);
+                reorder(index_buffer_views, order, items_count, scratch);
+                reorder(primitive_topologies, order, items_count, scratch);
+                reorder(elements_types, order, items_count, scratch);
+                reorder(position_scales, order, items_count, scratch);
+                reorder(position_offsets, order, items_count, scratch);
+            }
+
         private:
+            template<typename T>
+            static void reorder(T* const data, const u32* const order, u32 items_count, utl::vector<u8>& scratch)
+            {
+                scratch.resize(items_count * sizeof(T));
+                T* const copy{ (T*)scratch.data() };
+                memcpy(copy, data, items_count * sizeof(T));
+                for (u32 i{ 0 }; i < items_count; ++i)
+                {
+                    data[i] = copy[order[i]];
+                }
+            }
+
             constexpr static u32 struct_size{
                     sizeof(id::id_type) +                   // entity_ids
                     sizeof(id::id_type) +                   // submesh_gpu_ids
@@ -143,12 +191,86 @@ namespace nidhog::graphics::d3d12::gpass
                     sizeof(D3D12_INDEX_BUFFER_VIEW) +       // index_buffer_views
                     sizeof(D3D_PRIMITIVE_TOPOLOGY) +        // primitive_topologies
                     sizeof(u32) +                           // elements_types
-                    sizeof(D3D12_GPU_VIRTUAL_ADDRESS)       // per_object_data
+                    sizeof(math::v3) +                      // position_scales
+                    sizeof(math::v3)                        // position_offsets
             };
 
             utl::vector<u8> _buffer;
         } frame_cache;
 
+        // Culling state that's kept between frames. World bounds of a render item are only computed again if
+        // its entity moved, its submesh changed, or it wasn't rendered in the previous frame (its entity could
+        // have moved in the meantime without us noticing).
+        struct culling_cache
+        {
+            struct item_state
+            {
+                id::id_type     entity_id{ id::invalid_id };
+                id::id_type     submesh_gpu_id{ id::invalid_id };
+                u32             frame{ 0 };     // last frame the item was rendered in, 0 if never
+            };
+
+            culling::bounds_table                       bounds;
+            culling::occlusion_buffer                   occlusion{ occlusion_buffer_size.x, occlusion_buffer_size.y };
+            utl::vector<item_state>                     items;      // indexed by d3d12 render item id
+            u32                                         frame{ 0 };
+
+            // Scratch memory that is reused every frame.
+            utl::vector<game_entity::entity_id>         entity_ids;
+            utl::vector<u8>                             transform_flags;
+            utl::vector<id::id_type>                    moved_item_ids;
+            utl::vector<id::id_type>                    moved_submesh_ids;
+            utl::vector<nidhog::content::mesh_bounds>   moved_bounds;
+            utl::vector<math::m4x4>                     moved_world_matrices;
+            utl::vector<u32>                            visible_indices;
+        } cull_cache;
+
+        // Scratch memory for sorting the render items, reused every frame.
+        struct sorting_cache
+        {
+            utl::vector<u64>                            keys;
+            utl::vector<u64>                            scratch_keys;
+            utl::vector<u32>                            order;
+            utl::vector<u32>                            scratch_order;
+            utl::vector<u8>                             scratch;
+            std::atomic<bool>                           keys_overflowed{ false };
+        } sort_cache;
+
+        utl::vector<instancing::instance_group>         instance_groups;
+        u32                                             instance_group_count{ 0 };
+
+        // A CPU-writable buffer for data that's written every frame, one per frame in flight (like the light buffers).
+        // It only grows, so it's rarely recreated once the scene is loaded.
+        struct frame_upload_buffer
+        {
+            d3d12_buffer                                buffer{};
+            u8*                                         cpu_address{ nullptr };
+
+            void release()
+            {
+                buffer.release();
+                cpu_address = nullptr;
+            }
+        };
+
+        // Per-object data of all render items, kept on the GPU between frames and indexed by d3d12 render item id.
+        // Only the data of render items whose entity moved (or that are new in their slot) is uploaded every frame.
+        // NOTE: the uploads don't go through the per-frame constant buffer, because all render items are uploaded
+        //       in the first frame and whenever the table grows, which can be far more than the constant buffer holds.
+        struct scene_cache
+        {
+            gpu_scene::delta_builder                    delta{ sizeof(hlsl::PerObjectData) };
+            d3d12_buffer                                buffer;             // the per-object table
+            u32                                         capacity{ 0 };      // in render items
+            frame_upload_buffer                         upload_buffers[frame_buffer_count];    // dirty per-object data
+            frame_upload_buffer                         instance_buffers[frame_buffer_count];  // render item ids of the frame, in draw order
+            D3D12_GPU_VIRTUAL_ADDRESS                   instance_items{ 0 };// this frame's instance buffer
+
+            // Scratch memory that is reused every frame.
+            utl::vector<game_entity::entity_id>         entity_ids;
+            utl::vector<u8>                             transform_flags;
+        } scene;
+
         // haha,good don't forgot that
 #undef CONSTEXPR
         bool create_buffers(math::u32v2 size)
@@ -202,53 +324,326 @@ namespace nidhog::graphics::d3d12::gpass
             return gpass_main_buffer.resource() && gpass_depth_buffer.resource();
         }
         
-        void fill_per_object_data(const d3d12_frame_info& d3d12_info)
+        // Makes room for render items with ids up to max_item_id in the per-object table. The contents of the table
+        // are lost when it grows, so every slot is uploaded again.
+        void reserve_scene_buffer(id::id_type max_item_id)
+        {
+            scene_cache& state{ scene };
+            if (max_item_id < state.capacity) return;
+
+            // NOTE: grow by 50%, so we don't recreate the buffer every time a few render items are added.
+            state.capacity = std::max(max_item_id + 1, (state.capacity * 3) >> 1);
+
+            d3d12_buffer_init_info info{};
+            info.size = state.capacity * sizeof(hlsl::PerObjectData);
+            info.alignment = sizeof(math::v4);
+            // NOTE: release() is deferred, so the old table can still be read by frames in flight.
+            state.buffer = d3d12_buffer{ info, false };
+            NAME_D3D12_OBJECT_INDEXED(state.buffer.buffer(), state.capacity, L"GPU Scene Buffer - capacity");
+            state.delta.invalidate();
+        }
+
+        // Makes room for 'size' bytes in an upload buffer. Grows by 50%, like the per-object table.
+        // NOTE: the frame that used the old buffer is done, because we only get here when its frame index comes
+        //       around again. release() is deferred anyway.
+        void reserve_upload_buffer(frame_upload_buffer& upload, u32 size, [[maybe_unused]] const wchar_t* const name,
+                                   [[maybe_unused]] u32 frame_index)
+        {
+            if (!size || upload.buffer.size() >= size) return;
+
+            d3d12_buffer_init_info info{};
+            info.size = std::max(size, (upload.buffer.size() * 3) >> 1);
+            info.alignment = sizeof(math::v4);
+            upload.buffer = d3d12_buffer{ info, true };
+            NAME_D3D12_OBJECT_INDEXED(upload.buffer.buffer(), frame_index, name);
+
+            D3D12_RANGE range{};
+            DXCall(upload.buffer.buffer()->Map(0, &range, (void**)(&upload.cpu_address)));
+            assert(upload.cpu_address);
+        }
+
+        // Collects the per-object data of the render items that changed since the previous frame and writes it to
+        // this frame's upload buffer, to be copied into the per-object table by upload_scene_buffer(). Also writes
+        // the render item ids in draw order, which instance groups use to find the data of their instances.
+        void update_scene_buffer(u32 frame_index)
         {
             const gpass_cache& cache{ frame_cache };
-            const u32 render_items_count{ (u32)cache.size() };
-            id::id_type current_entity_id{ id::invalid_id };
-            hlsl::PerObjectData* current_data_pointer{ nullptr };
+            scene_cache& state{ scene };
+            const u32 items_count{ cache.size() };
+            const id::id_type* const item_ids{ cache.d3d12_render_item_ids.data() };
+
+            state.entity_ids.resize(items_count);
+            state.transform_flags.resize(items_count);
+            id::id_type max_item_id{ 0 };
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                state.entity_ids[i] = game_entity::entity_id{ cache.entity_ids[i] };
+                max_item_id = std::max(max_item_id, item_ids[i]);
+            }
 
-            constant_buffer& cbuffer{ core::cbuffer() };
+            transform::get_updated_components_flags(state.entity_ids.data(), items_count, state.transform_flags.data());
+            reserve_scene_buffer(max_item_id);
 
-            using namespace DirectX;
-            for (u32 i{ 0 }; i < render_items_count; ++i)
+            gpu_scene::delta_builder& delta{ state.delta };
+            delta.begin_frame();
+            hlsl::PerObjectData data{};
+            for (u32 i{ 0 }; i < items_count; ++i)
             {
-                if (current_entity_id != cache.entity_ids[i])
-                {
-                    current_entity_id = cache.entity_ids[i];
-                    hlsl::PerObjectData data{};
-                    transform::get_transform_matrices(game_entity::entity_id{ current_entity_id }, data.World, data.InvWorld);
-                    XMMATRIX world{ XMLoadFloat4x4(&data.World) };
-                    XMMATRIX wvp{ XMMatrixMultiply(world, d3d12_info.camera->view_projection()) };
-                    XMStoreFloat4x4(&data.WorldViewProjection, wvp);
-
-                    current_data_pointer = cbuffer.allocate<hlsl::PerObjectData>();
-                    memcpy(current_data_pointer, &data, sizeof(hlsl::PerObjectData));
-                }
+                const u64 object{ (u64)cache.entity_ids[i] << 32 | cache.submesh_gpu_ids[i] };
+                if (!delta.is_dirty(item_ids[i], object, state.transform_flags[i])) continue;
+
+                transform::get_transform_matrices(state.entity_ids[i], data.World, data.InvWorld);
+                data.PositionScale = cache.position_scales[i];
+                data.PositionOffset = cache.position_offsets[i];
+                delta.add(item_ids[i], &data);
+            }
+
+            delta.build();
+
+            if (delta.dirty_count())
+            {
+                frame_upload_buffer& upload{ state.upload_buffers[frame_index] };
+                reserve_upload_buffer(upload, delta.upload_size(), L"GPU Scene Upload Buffer", frame_index);
+                delta.write_upload_data(upload.cpu_address);
+            }
+
+            static_assert(sizeof(id::id_type) == sizeof(u32));
+            frame_upload_buffer& instances{ state.instance_buffers[frame_index] };
+            reserve_upload_buffer(instances, items_count * sizeof(u32), L"Instance Items Buffer", frame_index);
+            memcpy(instances.cpu_address, item_ids, items_count * sizeof(u32));
+            state.instance_items = instances.buffer.gpu_address();
+        }
 
-                assert(current_data_pointer);
-                cache.per_object_data[i] = cbuffer.gpu_address(current_data_pointer);
+        // Copies the data collected by update_scene_buffer() into the per-object table.
+        void upload_scene_buffer(id3d12_graphics_command_list* const cmd_list, u32 frame_index)
+        {
+            const scene_cache& state{ scene };
+            const gpu_scene::delta_builder& delta{ state.delta };
+            if (!delta.dirty_count()) return;
+
+            // NOTE: buffers decay to the common state after every frame and are promoted to the copy destination
+            //       state implicitly, so we only need a barrier after the copies.
+            ID3D12Resource* const upload_buffer{ state.upload_buffers[frame_index].buffer.buffer() };
+            constexpr u32 element_size{ sizeof(hlsl::PerObjectData) };
+            for (const gpu_scene::copy_range& range : delta.ranges())
+            {
+                cmd_list->CopyBufferRegion(state.buffer.buffer(), (u64)range.first_slot * element_size, upload_buffer,
+                                           range.upload_offset, (u64)range.slot_count * element_size);
             }
+
+            d3dx::transition_resource(cmd_list, state.buffer.buffer(), D3D12_RESOURCE_STATE_COPY_DEST,
+                                      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
         }
 
-        void set_root_parameters(id3d12_graphics_command_list* const cmd_list, u32 cache_index)
+        // States that were bound for the previous render item.
+        struct draw_state
+        {
+            ID3D12RootSignature*        root_signature{ nullptr };
+            ID3D12PipelineState*        pipeline_state{ nullptr };
+            id::id_type                 submesh_gpu_id{ id::invalid_id };
+            u32                         first_instance{ u32_invalid_id };
+        };
+
+        // Sets the root parameters and the geometry of a render item, if they're not the same as the previous item's.
+        // For an instance group, cache_index is the group's first item.
+        // NOTE: call after setting the item's root signature.
+        void set_root_parameters(id3d12_graphics_command_list* const cmd_list, u32 cache_index, draw_state& state, draw_statistics& stats)
         {
             gpass_cache& cache{ frame_cache };
             assert(cache_index < cache.size());
 
+            const id::id_type submesh_gpu_id{ cache.submesh_gpu_ids[cache_index] };
+            const bool geometry_changed{ state.submesh_gpu_id != submesh_gpu_id };
+            const bool instance_data_changed{ state.first_instance != cache_index };
             const material_type::type mtl_type{ cache.material_types[cache_index] };
             switch (mtl_type)
             {
             case material_type::opaque:
             {
                 using params = opaque_root_parameter;
-                cmd_list->SetGraphicsRootShaderResourceView(params::position_buffer, cache.position_buffers[cache_index]);
-                cmd_list->SetGraphicsRootShaderResourceView(params::element_buffer, cache.element_buffers[cache_index]);
-                cmd_list->SetGraphicsRootConstantBufferView(params::per_object_data, cache.per_object_data[cache_index]);
+                if (geometry_changed)
+                {
+                    cmd_list->SetGraphicsRootShaderResourceView(params::position_buffer, cache.position_buffers[cache_index]);
+                    cmd_list->SetGraphicsRootShaderResourceView(params::element_buffer, cache.element_buffers[cache_index]);
+                }
+
+                if (instance_data_changed)
+                {
+                    cmd_list->SetGraphicsRootShaderResourceView(params::instance_indices, scene.instance_items + (u64)cache_index * sizeof(u32));
+                }
             }
             break;
             }
+
+            if (geometry_changed)
+            {
+                state.submesh_gpu_id = submesh_gpu_id;
+                cmd_list->IASetIndexBuffer(&cache.index_buffer_views[cache_index]);
+                cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[cache_index]);
+                ++stats.geometry_changes;
+            }
+
+            if (instance_data_changed)
+            {
+                state.first_instance = cache_index;
+                ++stats.instance_data_changes;
+            }
+        }
+
+        // Puts the f32 bits of a positive view depth into the low 16 bits of a draw key. Positive floats
+        // compare like their bits, so nearer items get smaller keys (with a precision of about 1%).
+        [[nodiscard]] u64 depth_key(f32 depth)
+        {
+            depth = std::max(depth, 0.f);
+            u32 bits;
+            memcpy(&bits, &depth, sizeof(u32));
+            return bits >> 16;
+        }
+
+        // Sorts the render items in the same order as their draw keys, but compares the states themselves instead of
+        // the ids in the keys. Only used when an id didn't fit in its key field, which would make different states
+        // look the same. 'keys' only provide the depths.
+        void sort_render_items_by_state(const u64* const keys, u32* const order, u32 items_count)
+        {
+            const gpass_cache& cache{ frame_cache };
+            std::stable_sort(order, order + items_count, [&cache, keys](u32 a, u32 b) {
+                if (cache.material_types[a] != cache.material_types[b]) return cache.material_types[a] < cache.material_types[b];
+                if (cache.root_signatures[a] != cache.root_signatures[b]) return std::less<>{}(cache.root_signatures[a], cache.root_signatures[b]);
+                if (cache.gpass_pipeline_states[a] != cache.gpass_pipeline_states[b]) return std::less<>{}(cache.gpass_pipeline_states[a], cache.gpass_pipeline_states[b]);
+                if (cache.material_ids[a] != cache.material_ids[b]) return cache.material_ids[a] < cache.material_ids[b];
+                if (cache.submesh_gpu_ids[a] != cache.submesh_gpu_ids[b]) return cache.submesh_gpu_ids[a] < cache.submesh_gpu_ids[b];
+                return (keys[a] & 0xffff) < (keys[b] & 0xffff);
+            });
+        }
+
+        // Sorts the render items by their draw keys (see content::render_item::get_draw_keys()), so the render loops
+        // change states as little as possible. Items with the same states are drawn front to back.
+        // NOTE: this also puts render items that can be instanced next to each other.
+        void sort_render_items(const d3d12_frame_info& d3d12_info)
+        {
+            gpass_cache& cache{ frame_cache };
+            sorting_cache& state{ sort_cache };
+            const culling::bounds_table& bounds{ cull_cache.bounds };
+            const u32 items_count{ cache.size() };
+            const id::id_type* const item_ids{ cache.d3d12_render_item_ids.data() };
+
+            state.keys.resize(items_count);
+            state.scratch_keys.resize(items_count);
+            state.order.resize(items_count);
+            state.scratch_order.resize(items_count);
+
+            using namespace DirectX;
+            math::v3 camera_position, camera_direction;
+            XMStoreFloat3(&camera_position, d3d12_info.camera->position());
+            XMStoreFloat3(&camera_direction, d3d12_info.camera->direction());
+
+            const u32 range_count{ (items_count + sort_range_size - 1) / sort_range_size };
+            state.keys_overflowed.store(false, std::memory_order_relaxed);
+            culling::worker_threads().run(range_count, [&](u32 range) {
+                const u32 begin{ range * sort_range_size };
+                const u32 count{ std::min(sort_range_size, items_count - begin) };
+                if (!content::render_item::get_draw_keys(&item_ids[begin], count, &state.keys[begin]))
+                {
+                    state.keys_overflowed.store(true, std::memory_order_relaxed);
+                }
+
+                const XMVECTOR position{ XMLoadFloat3(&camera_position) };
+                const XMVECTOR direction{ XMLoadFloat3(&camera_direction) };
+                for (u32 i{ begin }; i < begin + count; ++i)
+                {
+                    math::v3 center, extents;
+                    bounds.get_aabb(item_ids[i], center, extents);
+                    const f32 depth{ XMVectorGetX(XMVector3Dot(XMVectorSubtract(XMLoadFloat3(&center), position), direction)) };
+                    state.keys[i] |= depth_key(depth);
+                    state.order[i] = i;
+                }
+            });
+
+            // NOTE: run() returns after all ranges are done, so we see every range's result.
+            if (state.keys_overflowed.load(std::memory_order_relaxed))
+            {
+                sort_render_items_by_state(state.keys.data(), state.order.data(), items_count);
+            }
+            else
+            {
+                utl::radix_sort(state.keys.data(), state.order.data(), items_count, state.scratch_keys.data(), state.scratch_order.data());
+            }
+
+            u32 i{ 0 };
+            while (i < items_count && state.order[i] == i) ++i;
+            if (i < items_count) cache.reorder(state.order.data(), state.scratch);
+        }
+
+        // Removes the render items that are outside of the camera frustum or hidden behind occluders from
+        // the frame cache.
+        void cull_render_items(const d3d12_frame_info& d3d12_info)
+        {
+            gpass_cache& cache{ frame_cache };
+            culling_cache& state{ cull_cache };
+            const u32 items_count{ cache.size() };
+            const id::id_type* const item_ids{ cache.d3d12_render_item_ids.data() };
+            const u32 frame{ ++state.frame };
+
+            state.entity_ids.resize(items_count);
+            state.transform_flags.resize(items_count);
+            id::id_type max_item_id{ 0 };
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                state.entity_ids[i] = game_entity::entity_id{ cache.entity_ids[i] };
+                max_item_id = std::max(max_item_id, item_ids[i]);
+            }
+
+            transform::get_updated_components_flags(state.entity_ids.data(), items_count, state.transform_flags.data());
+            if (max_item_id >= state.items.size()) state.items.resize(max_item_id + 1);
+
+            state.moved_item_ids.clear();
+            state.moved_submesh_ids.clear();
+            state.moved_world_matrices.clear();
+            for (u32 i{ 0 }; i < items_count; ++i)
+            {
+                culling_cache::item_state& item{ state.items[item_ids[i]] };
+                const bool is_up_to_date{ item.frame && item.frame + 1 == frame && !state.transform_flags[i] &&
+                                          item.entity_id == cache.entity_ids[i] && item.submesh_gpu_id == cache.submesh_gpu_ids[i] };
+                item.entity_id = cache.entity_ids[i];
+                item.submesh_gpu_id = cache.submesh_gpu_ids[i];
+                item.frame = frame;
+                if (is_up_to_date) continue;
+
+                state.moved_item_ids.emplace_back(item_ids[i]);
+                state.moved_submesh_ids.emplace_back(cache.submesh_gpu_ids[i]);
+                math::m4x4 inverse_world;
+                transform::get_transform_matrices(state.entity_ids[i], state.moved_world_matrices.emplace_back(), inverse_world);
+            }
+
+            const u32 moved_count{ (u32)state.moved_item_ids.size() };
+            if (moved_count)
+            {
+                state.moved_bounds.resize(moved_count);
+                nidhog::content::get_submesh_bounds(state.moved_submesh_ids.data(), moved_count, state.moved_bounds.data());
+                state.bounds.set(state.moved_item_ids.data(), state.moved_bounds.data(), state.moved_world_matrices.data(), moved_count);
+            }
+
+            state.visible_indices.resize(items_count);
+            const DirectX::XMMATRIX view_projection{ d3d12_info.camera->view_projection() };
+            const culling::frustum camera_frustum{ culling::make_frustum(view_projection) };
+            u32 visible_count{ state.bounds.cull(camera_frustum, item_ids, items_count, state.visible_indices.data()) };
+            visible_count = culling::cull_occluded(state.occlusion, state.bounds, view_projection, item_ids, state.visible_indices.data(), visible_count);
+
+            if (visible_count == items_count) return;
+
+            // Keep the visible items, in the same order, and gather their data again.
+            // NOTE: resize() moves the arrays around if the number of items changes, so we can't just compact them.
+            for (u32 i{ 0 }; i < visible_count; ++i)
+            {
+                cache.d3d12_render_item_ids[i] = cache.d3d12_render_item_ids[state.visible_indices[i]];
+            }
+
+            cache.d3d12_render_item_ids.resize(visible_count);
+            cache.resize();
+            if (visible_count)
+            {
+                content::render_item::get_items(cache.d3d12_render_item_ids.data(), visible_count, cache.items_cache());
+            }
         }
 
         void prepare_render_frame(const d3d12_frame_info& d3d12_info)
@@ -257,13 +652,23 @@ namespace nidhog::graphics::d3d12::gpass
             assert(d3d12_info.info->render_item_ids && d3d12_info.info->render_item_count);
             gpass_cache& cache{ frame_cache };
             cache.clear();
+            instance_group_count = 0;
 
             using namespace content;
             render_item::get_d3d12_render_item_ids(*d3d12_info.info, cache.d3d12_render_item_ids);
             cache.resize();
+            render_item::get_items(cache.d3d12_render_item_ids.data(), cache.size(), cache.items_cache());
+
+            cull_render_items(d3d12_info);
             const u32 items_count{ cache.size() };
+            if (!items_count)
+            {
+                // NOTE: forget the previous frame's changes, so we don't upload them again.
+                scene.delta.begin_frame();
+                return;
+            }
+
             const render_item::items_cache items_cache{ cache.items_cache() };
-            render_item::get_items(cache.d3d12_render_item_ids.data(), items_count, items_cache);
 
             const submesh::views_cache views_cache{ cache.views_cache() };
             submesh::get_views(items_cache.submesh_gpu_ids, items_count, views_cache);
@@ -271,18 +676,31 @@ namespace nidhog::graphics::d3d12::gpass
             const material::materials_cache materials_cache{ cache.materials_cache() };
             material::get_materials(items_cache.material_ids, items_count, materials_cache);
 
-            fill_per_object_data(d3d12_info);
+            sort_render_items(d3d12_info);
+            update_scene_buffer(d3d12_info.frame_index);
+
+            instance_groups.resize(items_count);
+            instance_group_count = instancing::make_groups(cache.submesh_gpu_ids, cache.material_ids, items_count, instance_groups.data());
         }
 
 	} // anonymous namespace
 
     bool initialize()
     {
+        culling::initialize();
         return create_buffers(initial_dimensions);
     }
 
     void shutdown()
     {
+        culling::shutdown();
+        scene.buffer.release();
+        scene.capacity = 0;
+        for (u32 i{ 0 }; i < frame_buffer_count; ++i)
+        {
+            scene.upload_buffers[i].release();
+            scene.instance_buffers[i].release();
+        }
         gpass_main_buffer.release();
         gpass_depth_buffer.release();
         dimensions = initial_dimensions;
@@ -290,6 +708,16 @@ namespace nidhog::graphics::d3d12::gpass
         
     }
 
+    const draw_statistics& depth_prepass_statistics()
+    {
+        return depth_prepass_stats;
+    }
+
+    const draw_statistics& gpass_statistics()
+    {
+        return gpass_stats;
+    }
+
     const d3d12_render_texture& main_buffer()
     {
         return gpass_main_buffer;
@@ -312,76 +740,92 @@ namespace nidhog::graphics::d3d12::gpass
     void depth_prepass(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info)
     {
         prepare_render_frame(d3d12_info);
+        upload_scene_buffer(cmd_list, d3d12_info.frame_index);
 
         const gpass_cache& cache{ frame_cache };
-        const u32 items_count{ cache.size() };
-        ID3D12RootSignature* current_root_signature{ nullptr };
-        ID3D12PipelineState* current_pipeline_state{ nullptr };
+        draw_statistics& stats{ depth_prepass_stats };
+        draw_state state{};
+        stats = {};
 
-        for (u32 i{ 0 }; i < items_count; ++i)
+        for (u32 g{ 0 }; g < instance_group_count; ++g)
         {
-            if (current_root_signature != cache.root_signatures[i])
+            const instancing::instance_group& group{ instance_groups[g] };
+            const u32 i{ group.first_item };
+
+            if (state.root_signature != cache.root_signatures[i])
             {
-                current_root_signature = cache.root_signatures[i];
-                cmd_list->SetGraphicsRootSignature(current_root_signature);
+                // NOTE: the root parameters of a new root signature have to be set again.
+                state = { cache.root_signatures[i], state.pipeline_state };
+                cmd_list->SetGraphicsRootSignature(state.root_signature);
                 cmd_list->SetGraphicsRootConstantBufferView(opaque_root_parameter::global_shader_data, d3d12_info.global_shader_data);
+                cmd_list->SetGraphicsRootShaderResourceView(opaque_root_parameter::per_object_data, scene.buffer.gpu_address());
+                ++stats.root_signature_changes;
             }
 
-            if (current_pipeline_state != cache.depth_pipeline_states[i])
+            if (state.pipeline_state != cache.depth_pipeline_states[i])
             {
-                current_pipeline_state = cache.depth_pipeline_states[i];
-                cmd_list->SetPipelineState(current_pipeline_state);
+                state.pipeline_state = cache.depth_pipeline_states[i];
+                cmd_list->SetPipelineState(state.pipeline_state);
+                ++stats.pipeline_state_changes;
             }
 
-            set_root_parameters(cmd_list, i);
+            set_root_parameters(cmd_list, i, state, stats);
 
             const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[i] };
             const u32 index_count{ ibv.SizeInBytes >> (ibv.Format == DXGI_FORMAT_R16_UINT ? 1 : 2) };
 
-            cmd_list->IASetIndexBuffer(&ibv);
-            cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[i]);
-            cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+            cmd_list->DrawIndexedInstanced(index_count, group.instance_count, 0, 0, 0);
+            ++stats.draw_count;
+            stats.draws_saved += group.instance_count - 1;
         }
     }
 
     void render(id3d12_graphics_command_list* cmd_list, const d3d12_frame_info& d3d12_info)
     {
         const gpass_cache& cache{ frame_cache };
-        const u32 items_count{ cache.size() };
         const u32 frame_index{ d3d12_info.frame_index };
         const id::id_type light_culling_id{ d3d12_info.light_culling_id };
 
-        ID3D12RootSignature* current_root_signature{ nullptr };
-        ID3D12PipelineState* current_pipeline_state{ nullptr };
+        draw_statistics& stats{ gpass_stats };
+        draw_state state{};
+        stats = {};
 
-        for (u32 i{ 0 }; i < items_count; ++i)
+        for (u32 g{ 0 }; g < instance_group_count; ++g)
         {
-            if (current_root_signature != cache.root_signatures[i])
+            const instancing::instance_group& group{ instance_groups[g] };
+            const u32 i{ group.first_item };
+
+            if (state.root_signature != cache.root_signatures[i])
             {
                 using idx = opaque_root_parameter;
-                current_root_signature = cache.root_signatures[i];
+                // NOTE: the root parameters of a new root signature have to be set again. state starts out without
+                //       a root signature, so the first item always binds its own, whatever the previous pass left.
+                state = { cache.root_signatures[i], state.pipeline_state };
+                cmd_list->SetGraphicsRootSignature(state.root_signature);
+                ++stats.root_signature_changes;
                 cmd_list->SetGraphicsRootConstantBufferView(idx::global_shader_data, d3d12_info.global_shader_data);
+                cmd_list->SetGraphicsRootShaderResourceView(idx::per_object_data, scene.buffer.gpu_address());
                 cmd_list->SetGraphicsRootShaderResourceView(idx::directional_lights, light::non_cullable_light_buffer(frame_index));
                 cmd_list->SetGraphicsRootShaderResourceView(idx::cullable_lights, light::cullable_light_buffer(frame_index));
                 cmd_list->SetGraphicsRootShaderResourceView(idx::light_grid, delight::light_grid_opaque(light_culling_id, frame_index));
                 cmd_list->SetGraphicsRootShaderResourceView(idx::light_index_list, delight::light_index_list_opaque(light_culling_id, frame_index));
             }
 
-            if (current_pipeline_state != cache.gpass_pipeline_states[i])
+            if (state.pipeline_state != cache.gpass_pipeline_states[i])
             {
-                current_pipeline_state = cache.gpass_pipeline_states[i];
-                cmd_list->SetPipelineState(current_pipeline_state);
+                state.pipeline_state = cache.gpass_pipeline_states[i];
+                cmd_list->SetPipelineState(state.pipeline_state);
+                ++stats.pipeline_state_changes;
             }
 
-            set_root_parameters(cmd_list, i);
+            set_root_parameters(cmd_list, i, state, stats);
 
             const D3D12_INDEX_BUFFER_VIEW& ibv{ cache.index_buffer_views[i] };
             const u32 index_count{ ibv.SizeInBytes >> (ibv.Format == DXGI_FORMAT_R16_UINT ? 1 : 2) };
-            
 
-            cmd_list->IASetIndexBuffer(&ibv);
-            cmd_list->IASetPrimitiveTopology(cache.primitive_topologies[i]);
-            cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+            cmd_list->DrawIndexedInstanced(index_count, group.instance_count, 0, 0, 0);
+            ++stats.draw_count;
+            stats.draws_saved += group.instance_count - 1;
         }
     }
     
@@ -25,14 +25,29 @@ namespace nidhog::graphics::d3d12::gpass
 			cullable_lights,
 			light_grid,
 			light_index_list,
+			instance_indices,
 
 			count
 		};
 	};
 
+	// Number of draws and state changes of a pass in the last frame.
+	struct draw_statistics
+	{
+		u32 draw_count;
+		u32 root_signature_changes;
+		u32 pipeline_state_changes;
+		u32 geometry_changes;			// vertex data, index buffer and topology
+		u32 instance_data_changes;		// per-object data is read through an array of render item ids per group
+		u32 draws_saved;				// by drawing render items with the same submesh and material as instances
+	};
+
 	bool initialize();
 	void shutdown();
 
+	[[nodiscard]] const draw_statistics&		depth_prepass_statistics();
+	[[nodiscard]] const draw_statistics&		gpass_statistics();
+
 	[[nodiscard]] const d3d12_render_texture&	main_buffer();
 	[[nodiscard]] const d3d12_depth_buffer&		depth_buffer();
 
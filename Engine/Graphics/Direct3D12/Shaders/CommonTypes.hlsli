@@ -26,7 +26,12 @@ struct PerObjectData
 {
     float4x4 World;
     float4x4 InvWorld;
-    float4x4 WorldViewProjection;
+
+    // Quantized positions are decoded as PositionOffset + position * PositionScale.
+    float3 PositionScale;
+    float _pad0;
+    float3 PositionOffset;
+    float _pad1;
 };
 
 struct Sphere
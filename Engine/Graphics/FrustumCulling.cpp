@@ -0,0 +1,263 @@
+#include "FrustumCulling.h"
+#include "Content/ContentToEngine.h"
+#include "Utilities/WorkerPool.h"
+
+namespace nidhog::graphics::culling
+{
+    namespace
+    {
+        constexpr u32 set_range_size{ 4096 };
+        constexpr u32 cull_range_size{ 16 * 1024 };     // NOTE: must be a multiple of 8.
+
+        utl::worker_pool workers;
+
+        // Frustum planes with every component broadcast to all lanes.
+        struct simd_planes
+        {
+            __m128  x[6];
+            __m128  y[6];
+            __m128  z[6];
+            __m128  w[6];
+            __m128  abs_x[6];
+            __m128  abs_y[6];
+            __m128  abs_z[6];
+        };
+
+        // NOTE: items are usually listed in the order they were added, so their ids are often consecutive.
+        //       Then we can load their bounds directly instead of gathering them one by one.
+        [[nodiscard]] __m128 gather(const f32* const data, const id::id_type* const ids, bool consecutive)
+        {
+            return consecutive ? _mm_loadu_ps(&data[ids[0]]) : _mm_setr_ps(data[ids[0]], data[ids[1]], data[ids[2]], data[ids[3]]);
+        }
+
+        // Returns a 4-bit mask of the items that are inside or intersect the frustum. An item is culled if
+        // either its sphere or its AABB is completely behind one of the planes.
+        // NOTE: 'bounds' are the component arrays of a bounds_table, in the order of bounds_table::component.
+        [[nodiscard]] u32 test_4(const f32* const* const bounds, const id::id_type* const ids, const simd_planes& planes)
+        {
+            const bool consecutive{ ids[1] == ids[0] + 1 && ids[2] == ids[0] + 2 && ids[3] == ids[0] + 3 };
+            const __m128 aabb_x{ gather(bounds[0], ids, consecutive) };
+            const __m128 aabb_y{ gather(bounds[1], ids, consecutive) };
+            const __m128 aabb_z{ gather(bounds[2], ids, consecutive) };
+            const __m128 extents_x{ gather(bounds[3], ids, consecutive) };
+            const __m128 extents_y{ gather(bounds[4], ids, consecutive) };
+            const __m128 extents_z{ gather(bounds[5], ids, consecutive) };
+            const __m128 sphere_x{ gather(bounds[6], ids, consecutive) };
+            const __m128 sphere_y{ gather(bounds[7], ids, consecutive) };
+            const __m128 sphere_z{ gather(bounds[8], ids, consecutive) };
+            const __m128 negative_radius{ _mm_sub_ps(_mm_setzero_ps(), gather(bounds[9], ids, consecutive)) };
+            const __m128 zero{ _mm_setzero_ps() };
+
+            __m128 inside{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+            for (u32 i{ 0 }; i < 6; ++i)
+            {
+                // Sphere: dot(n, center) + w >= -radius
+                const __m128 sphere_distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[i], sphere_x), _mm_mul_ps(planes.y[i], sphere_y)),
+                                                         _mm_add_ps(_mm_mul_ps(planes.z[i], sphere_z), planes.w[i])) };
+                // AABB: dot(n, center) + dot(abs(n), extents) + w >= 0
+                const __m128 center_distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[i], aabb_x), _mm_mul_ps(planes.y[i], aabb_y)),
+                                                         _mm_add_ps(_mm_mul_ps(planes.z[i], aabb_z), planes.w[i])) };
+                const __m128 projected_extents{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.abs_x[i], extents_x), _mm_mul_ps(planes.abs_y[i], extents_y)),
+                                                           _mm_mul_ps(planes.abs_z[i], extents_z)) };
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(sphere_distance, negative_radius));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(center_distance, projected_extents), zero));
+            }
+
+            return (u32)_mm_movemask_ps(inside);
+        }
+    } // anonymous namespace
+
+    frustum make_frustum(DirectX::FXMMATRIX view_projection)
+    {
+        using namespace DirectX;
+        // NOTE: (Gribb & Hartmann) with row vectors, the clip space planes are sums and differences of the
+        //       columns of the view-projection matrix, which are the rows of its transpose.
+        const XMMATRIX m{ XMMatrixTranspose(view_projection) };
+        const XMVECTOR planes[6]{
+            XMVectorAdd(m.r[3], m.r[0]),        // left
+            XMVectorSubtract(m.r[3], m.r[0]),   // right
+            XMVectorAdd(m.r[3], m.r[1]),        // bottom
+            XMVectorSubtract(m.r[3], m.r[1]),   // top
+            m.r[2],                             // z = 0
+            XMVectorSubtract(m.r[3], m.r[2]),   // z = w
+        };
+
+        frustum f{};
+        for (u32 i{ 0 }; i < _countof(planes); ++i)
+        {
+            const f32 length{ XMVectorGetX(XMVector3Length(planes[i])) };
+            // NOTE: a projection with an infinite far plane has no z = w plane. Use one that everything is in front of.
+            if (length > 1e-6f) XMStoreFloat4(&f.planes[i], XMVectorScale(planes[i], 1.f / length));
+            else f.planes[i] = { 0.f, 0.f, 0.f, 1.f };
+        }
+
+        return f;
+    }
+
+    void bounds_table::set(const id::id_type* const item_ids, const content::mesh_bounds* const local_bounds,
+                           const math::m4x4* const world_matrices, u32 count)
+    {
+        assert(item_ids && local_bounds && world_matrices && count);
+        reserve(item_ids, count);
+
+        f32* bounds[component::count];
+        for (u32 i{ 0 }; i < component::count; ++i) bounds[i] = _bounds[i].data();
+        u32* const last_pass{ _last_pass.data() };
+
+        const u32 range_count{ (count + set_range_size - 1) / set_range_size };
+        workers.run(range_count, [&](u32 range) {
+            const u32 begin{ range * set_range_size };
+            const u32 end{ std::min(count, begin + set_range_size) };
+            for (u32 i{ begin }; i < end; ++i)
+            {
+                const id::id_type id{ item_ids[i] };
+                const content::mesh_bounds& b{ local_bounds[i] };
+                const math::m4x4& m{ world_matrices[i] };
+
+                // NOTE: row vectors, so p' = p.x * row1 + p.y * row2 + p.z * row3 + row4.
+                const math::v3& c{ b.aabb_center };
+                const math::v3& e{ b.aabb_extents };
+                const math::v3& s{ b.sphere_center };
+                bounds[component::aabb_center_x][id] = c.x * m._11 + c.y * m._21 + c.z * m._31 + m._41;
+                bounds[component::aabb_center_y][id] = c.x * m._12 + c.y * m._22 + c.z * m._32 + m._42;
+                bounds[component::aabb_center_z][id] = c.x * m._13 + c.y * m._23 + c.z * m._33 + m._43;
+                bounds[component::aabb_extents_x][id] = e.x * fabsf(m._11) + e.y * fabsf(m._21) + e.z * fabsf(m._31);
+                bounds[component::aabb_extents_y][id] = e.x * fabsf(m._12) + e.y * fabsf(m._22) + e.z * fabsf(m._32);
+                bounds[component::aabb_extents_z][id] = e.x * fabsf(m._13) + e.y * fabsf(m._23) + e.z * fabsf(m._33);
+                bounds[component::sphere_center_x][id] = s.x * m._11 + s.y * m._21 + s.z * m._31 + m._41;
+                bounds[component::sphere_center_y][id] = s.x * m._12 + s.y * m._22 + s.z * m._32 + m._42;
+                bounds[component::sphere_center_z][id] = s.x * m._13 + s.y * m._23 + s.z * m._33 + m._43;
+
+                const f32 scale_x{ m._11 * m._11 + m._12 * m._12 + m._13 * m._13 };
+                const f32 scale_y{ m._21 * m._21 + m._22 * m._22 + m._23 * m._23 };
+                const f32 scale_z{ m._31 * m._31 + m._32 * m._32 + m._33 * m._33 };
+                bounds[component::sphere_radius][id] = b.sphere_radius * sqrtf(std::max(scale_x, std::max(scale_y, scale_z)));
+
+                // The bounds changed, so the last culling result can't be reused.
+                last_pass[id] = 0;
+            }
+        });
+    }
+
+    u32 bounds_table::cull(const frustum& view_frustum, const id::id_type* const item_ids, u32 count, u32* const visible_indices)
+    {
+        assert(item_ids && count && visible_indices);
+        ++_pass;
+        const bool reuse_results{ !memcmp(&_last_frustum, &view_frustum, sizeof(frustum)) };
+        _last_frustum = view_frustum;
+
+        const u32 range_count{ (count + cull_range_size - 1) / cull_range_size };
+        _range_counts.resize(range_count);
+        workers.run(range_count, [&](u32 range) {
+            const u32 begin{ range * cull_range_size };
+            const u32 end{ std::min(count, begin + cull_range_size) };
+            _range_counts[range] = cull_range(view_frustum, item_ids, begin, end, &visible_indices[begin], reuse_results);
+        });
+
+        // Every range wrote its visible items at the start of its own part of the output. Close the gaps.
+        u32 visible_count{ _range_counts[0] };
+        for (u32 i{ 1 }; i < range_count; ++i)
+        {
+            const u32 range_count_i{ _range_counts[i] };
+            if (range_count_i) memmove(&visible_indices[visible_count], &visible_indices[i * cull_range_size], range_count_i * sizeof(u32));
+            visible_count += range_count_i;
+        }
+
+        return visible_count;
+    }
+
+    void bounds_table::get_aabb(id::id_type item_id, math::v3& center, math::v3& extents) const
+    {
+        assert(item_id < size());
+        center = { _bounds[component::aabb_center_x][item_id], _bounds[component::aabb_center_y][item_id], _bounds[component::aabb_center_z][item_id] };
+        extents = { _bounds[component::aabb_extents_x][item_id], _bounds[component::aabb_extents_y][item_id], _bounds[component::aabb_extents_z][item_id] };
+    }
+
+    void bounds_table::reserve(const id::id_type* const item_ids, u32 count)
+    {
+        id::id_type max_id{ 0 };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            assert(id::is_valid(item_ids[i]));
+            max_id = std::max(max_id, item_ids[i]);
+        }
+
+        if (max_id < size()) return;
+
+        const u32 new_size{ max_id + 1 };
+        for (auto& component_data : _bounds) component_data.resize(new_size);
+        _last_pass.resize(new_size);
+        _visible.resize(new_size);
+    }
+
+    u32 bounds_table::cull_range(const frustum& view_frustum, const id::id_type* const item_ids, u32 begin, u32 end,
+                                 u32* const visible_indices, bool reuse_results)
+    {
+        simd_planes planes;
+        for (u32 i{ 0 }; i < 6; ++i)
+        {
+            const math::v4& p{ view_frustum.planes[i] };
+            planes.x[i] = _mm_set1_ps(p.x);
+            planes.y[i] = _mm_set1_ps(p.y);
+            planes.z[i] = _mm_set1_ps(p.z);
+            planes.w[i] = _mm_set1_ps(p.w);
+            planes.abs_x[i] = _mm_set1_ps(fabsf(p.x));
+            planes.abs_y[i] = _mm_set1_ps(fabsf(p.y));
+            planes.abs_z[i] = _mm_set1_ps(fabsf(p.z));
+        }
+
+        const f32* bounds[component::count];
+        for (u32 i{ 0 }; i < component::count; ++i) bounds[i] = _bounds[i].data();
+        u32* const last_pass{ _last_pass.data() };
+        u8* const visible{ _visible.data() };
+        const u32 previous_pass{ _pass - 1 };
+
+        u32 visible_count{ 0 };
+        for (u32 i{ begin }; i < end; i += 8)
+        {
+            const u32 item_count{ std::min(8u, end - i) };
+            id::id_type ids[8];
+            u32 mask{ 0 };
+            bool needs_test{ !reuse_results };
+            for (u32 k{ 0 }; k < 8; ++k)
+            {
+                // NOTE: the last batch is padded with copies of its last item.
+                const id::id_type id{ item_ids[i + std::min(k, item_count - 1)] };
+                assert(id < size());
+                ids[k] = id;
+                if (last_pass[id] && last_pass[id] == previous_pass) mask |= (u32)visible[id] << k;
+                else needs_test = true;
+            }
+
+            if (needs_test)
+            {
+                mask = test_4(bounds, &ids[0], planes) | (test_4(bounds, &ids[4], planes) << 4);
+                for (u32 k{ 0 }; k < item_count; ++k) visible[ids[k]] = (u8)((mask >> k) & 1);
+            }
+
+            for (u32 k{ 0 }; k < item_count; ++k)
+            {
+                last_pass[ids[k]] = _pass;
+                visible_indices[visible_count] = i + k;
+                visible_count += (mask >> k) & 1;
+            }
+        }
+
+        return visible_count;
+    }
+
+    void initialize()
+    {
+        workers.start();
+    }
+
+    utl::worker_pool& worker_threads()
+    {
+        return workers;
+    }
+
+    void shutdown()
+    {
+        workers.stop();
+    }
+}
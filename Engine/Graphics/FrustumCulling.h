@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::content { struct mesh_bounds; }
+namespace nidhog::utl { class worker_pool; }
+
+namespace nidhog::graphics::culling
+{
+    // View frustum as 6 planes (xyz: normal, w: distance) with their normals pointing inwards, so a point p is
+    // inside if dot(plane.xyz, p) + plane.w >= 0 for all planes.
+    struct frustum
+    {
+        math::v4 planes[6];
+    };
+
+    // Extracts the frustum planes from a view-projection matrix with D3D clip space (0 <= z <= w).
+    // NOTE: works with reversed depth too, the near and far planes just swap places.
+    [[nodiscard]] frustum make_frustum(DirectX::FXMMATRIX view_projection);
+
+    // World space bounds (AABB and bounding sphere) of items like render items, in SoA layout and indexed by
+    // a stable item id. Bounds are kept between frames, so only items that moved or are new have to be set
+    // again. The table also remembers the last culling result of every item, which is reused for items that
+    // weren't set again, as long as the frustum didn't change either.
+    class bounds_table
+    {
+    public:
+        bounds_table() = default;
+        DISABLE_COPY_AND_MOVE(bounds_table);
+
+        // Transforms the model space bounds of 'count' items to world space and stores them.
+        void set(const id::id_type* const item_ids, const content::mesh_bounds* const local_bounds,
+                 const math::m4x4* const world_matrices, u32 count);
+
+        // Tests 'count' items against the frustum, 8 at a time. Writes the indices (into item_ids) of the
+        // visible items to visible_indices, in order, and returns how many there are.
+        // NOTE: all items must have been set before, and an item id can only appear once per call.
+        [[nodiscard]] u32 cull(const frustum& view_frustum, const id::id_type* const item_ids, u32 count, u32* const visible_indices);
+
+        // World space AABB of an item that has been set before.
+        void get_aabb(id::id_type item_id, math::v3& center, math::v3& extents) const;
+
+        [[nodiscard]] u32 size() const { return (u32)_last_pass.size(); }
+
+    private:
+        struct component
+        {
+            enum : u32
+            {
+                aabb_center_x, aabb_center_y, aabb_center_z,
+                aabb_extents_x, aabb_extents_y, aabb_extents_z,
+                sphere_center_x, sphere_center_y, sphere_center_z,
+                sphere_radius,
+
+                count
+            };
+        };
+
+        void reserve(const id::id_type* const item_ids, u32 count);
+        [[nodiscard]] u32 cull_range(const frustum& view_frustum, const id::id_type* const item_ids, u32 begin, u32 end,
+                                     u32* const visible_indices, bool reuse_results);
+
+        utl::vector<f32>    _bounds[component::count];
+        utl::vector<u32>    _last_pass;     // last culling pass that tested the item, 0 if it was set after that
+        utl::vector<u8>     _visible;       // result of that pass
+        utl::vector<u32>    _range_counts;
+        frustum             _last_frustum{};
+        u32                 _pass{ 0 };
+    };
+
+    // Starts the worker threads that bounds_table uses to split its work. Without them, everything runs on
+    // the calling thread.
+    void initialize();
+    void shutdown();
+    // The same worker threads, for other per-frame work of the renderer that can be split up.
+    [[nodiscard]] utl::worker_pool& worker_threads();
+}
@@ -0,0 +1,95 @@
+#include "GpuScene.h"
+#include "Utilities/RadixSort.h"
+
+namespace nidhog::graphics::gpu_scene
+{
+    delta_builder::delta_builder(u32 element_size)
+        : _element_size{ element_size }
+    {
+        assert(element_size);
+    }
+
+    void delta_builder::begin_frame()
+    {
+        ++_frame;
+        _dirty_slots.clear();
+        _staging.clear();
+        _ranges.clear();
+    }
+
+    bool delta_builder::is_dirty(u32 slot, u64 object, bool changed)
+    {
+        assert(_frame);
+        // NOTE: grow by at least 50%, because utl::vector::resize() only reserves what's asked for.
+        if (slot >= _slots.size()) _slots.resize(std::max((u64)slot + 1, (_slots.size() * 3) >> 1));
+
+        slot_state& state{ _slots[slot] };
+        // NOTE: the slot was already checked in this frame.
+        if (state.frame == _frame) return false;
+
+        const bool is_up_to_date{ state.frame && state.frame + 1 == _frame && state.object == object && !changed };
+
+        state.object = object;
+        state.frame = _frame;
+        return !is_up_to_date;
+    }
+
+    void delta_builder::add(u32 slot, const void* const data)
+    {
+        assert(data && slot < _slots.size() && _slots[slot].frame == _frame);
+        _dirty_slots.emplace_back(slot);
+        const u64 offset{ _staging.size() };
+        if (offset + _element_size > _staging.capacity()) _staging.reserve(((offset + _element_size) * 3) >> 1);
+        _staging.resize(offset + _element_size);
+        memcpy(&_staging[offset], data, _element_size);
+    }
+
+    void delta_builder::build()
+    {
+        _ranges.clear();
+        const u32 count{ dirty_count() };
+        _keys.resize(count);
+        _scratch_keys.resize(count);
+        _order.resize(count);
+        _scratch_order.resize(count);
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            _keys[i] = _dirty_slots[i];
+            _order[i] = i;
+        }
+
+        utl::radix_sort(_keys.data(), _order.data(), count, _scratch_keys.data(), _scratch_order.data());
+
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            const u32 slot{ (u32)_keys[i] };
+            if (!_ranges.empty())
+            {
+                copy_range& range{ _ranges.back() };
+                if (range.first_slot + range.slot_count == slot)
+                {
+                    ++range.slot_count;
+                    continue;
+                }
+            }
+
+            _ranges.emplace_back(copy_range{ slot, 1, i * _element_size });
+        }
+    }
+
+    void delta_builder::write_upload_data(void* const dst) const
+    {
+        assert(dst || !dirty_count());
+        u8* const data{ (u8*)dst };
+        const u32 count{ dirty_count() };
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            memcpy(&data[(u64)i * _element_size], &_staging[(u64)_order[i] * _element_size], _element_size);
+        }
+    }
+
+    void delta_builder::invalidate()
+    {
+        for (slot_state& state : _slots) state.frame = 0;
+    }
+}
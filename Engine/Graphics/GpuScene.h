@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::graphics::gpu_scene
+{
+    // A copy of consecutive slots from the upload data into the scene buffer.
+    struct copy_range
+    {
+        u32 first_slot;
+        u32 slot_count;
+        u32 upload_offset;      // in bytes, from the start of the upload data
+    };
+
+    // Keeps track of what's in the slots of a persistent per-object table on the GPU and collects the data of
+    // the slots that changed in a frame, so only that data has to be uploaded.
+    // A slot is dirty if it was never written, if it holds a different object than last time, if its object
+    // changed, or if it wasn't used in the previous frame (its object could have changed in the meantime without
+    // us noticing). The dirty slots are sorted and packed, so consecutive slots can be copied at once.
+    // NOTE: this is CPU-only. Uploading the data and copying the ranges is up to the renderer.
+    class delta_builder
+    {
+    public:
+        explicit delta_builder(u32 element_size);
+        DISABLE_COPY_AND_MOVE(delta_builder);
+
+        // Starts a new frame and forgets the dirty slots of the previous frame.
+        void begin_frame();
+        // Returns true if the slot needs new data and marks the slot as used in this frame.
+        // 'object' identifies what the slot holds (e.g. the entity and submesh of a render item).
+        [[nodiscard]] bool is_dirty(u32 slot, u64 object, bool changed);
+        // Adds the new data of a dirty slot. Every slot can only be added once per frame.
+        void add(u32 slot, const void* const data);
+        // Sorts the dirty slots and merges consecutive slots into copy ranges.
+        void build();
+        // Writes the data of the dirty slots to dst, packed in the order of the copy ranges.
+        // NOTE: dst must have room for upload_size() bytes.
+        void write_upload_data(void* const dst) const;
+        // Makes all slots dirty, e.g. after the table on the GPU was recreated.
+        void invalidate();
+
+        [[nodiscard]] const utl::vector<copy_range>& ranges() const { return _ranges; }
+        [[nodiscard]] u32 dirty_count() const { return (u32)_dirty_slots.size(); }
+        [[nodiscard]] u32 upload_size() const { return dirty_count() * _element_size; }
+        [[nodiscard]] u32 element_size() const { return _element_size; }
+
+    private:
+        struct slot_state
+        {
+            u64 object{ 0 };
+            u32 frame{ 0 };     // last frame the slot was used in, 0 if never written
+        };
+
+        utl::vector<slot_state>     _slots;
+        utl::vector<u32>            _dirty_slots;   // in the order they were added
+        utl::vector<u8>             _staging;       // data of the dirty slots, in the same order
+        utl::vector<u64>            _keys;
+        utl::vector<u64>            _scratch_keys;
+        utl::vector<u32>            _order;         // index in _dirty_slots of every packed slot
+        utl::vector<u32>            _scratch_order;
+        utl::vector<copy_range>     _ranges;
+        const u32                   _element_size;
+        u32                         _frame{ 0 };
+    };
+}
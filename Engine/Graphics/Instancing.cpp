@@ -0,0 +1,23 @@
+#include "Instancing.h"
+
+namespace nidhog::graphics::instancing
+{
+    u32 make_groups(const id::id_type* const submesh_ids, const id::id_type* const material_ids, u32 item_count,
+                    instance_group* const groups)
+    {
+        assert(submesh_ids && material_ids && groups);
+        u32 group_count{ 0 };
+        u32 i{ 0 };
+        while (i < item_count)
+        {
+            const u32 first{ i };
+            const id::id_type submesh_id{ submesh_ids[i] };
+            const id::id_type material_id{ material_ids[i] };
+            while (++i < item_count && submesh_ids[i] == submesh_id && material_ids[i] == material_id) {}
+
+            groups[group_count++] = { first, i - first };
+        }
+
+        return group_count;
+    }
+}
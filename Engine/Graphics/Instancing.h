@@ -0,0 +1,24 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::graphics::instancing
+{
+    // A run of consecutive render items that is drawn with one instanced draw.
+    // The ids of all render items of a frame are stored in one array, in the same order as the items. So the ids
+    // of a group start at element first_item, and instance i of the group reads element first_item + i (the shader
+    // binds the array at the group's first element, indexes it with SV_InstanceID and then looks up the
+    // per-object data of the render item, see gpu_scene::delta_builder).
+    struct instance_group
+    {
+        u32 first_item;
+        u32 instance_count;
+    };
+
+    // Groups consecutive render items that use the same submesh and the same material. Those items also use the
+    // same pipeline states, because the states are created from the material and the submesh's vertex layout.
+    // Writes the groups to 'groups', which must have room for item_count groups, and returns their number.
+    // NOTE: items that can be instanced are only grouped if they are next to each other, so sort them first.
+    [[nodiscard]] u32 make_groups(const id::id_type* const submesh_ids, const id::id_type* const material_ids, u32 item_count,
+                                  instance_group* const groups);
+}
@@ -0,0 +1,332 @@
+#include "OcclusionCulling.h"
+#include "FrustumCulling.h"
+#include "Components/Entity.h"
+#include "Components/Transform.h"
+
+namespace nidhog::graphics::culling
+{
+    namespace
+    {
+        // Geometry closer than this (in clip space w) is clipped away, so we never divide by 0.
+        constexpr f32 min_w{ 1e-4f };
+
+        struct occluder
+        {
+            id::id_type             entity_id{ id::invalid_id };
+            utl::vector<math::v3>   positions;
+            utl::vector<u32>        indices;
+        };
+
+        std::mutex                  occluder_mutex;
+        utl::vector<occluder>       occluders;          // removed occluders have an invalid entity id
+        utl::vector<id::id_type>    free_occluder_ids;
+        u32                         active_occluder_count{ 0 };
+
+        // Screen space position: x and y in pixels, z = 1/w.
+        [[nodiscard]] math::v3 to_screen(const math::v4& clip, u32 width, u32 height)
+        {
+            const f32 inv_w{ 1.f / clip.w };
+            return { (clip.x * inv_w * 0.5f + 0.5f) * (f32)width, (0.5f - clip.y * inv_w * 0.5f) * (f32)height, inv_w };
+        }
+
+        // Index of the pixel row or column that contains v. Clamps before converting, because vertices close
+        // to the camera can end up very far off screen.
+        [[nodiscard]] s32 to_pixel(f32 v, u32 size)
+        {
+            return (s32)floorf(std::min(std::max(v, -1.f), (f32)size));
+        }
+
+        [[nodiscard]] math::v4 lerp(const math::v4& a, const math::v4& b, f32 t)
+        {
+            return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+        }
+
+        // Clips a triangle against the w = min_w plane. Returns the number of vertices of the resulting
+        // polygon (0, 3 or 4).
+        [[nodiscard]] u32 clip_near(const math::v4* const triangle, math::v4* const polygon)
+        {
+            u32 count{ 0 };
+            for (u32 i{ 0 }; i < 3; ++i)
+            {
+                const math::v4& a{ triangle[i] };
+                const math::v4& b{ triangle[(i + 1) % 3] };
+                const bool a_inside{ a.w >= min_w };
+                const bool b_inside{ b.w >= min_w };
+                if (a_inside) polygon[count++] = a;
+                if (a_inside != b_inside) polygon[count++] = lerp(a, b, (min_w - a.w) / (b.w - a.w));
+            }
+
+            assert(count == 0 || count == 3 || count == 4);
+            return count;
+        }
+    } // anonymous namespace
+
+    occlusion_buffer::occlusion_buffer(u32 width, u32 height)
+        : _width{ width }, _height{ height }
+    {
+        assert(width && height && !(width % tile_size) && !(height % tile_size));
+        _depth.resize(width * height);
+        _tiles.resize((width / tile_size) * (height / tile_size));
+    }
+
+    void occlusion_buffer::clear(DirectX::FXMMATRIX view_projection)
+    {
+        DirectX::XMStoreFloat4x4(&_view_projection, view_projection);
+        memset(_depth.data(), 0, _depth.size() * sizeof(f32));
+        memset(_tiles.data(), 0, _tiles.size() * sizeof(f32));
+    }
+
+    void occlusion_buffer::rasterize(const math::v3* const positions, u32 vertex_count, const u32* const indices, u32 index_count, const math::m4x4& world)
+    {
+        assert(positions && vertex_count && indices && index_count && !(index_count % 3));
+        using namespace DirectX;
+        const XMMATRIX world_view_projection{ XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&_view_projection)) };
+
+        _clip_positions.resize(vertex_count);
+        for (u32 i{ 0 }; i < vertex_count; ++i)
+        {
+            XMStoreFloat4(&_clip_positions[i], XMVector3Transform(XMLoadFloat3(&positions[i]), world_view_projection));
+        }
+
+        for (u32 i{ 0 }; i < index_count; i += 3)
+        {
+            assert(indices[i] < vertex_count && indices[i + 1] < vertex_count && indices[i + 2] < vertex_count);
+            const math::v4 triangle[3]{ _clip_positions[indices[i]], _clip_positions[indices[i + 1]], _clip_positions[indices[i + 2]] };
+            if (triangle[0].w >= min_w && triangle[1].w >= min_w && triangle[2].w >= min_w)
+            {
+                rasterize_triangle(triangle[0], triangle[1], triangle[2]);
+                continue;
+            }
+
+            math::v4 polygon[4];
+            const u32 count{ clip_near(&triangle[0], &polygon[0]) };
+            if (count >= 3) rasterize_triangle(polygon[0], polygon[1], polygon[2]);
+            if (count == 4) rasterize_triangle(polygon[0], polygon[2], polygon[3]);
+        }
+    }
+
+    void occlusion_buffer::update_tiles()
+    {
+        const u32 tiles_x{ _width / tile_size };
+        const u32 tiles_y{ _height / tile_size };
+        for (u32 ty{ 0 }; ty < tiles_y; ++ty)
+        {
+            for (u32 tx{ 0 }; tx < tiles_x; ++tx)
+            {
+                __m128 farthest{ _mm_set1_ps(FLT_MAX) };
+                for (u32 y{ ty * tile_size }; y < (ty + 1) * tile_size; ++y)
+                {
+                    const f32* const row{ &_depth[y * _width + tx * tile_size] };
+                    for (u32 x{ 0 }; x < tile_size; x += 4)
+                    {
+                        farthest = _mm_min_ps(farthest, _mm_loadu_ps(&row[x]));
+                    }
+                }
+
+                farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+                farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+                _tiles[ty * tiles_x + tx] = _mm_cvtss_f32(farthest);
+            }
+        }
+    }
+
+    bool occlusion_buffer::is_occluded(const math::v3& aabb_center, const math::v3& aabb_extents) const
+    {
+        using namespace DirectX;
+        const XMMATRIX view_projection{ XMLoadFloat4x4(&_view_projection) };
+        const XMVECTOR center{ XMLoadFloat3(&aabb_center) };
+        const XMVECTOR extents{ XMLoadFloat3(&aabb_extents) };
+
+        f32 min_x{ FLT_MAX }, min_y{ FLT_MAX }, max_x{ -FLT_MAX }, max_y{ -FLT_MAX };
+        f32 nearest{ 0.f };
+        for (u32 i{ 0 }; i < 8; ++i)
+        {
+            const XMVECTOR sign{ XMVectorSet(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f, 0.f) };
+            math::v4 clip;
+            XMStoreFloat4(&clip, XMVector3Transform(XMVectorMultiplyAdd(extents, sign, center), view_projection));
+            // Boxes that reach behind the camera are never occluded.
+            if (clip.w < min_w) return false;
+
+            const math::v3 p{ to_screen(clip, _width, _height) };
+            min_x = std::min(min_x, p.x);
+            min_y = std::min(min_y, p.y);
+            max_x = std::max(max_x, p.x);
+            max_y = std::max(max_y, p.y);
+            nearest = std::max(nearest, p.z);
+        }
+
+        // Every pixel that the box touches must have an occluder in front of the box.
+        const s32 x0{ std::max(0, to_pixel(min_x, _width)) };
+        const s32 y0{ std::max(0, to_pixel(min_y, _height)) };
+        const s32 x1{ std::min((s32)_width - 1, to_pixel(max_x, _width)) };
+        const s32 y1{ std::min((s32)_height - 1, to_pixel(max_y, _height)) };
+        // NOTE: boxes that are completely off screen are left to frustum culling.
+        if (x0 > x1 || y0 > y1) return false;
+
+        const u32 tiles_x{ _width / tile_size };
+        for (s32 ty{ y0 / (s32)tile_size }; ty <= y1 / (s32)tile_size; ++ty)
+        {
+            for (s32 tx{ x0 / (s32)tile_size }; tx <= x1 / (s32)tile_size; ++tx)
+            {
+                if (_tiles[ty * tiles_x + tx] > nearest) continue;
+
+                // Some pixels of the tile are farther than the box. Check the ones that the box touches.
+                const s32 tile_y1{ std::min(y1, (ty + 1) * (s32)tile_size - 1) };
+                const s32 tile_x1{ std::min(x1, (tx + 1) * (s32)tile_size - 1) };
+                for (s32 y{ std::max(y0, ty * (s32)tile_size) }; y <= tile_y1; ++y)
+                {
+                    const f32* const row{ &_depth[y * _width] };
+                    for (s32 x{ std::max(x0, tx * (s32)tile_size) }; x <= tile_x1; ++x)
+                    {
+                        if (row[x] <= nearest) return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void occlusion_buffer::rasterize_triangle(const math::v4& v0, const math::v4& v1, const math::v4& v2)
+    {
+        math::v3 a{ to_screen(v0, _width, _height) };
+        math::v3 b{ to_screen(v1, _width, _height) };
+        math::v3 c{ to_screen(v2, _width, _height) };
+
+        f32 area{ (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y) };
+        if (area == 0.f) return;
+        // Occluders are two-sided: make every triangle wind the same way.
+        if (area < 0.f)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+
+        const s32 x0{ std::max(0, to_pixel(std::min(a.x, std::min(b.x, c.x)), _width)) };
+        const s32 y0{ std::max(0, to_pixel(std::min(a.y, std::min(b.y, c.y)), _height)) };
+        const s32 x1{ std::min((s32)_width - 1, to_pixel(std::max(a.x, std::max(b.x, c.x)), _width)) };
+        const s32 y1{ std::min((s32)_height - 1, to_pixel(std::max(a.y, std::max(b.y, c.y)), _height)) };
+        if (x0 > x1 || y0 > y1) return;
+
+        // Edge functions e(x, y) = A * x + B * y + C, which are >= 0 inside the triangle.
+        const f32 edge_a[3]{ a.y - b.y, b.y - c.y, c.y - a.y };
+        const f32 edge_b[3]{ b.x - a.x, c.x - b.x, a.x - c.x };
+        const f32 edge_c[3]{ a.x * b.y - a.y * b.x, b.x * c.y - b.y * c.x, c.x * a.y - c.y * a.x };
+
+        // Depth plane z(x, y) = dzdx * x + dzdy * y + z0.
+        const f32 dzdx{ ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area };
+        const f32 dzdy{ ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area };
+        // NOTE: we store the farthest depth anywhere in the pixel instead of the one at its center, and never
+        //       anything farther than the triangle's farthest vertex, so occluders never seem closer than they are.
+        const f32 z0{ a.z - dzdx * a.x - dzdy * a.y - (fabsf(dzdx) + fabsf(dzdy)) * 0.5f };
+        const __m128 min_z{ _mm_set1_ps(std::min(a.z, std::min(b.z, c.z))) };
+
+        const __m128 zero{ _mm_setzero_ps() };
+        const __m128 lane_offsets{ _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f) };
+        for (s32 y{ y0 }; y <= y1; ++y)
+        {
+            const f32 py{ (f32)y + 0.5f };
+            const __m128 e0_row{ _mm_set1_ps(edge_b[0] * py + edge_c[0]) };
+            const __m128 e1_row{ _mm_set1_ps(edge_b[1] * py + edge_c[1]) };
+            const __m128 e2_row{ _mm_set1_ps(edge_b[2] * py + edge_c[2]) };
+            const __m128 z_row{ _mm_set1_ps(dzdy * py + z0) };
+            f32* const row{ &_depth[y * _width] };
+
+            // NOTE: pixels are processed 4 at a time. The ones left or right of the bounding box are outside
+            //       of the triangle, so they fail the edge tests.
+            for (s32 x{ x0 & ~3 }; x <= x1; x += 4)
+            {
+                const __m128 px{ _mm_add_ps(_mm_set1_ps((f32)x), lane_offsets) };
+                const __m128 e0{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge_a[0]), px), e0_row) };
+                const __m128 e1{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge_a[1]), px), e1_row) };
+                const __m128 e2{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge_a[2]), px), e2_row) };
+                const __m128 inside{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero)) };
+                if (!_mm_movemask_ps(inside)) continue;
+
+                const __m128 z{ _mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), z_row), min_z) };
+                const __m128 old_z{ _mm_loadu_ps(&row[x]) };
+                const __m128 new_z{ _mm_max_ps(old_z, z) };
+                _mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+            }
+        }
+    }
+
+    id::id_type add_occluder(id::id_type entity_id, const math::v3* const positions, u32 vertex_count,
+                             const u32* const indices, u32 index_count)
+    {
+        assert(id::is_valid(entity_id) && positions && vertex_count && indices && index_count && !(index_count % 3));
+        std::lock_guard lock{ occluder_mutex };
+        id::id_type id{ id::invalid_id };
+        if (free_occluder_ids.empty())
+        {
+            id = (id::id_type)occluders.size();
+            occluders.emplace_back();
+        }
+        else
+        {
+            id = free_occluder_ids.back();
+            free_occluder_ids.resize(free_occluder_ids.size() - 1);
+        }
+
+        occluder& o{ occluders[id] };
+        o.entity_id = entity_id;
+        o.positions.resize(vertex_count);
+        memcpy(o.positions.data(), positions, vertex_count * sizeof(math::v3));
+        o.indices.resize(index_count);
+        memcpy(o.indices.data(), indices, index_count * sizeof(u32));
+        ++active_occluder_count;
+        return id;
+    }
+
+    void remove_occluder(id::id_type id)
+    {
+        std::lock_guard lock{ occluder_mutex };
+        assert(id < occluders.size() && id::is_valid(occluders[id].entity_id));
+        occluder& o{ occluders[id] };
+        o.entity_id = id::invalid_id;
+        o.positions = utl::vector<math::v3>{};
+        o.indices = utl::vector<u32>{};
+        free_occluder_ids.emplace_back(id);
+        --active_occluder_count;
+    }
+
+    u32 occluder_count()
+    {
+        std::lock_guard lock{ occluder_mutex };
+        return active_occluder_count;
+    }
+
+    void rasterize_occluders(occlusion_buffer& buffer, DirectX::FXMMATRIX view_projection)
+    {
+        std::lock_guard lock{ occluder_mutex };
+        buffer.clear(view_projection);
+        for (const occluder& o : occluders)
+        {
+            if (!id::is_valid(o.entity_id)) continue;
+            math::m4x4 world, inverse_world;
+            transform::get_transform_matrices(game_entity::entity_id{ o.entity_id }, world, inverse_world);
+            buffer.rasterize(o.positions.data(), (u32)o.positions.size(), o.indices.data(), (u32)o.indices.size(), world);
+        }
+
+        buffer.update_tiles();
+    }
+
+    u32 cull_occluded(occlusion_buffer& buffer, const bounds_table& bounds, DirectX::FXMMATRIX view_projection,
+                      const id::id_type* const item_ids, u32* const visible_indices, u32 visible_count)
+    {
+        assert(item_ids && visible_indices);
+        if (!visible_count || !occluder_count()) return visible_count;
+
+        rasterize_occluders(buffer, view_projection);
+        u32 unoccluded_count{ 0 };
+        for (u32 i{ 0 }; i < visible_count; ++i)
+        {
+            const u32 index{ visible_indices[i] };
+            math::v3 center, extents;
+            bounds.get_aabb(item_ids[index], center, extents);
+            if (!buffer.is_occluded(center, extents)) visible_indices[unoccluded_count++] = index;
+        }
+
+        return unoccluded_count;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::graphics::culling
+{
+    class bounds_table;
+
+    // Low resolution depth buffer that occluders are rasterized into on the CPU, and that the bounds of
+    // render items are tested against before anything is drawn.
+    // Every pixel stores 1/w of the nearest occluder (0 if there's none), which is linear in screen space and
+    // doesn't depend on the depth convention of the projection. On top of that, every 8x8 tile stores the
+    // farthest depth of its pixels, so most tests don't have to look at single pixels.
+    // NOTE: everything runs on the calling thread and only uses SSE2, so the results are the same on every
+    //       machine and can be compared against reference images.
+    class occlusion_buffer
+    {
+    public:
+        constexpr static u32 tile_size{ 8 };
+
+        // NOTE: width and height must be multiples of tile_size.
+        occlusion_buffer(u32 width, u32 height);
+        DISABLE_COPY_AND_MOVE(occlusion_buffer);
+
+        // Clears the buffer before the occluders of a new frame are rasterized.
+        void clear(DirectX::FXMMATRIX view_projection);
+        // Rasterizes an indexed triangle list in model space. Occluders are two-sided.
+        void rasterize(const math::v3* const positions, u32 vertex_count, const u32* const indices, u32 index_count, const math::m4x4& world);
+        // Updates the depth of the tiles. Call after all occluders have been rasterized and before testing.
+        void update_tiles();
+
+        // Returns true if the world space AABB is completely behind the occluders.
+        [[nodiscard]] bool is_occluded(const math::v3& aabb_center, const math::v3& aabb_extents) const;
+
+        [[nodiscard]] constexpr u32 width() const { return _width; }
+        [[nodiscard]] constexpr u32 height() const { return _height; }
+        // 1/w of the nearest occluder in every pixel, row by row.
+        [[nodiscard]] const f32* depth() const { return _depth.data(); }
+
+    private:
+        void rasterize_triangle(const math::v4& v0, const math::v4& v1, const math::v4& v2);
+
+        utl::vector<f32>        _depth;
+        utl::vector<f32>        _tiles;     // farthest depth of every tile
+        utl::vector<math::v4>   _clip_positions;
+        math::m4x4              _view_projection{};
+        u32                     _width;
+        u32                     _height;
+    };
+
+    // Registers a low-poly mesh that hides what's behind it, like the walls of a room. The occluder follows
+    // the transform of its entity. Returns the occluder's id.
+    // NOTE: occluder meshes should be inside the meshes they stand in for, or they may hide things that
+    //       are visible.
+    [[nodiscard]] id::id_type add_occluder(id::id_type entity_id, const math::v3* const positions, u32 vertex_count,
+                                           const u32* const indices, u32 index_count);
+    void remove_occluder(id::id_type id);
+    [[nodiscard]] u32 occluder_count();
+    // Clears the buffer and rasterizes all occluders with the current transforms of their entities.
+    void rasterize_occluders(occlusion_buffer& buffer, DirectX::FXMMATRIX view_projection);
+    // Removes the items that are hidden behind the occluders from the 'visible_count' indices (into item_ids)
+    // that bounds_table::cull() wrote, keeping their order, and returns how many are left. Does nothing if
+    // there are no occluders.
+    [[nodiscard]] u32 cull_occluded(occlusion_buffer& buffer, const bounds_table& bounds, DirectX::FXMMATRIX view_projection,
+                                    const id::id_type* const item_ids, u32* const visible_indices, u32 visible_count);
+}
@@ -1,6 +1,7 @@
 #include "Renderer.h"
 #include "GraphicsPlatformInterface.h"
 #include "Direct3D12\D3D12Interface.h"
+#include "OcclusionCulling.h"
 
 //low-level renderer
 
@@ -420,4 +421,16 @@ namespace nidhog::graphics
 	{
 		gfx.resources.remove_render_item(id);
 	}
+
+	id::id_type add_occluder(id::id_type entity_id, const math::v3* const positions, u32 vertex_count,
+							 const u32* const indices, u32 index_count)
+	{
+		// NOTE: occlusion culling runs on the CPU, so it's the same for every graphics API.
+		return culling::add_occluder(entity_id, positions, vertex_count, indices, index_count);
+	}
+
+	void remove_occluder(id::id_type id)
+	{
+		culling::remove_occluder(id);
+	}
 }
\ No newline at end of file
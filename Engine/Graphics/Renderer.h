@@ -273,4 +273,10 @@ namespace nidhog::graphics
     id::id_type add_render_item(id::id_type entity_id, id::id_type geometry_content_id,
                                 u32 material_count, const id::id_type* const material_ids);
     void remove_render_item(id::id_type id);
+
+    // Registers a low-poly mesh (in the entity's model space) that hides the render items behind it, like the
+    // walls of a room. Render items that are completely hidden aren't drawn.
+    id::id_type add_occluder(id::id_type entity_id, const math::v3* const positions, u32 vertex_count,
+                             const u32* const indices, u32 index_count);
+    void remove_occluder(id::id_type id);
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::utl
+{
+    // Epoch based memory reclamation for read-mostly data.
+    // Readers wrap their accesses in an epoch_guard and never block. Writers first make old data unreachable
+    // (e.g. remove it from a paged_free_list or swap a published pointer) and then retire() it. Retired memory
+    // is freed once every reader that could still be looking at it has left its read section.
+    class epoch_manager
+    {
+    public:
+        constexpr static u32 max_readers{ 32 };
+
+        epoch_manager()
+        {
+            for (auto& epoch : _reader_epochs) epoch.store(idle, std::memory_order_relaxed);
+        }
+        DISABLE_COPY_AND_MOVE(epoch_manager);
+        ~epoch_manager()
+        {
+            // NOTE: there shouldn't be any readers left at this point.
+            for (const auto& item : _retired) item.deleter(item.pointer);
+        }
+
+        [[nodiscard]] u32 enter()
+        {
+            while (true)
+            {
+                const u64 epoch{ _global_epoch.load() };
+                for (u32 i{ 0 }; i < max_readers; ++i)
+                {
+                    u64 expected{ idle };
+                    if (_reader_epochs[i].compare_exchange_strong(expected, epoch)) return i;
+                }
+
+                // NOTE: all reader slots are taken. This only happens with more than max_readers threads
+                //       reading at the same time, so we just wait for one of them to leave.
+                _mm_pause();
+            }
+        }
+
+        void exit(u32 slot)
+        {
+            assert(slot < max_readers && _reader_epochs[slot].load() != idle);
+            _reader_epochs[slot].store(idle);
+        }
+
+        // NOTE: p must already be unreachable for new readers.
+        void retire(void* const p, void(*deleter)(void*))
+        {
+            assert(p && deleter);
+            std::lock_guard lock{ _mutex };
+            _retired.emplace_back(retired_item{ p, deleter, _global_epoch.fetch_add(1) });
+            collect_retired();
+        }
+
+        void collect()
+        {
+            std::lock_guard lock{ _mutex };
+            collect_retired();
+        }
+
+    private:
+        constexpr static u64 idle{ u64_invalid_id };
+
+        struct retired_item
+        {
+            void*       pointer;
+            void(*deleter)(void*);
+            u64         epoch;
+        };
+
+        void collect_retired()
+        {
+            u64 min_epoch{ idle };
+            for (const auto& epoch : _reader_epochs) min_epoch = std::min(min_epoch, epoch.load());
+
+            for (u32 i{ 0 }; i < _retired.size();)
+            {
+                if (_retired[i].epoch < min_epoch)
+                {
+                    _retired[i].deleter(_retired[i].pointer);
+                    utl::erase_unordered(_retired, i);
+                }
+                else ++i;
+            }
+        }
+
+        std::atomic<u64>            _reader_epochs[max_readers];
+        std::atomic<u64>            _global_epoch{ 0 };
+        utl::vector<retired_item>   _retired;
+        std::mutex                  _mutex;
+    };
+
+    class epoch_guard
+    {
+    public:
+        explicit epoch_guard(epoch_manager& manager) : _manager{ manager }, _slot{ manager.enter() } {}
+        DISABLE_COPY_AND_MOVE(epoch_guard);
+        ~epoch_guard() { _manager.exit(_slot); }
+
+    private:
+        epoch_manager&  _manager;
+        const u32       _slot;
+    };
+}
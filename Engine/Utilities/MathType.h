@@ -26,6 +26,24 @@ namespace nidhog::math {
 	using m3x3 = DirectX::XMFLOAT3X3; // NOTE: DirectXMath ûж 3x3 
 	using m4x4 = DirectX::XMFLOAT4X4;
 	using m4x4a = DirectX::XMFLOAT4X4A;
+#else
+	// NOTE: plain structs with the same members and constructors as the DirectXMath types, for code that only
+	//       stores vectors (like the content importers) and is built on platforms without DirectXMath.
+	struct v2 { f32 x, y; v2() = default; constexpr v2(f32 _x, f32 _y) : x{ _x }, y{ _y } {} };
+	struct v3 { f32 x, y, z; v3() = default; constexpr v3(f32 _x, f32 _y, f32 _z) : x{ _x }, y{ _y }, z{ _z } {} };
+	struct v4 { f32 x, y, z, w; v4() = default; constexpr v4(f32 _x, f32 _y, f32 _z, f32 _w) : x{ _x }, y{ _y }, z{ _z }, w{ _w } {} };
+	struct alignas(16) v2a : v2 { using v2::v2; };
+	struct alignas(16) v3a : v3 { using v3::v3; };
+	struct alignas(16) v4a : v4 { using v4::v4; };
+	struct u32v2 { u32 x, y; u32v2() = default; constexpr u32v2(u32 _x, u32 _y) : x{ _x }, y{ _y } {} };
+	struct u32v3 { u32 x, y, z; u32v3() = default; constexpr u32v3(u32 _x, u32 _y, u32 _z) : x{ _x }, y{ _y }, z{ _z } {} };
+	struct u32v4 { u32 x, y, z, w; u32v4() = default; constexpr u32v4(u32 _x, u32 _y, u32 _z, u32 _w) : x{ _x }, y{ _y }, z{ _z }, w{ _w } {} };
+	struct s32v2 { s32 x, y; s32v2() = default; constexpr s32v2(s32 _x, s32 _y) : x{ _x }, y{ _y } {} };
+	struct s32v3 { s32 x, y, z; s32v3() = default; constexpr s32v3(s32 _x, s32 _y, s32 _z) : x{ _x }, y{ _y }, z{ _z } {} };
+	struct s32v4 { s32 x, y, z, w; s32v4() = default; constexpr s32v4(s32 _x, s32 _y, s32 _z, s32 _w) : x{ _x }, y{ _y }, z{ _z }, w{ _w } {} };
+	struct m3x3 { f32 m[3][3]; };
+	struct m4x4 { f32 m[4][4]; };
+	struct alignas(16) m4x4a : m4x4 {};
 #endif
 
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::utl
+{
+    // Same as free_list, except that items never move in memory once they're added.
+    // Items live in fixed-size pages which are allocated on demand and only released in the destructor.
+    // This means that readers can access items without taking a lock while another thread adds or
+    // removes items.
+    //
+    // NOTE: writers (add/remove) still have to be serialized by the caller.
+    //       Reading an item that's being removed at the same time is an error, just like it is for free_list.
+    //       Use an epoch_manager if items own memory that readers could still be looking at.
+    template<typename T, u32 page_size = 4096, u32 max_pages = 1024>
+    class paged_free_list
+    {
+        static_assert(sizeof(T) >= sizeof(u32));
+        static_assert(page_size && !(page_size & (page_size - 1)), "Page size should be a power of 2.");
+    public:
+        paged_free_list() = default;
+        DISABLE_COPY_AND_MOVE(paged_free_list);
+        ~paged_free_list()
+        {
+            assert(!_size);
+            for (auto& page : _pages)
+            {
+                T* const p{ page.load(std::memory_order_relaxed) };
+                if (p) ::operator delete(p, std::align_val_t{ alignof(T) });
+            }
+        }
+
+        template<class... params>
+        u32 add(params&&... p)
+        {
+            u32 id{ u32_invalid_id };
+            if (_next_free_index == u32_invalid_id)
+            {
+                id = _capacity;
+                assert(id < page_size * max_pages);
+                const u32 page_index{ id / page_size };
+                if (!_pages[page_index].load(std::memory_order_relaxed))
+                {
+                    T* const page{ (T*)::operator new(sizeof(T) * page_size, std::align_val_t{ alignof(T) }) };
+                    _pages[page_index].store(page, std::memory_order_release);
+                }
+                ++_capacity;
+            }
+            else
+            {
+                id = _next_free_index;
+                assert(id < _capacity);
+                _next_free_index = *(const u32* const)address(id);
+            }
+
+            new (address(id)) T(std::forward<params>(p)...);
+            ++_size;
+            return id;
+        }
+
+        void remove(u32 id)
+        {
+            assert(id < _capacity);
+            T* const item{ address(id) };
+            item->~T();
+            DEBUG_OP(memset(item, 0xcc, sizeof(T)));
+            *(u32* const)item = _next_free_index;
+            _next_free_index = id;
+            --_size;
+        }
+
+        [[nodiscard]] constexpr u32 size() const { return _size; }
+        // NOTE: number of slots that were ever used, including removed items.
+        [[nodiscard]] constexpr u32 capacity() const { return _capacity; }
+        [[nodiscard]] constexpr bool empty() const { return _size == 0; }
+
+        [[nodiscard]] T& operator[](u32 id)
+        {
+            return *address(id);
+        }
+
+        [[nodiscard]] const T& operator[](u32 id) const
+        {
+            return *address(id);
+        }
+
+    private:
+        [[nodiscard]] T* address(u32 id) const
+        {
+            T* const page{ _pages[id / page_size].load(std::memory_order_acquire) };
+            assert(page);
+            return &page[id & (page_size - 1)];
+        }
+
+        std::atomic<T*>     _pages[max_pages]{};
+        u32                 _next_free_index{ u32_invalid_id };
+        u32                 _capacity{ 0 };
+        u32                 _size{ 0 };
+    };
+}
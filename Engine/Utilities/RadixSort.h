@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::utl
+{
+    // Sorts 64-bit keys in ascending order together with a u32 value per key (usually the key's original index).
+    // LSD radix sort with 8-bit digits: one pass over the keys builds the histograms of all 8 digits, then every
+    // digit that isn't the same for all keys takes one scatter pass. The sort is stable, so equal keys keep
+    // their order.
+    // NOTE: scratch_keys and scratch_values must have room for count elements. The result is in keys and values.
+    inline void radix_sort(u64* keys, u32* values, u32 count, u64* scratch_keys, u32* scratch_values)
+    {
+        if (count < 2) return;
+        assert(keys && values && scratch_keys && scratch_values);
+
+        constexpr u32 digit_count{ sizeof(u64) };
+        constexpr u32 bucket_count{ 256 };
+
+        u32 histograms[digit_count][bucket_count]{};
+        for (u32 i{ 0 }; i < count; ++i)
+        {
+            const u64 key{ keys[i] };
+            for (u32 d{ 0 }; d < digit_count; ++d)
+            {
+                ++histograms[d][(key >> (d * 8)) & 0xff];
+            }
+        }
+
+        u64* src_keys{ keys };
+        u32* src_values{ values };
+        u64* dst_keys{ scratch_keys };
+        u32* dst_values{ scratch_values };
+        for (u32 d{ 0 }; d < digit_count; ++d)
+        {
+            u32* const histogram{ histograms[d] };
+            const u32 shift{ d * 8 };
+            // NOTE: this digit is the same for all keys, so a pass wouldn't change anything.
+            if (histogram[(src_keys[0] >> shift) & 0xff] == count) continue;
+
+            u32 offset{ 0 };
+            for (u32 b{ 0 }; b < bucket_count; ++b)
+            {
+                const u32 bucket_size{ histogram[b] };
+                histogram[b] = offset;
+                offset += bucket_size;
+            }
+
+            for (u32 i{ 0 }; i < count; ++i)
+            {
+                const u64 key{ src_keys[i] };
+                const u32 index{ histogram[(key >> shift) & 0xff]++ };
+                dst_keys[index] = key;
+                dst_values[index] = src_values[i];
+            }
+
+            std::swap(src_keys, dst_keys);
+            std::swap(src_values, dst_values);
+        }
+
+        if (src_keys != keys)
+        {
+            memcpy(keys, src_keys, count * sizeof(u64));
+            memcpy(values, src_values, count * sizeof(u32));
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "CommonHeaders.h"
+
+namespace nidhog::utl
+{
+    struct slab_allocator_stats
+    {
+        u64         bytes_used{ 0 };        // bytes taken up by live allocations, after rounding up to their size class
+        u64         bytes_reserved{ 0 };    // bytes allocated from the heap (slabs and large allocations), including alignment padding
+        u32         allocation_count{ 0 };
+        u32         large_allocation_count{ 0 };
+        u32         slab_count{ 0 };
+
+        // Share of reserved bytes that are not used by any allocation.
+        [[nodiscard]] constexpr f32 fragmentation() const
+        {
+            return bytes_reserved ? 1.f - (f32)((double)bytes_used / (double)bytes_reserved) : 0.f;
+        }
+    };
+
+    // Allocator for small, variable-sized and long-lived blobs (geometry hierarchies, materials, etc.).
+    // Allocations are rounded up to a size class and carved out of 64KB slabs, so blobs of similar size
+    // end up next to each other in memory instead of being scattered all over the heap.
+    // Allocations larger than the biggest size class get their own block.
+    //
+    // NOTE: slabs are aligned to their size, so the slab header of any allocation is found by masking
+    //       its address. Large allocations are aligned the same way and have a header as well.
+    //       Aligning to 64KB costs up to 64KB of padding per block, which is counted in bytes_reserved.
+    //       Empty slabs are kept around for reuse until the allocator is destroyed.
+    class slab_allocator
+    {
+    public:
+        constexpr static u32 slab_size{ 64 * 1024 };
+        constexpr static u32 alignment{ 16 };
+
+        slab_allocator() = default;
+        DISABLE_COPY_AND_MOVE(slab_allocator);
+        ~slab_allocator()
+        {
+            assert(!_stats.allocation_count);
+            for (auto* slab : _slabs) _aligned_free(slab);
+        }
+
+        [[nodiscard]] void* allocate(u64 size)
+        {
+            assert(size);
+            std::lock_guard lock{ _mutex };
+
+            const u32 index{ size_class_index(size) };
+            if (index == u32_invalid_id)
+            {
+                const u64 block_size{ header_size + size };
+                slab_header* const header{ (slab_header*)_aligned_malloc(block_size, slab_size) };
+                assert(header);
+                header->size_class = u32_invalid_id;
+                header->used_count = 1;
+                header->block_size = block_size;
+
+                ++_stats.allocation_count;
+                ++_stats.large_allocation_count;
+                _stats.bytes_used += block_size;
+                _stats.bytes_reserved += reserved_size(block_size);
+                return (u8*)header + header_size;
+            }
+
+            size_class& sc{ _size_classes[index] };
+            if (!sc.free_chunks) add_slab(index);
+
+            free_chunk* const chunk{ sc.free_chunks };
+            sc.free_chunks = chunk->next;
+            ++slab_from_pointer(chunk)->used_count;
+
+            ++_stats.allocation_count;
+            _stats.bytes_used += chunk_sizes[index];
+            return chunk;
+        }
+
+        void deallocate(void* const p)
+        {
+            if (!p) return;
+            std::lock_guard lock{ _mutex };
+
+            slab_header* const header{ slab_from_pointer(p) };
+            assert(header->used_count);
+            --_stats.allocation_count;
+
+            if (header->size_class == u32_invalid_id)
+            {
+                --_stats.large_allocation_count;
+                _stats.bytes_used -= header->block_size;
+                _stats.bytes_reserved -= reserved_size(header->block_size);
+                _aligned_free(header);
+                return;
+            }
+
+            const u32 index{ header->size_class };
+            assert(index < size_class_count);
+            DEBUG_OP(memset(p, 0xcc, chunk_sizes[index]));
+            free_chunk* const chunk{ (free_chunk*)p };
+            chunk->next = _size_classes[index].free_chunks;
+            _size_classes[index].free_chunks = chunk;
+            --header->used_count;
+            _stats.bytes_used -= chunk_sizes[index];
+        }
+
+        [[nodiscard]] slab_allocator_stats stats()
+        {
+            std::lock_guard lock{ _mutex };
+            return _stats;
+        }
+
+    private:
+        struct slab_header
+        {
+            u32         size_class;
+            u32         used_count;
+            u64         block_size;     // only used by large allocations
+        };
+
+        struct free_chunk
+        {
+            free_chunk* next;
+        };
+
+        constexpr static u32 header_size{ (u32)math::align_size_up<alignment>(sizeof(slab_header)) };
+        // NOTE: roughly 1.5x apart, so no allocation wastes more than a third of its chunk.
+        constexpr static u32 chunk_sizes[]{ 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 };
+        constexpr static u32 size_class_count{ _countof(chunk_sizes) };
+
+        struct size_class
+        {
+            free_chunk* free_chunks{ nullptr };
+        };
+
+        [[nodiscard]] static u32 size_class_index(u64 size)
+        {
+            for (u32 i{ 0 }; i < size_class_count; ++i)
+            {
+                if (size <= chunk_sizes[i]) return i;
+            }
+
+            return u32_invalid_id;
+        }
+
+        // The number of bytes _aligned_malloc() takes from the heap for a slab_size-aligned block: it over-allocates
+        // by the alignment and a pointer to the unaligned block.
+        [[nodiscard]] constexpr static u64 reserved_size(u64 block_size)
+        {
+            return block_size + slab_size - 1 + sizeof(void*);
+        }
+
+        [[nodiscard]] static slab_header* slab_from_pointer(const void* const p)
+        {
+            return (slab_header*)((uintptr_t)p & ~((uintptr_t)slab_size - 1));
+        }
+
+        void add_slab(u32 index)
+        {
+            u8* const slab{ (u8*)_aligned_malloc(slab_size, slab_size) };
+            assert(slab);
+            slab_header* const header{ (slab_header*)slab };
+            header->size_class = index;
+            header->used_count = 0;
+            header->block_size = slab_size;
+
+            // Thread all chunks of the new slab onto the free list, in address order.
+            const u32 chunk_size{ chunk_sizes[index] };
+            const u32 chunk_count{ (slab_size - header_size) / chunk_size };
+            free_chunk* next{ _size_classes[index].free_chunks };
+            for (u32 i{ chunk_count }; i > 0; --i)
+            {
+                free_chunk* const chunk{ (free_chunk*)(slab + header_size + (u64)(i - 1) * chunk_size) };
+                chunk->next = next;
+                next = chunk;
+            }
+
+            _size_classes[index].free_chunks = next;
+            _slabs.emplace_back(slab);
+            ++_stats.slab_count;
+            _stats.bytes_reserved += reserved_size(slab_size);
+        }
+
+        size_class              _size_classes[size_class_count]{};
+        utl::vector<u8*>        _slabs;
+        slab_allocator_stats    _stats{};
+        std::mutex              _mutex;
+    };
+}
@@ -56,4 +56,7 @@ namespace nidhog::utl {
 }
 
 
-#include "FreeList.h"
\ No newline at end of file
+#include "FreeList.h"
+#include "PagedFreeList.h"
+#include "Epoch.h"
+#include "SlabAllocator.h"
\ No newline at end of file
@@ -167,12 +167,27 @@ namespace nidhog::utl
             {
                 // NOTE: µڴ
                 //       realoc()Զƻе
-                void* new_buffer{ realloc(_data, new_capacity * sizeof(T)) };
-                assert(new_buffer);
-                if (new_buffer)
+                if constexpr (relocate_with_memcpy)
                 {
-                    _data = static_cast<T*>(new_buffer);
-                    _capacity = new_capacity;
+                    void* new_buffer{ realloc(_data, new_capacity * sizeof(T)) };
+                    assert(new_buffer);
+                    if (new_buffer)
+                    {
+                        _data = static_cast<T*>(new_buffer);
+                        _capacity = new_capacity;
+                    }
+                }
+                else
+                {
+                    T* const new_buffer{ static_cast<T*>(malloc(new_capacity * sizeof(T))) };
+                    assert(new_buffer);
+                    if (new_buffer)
+                    {
+                        relocate(new_buffer, _data, _size);
+                        if (_data) free(_data);
+                        _data = new_buffer;
+                        _capacity = new_capacity;
+                    }
                 }
             }
         }
@@ -193,7 +208,7 @@ namespace nidhog::utl
             --_size;
             if (item < std::addressof(_data[_size]))
             {
-                memcpy(item, item + 1, (std::addressof(_data[_size]) - item) * sizeof(T));
+                relocate(item, item + 1, std::addressof(_data[_size]) - item);
             }
 
             return item;
@@ -215,7 +230,7 @@ namespace nidhog::utl
             --_size;
             if (item < std::addressof(_data[_size]))
             {
-                memcpy(item, std::addressof(_data[_size]), sizeof(T));
+                relocate(item, std::addressof(_data[_size]), 1);
             }
 
             return item;
@@ -362,6 +377,33 @@ namespace nidhog::utl
             _data = nullptr;
         }
 
+        // NOTE: items are moved around in memory with realloc() and memcpy(). MSVC's standard library types
+        //       (std::string, etc.) don't mind, but on other platforms some of them point into themselves
+        //       (like libstdc++'s std::string), so there only trivially copyable types are moved that way.
+#ifdef _WIN64
+        constexpr static bool relocate_with_memcpy{ true };
+#else
+        constexpr static bool relocate_with_memcpy{ std::is_trivially_copyable_v<T> };
+#endif
+
+        // Moves 'count' items from 'src' to 'dst', which is either before 'src' or doesn't overlap it.
+        // The items at 'src' are gone afterwards (no destructor has to be called for them).
+        static void relocate(T* const dst, T* const src, u64 count)
+        {
+            if constexpr (relocate_with_memcpy)
+            {
+                memmove(dst, src, count * sizeof(T));
+            }
+            else
+            {
+                for (u64 i{ 0 }; i < count; ++i)
+                {
+                    new (std::addressof(dst[i])) T(std::move(src[i]));
+                    src[i].~T();
+                }
+            }
+        }
+
         constexpr void destruct_range(u64 first, u64 last)
         {
             assert(destruct);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "CommonHeaders.h"
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace nidhog::utl
+{
+    // A few persistent threads, so we don't have to start new threads every frame. The calling thread of run()
+    // takes part in the work too.
+    class worker_pool
+    {
+    public:
+        worker_pool() = default;
+        DISABLE_COPY_AND_MOVE(worker_pool);
+        ~worker_pool() { assert(_threads.empty()); }
+
+        void start()
+        {
+            assert(_threads.empty());
+            const u32 thread_count{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+            for (u32 i{ 0 }; i < thread_count; ++i)
+            {
+                _threads.emplace_back([this]() { work(); });
+            }
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard lock{ _mutex };
+                _stop = true;
+            }
+            _wake.notify_all();
+            for (auto& thread : _threads) thread.join();
+            _threads.clear();
+            _stop = false;
+        }
+
+        // Calls func(task_index) for every task in [0, task_count), on the workers and the calling thread,
+        // and returns when all of them are done.
+        template<typename F>
+        void run(u32 task_count, F&& func)
+        {
+            if (_threads.empty() || task_count <= 1)
+            {
+                for (u32 i{ 0 }; i < task_count; ++i) func(i);
+                return;
+            }
+
+            using func_type = std::remove_reference_t<F>;
+            {
+                std::unique_lock lock{ _mutex };
+                // NOTE: a worker that woke up too late for the previous run may still hold on to its task.
+                //       It won't find anything left to do, but we have to wait for it to let go.
+                _finished.wait(lock, [this]() { return !_active_workers; });
+                _task = [](void* context, u32 index) { (*(func_type*)context)(index); };
+                _context = (void*)&func;
+                _task_count = task_count;
+                _next_task = 0;
+                _done_count = 0;
+                ++_generation;
+            }
+            _wake.notify_all();
+
+            const u32 done{ execute(_task, _context, task_count) };
+
+            std::unique_lock lock{ _mutex };
+            _done_count += done;
+            _finished.wait(lock, [this]() { return _done_count == _task_count && !_active_workers; });
+        }
+
+    private:
+        using task_func = void(*)(void*, u32);
+
+        [[nodiscard]] u32 execute(task_func task, void* context, u32 task_count)
+        {
+            u32 done{ 0 };
+            for (u32 i{ _next_task++ }; i < task_count; i = _next_task++)
+            {
+                task(context, i);
+                ++done;
+            }
+
+            return done;
+        }
+
+        void work()
+        {
+            u64 generation{ 0 };
+            std::unique_lock lock{ _mutex };
+            while (true)
+            {
+                _wake.wait(lock, [this, &generation]() { return _stop || _generation != generation; });
+                if (_stop) return;
+
+                generation = _generation;
+                const task_func task{ _task };
+                void* const context{ _context };
+                const u32 task_count{ _task_count };
+                ++_active_workers;
+                lock.unlock();
+
+                const u32 done{ execute(task, context, task_count) };
+
+                lock.lock();
+                --_active_workers;
+                _done_count += done;
+                _finished.notify_all();
+            }
+        }
+
+        std::vector<std::thread>    _threads;
+        std::mutex                  _mutex;
+        std::condition_variable     _wake;
+        std::condition_variable     _finished;
+        task_func                   _task{ nullptr };
+        void*                       _context{ nullptr };
+        std::atomic<u32>            _next_task{ 0 };
+        u64                         _generation{ 0 };
+        u32                         _task_count{ 0 };
+        u32                         _done_count{ 0 };
+        u32                         _active_workers{ 0 };
+        bool                        _stop{ false };
+    };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "..\Engine\Common\CommonHeaders.h"
+#include "Content/ContentToEngine.h"
+#include "Graphics/Renderer.h"
+#include "Utilities/IOStream.h"
+
+#include <memory>
+
+using namespace nidhog;
+
+// Builds content in the formats that content::create_resource() and content::add_shader_group() expect, so the
+// content tests can go through the real registries without loading any files. 'seed' goes into the data,
+// so different seeds give different content (which keeps the content caches from merging them) and readers
+// can check that they got back what was created.
+namespace content_test
+{
+    // The first submesh of a geometry made with 'seed' has this AABB center. The other submeshes are
+    // moved along z, one unit per submesh.
+    inline f32 submesh_center_x(u32 seed) { return (f32)(seed & 0xffffff) + 0.5f; }
+
+    // A geometry with lod_count LODs of submesh_count submeshes each. Every submesh is a position-only quad
+    // (4 vertices, 6 16-bit indices) with its bounds in front of it (see create_geometry_resource()).
+    inline std::unique_ptr<u8[]> make_geometry(u32 seed, u32 lod_count, u32 submesh_count)
+    {
+        assert(lod_count && submesh_count);
+        constexpr u32 vertex_count{ 4 };
+        constexpr u32 index_count{ 6 };
+        constexpr u32 submesh_size{
+            sizeof(f32) * 11 +                  // bounds, sphere and lod_error
+            sizeof(u32) * 5 +                   // element_size, vertex_count, index_count, elements_type, primitive_topology
+            sizeof(math::v3) * vertex_count +   // positions (48 bytes, so no padding needed)
+            sizeof(u16) * index_count           // indices
+        };
+        const u32 lod_size{ sizeof(f32) + sizeof(u32) * 2 + submesh_size * submesh_count };
+        const u32 size{ sizeof(u32) * 3 + lod_size * lod_count };
+
+        std::unique_ptr<u8[]> data{ std::make_unique<u8[]>(size) };
+        utl::blob_stream_writer blob{ data.get(), size };
+        blob.write(content::geometry_format::tag);
+        blob.write(content::geometry_format::version);
+        blob.write(lod_count);
+        for (u32 lod{ 0 }; lod < lod_count; ++lod)
+        {
+            blob.write((f32)lod * 10.f); // thresholds have to be strictly ascending
+            blob.write(submesh_count);
+            blob.write(submesh_size * submesh_count);
+            for (u32 i{ 0 }; i < submesh_count; ++i)
+            {
+                const f32 x{ submesh_center_x(seed) - 0.5f };
+                const f32 z{ (f32)i };
+                const math::v3 positions[vertex_count]{ { x, 0.f, z }, { x + 1.f, 0.f, z }, { x + 1.f, 1.f, z }, { x, 1.f, z } };
+                const u16 indices[index_count]{ 0, 1, 2, 0, 2, 3 };
+
+                blob.write(x); blob.write(0.f); blob.write(z);                  // bounds_min
+                blob.write(x + 1.f); blob.write(1.f); blob.write(z);            // bounds_max
+                blob.write(x + 0.5f); blob.write(0.5f); blob.write(z);          // sphere_center
+                blob.write(0.7072f);                                            // sphere_radius
+                blob.write((f32)lod * 0.01f);                                   // lod_error
+                blob.write(0u);                                                 // element_size
+                blob.write(vertex_count);
+                blob.write(index_count);
+                blob.write(0u);                                                 // elements_type: position only
+                blob.write((u32)graphics::primitive_topology::triangle_list);
+                blob.write((const u8*)&positions[0], sizeof(positions));
+                blob.write((const u8*)&indices[0], sizeof(indices));
+            }
+        }
+
+        assert(blob.offset() == size);
+        return data;
+    }
+
+    constexpr u32 shader_byte_code_size{ 64 };
+
+    // A compiled shader whose hash and byte code start with 'seed'. It's never given to the GPU.
+    inline std::unique_ptr<u8[]> make_shader(u32 seed)
+    {
+        const u64 size{ content::compiled_shader::buffer_size(shader_byte_code_size) };
+        std::unique_ptr<u8[]> data{ std::make_unique<u8[]>(size) };
+        utl::blob_stream_writer blob{ data.get(), size };
+        blob.write((u64)shader_byte_code_size);
+        blob.write(seed);
+        blob.skip(content::compiled_shader::hash_length - sizeof(u32));
+        blob.write(seed);
+        return data;
+    }
+
+    // The seed a shader made by make_shader() was made with.
+    inline u32 shader_seed(content::compiled_shader_ptr shader)
+    {
+        assert(shader && shader->byte_code_size() == shader_byte_code_size);
+        return *(const u32*)shader->byte_code();
+    }
+
+    // An opaque material with a vertex and a pixel shader group. Shader groups are the only thing
+    // material::add() needs to be valid.
+    inline graphics::material_init_info make_material(id::id_type vs_id, id::id_type ps_id)
+    {
+        graphics::material_init_info info{};
+        info.type = graphics::material_type::opaque;
+        info.shader_ids[graphics::shader_type::vertex] = vs_id;
+        info.shader_ids[graphics::shader_type::pixel] = ps_id;
+        return info;
+    }
+}
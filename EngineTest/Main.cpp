@@ -10,6 +10,20 @@
 #include "TestWindow.h"
 #elif TEST_RENDERER
 #include"TestRenderer.h"
+#elif TEST_CONTENT_REGISTRIES
+#include "TestContentRegistries.h"
+#elif TEST_CONTENT_ALLOCATOR
+#include "TestContentAllocator.h"
+#elif TEST_FRUSTUM_CULLING
+#include "TestFrustumCulling.h"
+#elif TEST_OCCLUSION_CULLING
+#include "TestOcclusionCulling.h"
+#elif TEST_DRAW_SORTING
+#include "TestDrawSorting.h"
+#elif TEST_INSTANCING
+#include "TestInstancing.h"
+#elif TEST_GPU_SCENE
+#include "TestGpuScene.h"
 #else
 #error One of the tests need to be enabled
 #endif
@@ -55,19 +55,31 @@ namespace {
 
         const char* shader_path{ "..\\..\\enginetest\\" };
 
-        std::wstring defines[]{ L"ELEMENTS_TYPE=1", L"ELEMENTS_TYPE=3" };
+        // NOTE: one vertex shader for every element layout, with and without quantized positions.
+        using tools::elements::elements_type;
+        const u32 layouts[]{
+            elements_type::static_normal,
+            elements_type::static_normal_texture,
+            elements_type::static_normal_octahedral,
+            elements_type::static_normal_texture_octahedral,
+            elements_type::static_normal_texture_quaternion,
+        };
+
         utl::vector<u32> keys;
-        keys.emplace_back(tools::elements::elements_type::static_normal);
-        keys.emplace_back(tools::elements::elements_type::static_normal_texture);
+        for (u32 layout : layouts)
+        {
+            keys.emplace_back(layout);
+            keys.emplace_back(layout | elements_type::quantized_position);
+        }
 
         utl::vector<std::wstring> extra_args{};
         utl::vector<std::unique_ptr<u8[]>> vertex_shaders;
         utl::vector<const u8*> vertex_shader_pointers;
-        for (u32 i{ 0 }; i < _countof(defines); ++i)
+        for (u32 i{ 0 }; i < keys.size(); ++i)
         {
             extra_args.clear();
             extra_args.emplace_back(L"-D");
-            extra_args.emplace_back(defines[i]);
+            extra_args.emplace_back(L"ELEMENTS_TYPE=" + std::to_wstring(keys[i]));
             vertex_shaders.emplace_back(std::move(compile_shader(info, shader_path, extra_args)));
             assert(vertex_shaders.back().get());
             vertex_shader_pointers.emplace_back(vertex_shaders.back().get());
@@ -6,6 +6,13 @@
 #define TEST_ENTITY_COMPONENTS 0
 #define TEST_WINDOW 0
 #define TEST_RENDERER 1
+#define TEST_CONTENT_REGISTRIES 0
+#define TEST_CONTENT_ALLOCATOR 0
+#define TEST_FRUSTUM_CULLING 0
+#define TEST_OCCLUSION_CULLING 0
+#define TEST_DRAW_SORTING 0
+#define TEST_INSTANCING 0
+#define TEST_GPU_SCENE 0
 
 class test
 {
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Test.h"
+#include "ContentTestData.h"
+#include "ShaderCompilation.h"
+#include "Graphics/Direct3D12/D3D12Content.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace nidhog;
+
+// Benchmark for the slab allocators that store geometry hierarchies and materials.
+// We create geometries with 2 to 4 LODs and 50k materials through content::create_resource, and interleave
+// unrelated allocations like a real level load would. Then we walk all of them the way the renderer does each
+// frame (get_submesh_gpu_ids, get_lod_offsets and material::get_materials), and churn through removing and
+// re-adding a quarter of them to see how fragmentation develops. The allocators' stats are printed after each step.
+// NOTE: every submesh is a GPU buffer, so there are far fewer geometries than materials. Buffers of removed
+//       submeshes are only released when rendering, which this test doesn't do, so run() only churns once.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        if (!compile_shaders() || !graphics::initialize(graphics::graphics_platform::direct3d12)) return false;
+
+        for (u32 i{ 0 }; i < shader_group_count; ++i)
+        {
+            const auto shader{ content_test::make_shader(i) };
+            const u8* const shaders[]{ shader.get() };
+            const u32 key{ 0 };
+            _shader_groups[i] = content::add_shader_group(&shaders[0], 1, &key);
+            if (!id::is_valid(_shader_groups[i])) return false;
+        }
+
+        return true;
+    }
+
+    void run() override
+    {
+        if (_has_run) return;
+        _has_run = true;
+
+        results r{};
+        _geometries.resize(geometry_count);
+        _materials.resize(material_count);
+        std::vector<std::unique_ptr<u8[]>> noise;
+
+        auto start{ clock::now() };
+        for (u32 i{ 0 }; i < material_count; ++i)
+        {
+            if (i < geometry_count) _geometries[i] = create_geometry(i);
+            _materials[i] = create_material(i);
+            // NOTE: other systems allocate during a level load too.
+            noise.emplace_back(std::make_unique<u8[]>(32 + (i * 2654435761u >> 7) % 512));
+        }
+        r.create_ms = elapsed_us(start) * 1e-3;
+        print_stats("created", r.create_ms);
+
+        start = clock::now();
+        u64 checksum{ 0 };
+        for (u32 frame{ 0 }; frame < frame_count; ++frame) checksum += read_all();
+        r.frame_us = elapsed_us(start) / frame_count;
+
+        start = clock::now();
+        for (u32 i{ 0 }; i < material_count; i += 4)
+        {
+            if (i < geometry_count) content::destroy_resource(_geometries[i].id, content::asset_type::mesh);
+            content::destroy_resource(_materials[i], content::asset_type::material);
+        }
+        print_stats("removed a quarter", elapsed_us(start) * 1e-3);
+
+        start = clock::now();
+        for (u32 i{ 0 }; i < material_count; i += 4)
+        {
+            // NOTE: new content, so the content caches don't hand back something that's still there.
+            if (i < geometry_count) _geometries[i] = create_geometry(i + geometry_count);
+            _materials[i] = create_material(i + material_count);
+        }
+        r.churn_ms = elapsed_us(start) * 1e-3;
+        print_stats("re-added", r.churn_ms);
+
+        // NOTE: keep the compiler from optimizing the reads away.
+        if (checksum == 0xdeadbeef) OutputDebugStringA(" ");
+
+        std::ostringstream out;
+        out << "frame " << r.frame_us << " us\n";
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    void shutdown() override
+    {
+        for (const auto& geometry : _geometries) content::destroy_resource(geometry.id, content::asset_type::mesh);
+        for (const auto& material : _materials) content::destroy_resource(material, content::asset_type::material);
+        for (const auto& group : _shader_groups) content::remove_shader_group(group);
+        graphics::shutdown();
+    }
+
+private:
+    constexpr static u32 geometry_count{ 1'000 };
+    constexpr static u32 material_count{ 50'000 };
+    constexpr static u32 shader_group_count{ 512 };
+    constexpr static u32 frame_count{ 100 };
+
+    using clock = std::chrono::high_resolution_clock;
+
+    struct geometry
+    {
+        id::id_type id;
+        u32         gpu_id_count;
+    };
+
+    struct results
+    {
+        double create_ms{ 0.0 };
+        double frame_us{ 0.0 };
+        double churn_ms{ 0.0 };
+    };
+
+    // NOTE: 2 to 4 LODs of 1 or 2 submeshes, so hierarchies come in different sizes.
+    static geometry create_geometry(u32 seed)
+    {
+        const u32 lod_count{ 2 + seed % 3 };
+        const u32 submesh_count{ 1 + (seed >> 2) % 2 };
+        const auto data{ content_test::make_geometry(seed, lod_count, submesh_count) };
+        const id::id_type id{ content::create_resource(data.get(), content::asset_type::mesh) };
+        assert(id::is_valid(id));
+        return { id, lod_count * submesh_count };
+    }
+
+    // NOTE: every seed below shader_group_count^2 gives a different pair of shader groups, so a different material.
+    id::id_type create_material(u32 seed) const
+    {
+        const graphics::material_init_info info{ content_test::make_material(_shader_groups[seed % shader_group_count],
+                                                                             _shader_groups[(seed / shader_group_count) % shader_group_count]) };
+        const id::id_type id{ content::create_resource(&info, content::asset_type::material) };
+        assert(id::is_valid(id));
+        return id;
+    }
+
+    u64 read_all()
+    {
+        u64 checksum{ 0 };
+        _geometry_ids.clear();
+        _thresholds.clear();
+        for (u32 i{ 0 }; i < geometry_count; ++i)
+        {
+            id::id_type gpu_ids[8]{};
+            content::get_submesh_gpu_ids(_geometries[i].id, _geometries[i].gpu_id_count, &gpu_ids[0]);
+            checksum += gpu_ids[0];
+            _geometry_ids.emplace_back(_geometries[i].id);
+            _thresholds.emplace_back((f32)(i % 40));
+        }
+
+        _lod_offsets.clear();
+        content::get_lod_offsets(_geometry_ids.data(), _thresholds.data(), geometry_count, _lod_offsets);
+        checksum += _lod_offsets[geometry_count - 1].offset;
+
+        _root_signatures.resize(material_count);
+        _material_types.resize(material_count);
+        graphics::d3d12::content::material::get_materials(_materials.data(), material_count,
+                                                          { _root_signatures.data(), _material_types.data() });
+        checksum += (uintptr_t)_root_signatures[material_count - 1];
+        return checksum;
+    }
+
+    static double elapsed_us(clock::time_point start)
+    {
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() * 1e-3;
+    }
+
+    static void print_stats(const char* step, double ms)
+    {
+        std::ostringstream out;
+        out << step << " in " << ms << " ms\n";
+        print_allocator_stats(out, "  hierarchies", content::get_geometry_allocator_stats());
+        print_allocator_stats(out, "  materials", graphics::d3d12::content::get_allocator_stats());
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    static void print_allocator_stats(std::ostringstream& out, const char* name, const utl::slab_allocator_stats& stats)
+    {
+        out << name << ": used " << stats.bytes_used << " bytes of " << stats.bytes_reserved << " reserved in "
+            << stats.slab_count << " slabs and " << stats.large_allocation_count << " large allocations, fragmentation "
+            << stats.fragmentation() * 100.f << "%\n";
+    }
+
+    id::id_type                             _shader_groups[shader_group_count]{};
+    utl::vector<geometry>                   _geometries;
+    utl::vector<id::id_type>                _materials;
+    utl::vector<id::id_type>                _geometry_ids;
+    utl::vector<f32>                        _thresholds;
+    utl::vector<content::lod_offset>        _lod_offsets;
+    utl::vector<ID3D12RootSignature*>       _root_signatures;
+    utl::vector<graphics::material_type::type> _material_types;
+    bool                                    _has_run{ false };
+};
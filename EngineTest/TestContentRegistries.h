@@ -0,0 +1,263 @@
+#pragma once
+
+#include "Test.h"
+#include "ContentTestData.h"
+#include "ShaderCompilation.h"
+#include "Graphics/Direct3D12/D3D12Content.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace nidhog;
+
+// Contention benchmark for the content registries.
+// A reader thread walks a resident set of shader groups, geometries and materials at 60 Hz through the same
+// getters the render thread uses in prepare_render_frame (get_shader, get_lod_offsets, get_submesh_gpu_ids,
+// get_submesh_bounds and material::get_materials), and checks what it reads. Meanwhile, loader threads keep
+// adding and removing other shader groups, geometries and materials through content::add_shader_group and
+// content::create_resource. We run it once without loaders and once with them, and compare the reader's frame
+// times. With the epoch scheme, the reader shouldn't slow down much while the loaders are busy.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        if (!compile_shaders() || !graphics::initialize(graphics::graphics_platform::direct3d12)) return false;
+
+        for (u32 i{ 0 }; i < resident_shader_group_count; ++i)
+        {
+            _shader_groups.emplace_back(add_shader_group(next_seed()));
+        }
+
+        for (u32 i{ 0 }; i < resident_geometry_count; ++i)
+        {
+            // NOTE: half of the geometries are single submeshes, which are stored differently.
+            const u32 seed{ next_seed() };
+            const u32 lod_count{ (i & 1) ? 2u : 1u };
+            const u32 submesh_count{ (i & 1) ? 2u : 1u };
+            const auto data{ content_test::make_geometry(seed, lod_count, submesh_count) };
+            const id::id_type id{ content::create_resource(data.get(), content::asset_type::mesh) };
+            if (!id::is_valid(id)) return false;
+            _geometries.push_back({ id, seed, lod_count * submesh_count, submesh_count });
+        }
+
+        for (u32 i{ 0 }; i < resident_material_count; ++i)
+        {
+            const graphics::material_init_info info{ content_test::make_material(_shader_groups[i % resident_shader_group_count].id,
+                                                                                 _shader_groups[(i * 7 + 1) % resident_shader_group_count].id) };
+            const id::id_type id{ content::create_resource(&info, content::asset_type::material) };
+            if (!id::is_valid(id)) return false;
+            _materials.emplace_back(id);
+        }
+
+        return true;
+    }
+
+    void run() override
+    {
+        const results idle{ run_benchmark(0) };
+        const results loading{ run_benchmark(loader_count) };
+        print_results("no loaders", idle);
+        print_results("4 loaders", loading);
+    }
+
+    void shutdown() override
+    {
+        for (const auto& material : _materials) content::destroy_resource(material, content::asset_type::material);
+        for (const auto& geometry : _geometries) content::destroy_resource(geometry.id, content::asset_type::mesh);
+        for (const auto& group : _shader_groups) content::remove_shader_group(group.id);
+        graphics::shutdown();
+    }
+
+private:
+    constexpr static u32 loader_count{ 4 };
+    constexpr static u32 resident_shader_group_count{ 256 };
+    constexpr static u32 resident_geometry_count{ 1024 };
+    constexpr static u32 resident_material_count{ 256 };
+    // NOTE: removed submeshes release their GPU buffers through deferred_release(), which only runs while
+    //       rendering. This test doesn't render, so we cap the number of geometries the loaders create per run.
+    constexpr static u32 max_geometry_loads{ 512 };
+    constexpr static u32 run_seconds{ 3 };
+
+    using clock = std::chrono::high_resolution_clock;
+
+    struct shader_group
+    {
+        id::id_type id;
+        u32         seed;
+    };
+
+    struct geometry
+    {
+        id::id_type id;
+        u32         seed;
+        u32         gpu_id_count;
+        u32         submeshes_per_lod;
+    };
+
+    struct results
+    {
+        u64 frames{ 0 };
+        u64 loads{ 0 };
+        u64 errors{ 0 };
+        double avg_frame_us{ 0.0 };
+        double max_frame_us{ 0.0 };
+    };
+
+    // NOTE: seeds are never reused, so loaded content is never merged with content that's already there,
+    //       not even when run() is called again.
+    u32 next_seed() { return _seed.fetch_add(1, std::memory_order_relaxed); }
+
+    // A group of a vertex and a pixel shader variant (keys 0 and 1), made with seed and seed + (1 << 31).
+    static shader_group add_shader_group(u32 seed)
+    {
+        const auto vs{ content_test::make_shader(seed) };
+        const auto ps{ content_test::make_shader(seed | 0x80000000) };
+        const u8* const shaders[]{ vs.get(), ps.get() };
+        const u32 keys[]{ 0, 1 };
+        return { content::add_shader_group(&shaders[0], _countof(shaders), &keys[0]), seed };
+    }
+
+    static bool check_shader_group(const shader_group& group)
+    {
+        const content::compiled_shader_ptr vs{ content::get_shader(group.id, 0) };
+        const content::compiled_shader_ptr ps{ content::get_shader(group.id, 1) };
+        return vs && ps && content_test::shader_seed(vs) == group.seed && content_test::shader_seed(ps) == (group.seed | 0x80000000);
+    }
+
+    // One loader iteration: add, check and remove a shader group, and the same for a material that uses it
+    // and (while there's budget left) a geometry.
+    u64 load_and_unload(std::atomic<u32>& geometry_loads)
+    {
+        u64 errors{ 0 };
+        const shader_group group{ add_shader_group(next_seed()) };
+        if (!id::is_valid(group.id) || !check_shader_group(group)) ++errors;
+
+        const graphics::material_init_info info{ content_test::make_material(group.id, group.id) };
+        const id::id_type material_id{ content::create_resource(&info, content::asset_type::material) };
+        if (id::is_valid(material_id)) content::destroy_resource(material_id, content::asset_type::material);
+        else ++errors;
+
+        if (geometry_loads.fetch_add(1, std::memory_order_relaxed) < max_geometry_loads)
+        {
+            const auto data{ content_test::make_geometry(next_seed(), 2, 2) };
+            const id::id_type geometry_id{ content::create_resource(data.get(), content::asset_type::mesh) };
+            if (id::is_valid(geometry_id)) content::destroy_resource(geometry_id, content::asset_type::mesh);
+            else ++errors;
+        }
+
+        if (id::is_valid(group.id)) content::remove_shader_group(group.id);
+        return errors;
+    }
+
+    results run_benchmark(u32 loader_threads)
+    {
+        std::atomic<bool> done{ false };
+        std::atomic<u64> loads{ 0 };
+        std::atomic<u64> loader_errors{ 0 };
+        std::atomic<u32> geometry_loads{ 0 };
+
+        std::vector<std::thread> loaders;
+        for (u32 i{ 0 }; i < loader_threads; ++i)
+        {
+            loaders.emplace_back([&]() {
+                u64 count{ 0 };
+                u64 errors{ 0 };
+                while (!done.load(std::memory_order_relaxed))
+                {
+                    errors += load_and_unload(geometry_loads);
+                    ++count;
+                }
+                loads += count;
+                loader_errors += errors;
+            });
+        }
+
+        results result{};
+        const auto start{ clock::now() };
+        auto next_frame{ start };
+        while (clock::now() - start < std::chrono::seconds{ run_seconds })
+        {
+            const auto frame_start{ clock::now() };
+            result.errors += read_all();
+            const double frame_us{ (double)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - frame_start).count() * 1e-3 };
+
+            ++result.frames;
+            result.avg_frame_us += (frame_us - result.avg_frame_us) / (double)result.frames;
+            result.max_frame_us = std::max(result.max_frame_us, frame_us);
+
+            next_frame += std::chrono::microseconds{ 16667 };
+            std::this_thread::sleep_until(next_frame);
+        }
+
+        done = true;
+        for (auto& loader : loaders) loader.join();
+        result.loads = loads;
+        result.errors += loader_errors;
+        return result;
+    }
+
+    // Reads all resident content like the render thread does in a frame, and returns the number of
+    // things that weren't what was created.
+    u64 read_all()
+    {
+        u64 errors{ 0 };
+        for (const auto& group : _shader_groups)
+        {
+            if (!check_shader_group(group)) ++errors;
+        }
+
+        _geometry_ids.clear();
+        _thresholds.clear();
+        for (const auto& geometry : _geometries)
+        {
+            _geometry_ids.emplace_back(geometry.id);
+            _thresholds.emplace_back(15.f);
+        }
+        _lod_offsets.clear();
+        content::get_lod_offsets(_geometry_ids.data(), _thresholds.data(), (u32)_geometry_ids.size(), _lod_offsets);
+        for (u32 i{ 0 }; i < (u32)_geometries.size(); ++i)
+        {
+            if (_lod_offsets[i].count != _geometries[i].submeshes_per_lod) ++errors;
+        }
+
+        for (const auto& geometry : _geometries)
+        {
+            id::id_type gpu_ids[4]{};
+            content::mesh_bounds bounds[4]{};
+            content::get_submesh_gpu_ids(geometry.id, geometry.gpu_id_count, &gpu_ids[0]);
+            content::get_submesh_bounds(&gpu_ids[0], geometry.gpu_id_count, &bounds[0]);
+            for (u32 i{ 0 }; i < geometry.gpu_id_count; ++i)
+            {
+                if (bounds[i].aabb_center.x != content_test::submesh_center_x(geometry.seed)) ++errors;
+            }
+        }
+
+        ID3D12RootSignature* root_signatures[resident_material_count]{};
+        graphics::material_type::type material_types[resident_material_count]{};
+        graphics::d3d12::content::material::get_materials(_materials.data(), (u32)_materials.size(),
+                                                          { &root_signatures[0], &material_types[0] });
+        for (u32 i{ 0 }; i < resident_material_count; ++i)
+        {
+            if (!root_signatures[i] || material_types[i] != graphics::material_type::opaque) ++errors;
+        }
+
+        return errors;
+    }
+
+    void print_results(const char* name, const results& r) const
+    {
+        std::ostringstream out;
+        out << name << ": " << r.frames << " reader frames, avg " << r.avg_frame_us << " us, max " << r.max_frame_us
+            << " us, " << (r.loads / run_seconds) << " loads/s, " << r.errors << " errors\n";
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    std::atomic<u32>                    _seed{ 1 };
+    utl::vector<shader_group>           _shader_groups;
+    utl::vector<geometry>               _geometries;
+    utl::vector<id::id_type>            _materials;
+    utl::vector<id::id_type>            _geometry_ids;
+    utl::vector<f32>                    _thresholds;
+    utl::vector<content::lod_offset>    _lod_offsets;
+};
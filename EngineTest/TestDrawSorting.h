@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Test.h"
+#include "..\Engine\Common\CommonHeaders.h"
+#include "Utilities/RadixSort.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace nidhog;
+
+// Headless benchmark for sorting draws by their 64-bit keys.
+// We make up draw keys with the same layout as content::render_item::get_draw_keys() for a scene with a few
+// root signatures, pipeline states, materials and submeshes, and count how often the states change between
+// consecutive draws before and after sorting. We also compare the time of the radix sort with std::sort.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        create_keys();
+        return true;
+    }
+
+    void run() override
+    {
+        const state_changes unsorted{ count_state_changes(_keys) };
+
+        std::vector<u64> keys{ _keys };
+        std::vector<u32> order(item_count);
+        std::vector<u64> scratch_keys(item_count);
+        std::vector<u32> scratch_order(item_count);
+        double radix_ms{ 0.0 };
+        for (u32 i{ 0 }; i < run_count; ++i)
+        {
+            keys = _keys;
+            for (u32 k{ 0 }; k < item_count; ++k) order[k] = k;
+            const auto start{ clock::now() };
+            utl::radix_sort(keys.data(), order.data(), item_count, scratch_keys.data(), scratch_order.data());
+            radix_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        }
+
+        double std_sort_ms{ 0.0 };
+        std::vector<u64> std_keys;
+        for (u32 i{ 0 }; i < run_count; ++i)
+        {
+            std_keys = _keys;
+            const auto start{ clock::now() };
+            std::sort(std_keys.begin(), std_keys.end());
+            std_sort_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        }
+
+        const state_changes sorted{ count_state_changes(keys) };
+        const bool same_result{ keys == std_keys };
+
+        std::ostringstream out;
+        out << item_count << " draws. state changes (root signature/pipeline state/material/geometry) unsorted: "
+            << unsorted.root_signatures << "/" << unsorted.pipeline_states << "/" << unsorted.materials << "/" << unsorted.geometries
+            << ", sorted: " << sorted.root_signatures << "/" << sorted.pipeline_states << "/" << sorted.materials << "/" << sorted.geometries
+            << ". radix sort: " << radix_ms / run_count << " ms, std::sort: " << std_sort_ms / run_count << " ms"
+            << (same_result ? "" : " (DIFFERENT RESULTS!)") << "\n";
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    void shutdown() override {}
+
+private:
+    constexpr static u32 item_count{ 100'000 };
+    constexpr static u32 run_count{ 20 };
+    constexpr static u32 root_signature_count{ 4 };
+    constexpr static u32 pipeline_state_count{ 64 };
+    constexpr static u32 material_count{ 256 };
+    constexpr static u32 submesh_count{ 2048 };
+
+    using clock = std::chrono::high_resolution_clock;
+
+    struct state_changes
+    {
+        u32 root_signatures{ 0 };
+        u32 pipeline_states{ 0 };
+        u32 materials{ 0 };
+        u32 geometries{ 0 };
+    };
+
+    void create_keys()
+    {
+        std::mt19937 rng{ 1 };
+        std::uniform_int_distribution<u32> submesh{ 0, submesh_count - 1 };
+        std::uniform_real_distribution<f32> depth{ 0.1f, 1000.f };
+
+        _keys.resize(item_count);
+        for (u32 i{ 0 }; i < item_count; ++i)
+        {
+            // NOTE: a material always uses the same root signature and pipeline state, like in the renderer.
+            const u32 geometry{ submesh(rng) };
+            const u32 material{ geometry % material_count };
+            const u32 pipeline_state{ material % pipeline_state_count };
+            const u32 root_signature{ pipeline_state % root_signature_count };
+            const f32 d{ depth(rng) };
+            u32 depth_bits;
+            memcpy(&depth_bits, &d, sizeof(u32));
+            _keys[i] = (u64)root_signature << 52 | (u64)pipeline_state << 40 | (u64)material << 28 |
+                       (u64)geometry << 16 | (depth_bits >> 16);
+        }
+    }
+
+    static state_changes count_state_changes(const std::vector<u64>& keys)
+    {
+        state_changes changes{};
+        u64 previous{ ~0ull };
+        for (const u64 key : keys)
+        {
+            if ((key >> 52) != (previous >> 52)) ++changes.root_signatures;
+            if (((key >> 40) & 0xfff) != ((previous >> 40) & 0xfff)) ++changes.pipeline_states;
+            if (((key >> 28) & 0xfff) != ((previous >> 28) & 0xfff)) ++changes.materials;
+            if (((key >> 16) & 0xfff) != ((previous >> 16) & 0xfff)) ++changes.geometries;
+            previous = key;
+        }
+
+        return changes;
+    }
+
+    std::vector<u64>    _keys;
+};
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "Test.h"
+#include "..\Engine\Common\CommonHeaders.h"
+#include "Content/ContentToEngine.h"
+#include "Graphics/FrustumCulling.h"
+
+#include <random>
+#include <sstream>
+
+using namespace nidhog;
+
+// Headless benchmark for the CPU frustum culling that runs before the depth prepass.
+// 1M items with random bounds and transforms are scattered around the camera. We measure how long it
+// takes to set the world bounds of all items (like when everything moves), to cull them with a turning
+// camera (every item is tested), with a still camera (static items reuse last frame's results), and with
+// a still camera while 10% of the items move every frame.
+// Every culled frame is also checked against a plain scalar sphere/AABB test of all items, outside of the
+// measured time. Any difference is reported as a failure.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        graphics::culling::initialize();
+        create_items();
+        return true;
+    }
+
+    void run() override
+    {
+        results r{};
+        r.set_all_ms = set_all();
+        r.turning_camera_ms = cull_frames(true, false);
+        r.still_camera_ms = cull_frames(false, false);
+        r.moving_items_ms = cull_frames(false, true);
+        print_results(r);
+        assert(!_mismatch_count);
+    }
+
+    void shutdown() override
+    {
+        graphics::culling::shutdown();
+    }
+
+private:
+    constexpr static u32 item_count{ 1'000'000 };
+    constexpr static u32 frame_count{ 60 };
+    constexpr static u32 moving_item_stride{ 10 };
+    constexpr static f32 scene_size{ 1000.f };
+
+    using clock = std::chrono::high_resolution_clock;
+
+    // World space bounds of an item for the reference test.
+    struct world_bounds
+    {
+        math::v3 aabb_center;
+        math::v3 aabb_extents;
+        math::v3 sphere_center;
+        f32 sphere_radius;
+    };
+
+    struct results
+    {
+        double set_all_ms{ 0.0 };
+        double turning_camera_ms{ 0.0 };
+        double still_camera_ms{ 0.0 };
+        double moving_items_ms{ 0.0 };
+    };
+
+    void create_items()
+    {
+        std::mt19937 rng{ 1 };
+        std::uniform_real_distribution<f32> position{ -scene_size * 0.5f, scene_size * 0.5f };
+        std::uniform_real_distribution<f32> size{ 0.5f, 5.f };
+        std::uniform_real_distribution<f32> angle{ 0.f, DirectX::XM_2PI };
+
+        _item_ids.resize(item_count);
+        _local_bounds.resize(item_count);
+        _world_matrices.resize(item_count);
+        _world_bounds.resize(item_count);
+        _visible_indices.resize(item_count);
+        _reference_indices.resize(item_count);
+
+        using namespace DirectX;
+        for (u32 i{ 0 }; i < item_count; ++i)
+        {
+            _item_ids[i] = i;
+            const math::v3 extents{ size(rng), size(rng), size(rng) };
+            content::mesh_bounds& b{ _local_bounds[i] };
+            b.aabb_center = { 0.f, extents.y, 0.f };
+            b.aabb_extents = extents;
+            b.sphere_center = b.aabb_center;
+            b.sphere_radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&extents)));
+            b.lod_error = 0.f;
+
+            const XMMATRIX world{ XMMatrixRotationY(angle(rng)) * XMMatrixTranslation(position(rng), position(rng), position(rng)) };
+            XMStoreFloat4x4(&_world_matrices[i], world);
+            _world_bounds[i] = transform_bounds(b, _world_matrices[i]);
+        }
+    }
+
+    // NOTE: the reference test uses the same arithmetic, in the same order, as bounds_table, so both give
+    //       exactly the same result for items that touch a plane.
+    [[nodiscard]] static world_bounds transform_bounds(const content::mesh_bounds& b, const math::m4x4& m)
+    {
+        const math::v3& c{ b.aabb_center };
+        const math::v3& e{ b.aabb_extents };
+        const math::v3& s{ b.sphere_center };
+        world_bounds w{};
+        w.aabb_center = { c.x * m._11 + c.y * m._21 + c.z * m._31 + m._41,
+                          c.x * m._12 + c.y * m._22 + c.z * m._32 + m._42,
+                          c.x * m._13 + c.y * m._23 + c.z * m._33 + m._43 };
+        w.aabb_extents = { e.x * fabsf(m._11) + e.y * fabsf(m._21) + e.z * fabsf(m._31),
+                           e.x * fabsf(m._12) + e.y * fabsf(m._22) + e.z * fabsf(m._32),
+                           e.x * fabsf(m._13) + e.y * fabsf(m._23) + e.z * fabsf(m._33) };
+        w.sphere_center = { s.x * m._11 + s.y * m._21 + s.z * m._31 + m._41,
+                            s.x * m._12 + s.y * m._22 + s.z * m._32 + m._42,
+                            s.x * m._13 + s.y * m._23 + s.z * m._33 + m._43 };
+        const f32 scale_x{ m._11 * m._11 + m._12 * m._12 + m._13 * m._13 };
+        const f32 scale_y{ m._21 * m._21 + m._22 * m._22 + m._23 * m._23 };
+        const f32 scale_z{ m._31 * m._31 + m._32 * m._32 + m._33 * m._33 };
+        w.sphere_radius = b.sphere_radius * sqrtf(std::max(scale_x, std::max(scale_y, scale_z)));
+        return w;
+    }
+
+    // Tests one item at a time: it's culled if its sphere or its AABB is completely behind one of the planes.
+    [[nodiscard]] static bool is_visible(const graphics::culling::frustum& f, const world_bounds& w)
+    {
+        for (const math::v4& p : f.planes)
+        {
+            const f32 sphere_distance{ (p.x * w.sphere_center.x + p.y * w.sphere_center.y) + (p.z * w.sphere_center.z + p.w) };
+            const f32 center_distance{ (p.x * w.aabb_center.x + p.y * w.aabb_center.y) + (p.z * w.aabb_center.z + p.w) };
+            const f32 projected_extents{ (fabsf(p.x) * w.aabb_extents.x + fabsf(p.y) * w.aabb_extents.y) + fabsf(p.z) * w.aabb_extents.z };
+            if (!(sphere_distance >= -w.sphere_radius) || !(center_distance + projected_extents >= 0.f)) return false;
+        }
+
+        return true;
+    }
+
+    // Compares the visible items of the last cull() with the reference test and returns the number of differences.
+    [[nodiscard]] u32 verify_frame(const graphics::culling::frustum& f)
+    {
+        u32 reference_count{ 0 };
+        for (u32 i{ 0 }; i < item_count; ++i)
+        {
+            _reference_indices[reference_count] = i;
+            reference_count += is_visible(f, _world_bounds[i]) ? 1 : 0;
+        }
+
+        u32 mismatch_count{ 0 };
+        u32 a{ 0 }, b{ 0 };
+        while (a < _visible_count || b < reference_count)
+        {
+            if (a < _visible_count && b < reference_count && _visible_indices[a] == _reference_indices[b]) { ++a; ++b; }
+            else if (b == reference_count || (a < _visible_count && _visible_indices[a] < _reference_indices[b])) { ++a; ++mismatch_count; }
+            else { ++b; ++mismatch_count; }
+        }
+
+        return mismatch_count;
+    }
+
+    [[nodiscard]] graphics::culling::frustum camera_frustum(u32 frame, bool turning) const
+    {
+        using namespace DirectX;
+        const f32 yaw{ turning ? (f32)frame * 0.05f : 0.f };
+        const XMMATRIX view{ XMMatrixLookToRH(XMVectorZero(), XMVectorSet(sinf(yaw), 0.f, -cosf(yaw), 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f)) };
+        // NOTE: same reversed depth projection as d3d12_camera.
+        const XMMATRIX projection{ XMMatrixPerspectiveFovRH(0.25f * XM_PI, 16.f / 9.f, scene_size, 0.1f) };
+        return graphics::culling::make_frustum(view * projection);
+    }
+
+    double set_all()
+    {
+        const auto start{ clock::now() };
+        _bounds.set(_item_ids.data(), _local_bounds.data(), _world_matrices.data(), item_count);
+        const double ms{ std::chrono::duration<double, std::milli>(clock::now() - start).count() };
+
+        // Items that moved in the last run are back where they started.
+        for (u32 i{ 0 }; i < item_count; ++i) _world_bounds[i] = transform_bounds(_local_bounds[i], _world_matrices[i]);
+        return ms;
+    }
+
+    double cull_frames(bool turning_camera, bool moving_items)
+    {
+        std::vector<id::id_type> moved_ids;
+        std::vector<content::mesh_bounds> moved_bounds;
+        std::vector<math::m4x4> moved_matrices;
+        if (moving_items)
+        {
+            for (u32 i{ 0 }; i < item_count; i += moving_item_stride)
+            {
+                moved_ids.emplace_back(_item_ids[i]);
+                moved_bounds.emplace_back(_local_bounds[i]);
+                moved_matrices.emplace_back(_world_matrices[i]);
+            }
+        }
+
+        double total_ms{ 0.0 };
+        for (u32 frame{ 0 }; frame < frame_count; ++frame)
+        {
+            if (moving_items)
+            {
+                for (auto& m : moved_matrices) m._41 += 0.1f;
+            }
+
+            const graphics::culling::frustum view_frustum{ camera_frustum(frame, turning_camera) };
+            const auto start{ clock::now() };
+            if (moving_items)
+            {
+                _bounds.set(moved_ids.data(), moved_bounds.data(), moved_matrices.data(), (u32)moved_ids.size());
+            }
+
+            _visible_count = _bounds.cull(view_frustum, _item_ids.data(), item_count, _visible_indices.data());
+            total_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            if (moving_items)
+            {
+                for (u32 i{ 0 }; i < (u32)moved_ids.size(); ++i)
+                {
+                    _world_bounds[moved_ids[i]] = transform_bounds(moved_bounds[i], moved_matrices[i]);
+                }
+            }
+
+            _mismatch_count += verify_frame(view_frustum);
+        }
+
+        return total_ms / frame_count;
+    }
+
+    void print_results(const results& r) const
+    {
+        std::ostringstream out;
+        out << item_count << " items, " << _visible_count << " visible. set all bounds: " << r.set_all_ms
+            << " ms, turning camera: " << r.turning_camera_ms << " ms/frame, still camera: " << r.still_camera_ms
+            << " ms/frame, 10% moving: " << r.moving_items_ms << " ms/frame, reference test: "
+            << (_mismatch_count ? "FAILED, " + std::to_string(_mismatch_count) + " items differ" : std::string{ "passed" }) << "\n";
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    graphics::culling::bounds_table     _bounds;
+    std::vector<id::id_type>            _item_ids;
+    std::vector<content::mesh_bounds>   _local_bounds;
+    std::vector<math::m4x4>             _world_matrices;
+    std::vector<world_bounds>           _world_bounds;
+    std::vector<u32>                    _visible_indices;
+    std::vector<u32>                    _reference_indices;
+    u32                                 _visible_count{ 0 };
+    u32                                 _mismatch_count{ 0 };
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Test.h"
+#include "..\Engine\Common\CommonHeaders.h"
+#include "Graphics/GpuScene.h"
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace nidhog;
+
+// Headless test and benchmark for the delta builder of the persistent per-object table.
+// 1M static objects and 10k dynamic objects (scattered among them) are checked every frame, like the gpass does
+// with its render items. Only the dynamic objects should be dirty, except in the first frame and after an object
+// was missing for a frame. We apply the copy ranges to a CPU copy of the table and compare it with the expected
+// data after every frame, and measure how long the dirty check, the build and writing the upload data take.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        std::mt19937 rng{ 1 };
+        std::uniform_int_distribution<u32> slot{ 0, static_object_count + dynamic_object_count - 1 };
+        _is_dynamic.resize(static_object_count + dynamic_object_count);
+        u32 dynamic_count{ 0 };
+        while (dynamic_count < dynamic_object_count)
+        {
+            u8& is_dynamic{ _is_dynamic[slot(rng)] };
+            dynamic_count += is_dynamic ? 0 : 1;
+            is_dynamic = 1;
+        }
+
+        _data.resize(_is_dynamic.size());
+        _table.resize(_is_dynamic.size());
+        return true;
+    }
+
+    void run() override
+    {
+        const u32 object_count{ (u32)_is_dynamic.size() };
+        graphics::gpu_scene::delta_builder delta{ sizeof(object_data) };
+        std::vector<u8> upload;
+        double first_frame_ms{ 0.0 };
+        double total_ms{ 0.0 };
+        u32 first_frame_dirty_count{ 0 };
+        u32 dirty_count{ 0 };
+        u32 copy_count{ 0 };
+        bool valid{ true };
+
+        for (u32 frame{ 0 }; frame < frame_count; ++frame)
+        {
+            // NOTE: the object in slot 0 is missing in frame 5, so it has to be uploaded again in frame 6.
+            const bool skip_first{ frame == 5 };
+            for (u32 i{ 0 }; i < object_count; ++i)
+            {
+                if (_is_dynamic[i]) _data[i].position[0] = (f32)frame;
+            }
+
+            const auto start{ clock::now() };
+            delta.begin_frame();
+            for (u32 i{ skip_first ? 1u : 0u }; i < object_count; ++i)
+            {
+                if (delta.is_dirty(i, i, _is_dynamic[i] && frame)) delta.add(i, &_data[i]);
+            }
+
+            delta.build();
+            upload.resize(delta.upload_size());
+            delta.write_upload_data(upload.data());
+            const double frame_ms{ std::chrono::duration<double, std::milli>(clock::now() - start).count() };
+            if (frame) total_ms += frame_ms;
+            else first_frame_ms = frame_ms;
+
+            for (const graphics::gpu_scene::copy_range& range : delta.ranges())
+            {
+                memcpy(&_table[range.first_slot], &upload[range.upload_offset], range.slot_count * sizeof(object_data));
+            }
+
+            valid &= !memcmp(&_table[skip_first ? 1 : 0], &_data[skip_first ? 1 : 0], (object_count - (skip_first ? 1 : 0)) * sizeof(object_data));
+            if (!frame) first_frame_dirty_count = delta.dirty_count();
+            if (frame == frame_count - 1)
+            {
+                dirty_count = delta.dirty_count();
+                copy_count = (u32)delta.ranges().size();
+            }
+        }
+
+        std::ostringstream out;
+        out << static_object_count << " static + " << dynamic_object_count << " dynamic objects. dirty in first frame: "
+            << first_frame_dirty_count << ", in last frame: " << dirty_count << " (" << copy_count << " copies). first frame: "
+            << first_frame_ms << " ms, then " << (total_ms / (frame_count - 1)) << " ms/frame" << (valid ? "" : " (TABLE DOESN'T MATCH!)") << "\n";
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    void shutdown() override {}
+
+private:
+    constexpr static u32 static_object_count{ 1'000'000 };
+    constexpr static u32 dynamic_object_count{ 10'000 };
+    constexpr static u32 frame_count{ 30 };
+
+    using clock = std::chrono::high_resolution_clock;
+
+    // Same size as hlsl::PerObjectData.
+    struct object_data
+    {
+        f32 world[16];
+        f32 inverse_world[16];
+        f32 position[8];
+    };
+
+    std::vector<u8>             _is_dynamic;
+    std::vector<object_data>    _data;
+    std::vector<object_data>    _table;     // what would be on the GPU
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Test.h"
+#include "..\Engine\Common\CommonHeaders.h"
+#include "Graphics/Instancing.h"
+#include "Utilities/RadixSort.h"
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace nidhog;
+
+// Headless test for the automatic instancing in the gpass.
+// We make up render items for a scene in which a few props are repeated many times, plus some unique items.
+// The items are sorted by draw keys with the same layout as content::render_item::get_draw_keys() and then
+// grouped like in the gpass. We check that the groups cover every item exactly once, that the items of a group
+// have the same submesh and material, and that no two neighbouring groups could have been merged. Then we
+// report how many draws instancing saves and how long the grouping takes.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        create_items();
+        return true;
+    }
+
+    void run() override
+    {
+        std::vector<u64> keys{ _keys };
+        std::vector<u32> order(item_count);
+        std::vector<u64> scratch_keys(item_count);
+        std::vector<u32> scratch_order(item_count);
+        for (u32 i{ 0 }; i < item_count; ++i) order[i] = i;
+        utl::radix_sort(keys.data(), order.data(), item_count, scratch_keys.data(), scratch_order.data());
+
+        std::vector<id::id_type> submesh_ids(item_count);
+        std::vector<id::id_type> material_ids(item_count);
+        for (u32 i{ 0 }; i < item_count; ++i)
+        {
+            submesh_ids[i] = _submesh_ids[order[i]];
+            material_ids[i] = _material_ids[order[i]];
+        }
+
+        std::vector<graphics::instancing::instance_group> groups(item_count);
+        u32 group_count{ 0 };
+        const auto start{ clock::now() };
+        for (u32 i{ 0 }; i < run_count; ++i)
+        {
+            group_count = graphics::instancing::make_groups(submesh_ids.data(), material_ids.data(), item_count, groups.data());
+        }
+        const double group_ms{ std::chrono::duration<double, std::milli>(clock::now() - start).count() / run_count };
+
+        const bool valid{ check_groups(groups.data(), group_count, submesh_ids, material_ids) };
+
+        std::ostringstream out;
+        out << item_count << " render items, " << group_count << " draws with instancing, " << item_count - group_count
+            << " draws saved. grouping: " << group_ms << " ms" << (valid ? "" : " (INVALID GROUPS!)") << "\n";
+        OutputDebugStringA(out.str().c_str());
+    }
+
+    void shutdown() override {}
+
+private:
+    constexpr static u32 item_count{ 50'000 };
+    constexpr static u32 run_count{ 100 };
+    constexpr static u32 prop_count{ 20 };              // repeated props, with up to 3 submeshes each
+    constexpr static u32 unique_item_stride{ 10 };      // every 10th item is unique
+
+    using clock = std::chrono::high_resolution_clock;
+
+    void create_items()
+    {
+        std::mt19937 rng{ 1 };
+        std::uniform_int_distribution<u32> prop{ 0, prop_count - 1 };
+        std::uniform_real_distribution<f32> depth{ 0.1f, 500.f };
+
+        _keys.resize(item_count);
+        _submesh_ids.resize(item_count);
+        _material_ids.resize(item_count);
+        id::id_type next_unique_id{ prop_count * 3 };
+        for (u32 i{ 0 }; i < item_count; ++i)
+        {
+            if (i % unique_item_stride)
+            {
+                const u32 p{ prop(rng) };
+                _submesh_ids[i] = p * 3 + i % 3;
+                _material_ids[i] = p;
+            }
+            else
+            {
+                _submesh_ids[i] = next_unique_id;
+                _material_ids[i] = next_unique_id % 64;
+                ++next_unique_id;
+            }
+
+            // NOTE: the pipeline state depends on the material only, like for submeshes with the same vertex layout.
+            const f32 d{ depth(rng) };
+            u32 depth_bits;
+            memcpy(&depth_bits, &d, sizeof(u32));
+            const u64 mask{ 0xfff };
+            _keys[i] = ((u64)_material_ids[i] % 8) << 40 | ((u64)_material_ids[i] & mask) << 28 |
+                       ((u64)_submesh_ids[i] & mask) << 16 | (depth_bits >> 16);
+        }
+    }
+
+    static bool check_groups(const graphics::instancing::instance_group* const groups, u32 group_count,
+                             const std::vector<id::id_type>& submesh_ids, const std::vector<id::id_type>& material_ids)
+    {
+        u32 next_item{ 0 };
+        for (u32 g{ 0 }; g < group_count; ++g)
+        {
+            const graphics::instancing::instance_group& group{ groups[g] };
+            if (group.first_item != next_item || !group.instance_count) return false;
+
+            for (u32 i{ group.first_item + 1 }; i < group.first_item + group.instance_count; ++i)
+            {
+                if (submesh_ids[i] != submesh_ids[group.first_item] || material_ids[i] != material_ids[group.first_item]) return false;
+            }
+
+            if (g && submesh_ids[group.first_item] == submesh_ids[group.first_item - 1] &&
+                material_ids[group.first_item] == material_ids[group.first_item - 1]) return false;
+
+            next_item += group.instance_count;
+        }
+
+        return next_item == item_count;
+    }
+
+    std::vector<u64>            _keys;
+    std::vector<id::id_type>    _submesh_ids;
+    std::vector<id::id_type>    _material_ids;
+};
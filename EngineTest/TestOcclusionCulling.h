@@ -0,0 +1,270 @@
+#pragma once
+
+#include "Test.h"
+#include "..\Engine\Common\CommonHeaders.h"
+#include "Components/Entity.h"
+#include "Components/Transform.h"
+#include "Content/ContentToEngine.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/OcclusionCulling.h"
+#include "Graphics/Renderer.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace nidhog;
+
+// Headless test and benchmark for the software occlusion culling.
+// We build a room with a few walls (the occluders) and a grid of boxes around it, rasterize the walls
+// and test all boxes. The depth buffer is written to occlusion_depth.pgm and compared with
+// EngineTest/occlusion_reference.pgm, so any change in what gets rasterized shows up. A few boxes behind and
+// in front of the walls check that the right ones are culled. The test fails if the reference image is
+// missing or differs, or if one of these boxes isn't culled (or is culled) when it should be.
+// The back wall is also registered as the occluder of an entity with graphics::add_occluder(), and the same
+// boxes go through frustum and occlusion culling like the render items in the gpass.
+// NOTE: after intended changes to the rasterizer, check occlusion_depth.pgm and copy it over the reference.
+class engine_test : public test
+{
+public:
+    bool initialize() override
+    {
+        create_scene();
+        return true;
+    }
+
+    void run() override
+    {
+        const auto start{ clock::now() };
+        u32 occluded_count{ 0 };
+        for (u32 frame{ 0 }; frame < frame_count; ++frame)
+        {
+            _buffer.clear(view_projection());
+            for (const wall& w : _walls)
+            {
+                _buffer.rasterize(&w.positions[0], _countof(w.positions), &wall_indices[0], _countof(wall_indices), identity());
+            }
+
+            _buffer.update_tiles();
+            occluded_count = 0;
+            for (const box& b : _boxes)
+            {
+                occluded_count += _buffer.is_occluded(b.center, b.extents) ? 1 : 0;
+            }
+        }
+        const double frame_ms{ std::chrono::duration<double, std::milli>(clock::now() - start).count() / frame_count };
+
+        write_image("occlusion_depth.pgm");
+        const char* const reference_result{ compare_with_reference("..\\..\\EngineTest\\occlusion_reference.pgm") };
+        const u32 wrong_probe_count{ test_probes() };
+        const u32 wrong_item_count{ test_engine_occluders() };
+
+        std::ostringstream out;
+        out << _walls.size() * 2 << " occluder triangles, " << _boxes.size() << " boxes, " << occluded_count
+            << " occluded, " << frame_ms << " ms/frame, reference image: " << (reference_result ? reference_result : "match")
+            << ", probe boxes: " << (wrong_probe_count ? "FAILED, " + std::to_string(wrong_probe_count) + " wrong" : std::string{ "passed" })
+            << ", engine occluders: " << (wrong_item_count ? "FAILED, " + std::to_string(wrong_item_count) + " wrong" : std::string{ "passed" }) << "\n";
+        OutputDebugStringA(out.str().c_str());
+        assert(!reference_result && !wrong_probe_count && !wrong_item_count);
+    }
+
+    void shutdown() override {}
+
+private:
+    constexpr static u32 buffer_width{ 256 };
+    constexpr static u32 buffer_height{ 128 };
+    constexpr static u32 frame_count{ 100 };
+    constexpr static u32 grid_size{ 64 };
+    constexpr static u32 wall_indices[6]{ 0, 1, 2, 0, 2, 3 };
+    constexpr static u32 back_wall_count{ 3 };  // the first walls, with the door between them
+
+    using clock = std::chrono::high_resolution_clock;
+
+    struct wall
+    {
+        math::v3 positions[4];
+    };
+
+    struct box
+    {
+        math::v3 center;
+        math::v3 extents;
+    };
+
+    // A box that the walls either hide completely or not at all.
+    struct probe
+    {
+        box b;
+        bool occluded;
+    };
+
+    constexpr static probe probes[]{
+        { { { -5.f, 0.5f, -15.f }, { 0.4f, 0.5f, 0.4f } }, true },     // behind the back wall, left of the door
+        { { { 6.f, 0.5f, -20.f }, { 0.4f, 0.5f, 0.4f } }, true },      // behind the back wall, right of the door
+        { { { -7.f, 3.f, -30.f }, { 2.f, 1.f, 2.f } }, true },         // large box far behind the back wall
+        { { { 0.f, 0.5f, -15.f }, { 0.4f, 0.5f, 0.4f } }, false },     // behind the door, seen through it
+        { { { -5.f, 0.5f, -8.f }, { 0.4f, 0.5f, 0.4f } }, false },     // in front of the back wall
+        { { { 3.f, 0.5f, -3.f }, { 0.4f, 0.5f, 0.4f } }, false },      // in front of the pillar
+        { { { 3.f, 7.f, -15.f }, { 0.4f, 0.4f, 0.4f } }, false },       // behind the back wall, but seen above it
+    };
+
+    static math::m4x4 identity()
+    {
+        math::m4x4 m;
+        DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixIdentity());
+        return m;
+    }
+
+    static DirectX::XMMATRIX view_projection()
+    {
+        using namespace DirectX;
+        const XMMATRIX view{ XMMatrixLookToRH(XMVectorSet(0.f, 1.7f, 0.f, 0.f), XMVectorSet(0.f, 0.f, -1.f, 0.f), XMVectorSet(0.f, 1.f, 0.f, 0.f)) };
+        // NOTE: same reversed depth projection as d3d12_camera.
+        const XMMATRIX projection{ XMMatrixPerspectiveFovRH(0.25f * XM_PI, 2.f, 1000.f, 0.1f) };
+        return view * projection;
+    }
+
+    void create_scene()
+    {
+        // A room of 20 x 4 x 20 meters around the camera, with a door in the back wall, and a pillar.
+        const auto add_wall = [this](math::v3 a, math::v3 b, f32 bottom, f32 top) {
+            _walls.push_back({ { { a.x, bottom, a.z }, { b.x, bottom, b.z }, { b.x, top, b.z }, { a.x, top, a.z } } });
+        };
+        add_wall({ -10.f, 0.f, -10.f }, { -1.f, 0.f, -10.f }, 0.f, 4.f);
+        add_wall({ 1.f, 0.f, -10.f }, { 10.f, 0.f, -10.f }, 0.f, 4.f);
+        add_wall({ -1.f, 0.f, -10.f }, { 1.f, 0.f, -10.f }, 2.5f, 4.f);
+        add_wall({ -10.f, 0.f, 10.f }, { -10.f, 0.f, -10.f }, 0.f, 4.f);
+        add_wall({ 10.f, 0.f, -10.f }, { 10.f, 0.f, 10.f }, 0.f, 4.f);
+        add_wall({ 2.5f, 0.f, -5.f }, { 3.5f, 0.f, -5.f }, 0.f, 4.f);
+
+        // Boxes in and around the room.
+        for (u32 z{ 0 }; z < grid_size; ++z)
+        {
+            for (u32 x{ 0 }; x < grid_size; ++x)
+            {
+                const f32 px{ -40.f + 80.f * (f32)x / (f32)(grid_size - 1) };
+                const f32 pz{ 30.f - 80.f * (f32)z / (f32)(grid_size - 1) };
+                _boxes.push_back({ { px, 0.5f, pz }, { 0.4f, 0.5f, 0.4f } });
+            }
+        }
+    }
+
+    void write_image(const char* file) const
+    {
+        std::ofstream image{ file, std::ios::out | std::ios::binary };
+        image << "P5\n" << _buffer.width() << " " << _buffer.height() << "\n255\n";
+        const f32* const depth{ _buffer.depth() };
+        for (u32 i{ 0 }; i < _buffer.width() * _buffer.height(); ++i)
+        {
+            // 1/w of 1 meter or closer is white, no occluder is black.
+            image.put((char)(u8)(std::min(depth[i], 1.f) * 255.f));
+        }
+    }
+
+    // Returns nullptr if the last depth image matches the reference, or why it doesn't.
+    // NOTE: depth is truncated to 8 bits, so a value that's a whole gray level (like 1/5 m) may round down by
+    //       one level with different math libraries. Pixels may differ by 1 level, but coverage has to match.
+    const char* compare_with_reference(const char* file) const
+    {
+        std::ifstream result{ "occlusion_depth.pgm", std::ios::in | std::ios::binary };
+        std::ifstream reference{ file, std::ios::in | std::ios::binary };
+        if (!reference) return "MISSING";
+
+        std::ostringstream a, b;
+        a << reference.rdbuf();
+        b << result.rdbuf();
+        const std::string expected{ a.str() };
+        const std::string actual{ b.str() };
+        if (expected.size() != actual.size()) return "MISMATCH (size)";
+
+        for (size_t i{ 0 }; i < expected.size(); ++i)
+        {
+            if (abs((s32)(u8)expected[i] - (s32)(u8)actual[i]) > 1) return "MISMATCH";
+        }
+
+        return nullptr;
+    }
+
+    // Returns the number of probe boxes that aren't culled correctly.
+    u32 test_probes() const
+    {
+        u32 wrong_count{ 0 };
+        for (const probe& p : probes)
+        {
+            wrong_count += _buffer.is_occluded(p.b.center, p.b.extents) != p.occluded ? 1 : 0;
+        }
+
+        return wrong_count;
+    }
+
+    // Adds the back wall with the door as the occluder of an entity, and culls the probe boxes and a box behind
+    // the camera the way the gpass culls render items. Returns the number of boxes that aren't culled
+    // correctly, including after the occluder is removed, when only the frustum should cull.
+    u32 test_engine_occluders() const
+    {
+        using namespace graphics::culling;
+        assert(!occluder_count());
+
+        // NOTE: the wall is in the entity's model space, the entity moves it back to z = -10.
+        transform::init_info transform_info{};
+        transform_info.position[2] = -10.f;
+        transform_info.rotation[3] = 1.f;
+        game_entity::entity_info entity_info{ &transform_info };
+        const game_entity::entity entity{ game_entity::create(entity_info) };
+        std::vector<math::v3> positions;
+        std::vector<u32> indices;
+        for (u32 i{ 0 }; i < back_wall_count; ++i)
+        {
+            for (u32 index : wall_indices) indices.emplace_back((u32)positions.size() + index);
+            for (const math::v3& p : _walls[i].positions) positions.push_back({ p.x, p.y, p.z + 10.f });
+        }
+
+        const id::id_type occluder_id{ graphics::add_occluder(entity.get_id(), positions.data(), (u32)positions.size(),
+                                                              indices.data(), (u32)indices.size()) };
+
+        constexpr u32 item_count{ _countof(probes) + 1 };
+        std::vector<id::id_type> item_ids(item_count);
+        std::vector<content::mesh_bounds> local_bounds(item_count);
+        std::vector<math::m4x4> world_matrices(item_count, identity());
+        std::vector<bool> expected_visible(item_count);
+        for (u32 i{ 0 }; i < item_count; ++i)
+        {
+            // NOTE: the last box is behind the camera, so it's culled by the frustum.
+            const box b{ i < _countof(probes) ? probes[i].b : box{ { 0.f, 0.5f, 10.f }, { 0.4f, 0.5f, 0.4f } } };
+            item_ids[i] = i;
+            content::mesh_bounds& bounds{ local_bounds[i] };
+            bounds.aabb_center = b.center;
+            bounds.aabb_extents = b.extents;
+            bounds.sphere_center = b.center;
+            bounds.sphere_radius = sqrtf(b.extents.x * b.extents.x + b.extents.y * b.extents.y + b.extents.z * b.extents.z);
+            bounds.lod_error = 0.f;
+            expected_visible[i] = i < _countof(probes) && !probes[i].occluded;
+        }
+
+        bounds_table bounds;
+        bounds.set(item_ids.data(), local_bounds.data(), world_matrices.data(), item_count);
+        occlusion_buffer buffer{ buffer_width, buffer_height };
+        std::vector<u32> visible_indices(item_count);
+
+        const DirectX::XMMATRIX vp{ view_projection() };
+        u32 visible_count{ bounds.cull(make_frustum(vp), item_ids.data(), item_count, visible_indices.data()) };
+        visible_count = cull_occluded(buffer, bounds, vp, item_ids.data(), visible_indices.data(), visible_count);
+
+        u32 wrong_count{ 0 };
+        std::vector<bool> visible(item_count);
+        for (u32 i{ 0 }; i < visible_count; ++i) visible[visible_indices[i]] = true;
+        for (u32 i{ 0 }; i < item_count; ++i) wrong_count += visible[i] != expected_visible[i] ? 1 : 0;
+
+        // Without occluders, only the frustum culls.
+        graphics::remove_occluder(occluder_id);
+        game_entity::remove(entity.get_id());
+        visible_count = bounds.cull(make_frustum(vp), item_ids.data(), item_count, visible_indices.data());
+        wrong_count += cull_occluded(buffer, bounds, vp, item_ids.data(), visible_indices.data(), visible_count) != item_count - 1 ? 1 : 0;
+
+        return wrong_count;
+    }
+
+    graphics::culling::occlusion_buffer _buffer{ buffer_width, buffer_height };
+    std::vector<wall>                   _walls;
+    std::vector<box>                    _boxes;
+};
@@ -23,76 +23,152 @@ struct PixelOut
 #define ElementsTypeSkeletalNormalColor         ElementsTypeSkeletalNormal | ElementsTypestaticColor
 #define ElementsTypeSkeletalNormalTexture       ElementsTypeSkeletal | ElementsTypeStaticNormalTexture
 #define ElementsTypeSkeletalNormalTextureColor  ElementsTypeSkeletalNormalTexture | ElementsTypeStaticColor
+#define ElementsTypeQuantizedPosition           0x10
+#define ElementsTypeOctahedralTSpace            0x20
+#define ElementsTypeQuaternionTSpace            0x40
+#define ElementsTypeStaticNormalTextureQuaternion (ElementsTypeStaticNormalTexture | ElementsTypeQuaternionTSpace)
+
+// NOTE: quantized positions and octahedral tangent space don't change the layout of the vertex elements.
+#define ELEMENTS_LAYOUT                         (ELEMENTS_TYPE & ~(ElementsTypeQuantizedPosition | ElementsTypeOctahedralTSpace))
 
 struct VertexElement
 {
-#if ELEMENTS_TYPE == ElementsTypeStaticNormal
+#if ELEMENTS_LAYOUT == ElementsTypeStaticNormal
     uint        ColorTSign;
     uint16_t2   Normal;
-#elif ELEMENTS_TYPE == ElementsTypeStaticNormalTexture
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticNormalTexture
     uint        ColorTSign;
     uint16_t2   Normal;
     uint16_t2   Tangent;
     float2      UV;
-#elif ELEMENTS_TYPE == ElementsTypeStaticColor
-#elif ELEMENTS_TYPE == ElementsTypeSkeletal
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalColor
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormal
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormalColor
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormalTexture
-#elif ELEMENTS_TYPE == ElementsTypeSkeletalNormalTextureColor
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticNormalTextureQuaternion
+    uint        ColorTSign;
+    uint        TBN;
+    float2      UV;
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticColor
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletal
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalColor
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormal
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormalColor
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormalTexture
+#elif ELEMENTS_LAYOUT == ElementsTypeSkeletalNormalTextureColor
 #endif
 };
 
 const static float InvIntervals = 2.f / ((1 << 16) - 1);
 
 ConstantBuffer<GlobalShaderData>                    GlobalData          : register(b0, space0);
-ConstantBuffer<PerObjectData>                       PerObjectBuffer     : register(b1, space0);
+#if ELEMENTS_TYPE & ElementsTypeQuantizedPosition
+ByteAddressBuffer                                   VertexPositions     : register(t0, space0);
+#else
 StructuredBuffer<float3>                            VertexPositions     : register(t0, space0);
+#endif
 StructuredBuffer<VertexElement>                     Elements            : register(t1, space0);
 
 StructuredBuffer<DirectionalLightParameters>        DirectionalLights   : register(t3, space0);
 StructuredBuffer<LightParameters>                   CullableLights      : register(t4, space0);
 StructuredBuffer<uint2>                             LightGrid           : register(t5, space0);
 StructuredBuffer<uint>                              LightIndexList      : register(t6, space0);
+// NOTE: the per-object data of all render items, indexed by render item id. InstanceItems is bound at the
+//       first instance of the draw, so it can be indexed with SV_InstanceID.
+StructuredBuffer<PerObjectData>                     PerObjectBuffer     : register(t7, space0);
+StructuredBuffer<uint>                              InstanceItems       : register(t8, space0);
 
-VertexOut TestShaderVS(in uint VertexIdx : SV_VertexID)
+float3 LoadPosition(uint vertexIdx, PerObjectData object)
+{
+#if ELEMENTS_TYPE & ElementsTypeQuantizedPosition
+    // NOTE: 3 x 16-bit unorm per vertex, so every other vertex starts in the middle of a uint.
+    const uint offset = vertexIdx * 6;
+    const uint2 words = VertexPositions.Load2(offset & ~3);
+    const uint3 q = (offset & 2) ? uint3(words.x >> 16, words.y & 0xffff, words.y >> 16)
+                                 : uint3(words.x & 0xffff, words.x >> 16, words.y & 0xffff);
+    return object.PositionOffset + float3(q) * object.PositionScale;
+#else
+    return VertexPositions[vertexIdx];
+#endif
+}
+
+// Unpacks a normal or tangent. signZ is only used by the default encoding (x, y and the sign of z).
+float3 UnpackUnitVector(uint16_t2 packed, float signZ)
+{
+    float2 xy = packed * InvIntervals - 1.f;
+#if ELEMENTS_TYPE & ElementsTypeOctahedralTSpace
+    float3 v = float3(xy.x, xy.y, 1.f - abs(xy.x) - abs(xy.y));
+    const float t = saturate(-v.z);
+    v.x += v.x >= 0.f ? -t : t;
+    v.y += v.y >= 0.f ? -t : t;
+    return normalize(v);
+#else
+    return float3(xy.x, xy.y, sqrt(saturate(1.f - dot(xy, xy))) * signZ);
+#endif
+}
+
+// Same as decode_tbn_quaternion() in ContentTools.
+void DecodeTBNQuaternion(uint packed, out float3 normal, out float3 tangent)
+{
+    const float invSqrt2 = 0.70710678f;
+    const uint largest = packed >> 30;
+    const float3 abc = float3((packed >> 20) & 0x3ff, (packed >> 10) & 0x3ff, packed & 0x3ff) * (2.f * invSqrt2 / 1023.f) - invSqrt2;
+    const float d = sqrt(saturate(1.f - dot(abc, abc)));
+    const float4 q = largest == 0 ? float4(d, abc.x, abc.y, abc.z) :
+                     largest == 1 ? float4(abc.x, d, abc.y, abc.z) :
+                     largest == 2 ? float4(abc.x, abc.y, d, abc.z) : float4(abc.x, abc.y, abc.z, d);
+
+    tangent = float3(1.f - 2.f * (q.y * q.y + q.z * q.z), 2.f * (q.x * q.y + q.w * q.z), 2.f * (q.x * q.z - q.w * q.y));
+    normal = float3(2.f * (q.x * q.z + q.w * q.y), 2.f * (q.y * q.z - q.w * q.x), 1.f - 2.f * (q.x * q.x + q.y * q.y));
+}
+
+VertexOut TestShaderVS(in uint VertexIdx : SV_VertexID, in uint InstanceIdx : SV_InstanceID)
 {
     VertexOut vsOut;
 
-    float4 position = float4(VertexPositions[VertexIdx], 1.f);
-    float4 worldPosition = mul(PerObjectBuffer.World, position);
+    const PerObjectData object = PerObjectBuffer[InstanceItems[InstanceIdx]];
+    float4 position = float4(LoadPosition(VertexIdx, object), 1.f);
+    float4 worldPosition = mul(object.World, position);
 
-#if ELEMENTS_TYPE == ElementsTypeStaticNormal
+#if ELEMENTS_LAYOUT == ElementsTypeStaticNormal
 
     VertexElement element = Elements[VertexIdx];
-    float2 nXY = element.Normal * InvIntervals - 1.f;
     uint signs = (element.ColorTSign >> 24) & 0xff;
     float nSign = float(signs & 0x02) - 1;
-    float3 normal = float3(nXY.x, nXY.y, sqrt(saturate(1.f - dot(nXY, nXY))) * nSign);
+    float3 normal = UnpackUnitVector(element.Normal, nSign);
 
-    vsOut.HomogeneousPosition = mul(PerObjectBuffer.WorldViewProjection, position);
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
     vsOut.WorldPosition = worldPosition.xyz;
-    vsOut.WorldNormal = mul(float4(normal, 0.f), PerObjectBuffer.InvWorld).xyz;
+    vsOut.WorldNormal = mul(float4(normal, 0.f), object.InvWorld).xyz;
     vsOut.WorldTangent = 0.f;
     vsOut.UV = 0.f;
 
-#elif ELEMENTS_TYPE == ElementsTypeStaticNormalTexture
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticNormalTexture
 
     VertexElement element = Elements[VertexIdx];
-    float2 nXY = element.Normal * InvIntervals - 1.f;
     uint signs = (element.ColorTSign >> 24) & 0xff;
     float nSign = float(signs & 0x02) - 1;
-    float3 normal = float3(nXY.x, nXY.y, sqrt(saturate(1.f - dot(nXY, nXY))) * nSign);
+    float3 normal = UnpackUnitVector(element.Normal, nSign);
+
+    // NOTE: bit 0 is the sign of tangent.z, bit 2 the handedness, which is needed for the bitangent only.
+    float tSign = float((signs & 0x01) << 1) - 1;
+    float3 tangent = UnpackUnitVector(element.Tangent, tSign);
 
-    vsOut.HomogeneousPosition = mul(PerObjectBuffer.WorldViewProjection, position);
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
     vsOut.WorldPosition = worldPosition.xyz;
-    vsOut.WorldNormal = mul(float4(normal, 0.f), PerObjectBuffer.InvWorld).xyz;
-    vsOut.WorldTangent = 0.f;
-    vsOut.UV = 0.f;
+    vsOut.WorldNormal = mul(float4(normal, 0.f), object.InvWorld).xyz;
+    vsOut.WorldTangent = mul(object.World, float4(tangent, 0.f)).xyz;
+    vsOut.UV = element.UV;
+#elif ELEMENTS_LAYOUT == ElementsTypeStaticNormalTextureQuaternion
+
+    VertexElement element = Elements[VertexIdx];
+    float3 normal, tangent;
+    DecodeTBNQuaternion(element.TBN, normal, tangent);
+
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
+    vsOut.WorldPosition = worldPosition.xyz;
+    vsOut.WorldNormal = mul(float4(normal, 0.f), object.InvWorld).xyz;
+    vsOut.WorldTangent = mul(object.World, float4(tangent, 0.f)).xyz;
+    vsOut.UV = element.UV;
 #else
 #undef ELEMENTS_TYPE
-    vsOut.HomogeneousPosition = mul(PerObjectBuffer.WorldViewProjection, position);
+    vsOut.HomogeneousPosition = mul(GlobalData.ViewProjection, worldPosition);
     vsOut.WorldPosition = worldPosition.xyz;
     vsOut.WorldNormal = 0.f;
     vsOut.WorldTangent = 0.f;
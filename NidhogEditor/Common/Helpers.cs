@@ -45,7 +45,7 @@ namespace NidhogEditor
 
     public static class ContentHelper
     {
-        public static string[] MeshFileExtensions = { ".fbx" };
+        public static string[] MeshFileExtensions = { ".fbx", ".obj", ".ply", ".gltf", ".glb" };
         public static string[] ImageFileExtensions = { ".bmp", ",png", ".jpg", ".jpeg", ".tiff", ".tif", ".tga", ".dds", ".hdr" };
         public static string[] AudioFileExtensions = { ".ogg", ".wav" };
         public static string GetRandomString(int length = 8)
@@ -7,6 +7,7 @@ using System.Collections.ObjectModel;
 using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Numerics;
 using System.Text;
 using System.Threading.Tasks;
 using System.Windows;
@@ -30,7 +31,11 @@ namespace NidhogEditor.Content
         Normals = 0x01,
         TSpace = 0x03,
         Joints = 0x04,
-        Colors = 0x08
+        Colors = 0x08,
+        QuantizedPosition = 0x10,
+        OctahedralTSpace = 0x20,
+        QuaternionTSpace = 0x40,
+        Meshlets = 0x80
     }
 
     enum PrimitiveTopology
@@ -45,7 +50,8 @@ namespace NidhogEditor.Content
     //类似c++中定义的mesh的output data
     class Mesh : ViewModelBase
     {
-        public static int PositionSize => sizeof(float) * 3;
+        // NOTE: quantized positions are 3 x 16-bit unorm, relative to AabbMin/AabbMax.
+        public int PositionSize => ElementsType.HasFlag(ElementsType.QuantizedPosition) ? sizeof(ushort) * 3 : sizeof(float) * 3;
 
         private int _elementSize;
         public int ElementSize
@@ -119,10 +125,22 @@ namespace NidhogEditor.Content
 
         public ElementsType ElementsType { get; set; }
         public PrimitiveTopology PrimitiveTopology { get; set; }
+        public Vector3 AabbMin { get; set; }
+        public Vector3 AabbMax { get; set; }
+        // NOTE: tight bounds of the vertices and the geometric error of the LOD, for culling and LOD selection.
+        //       AabbMin/AabbMax are only the bounds that quantized positions are relative to.
+        public Vector3 BoundsMin { get; set; }
+        public Vector3 BoundsMax { get; set; }
+        public Vector3 SphereCenter { get; set; }
+        public float SphereRadius { get; set; }
+        public float LodError { get; set; }
 
         public byte[] Positions { get; set; }
         public byte[] Elements { get; set; }
         public byte[] Indices { get; set; }
+        // NOTE: the meshlet section of the submesh as it comes from ContentTools, including the counts.
+        //       Only set if ElementsType has the Meshlets flag.
+        public byte[] Meshlets { get; set; }
     }
 
     class MeshLOD : ViewModelBase
@@ -311,9 +329,16 @@ namespace NidhogEditor.Content
         public void FromRawData(byte[] data)
         {
             Debug.Assert(data?.Length > 0);
+            using var stream = new MemoryStream(data);
+            FromRawData(stream);
+        }
+
+        public void FromRawData(Stream stream)
+        {
+            Debug.Assert(stream?.CanRead == true);
             _lodGroups.Clear();
 
-            using var reader = new BinaryReader(new MemoryStream(data));
+            using var reader = new BinaryReader(stream, Encoding.UTF8, true);
             // 暂时跳过读取场景名
             var s = reader.ReadInt32();
             reader.BaseStream.Position += s;
@@ -385,13 +410,23 @@ namespace NidhogEditor.Content
             mesh.IndexSize = reader.ReadInt32();
             mesh.IndexCount = reader.ReadInt32();
             var lodThreshold = reader.ReadSingle();
+            ReadBounds(reader, mesh);
+            if (mesh.ElementsType.HasFlag(ElementsType.QuantizedPosition))
+            {
+                mesh.AabbMin = ReadVector3(reader);
+                mesh.AabbMax = ReadVector3(reader);
+            }
 
             var elementsBufferSize = mesh.ElementSize * mesh.VertexCount;
             var indexBufferSize = mesh.IndexSize * mesh.IndexCount;
 
-            mesh.Positions = reader.ReadBytes(Mesh.PositionSize * mesh.VertexCount);
+            mesh.Positions = reader.ReadBytes(mesh.PositionSize * mesh.VertexCount);
             mesh.Elements = reader.ReadBytes(elementsBufferSize);
             mesh.Indices = reader.ReadBytes(indexBufferSize);
+            if (mesh.ElementsType.HasFlag(ElementsType.Meshlets))
+            {
+                mesh.Meshlets = ReadMeshlets(reader);
+            }
 
             MeshLOD lod;
             if (ID.IsValid(lodId) && lodIds.Contains(lodId))
@@ -418,6 +453,32 @@ namespace NidhogEditor.Content
             {
                 return ImportFbx(file);
             }
+            if (ext == ".obj" || ext == ".ply" || ext == ".gltf" || ext == ".glb")
+            {
+                return ImportMeshFile(file, ext);
+            }
+            return false;
+        }
+
+        // NOTE: OBJ, PLY and glTF files are only read (memory-mapped), so unlike FBX files they don't need a copy.
+        private bool ImportMeshFile(string file, string ext)
+        {
+            Logger.Log(MessageType.Info, $"Importing {ext.TrimStart('.')} file {file}");
+            try
+            {
+                if (ext == ".obj") ContentToolsAPI.ImportObj(file, this);
+                else if (ext == ".ply") ContentToolsAPI.ImportPly(file, this);
+                else ContentToolsAPI.ImportGltf(file, this);
+                return true;
+            }
+            catch (Exception ex)
+            {
+                Debug.WriteLine(ex.Message);
+                var msg = $"Failed to read {file} for import";
+                Debug.WriteLine(msg);
+                Logger.Log(MessageType.Error, msg);
+            }
+
             return false;
         }
 
@@ -564,23 +625,40 @@ namespace NidhogEditor.Content
             return savedFiles;
         }
 
+        // NOTE: must match content::geometry_format in the engine. The engine rejects geometry with another version.
+        private const uint EngineGeometryFormatTag = 0x4d47484e; // "NHGM"
+        private const uint EngineGeometryFormatVersion = 2;
+
         /// <summary>
         /// Packs the geometry into a byte array which can be used by the engine.
         /// </summary>
         /// <returns>
         /// A byte array that contains
         /// struct{
+        ///     u32 format_tag,                                           // EngineGeometryFormatTag
+        ///     u32 format_version,                                       // EngineGeometryFormatVersion
         ///     u32 lod_count,
         ///     struct {
         ///         f32 lod_threshold,
         ///         u32 submesh_count,
         ///         u32 size_of_submeshes,
         ///         struct {
+        ///             f32 bounds_min[3], f32 bounds_max[3],             // tight AABB of the vertices
+        ///             f32 sphere_center[3], f32 sphere_radius,
+        ///             f32 lod_error,                                    // geometric error compared to LOD 0
         ///             u32 element_size, u32 vertex_count,
         ///             u32 index_count, u32 elements_type, u32 primitive_topology
-        ///             u8 positions[sizeof(f32) * 3 * vertex_count],     // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
+        ///             f32 aabb_min[3], f32 aabb_max[3],                 // only if elements_type has the quantized_position flag.
+        ///             u8 positions[position_size * vertex_count],       // sizeof(positions) must be a multiple of 4 bytes. Pad if needed.
         ///             u8 elements[sizeof(element_size) * vertex_count], // sizeof(elements) must be a multiple of 4 bytes. Pad if needed.
-        ///             u8 indices[index_size * index_count]
+        ///             u8 indices[index_size * index_count],
+        ///             struct {                                          // only if elements_type has the meshlets flag.
+        ///                 u32 meshlet_count, u32 meshlet_vertex_count, u32 meshlet_triangle_index_count,
+        ///                 meshlet meshlets[meshlet_count],              // u32 vertex_offset, triangle_offset, vertex_count, triangle_count
+        ///                 meshlet_bounds bounds[meshlet_count],         // f32 center[3], radius, cone_axis[3], cone_cutoff
+        ///                 u32 meshlet_vertices[meshlet_vertex_count],
+        ///                 u8 meshlet_triangles[meshlet_triangle_index_count] // padded to a multiple of 4 bytes.
+        ///             } meshlets
         ///         } submeshes[submesh_count]
         ///     } mesh_lods[lod_count]
         /// } geometry;
@@ -589,6 +667,8 @@ namespace NidhogEditor.Content
         {
             using var writer = new BinaryWriter(new MemoryStream());
 
+            writer.Write(EngineGeometryFormatTag);
+            writer.Write(EngineGeometryFormatVersion);
             writer.Write(GetLODGroup().LODs.Count);
             foreach (var lod in GetLODGroup().LODs)
             {
@@ -598,11 +678,17 @@ namespace NidhogEditor.Content
                 writer.Write(0);
                 foreach (var mesh in lod.Meshes)
                 {
+                    WriteBounds(writer, mesh);
                     writer.Write(mesh.ElementSize);
                     writer.Write(mesh.VertexCount);
                     writer.Write(mesh.IndexCount);
                     writer.Write((int)mesh.ElementsType);
                     writer.Write((int)mesh.PrimitiveTopology);
+                    if (mesh.ElementsType.HasFlag(ElementsType.QuantizedPosition))
+                    {
+                        WriteVector3(writer, mesh.AabbMin);
+                        WriteVector3(writer, mesh.AabbMax);
+                    }
 
                     var alignedPositionBuffer = new byte[MathUtil.AlignSizeUp(mesh.Positions.Length, 4)];
                     Array.Copy(mesh.Positions, alignedPositionBuffer, mesh.Positions.Length);
@@ -612,6 +698,10 @@ namespace NidhogEditor.Content
                     writer.Write(alignedPositionBuffer);
                     writer.Write(alignedElementBuffer);
                     writer.Write(mesh.Indices);
+                    if (mesh.ElementsType.HasFlag(ElementsType.Meshlets))
+                    {
+                        writer.Write(mesh.Meshlets);
+                    }
                 }
 
                 var endOfSubmeshes = writer.BaseStream.Position;
@@ -654,9 +744,19 @@ namespace NidhogEditor.Content
                 writer.Write(mesh.VertexCount);
                 writer.Write(mesh.IndexSize);
                 writer.Write(mesh.IndexCount);
+                WriteBounds(writer, mesh);
+                if (mesh.ElementsType.HasFlag(ElementsType.QuantizedPosition))
+                {
+                    WriteVector3(writer, mesh.AabbMin);
+                    WriteVector3(writer, mesh.AabbMax);
+                }
                 writer.Write(mesh.Positions);
                 writer.Write(mesh.Elements);
                 writer.Write(mesh.Indices);
+                if (mesh.ElementsType.HasFlag(ElementsType.Meshlets))
+                {
+                    writer.Write(mesh.Meshlets);
+                }
             }
 
             var meshDataSize = writer.BaseStream.Position - meshDataBegin;
@@ -685,9 +785,20 @@ namespace NidhogEditor.Content
                     IndexCount = reader.ReadInt32()
                 };
 
-                mesh.Positions = reader.ReadBytes(Mesh.PositionSize * mesh.VertexCount);
+                ReadBounds(reader, mesh);
+                if (mesh.ElementsType.HasFlag(ElementsType.QuantizedPosition))
+                {
+                    mesh.AabbMin = ReadVector3(reader);
+                    mesh.AabbMax = ReadVector3(reader);
+                }
+
+                mesh.Positions = reader.ReadBytes(mesh.PositionSize * mesh.VertexCount);
                 mesh.Elements = reader.ReadBytes(mesh.ElementSize * mesh.VertexCount);
                 mesh.Indices = reader.ReadBytes(mesh.IndexSize * mesh.IndexCount);
+                if (mesh.ElementsType.HasFlag(ElementsType.Meshlets))
+                {
+                    mesh.Meshlets = ReadMeshlets(reader);
+                }
 
                 lod.Meshes.Add(mesh);
             }
@@ -695,6 +806,52 @@ namespace NidhogEditor.Content
             return lod;
         }
 
+        private static byte[] ReadMeshlets(BinaryReader reader)
+        {
+            const int meshletSize = sizeof(int) * 4;
+            const int meshletBoundsSize = sizeof(float) * 8;
+
+            var meshletCount = reader.ReadInt32();
+            var vertexCount = reader.ReadInt32();
+            var triangleIndexCount = reader.ReadInt32();
+            var size = meshletCount * (meshletSize + meshletBoundsSize) + vertexCount * sizeof(int) + MathUtil.AlignSizeUp(triangleIndexCount, 4);
+
+            using var writer = new BinaryWriter(new MemoryStream());
+            writer.Write(meshletCount);
+            writer.Write(vertexCount);
+            writer.Write(triangleIndexCount);
+            writer.Write(reader.ReadBytes(size));
+            writer.Flush();
+            return (writer.BaseStream as MemoryStream).ToArray();
+        }
+
+        private static Vector3 ReadVector3(BinaryReader reader) => new(reader.ReadSingle(), reader.ReadSingle(), reader.ReadSingle());
+
+        private static void WriteVector3(BinaryWriter writer, Vector3 v)
+        {
+            writer.Write(v.X);
+            writer.Write(v.Y);
+            writer.Write(v.Z);
+        }
+
+        private static void ReadBounds(BinaryReader reader, Mesh mesh)
+        {
+            mesh.BoundsMin = ReadVector3(reader);
+            mesh.BoundsMax = ReadVector3(reader);
+            mesh.SphereCenter = ReadVector3(reader);
+            mesh.SphereRadius = reader.ReadSingle();
+            mesh.LodError = reader.ReadSingle();
+        }
+
+        private static void WriteBounds(BinaryWriter writer, Mesh mesh)
+        {
+            WriteVector3(writer, mesh.BoundsMin);
+            WriteVector3(writer, mesh.BoundsMax);
+            WriteVector3(writer, mesh.SphereCenter);
+            writer.Write(mesh.SphereRadius);
+            writer.Write(mesh.LodError);
+        }
+
         private static byte[] GenerateIcon(MeshLOD lod)
         {
             var width = ContentInfo.IconWidth * 4;
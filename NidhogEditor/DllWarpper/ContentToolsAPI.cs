@@ -112,6 +112,11 @@ namespace NidhogEditor.ContentToolsAPIStructs
         public byte ReverseHandedness = 0;
         public byte ImportEmbededTextures = 1;
         public byte ImportAnimations = 1;
+        public byte AutoLodCount = 3;
+        public byte QuantizePositions = 0;
+        public byte TSpaceEncoding = 0; // 0: x/y and sign of z, 1: octahedral, 2: quaternion
+        public byte BuildMeshlets = 1;
+        public byte LogStats = 0;
 
 
         private byte ToByte(bool value) => value ? (byte)1 : (byte)0;
@@ -135,7 +140,7 @@ namespace NidhogEditor.ContentToolsAPIStructs
     class SceneData : IDisposable
     {
         public IntPtr Data;
-        public int DataSize;
+        public long DataSize;
         public GeometryImportSettings ImportSettings = new();
 
         public void Dispose()
@@ -313,9 +318,10 @@ namespace NidhogEditor.DllWrapper
                 sceneData.ImportSettings.FromContentSettings(geometry);
                 sceneDataGenerator(sceneData);
                 Debug.Assert(sceneData.Data != IntPtr.Zero && sceneData.DataSize > 0);
+                if (sceneData.DataSize > int.MaxValue) throw new InvalidOperationException("Scene data is too large for a single buffer.");
                 var data = new byte[sceneData.DataSize];
                 //数据传递
-                Marshal.Copy(sceneData.Data, data, 0, sceneData.DataSize);
+                Marshal.Copy(sceneData.Data, data, 0, (int)sceneData.DataSize);
                 //删除原来的buffer释放内存（可以自动化的释放）
                 geometry.FromRawData(data);
             }
@@ -332,12 +338,60 @@ namespace NidhogEditor.DllWrapper
             GeometryFromSceneData(geometry, (sceneData) => CreatePrimitiveMesh(sceneData, info), $"Failed to create {info.Type} primitive mesh.");
         }
 
-        [DllImport(_toolsDLL)]
-        private static extern void ImportFbx(string file, [In, Out] SceneData data);
+        // NOTE: imported scenes can be very large (e.g. scans that are processed out of core), so ContentTools
+        //       streams them to a temporary file instead of returning them in a single buffer.
+        private static void GeometryFromSceneFile(Content.Geometry geometry, Action<string, SceneData> sceneFileGenerator, string failureMessage)
+        {
+            Debug.Assert(geometry != null);
+            using var sceneData = new SceneData();
+            var output = Path.GetTempFileName();
+            try
+            {
+                sceneData.ImportSettings.FromContentSettings(geometry);
+                sceneFileGenerator(output, sceneData);
+                if (sceneData.DataSize <= 0) throw new InvalidOperationException($"ContentTools didn't write {output}.");
+
+                using var stream = new FileStream(output, FileMode.Open, FileAccess.Read);
+                Debug.Assert(stream.Length == sceneData.DataSize);
+                geometry.FromRawData(stream);
+            }
+            catch (Exception ex)
+            {
+                Logger.Log(MessageType.Error, failureMessage);
+                Debug.WriteLine(ex.Message);
+            }
+            finally
+            {
+                File.Delete(output);
+            }
+        }
 
+        [DllImport(_toolsDLL)]
+        private static extern void ImportFbxToFile(string file, string output, [In, Out] SceneData data);
         public static void ImportFbx(string file, Content.Geometry geometry)
         {
-            GeometryFromSceneData(geometry, (sceneData) => ImportFbx(file, sceneData), $"Failed to import from FBX file: {file}");
+            GeometryFromSceneFile(geometry, (output, sceneData) => ImportFbxToFile(file, output, sceneData), $"Failed to import from FBX file: {file}");
+        }
+
+        [DllImport(_toolsDLL)]
+        private static extern void ImportObjToFile(string file, string output, [In, Out] SceneData data);
+        public static void ImportObj(string file, Content.Geometry geometry)
+        {
+            GeometryFromSceneFile(geometry, (output, sceneData) => ImportObjToFile(file, output, sceneData), $"Failed to import from OBJ file: {file}");
+        }
+
+        [DllImport(_toolsDLL)]
+        private static extern void ImportPlyToFile(string file, string output, [In, Out] SceneData data);
+        public static void ImportPly(string file, Content.Geometry geometry)
+        {
+            GeometryFromSceneFile(geometry, (output, sceneData) => ImportPlyToFile(file, output, sceneData), $"Failed to import from PLY file: {file}");
+        }
+
+        [DllImport(_toolsDLL)]
+        private static extern void ImportGltfToFile(string file, string output, [In, Out] SceneData data);
+        public static void ImportGltf(string file, Content.Geometry geometry)
+        {
+            GeometryFromSceneFile(geometry, (output, sceneData) => ImportGltfToFile(file, output, sceneData), $"Failed to import from glTF file: {file}");
         }
         #endregion Geometry
     }
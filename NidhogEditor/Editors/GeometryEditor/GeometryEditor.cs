@@ -191,6 +191,35 @@ namespace NidhogEditor.Editors
             }
         }
 
+        // Same as decode_octahedral() in ContentTools, with x and y already unpacked to [-1, 1].
+        private static Vector3D DecodeOctahedral(double x, double y)
+        {
+            var z = 1.0 - Math.Abs(x) - Math.Abs(y);
+            var t = Math.Clamp(-z, 0.0, 1.0);
+            return new Vector3D(x >= 0.0 ? x - t : x + t, y >= 0.0 ? y - t : y + t, z);
+        }
+
+        // Same as decode_tbn_quaternion() in ContentTools, but we only need the normal here.
+        private static Vector3D DecodeQuaternionNormal(uint packed)
+        {
+            const double invSqrt2 = 0.70710678;
+            var largest = (int)(packed >> 30);
+            var q = new double[4];
+            var sum = 0.0;
+            var shift = 20;
+            for (int i = 0; i < 4; ++i)
+            {
+                if (i == largest) continue;
+                q[i] = ((packed >> shift) & 0x3ff) / 1023.0 * 2.0 * invSqrt2 - invSqrt2;
+                sum += q[i] * q[i];
+                shift -= 10;
+            }
+            q[largest] = Math.Sqrt(Math.Max(0.0, 1.0 - sum));
+
+            double x = q[0], y = q[1], z = q[2], w = q[3];
+            return new Vector3D(2.0 * (x * z + w * y), 2.0 * (y * z - w * x), 1.0 - 2.0 * (x * x + y * y));
+        }
+
         public MeshRenderer(MeshLOD lod, MeshRenderer old)
         {
             Debug.Assert(lod?.Meshes.Any() == true);
@@ -206,13 +235,15 @@ namespace NidhogEditor.Editors
             {
                 var vertexData = new MeshRendererVertexData() { Name = mesh.Name };
                 // Unpack all vertices
+                var quantized = mesh.ElementsType.HasFlag(ElementsType.QuantizedPosition);
+                var scale = (mesh.AabbMax - mesh.AabbMin) / ushort.MaxValue;
                 using (var reader = new BinaryReader(new MemoryStream(mesh.Positions)))
                     for (int i = 0; i < mesh.VertexCount; ++i)
                     {
-                        // Read positions
-                        var posX = reader.ReadSingle();
-                        var posY = reader.ReadSingle();
-                        var posZ = reader.ReadSingle();
+                        // Read positions (unpack them if they're quantized)
+                        var posX = quantized ? mesh.AabbMin.X + reader.ReadUInt16() * scale.X : reader.ReadSingle();
+                        var posY = quantized ? mesh.AabbMin.Y + reader.ReadUInt16() * scale.Y : reader.ReadSingle();
+                        var posZ = quantized ? mesh.AabbMin.Z + reader.ReadUInt16() * scale.Z : reader.ReadSingle();
                         vertexData.Positions.Add(new Point3D(posX, posY, posZ));
 
                         // Adjust the bounding box:
@@ -231,10 +262,22 @@ namespace NidhogEditor.Editors
                             var signs = (reader.ReadUInt32() >> 24) & 0x000000ff;
                             reader.BaseStream.Position += tSpaceOffset;
                             // Read normals
-                            var nrmX = reader.ReadUInt16() * intervals - 1.0f;
-                            var nrmY = reader.ReadUInt16() * intervals - 1.0f;
-                            var nrmZ = Math.Sqrt(Math.Clamp(1f - (nrmX * nrmX + nrmY * nrmY), 0f, 1f)) * ((signs & 0x2) - 1f);
-                            var normal = new Vector3D(nrmX, nrmY, nrmZ);
+                            Vector3D normal;
+                            if (mesh.ElementsType.HasFlag(ElementsType.QuaternionTSpace))
+                            {
+                                normal = DecodeQuaternionNormal(reader.ReadUInt32());
+                            }
+                            else if (mesh.ElementsType.HasFlag(ElementsType.OctahedralTSpace))
+                            {
+                                normal = DecodeOctahedral(reader.ReadUInt16() * intervals - 1.0f, reader.ReadUInt16() * intervals - 1.0f);
+                            }
+                            else
+                            {
+                                var nrmX = reader.ReadUInt16() * intervals - 1.0f;
+                                var nrmY = reader.ReadUInt16() * intervals - 1.0f;
+                                var nrmZ = Math.Sqrt(Math.Clamp(1f - (nrmX * nrmX + nrmY * nrmY), 0f, 1f)) * ((signs & 0x2) - 1f);
+                                normal = new Vector3D(nrmX, nrmY, nrmZ);
+                            }
                             normal.Normalize();
                             vertexData.Normals.Add(normal);
                             avgNormal += normal;
@@ -242,7 +285,8 @@ namespace NidhogEditor.Editors
                             // Read UVs
                             if (mesh.ElementsType.HasFlag(ElementsType.TSpace))
                             {
-                                reader.BaseStream.Position += sizeof(short) * 2; // skip tangents.
+                                // skip tangents (they're part of the quaternion in the quaternion layout).
+                                if (!mesh.ElementsType.HasFlag(ElementsType.QuaternionTSpace)) reader.BaseStream.Position += sizeof(short) * 2;
                                 var u = reader.ReadSingle();
                                 var v = reader.ReadSingle();
                                 vertexData.UVs.Add(new Point(u, v));